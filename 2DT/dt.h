@@ -73,4 +73,18 @@ int DT_destroy(void);
 */
 char *DT_toString(void);
 
+/*
+  Returns a string representation of the part of the data structure
+  rooted at absolute path pcPath and extending at most ulMaxDepth
+  levels below it (0 for just pcPath; (size_t) -1 for the whole
+  hierarchy), in the format of DT_toString. The string is sized
+  exactly, in one pass over only the nodes it represents. Returns NULL
+  if the structure is not initialized, pcPath is not in it, or there
+  is an allocation error.
+
+  Allocates memory for the returned string,
+  which is then owned by client!
+*/
+char *DT_toStringAt(const char *pcPath, size_t ulMaxDepth);
+
 #endif
@@ -27,6 +27,8 @@ static boolean bIsInitialized;
 static Node_T oNRoot;
 /* 3. a counter of the number of nodes in the hierarchy */
 static size_t ulCount;
+/* 4. the length of DT_toString's result, without its '\0' */
+static size_t ulStringLength;
 
 
 
@@ -163,6 +165,23 @@ static int DT_findNode(const char *pcPath, Node_T *poNResult) {
    *poNResult = oNFound;
    return SUCCESS;
 }
+
+/* Returns the length of the lines that the subtree rooted at oNNode,
+   down to ulMaxDepth levels below it ((size_t) -1 for all),
+   contributes to DT_toString's result. */
+static size_t DT_subtreeLength(Node_T oNNode, size_t ulMaxDepth) {
+   size_t ulLength = Path_getStrLength(Node_getPath(oNNode)) + 1;
+   size_t c;
+
+   if(ulMaxDepth == 0)
+      return ulLength;
+   for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, c, &oNChild);
+      ulLength += DT_subtreeLength(oNChild, ulMaxDepth - 1);
+   }
+   return ulLength;
+}
 /*--------------------------------------------------------------------*/
 
 
@@ -173,6 +192,7 @@ int DT_insert(const char *pcPath) {
    Node_T oNCurr = NULL;
    size_t ulDepth, ulIndex;
    size_t ulNewNodes = 0;
+   size_t ulNewLength = 0;
 
    assert(pcPath != NULL);
    assert(CheckerDT_isValid(bIsInitialized, oNRoot, ulCount));
@@ -241,6 +261,7 @@ int DT_insert(const char *pcPath) {
       }
 
       /* set up for next level */
+      ulNewLength += Path_getStrLength(oPPrefix) + 1;
       Path_free(oPPrefix);
       oNCurr = oNNewNode;
       ulNewNodes++;
@@ -254,6 +275,7 @@ int DT_insert(const char *pcPath) {
    if(oNRoot == NULL)
       oNRoot = oNFirstNew;
    ulCount += ulNewNodes;
+   ulStringLength += ulNewLength;
 
    assert(CheckerDT_isValid(bIsInitialized, oNRoot, ulCount));
    return SUCCESS;
@@ -282,6 +304,7 @@ int DT_rm(const char *pcPath) {
    if(iStatus != SUCCESS)
        return iStatus;
 
+   ulStringLength -= DT_subtreeLength(oNFound, (size_t) -1);
    ulCount -= Node_free(oNFound);
    if(ulCount == 0)
       oNRoot = NULL;
@@ -299,6 +322,7 @@ int DT_init(void) {
    bIsInitialized = TRUE;
    oNRoot = NULL;
    ulCount = 0;
+   ulStringLength = 0;
 
    assert(CheckerDT_isValid(bIsInitialized, oNRoot, ulCount));
    return SUCCESS;
@@ -314,6 +338,7 @@ int DT_destroy(void) {
       ulCount -= Node_free(oNRoot);
       oNRoot = NULL;
    }
+   ulStringLength = 0;
 
    bIsInitialized = FALSE;
 
@@ -329,81 +354,65 @@ int DT_destroy(void) {
 */
 
 /*
-  Performs a pre-order traversal of the tree rooted at n,
-  inserting each payload to DynArray_T d beginning at index i.
-  Returns the next unused index in d after the insertion(s).
+  Writes the lines of the subtree rooted at oNNode down to ulMaxDepth
+  levels below it ((size_t) -1 for all), in the pre-order of
+  DT_toString, to pcNext, and returns the position just past them.
 */
-static size_t DT_preOrderTraversal(Node_T n, DynArray_T d, size_t i) {
+static char *DT_writeSubtree(Node_T oNNode, size_t ulMaxDepth,
+                             char *pcNext) {
+   Path_T oPPath = Node_getPath(oNNode);
+   size_t ulPathLength = Path_getStrLength(oPPath);
    size_t c;
 
-   assert(d != NULL);
-
-   if(n != NULL) {
-      (void) DynArray_set(d, i, n);
-      i++;
-      for(c = 0; c < Node_getNumChildren(n); c++) {
-         int iStatus;
-         Node_T oNChild = NULL;
-         iStatus = Node_getChild(n,c, &oNChild);
-         assert(iStatus == SUCCESS);
-         i = DT_preOrderTraversal(oNChild, d, i);
-      }
-   }
-   return i;
-}
-
-/*
-  Alternate version of strlen that uses pulAcc as an in-out parameter
-  to accumulate a string length, rather than returning the length of
-  oNNode's path, and also always adds one addition byte to the sum.
-*/
-static void DT_strlenAccumulate(Node_T oNNode, size_t *pulAcc) {
-   assert(pulAcc != NULL);
-
-   if(oNNode != NULL)
-      *pulAcc += (Path_getStrLength(Node_getPath(oNNode)) + 1);
-}
-
-/*
-  Alternate version of strcat that inverts the typical argument
-  order, appending oNNode's path onto pcAcc, and also always adds one
-  newline at the end of the concatenated string.
-*/
-static void DT_strcatAccumulate(Node_T oNNode, char *pcAcc) {
-   assert(pcAcc != NULL);
-
-   if(oNNode != NULL) {
-      strcat(pcAcc, Path_getPathname(Node_getPath(oNNode)));
-      strcat(pcAcc, "\n");
+   memcpy(pcNext, Path_getPathname(oPPath), ulPathLength);
+   pcNext += ulPathLength;
+   *pcNext++ = '\n';
+   if(ulMaxDepth == 0)
+      return pcNext;
+   for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, c, &oNChild);
+      pcNext = DT_writeSubtree(oNChild, ulMaxDepth - 1, pcNext);
    }
+   return pcNext;
 }
 /*--------------------------------------------------------------------*/
 
 char *DT_toString(void) {
-   DynArray_T nodes;
-   size_t totalStrlen = 1;
-   char *result = NULL;
+   char *pcResult;
 
    if(!bIsInitialized)
       return NULL;
 
-   nodes = DynArray_new(ulCount);
-   (void) DT_preOrderTraversal(oNRoot, nodes, 0);
+   /* the length is kept up to date, so each path is copied once, at
+      the end of what has been written */
+   pcResult = malloc(ulStringLength + 1);
+   if(pcResult == NULL)
+      return NULL;
+   if(oNRoot != NULL)
+      (void) DT_writeSubtree(oNRoot, (size_t) -1, pcResult);
+   pcResult[ulStringLength] = '\0';
 
-   DynArray_map(nodes, (void (*)(void *, void*)) DT_strlenAccumulate,
-                (void*) &totalStrlen);
+   return pcResult;
+}
 
-   result = malloc(totalStrlen);
-   if(result == NULL) {
-      DynArray_free(nodes);
-      return NULL;
-   }
-   *result = '\0';
+char *DT_toStringAt(const char *pcPath, size_t ulMaxDepth) {
+   Node_T oNFound = NULL;
+   size_t ulLength;
+   char *pcResult;
 
-   DynArray_map(nodes, (void (*)(void *, void*)) DT_strcatAccumulate,
-                (void *) result);
+   assert(pcPath != NULL);
 
-   DynArray_free(nodes);
+   if(DT_findNode(pcPath, &oNFound) != SUCCESS)
+      return NULL;
 
-   return result;
+   /* the length is measured first, so each path is copied once, in
+      place */
+   ulLength = DT_subtreeLength(oNFound, ulMaxDepth);
+   pcResult = malloc(ulLength + 1);
+   if(pcResult == NULL)
+      return NULL;
+   (void) DT_writeSubtree(oNFound, ulMaxDepth, pcResult);
+   pcResult[ulLength] = '\0';
+   return pcResult;
 }
@@ -8,76 +8,127 @@
 #include <string.h>
 #include "checkerFT.h"
 #include "dynarray.h"
-#include "path.h"
 #include "nodeFT.h"
 
 /* helper function checking the parent-child relation invariants */
 static boolean checkerFT_Child_isValid(Node_T oNParent, Node_T oNChild,
                                        size_t index, size_t totChildren) {
-    Path_T oPPPath;
-    Path_T oPNPath;
-    Node_T oNOtherChild;
     Node_T oNPrevChild;
-    size_t j;
     
     assert(oNParent != NULL);
 
-    oPNPath = Node_getPath(oNChild);
-    oPPPath = Node_getPath(oNParent);
-
     /* child shouldn't be NULL */
     if(oNChild == NULL) {
         fprintf(stderr, "Child shouldn't be NULL\n");
         return FALSE;
     }
 
-    /* the child's pointer should be the same as the parent */
-    if(Node_getParent(oNChild) != oNParent) {
+    /* the child's pointer should be the same as the parent, unless
+       the parent is shared and the child is the snapshot's */
+    if(!Node_isShared(oNParent) && Node_getParent(oNChild) != oNParent) {
       fprintf(stderr, "Child's parent pointer doesn't match the parnet\n");
       return FALSE;
     }
-    
-    if(oPPPath == NULL || oPNPath == NULL) {
-        fprintf(stderr, "parent or child path is NULL\n");
-        return FALSE;
+
+  /* adding check for order; strictly increasing names also rule out
+     duplicate children under the same parent */
+    if(index > 0 && index < totChildren) {
+      oNPrevChild = Node_peekChild(oNParent, index-1);
+      if(oNPrevChild != NULL) {
+        
+        if(strcmp(Node_getName(oNPrevChild), Node_getName(oNChild)) >= 0) {
+          fprintf(stderr, "children names out of order or duplicated: (%s) (%s)\n",
+                  Node_getName(oNPrevChild), Node_getName(oNChild));
+          return FALSE;
+        }
+      }
     }
 
-    /* parent must be the longest proper prefix of child's path */
-    if(Path_getSharedPrefixDepth(oPNPath, oPPPath) !=
-       Path_getDepth(oPNPath) - 1) {
-        fprintf(stderr, "P-C nodes don't have P-C paths: (%s) (%s)\n",
-                 Path_getPathname(oPPPath), Path_getPathname(oPNPath));
+    return TRUE;
+}
+
+/* helper function checking that a directory's file size aggregates
+   agree with its children's */
+static boolean checkerFT_Sizes_areValid(Node_T oNNode) {
+    size_t ulFiles = 0;
+    size_t ulMax = 0;
+    size_t ulMin = 0;
+    size_t ulBucket;
+    size_t ulIndex;
+    Node_T oNChild;
+
+    for(ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++) {
+        oNChild = Node_peekChild(oNNode, ulIndex);
+        if(Node_getNumFiles(oNChild) == 0)
+            continue;
+        if(ulFiles == 0 || Node_getMaxFileSize(oNChild) > ulMax)
+            ulMax = Node_getMaxFileSize(oNChild);
+        if(ulFiles == 0 || Node_getMinFileSize(oNChild) < ulMin)
+            ulMin = Node_getMinFileSize(oNChild);
+        ulFiles += Node_getNumFiles(oNChild);
+    }
+    if(ulFiles != Node_getNumFiles(oNNode) ||
+       ulMax != Node_getMaxFileSize(oNNode) ||
+       ulMin != Node_getMinFileSize(oNNode)) {
+        fprintf(stderr, "Directory file size aggregates are stale: (%s)\n",
+                Node_getName(oNNode));
         return FALSE;
     }
 
-    /* adding check for duplicate children under the same parent */
-    for(j = index + 1; j < totChildren; j++) {
-        oNOtherChild = NULL;
-        if (Node_getChild(oNParent, j, &oNOtherChild) == SUCCESS &&
-            oNOtherChild != NULL) {
-            if(Path_comparePath(Node_getPath(oNChild),Node_getPath(oNOtherChild))
-                == 0) {
-                fprintf(stderr, "duplicate child paths under parent: (%s) (%s)\n",
-                        Path_getPathname(oPPPath), Path_getPathname(oPNPath));
-                return FALSE;
-            }
+    for(ulBucket = 0; ulBucket < NODE_SIZE_BUCKETS; ulBucket++) {
+        size_t ulSum = 0;
+        for(ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+            ulSum += Node_getBucketCount(Node_peekChild(oNNode, ulIndex),
+                                         ulBucket);
+        if(ulSum != Node_getBucketCount(oNNode, ulBucket)) {
+            fprintf(stderr, "Directory size bucket %lu is stale: (%s)\n",
+                    (unsigned long) ulBucket,
+                    Node_getName(oNNode));
+            return FALSE;
         }
-      
     }
-  
-  /* adding check for order */
-    if(index > 0) {
-      oNPrevChild = NULL;
-      if(Node_getChild(oNParent, index-1, &oNPrevChild) == SUCCESS &&
-        oNPrevChild != NULL) {
-        
-        if(Path_comparePath(Node_getPath(oNPrevChild),Node_getPath(oNChild)) > 0) {
-          fprintf(stderr, "children names out of order\n");
-          return FALSE;
+    return TRUE;
+}
+
+/*
+  Returns TRUE if oNNode's subtree node count is one more than the sum
+  of its children's, its per-child prefix sums agree with them, and
+  its length of the paths below it is the sum of its children's
+  subtrees' lengths as seen from it.
+*/
+static boolean checkerFT_Counts_areValid(Node_T oNNode) {
+    size_t ulNodes = 0;
+    size_t ulLength = 0;
+    size_t ulIndex;
+    Node_T oNChild;
+
+    for(ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++) {
+        if(Node_getNodesBefore(oNNode, ulIndex) != ulNodes) {
+            fprintf(stderr, "Directory child prefix count is stale: (%s)\n",
+                    Node_getName(oNNode));
+            return FALSE;
         }
-      }
+        oNChild = Node_peekChild(oNNode, ulIndex);
+        if(Node_hasHash(oNNode) && !Node_hasHash(oNChild)) {
+            fprintf(stderr, "Hash outlives a child's change: (%s)\n",
+                    Node_getName(oNNode));
+            return FALSE;
+        }
+        ulNodes += Node_getNumNodes(oNChild);
+        ulLength += Node_getNumNodes(oNChild) *
+                    (strlen(Node_getName(oNChild)) + 1) +
+                    Node_getBelowLength(oNChild);
+    }
+    if(ulNodes + 1 != Node_getNumNodes(oNNode)) {
+        fprintf(stderr, "Subtree node count is stale: (%s)\n",
+                Node_getName(oNNode));
+        return FALSE;
+    }
+    if(ulLength != Node_getBelowLength(oNNode)) {
+        fprintf(stderr, "Subtree path length is stale: (%s)\n",
+                Node_getName(oNNode));
+        return FALSE;
     }
-
     return TRUE;
 }
 
@@ -85,8 +136,7 @@ static boolean checkerFT_Child_isValid(Node_T oNParent, Node_T oNChild,
 boolean CheckerFT_Node_isValid(Node_T oNNode) {
    Node_T oNParent;
    Node_T oNChild;
-   Path_T oPNPath;
-   Path_T oPPPath;
+   const char *pcName;
    size_t ulNumChildren;
    size_t ulIndex;
 
@@ -96,35 +146,22 @@ boolean CheckerFT_Node_isValid(Node_T oNNode) {
       return FALSE;
    }
     
-    /* adding check that the node path is not null */
-    oPNPath = Node_getPath(oNNode);
-    if(oPNPath == NULL) {
-        fprintf(stderr, "Node has a NULL path\n");
+    /* adding check that the node's name is a valid path component */
+    pcName = Node_getName(oNNode);
+    if(pcName == NULL || *pcName == '\0' || strchr(pcName, '/') != NULL) {
+        fprintf(stderr, "Node has an empty or invalid name\n");
         return FALSE;
     }
 
-   /* Sample check: parent's path must be the longest possible
-      proper prefix of the node's path */
+   /* Sample check: a node other than a root must be among its
+      parent's children (a parentless file is the root of a detached
+      subtree; the FT's own root is checked in CheckerFT_isValid) */
    oNParent = Node_getParent(oNNode);
-   if(oNParent == NULL) {
-     if(Node_isFile(oNNode)) {
-       fprintf(stderr, "root node is a file\n");
-       return FALSE;
-     }
-   }
-   else {
-       oPNPath = Node_getPath(oNNode);
-       oPPPath = Node_getPath(oNParent);
-
-       if(oPPPath == NULL || oPNPath == NULL) {
-           fprintf(stderr, "parent or child path is NULL\n");
-           return FALSE;
-       }
-
-      if(Path_getSharedPrefixDepth(oPNPath, oPPPath) !=
-         Path_getDepth(oPNPath) - 1) {
-         fprintf(stderr, "P-C nodes don't have P-C paths: (%s) (%s)\n",
-                 Path_getPathname(oPPPath), Path_getPathname(oPNPath));
+   if(oNParent != NULL) {
+      if(!Node_hasChildName(oNParent, pcName, &ulIndex) ||
+         Node_peekChild(oNParent, ulIndex) != oNNode) {
+         fprintf(stderr, "Node is not its parent's child: (%s)\n",
+                 pcName);
          return FALSE;
       }
    }
@@ -133,22 +170,22 @@ boolean CheckerFT_Node_isValid(Node_T oNNode) {
    /* adding check file node must not have children */ 
    if(Node_isFile(oNNode)) {
      if(Node_getNumChildren(oNNode) != 0) {
-       fprintf(stderr, "File Node has children: (%s)\n",
-               Path_getPathname(oPNPath));
+       fprintf(stderr, "File Node has children: (%s)\n", pcName);
        return FALSE;
      }
    }
 
+   /* adding check that directory size aggregates are up to date */
+   if(!Node_isFile(oNNode) && !checkerFT_Sizes_areValid(oNNode))
+       return FALSE;
+
+   if(!checkerFT_Counts_areValid(oNNode))
+       return FALSE;
   
    /* checking children conditions */
    ulNumChildren = Node_getNumChildren(oNNode);
    for(ulIndex = 0; ulIndex < ulNumChildren; ulIndex++) {
-       oNChild = NULL;
-
-       if(Node_getChild(oNNode, ulIndex, &oNChild) != SUCCESS) {
-           fprintf(stderr, "getNumChildren claims more children than getChild returns\n");
-           return FALSE;
-       }
+       oNChild = Node_peekChild(oNNode, ulIndex);
 
        if(!checkerFT_Child_isValid(oNNode, oNChild, ulIndex, ulNumChildren)) {
            return FALSE;
@@ -177,16 +214,12 @@ static boolean CheckerFT_treeCheck(Node_T oNNode) {
       if(!CheckerFT_Node_isValid(oNNode))
          return FALSE;
 
-      /* Recur on every child of oNNode */
-      for(ulIndex = 0; ulIndex < Node_getNumChildren(oNNode); ulIndex++)
+      /* Recur on every child of oNNode; a shared directory's are the
+         snapshot's, which was checked when taken and is not changed */
+      for(ulIndex = 0; !Node_isShared(oNNode) &&
+          ulIndex < Node_getNumChildren(oNNode); ulIndex++)
       {
-         Node_T oNChild = NULL;
-         int iStatus = Node_getChild(oNNode, ulIndex, &oNChild);
-
-         if(iStatus != SUCCESS) {
-            fprintf(stderr, "getNumChildren claims more children than getChild returns\n");
-            return FALSE;
-         }
+         Node_T oNChild = Node_peekChild(oNNode, ulIndex);
 
          /* if recurring down one subtree results in a failed check
             farther down, passes the failure back up immediately */
@@ -200,17 +233,19 @@ static boolean CheckerFT_treeCheck(Node_T oNNode) {
 /* keep track of nodes in DT */
 static void CountNodes(Node_T oNNode, size_t *pCount) {
   size_t i;
-  Node_T oNChild = NULL;
 
   if(oNNode == NULL) {
     return;
   }
+  /* a shared directory stands for its snapshot's nodes */
+  if(Node_isShared(oNNode)) {
+    *pCount += Node_getNumNodes(oNNode);
+    return;
+  }
   (*pCount)++;
 
   for(i = 0; i < Node_getNumChildren(oNNode); i++) {
-    if (Node_getChild(oNNode, i, &oNChild) == SUCCESS && oNChild != NULL) {
-      CountNodes(oNChild, pCount);
-    }
+    CountNodes(Node_peekChild(oNNode, i), pCount);
   }
 }
 /* see checkerDT.h for specification */
@@ -258,6 +293,10 @@ boolean CheckerFT_isValid(boolean bIsInitialized, Node_T oNRoot,
         fprintf(stderr, "ulCount not equal to actual number of nodes\n");
         return FALSE;
     }
+    if(Node_getNumNodes(oNRoot) != ulCount) {
+        fprintf(stderr, "Root's subtree node count is not ulCount\n");
+        return FALSE;
+    }
 
     
     
@@ -8,11 +8,20 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "dynarray.h"
 #include "path.h"
 #include "nodeFT.h"
 #include "checkerFT.h" 
+#include "tar.h"
+#include "nameIndex.h"
+#include "trigramIndex.h"
 #include "ft.h"
 
 
@@ -27,8 +36,178 @@ static boolean bIsInitialized;
 static Node_T oNRoot;
 /* 3. a counter of the number of nodes in the hierarchy */
 static size_t ulCount;
+/* 4. the optional inverted indexes by name and by extension, both
+      NULL unless enabled with FT_setNameIndex */
+static NameIndex_T oNIByName;
+static NameIndex_T oNIByExtension;
+/* 5. the optional trigram index over names, NULL unless enabled with
+      FT_setSubstringIndex */
+static TrigramIndex_T oTIBySubstring;
 
+/* Kinds of undo log records, one per kind of change logged */
+enum { FT_UNDO_INSERT, FT_UNDO_REMOVE, FT_UNDO_MOVE, FT_UNDO_CONTENTS };
 
+/* A record of the undo log: enough to reverse one change */
+struct FT_Undo {
+   int iKind;
+   /* the inserted, removed, moved or rewritten node */
+   Node_T oNNode;
+   /* the removed node's parent, or the moved node's old one */
+   Node_T oNParent;
+   /* the moved node's old name, or the rewritten file's old contents
+      and their length, owned by the log */
+   void *pvOld;
+   size_t ulOldLength;
+};
+
+/* 6. whether a transaction is open (see FT_begin), and its undo log:
+      ulUndoLength records in an array with room for ulUndoCap */
+static boolean bInTransaction;
+static struct FT_Undo *psUndoLog;
+static size_t ulUndoLength;
+static size_t ulUndoCap;
+
+/* Removed subtrees of more than FT_RECLAIM_MIN nodes are freed by the
+   reclaimer thread, FT_RECLAIM_CHUNK nodes at a time */
+enum { FT_RECLAIM_MIN = 1024, FT_RECLAIM_CHUNK = 4096 };
+
+/* 7. the reclaimer thread, if started, and the queue of detached
+      subtrees it is to free, both guarded by oReclaimLock; the thread
+      waits on oReclaimWork for more, or to be told to stop */
+static pthread_mutex_t oReclaimLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t oReclaimWork = PTHREAD_COND_INITIALIZER;
+static pthread_t tReclaimer;
+static boolean bReclaimerStarted;
+static boolean bReclaimerStopping;
+static DynArray_T oDReclaimQueue;
+
+/* Directories whose lines in the FT_toString representation take at
+   most FT_FRAGMENT_MAX bytes are the ones that cache them */
+enum { FT_FRAGMENT_MAX = 64 * 1024 };
+
+/* 8. whether FT_toString and FT_toStringInto cache the lines of
+      subtrees as fragments on their directories (see
+      FT_setStringCache) */
+static boolean bCacheStrings;
+
+
+/*
+  Nodes store only their names, so the paths handed to visitors are
+  assembled on demand in a buffer owned by each traversal, which
+  keeps traversals reentrant for visitors that call back into the FT.
+*/
+
+/* A buffer for assembling node paths, and whether growing it failed */
+struct FT_PathBuf {
+   char *pcPath;
+   size_t ulCap;
+   int iStatus;
+};
+
+/*
+  Writes oNNode's path into psBuf, growing it as needed, and returns
+  it. Returns NULL and records MEMORY_ERROR in psBuf if memory could
+  not be allocated.
+*/
+static const char *FT_getPath(Node_T oNNode, struct FT_PathBuf *psBuf) {
+   size_t ulLength;
+
+   assert(oNNode != NULL);
+   assert(psBuf != NULL);
+
+   ulLength = Node_getPathLength(oNNode);
+   if(ulLength >= psBuf->ulCap) {
+      size_t ulNewCap = psBuf->ulCap == 0 ? 64 : psBuf->ulCap;
+      char *pcNew;
+      while(ulLength >= ulNewCap)
+         ulNewCap *= 2;
+      pcNew = realloc(psBuf->pcPath, ulNewCap);
+      if(pcNew == NULL) {
+         psBuf->iStatus = MEMORY_ERROR;
+         return NULL;
+      }
+      psBuf->pcPath = pcNew;
+      psBuf->ulCap = ulNewCap;
+   }
+   return Node_writePath(oNNode, psBuf->pcPath);
+}
+
+/* One level of a scan's stack */
+struct FT_ScanFrame {
+   Node_T oNDir;
+   size_t ulNext;
+};
+
+/* The stack of a scan in progress */
+struct FT_Scan {
+   struct FT_ScanFrame *psFrames;
+   size_t ulFrames;
+   size_t ulCap;
+};
+
+/* Pushes a frame for oNDir, next visiting child ulNext, onto psScan.
+   Returns SUCCESS or MEMORY_ERROR. */
+static int FT_scanPush(struct FT_Scan *psScan, Node_T oNDir,
+                       size_t ulNext) {
+   if(psScan->ulFrames == psScan->ulCap) {
+      size_t ulNewCap = psScan->ulCap == 0 ? 16 : 2 * psScan->ulCap;
+      struct FT_ScanFrame *psNew =
+         realloc(psScan->psFrames, ulNewCap * sizeof(*psNew));
+      if(psNew == NULL)
+         return MEMORY_ERROR;
+      psScan->psFrames = psNew;
+      psScan->ulCap = ulNewCap;
+   }
+   psScan->psFrames[psScan->ulFrames].oNDir = oNDir;
+   psScan->psFrames[psScan->ulFrames].ulNext = ulNext;
+   psScan->ulFrames++;
+   return SUCCESS;
+}
+
+/*
+  Returns the node after those psScan has visited in FT_toString
+  order, popping the frames of the directories it finishes, or NULL
+  once there are none. A frame's ulNext counts through its
+  directory's children twice, for the files and then for the
+  directories; the caller pushes a frame for each directory it is
+  handed that has children. The children of a shared directory are
+  read without unsharing it, so a caller that needs their paths must
+  unshare the directory before pushing it.
+*/
+static Node_T FT_scanNextLine(struct FT_Scan *psScan) {
+   while(psScan->ulFrames > 0) {
+      struct FT_ScanFrame *psTop = &psScan->psFrames[psScan->ulFrames - 1];
+      size_t ulChildren = Node_getNumChildren(psTop->oNDir);
+      boolean bFiles = (boolean) (psTop->ulNext < ulChildren);
+      Node_T oNChild;
+
+      if(psTop->ulNext == 2 * ulChildren) {
+         psScan->ulFrames--;
+         continue;
+      }
+      oNChild = Node_peekChild(psTop->oNDir, bFiles ? psTop->ulNext
+                               : psTop->ulNext - ulChildren);
+      psTop->ulNext++;
+      if(Node_isFile(oNChild) == bFiles)
+         return oNChild;
+   }
+   return NULL;
+}
+
+
+
+/* Returns a newly allocated copy of pcString, or NULL if pcString is
+   NULL or there is not enough memory. */
+static char *FT_copyString(const char *pcString) {
+   char *pcCopy;
+
+   if(pcString == NULL)
+      return NULL;
+   pcCopy = malloc(strlen(pcString) + 1);
+   if(pcCopy != NULL)
+      strcpy(pcCopy, pcString);
+   return pcCopy;
+}
 
 /* --------------------------------------------------------------------
 
@@ -39,59 +218,33 @@ static size_t ulCount;
 */
 
 /*
-  Traverses the FT starting at the root as far as possible towards
-  absolute path oPPath. If able to traverse, returns an int SUCCESS
-  status and sets *poNFurthest to the furthest node reached (which may
-  be only a prefix of oPPath, or even NULL if the root is NULL).
-  Otherwise, sets *poNFurthest to NULL and returns with status:
-  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  Traverses the FT starting at oNStart, whose path must be a prefix of
+  oPPath, as far as possible towards absolute path oPPath. If able to
+  traverse, returns an int SUCCESS status and sets *poNFurthest to the
+  furthest node reached. Otherwise, sets *poNFurthest to NULL and
+  returns with status:
   * MEMORY_ERROR if memory could not be allocated to complete request
 */
-static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
+static int FT_traverseFrom(Node_T oNStart, Path_T oPPath,
+                           Node_T *poNFurthest) {
    int iStatus;
-   Path_T oPPrefix = NULL;
    Node_T oNCurr;
    Node_T oNChild = NULL;
    size_t ulDepth;
    size_t i;
    size_t ulChildID;
 
+   assert(oNStart != NULL);
    assert(oPPath != NULL);
    assert(poNFurthest != NULL);
 
-   /* root is NULL -> won't find anything */
-   if(oNRoot == NULL) {
-      *poNFurthest = NULL;
-      return SUCCESS;
-   }
-
-   iStatus = Path_prefix(oPPath, 1, &oPPrefix);
-   if(iStatus != SUCCESS) {
-      *poNFurthest = NULL;
-      return iStatus;
-   }
-
-   if(Path_comparePath(Node_getPath(oNRoot), oPPrefix)) {
-      Path_free(oPPrefix);
-      *poNFurthest = NULL;
-      return CONFLICTING_PATH;
-   }
-   Path_free(oPPrefix);
-   oPPrefix = NULL;
-
-   oNCurr = oNRoot;
+   oNCurr = oNStart;
    ulDepth = Path_getDepth(oPPath);
-  
-   for(i = 2; i <= ulDepth; i++) {
-      iStatus = Path_prefix(oPPath, i, &oPPrefix);
-      if(iStatus != SUCCESS) {
-         *poNFurthest = NULL;
-         return iStatus;
-      }
-      if(Node_hasChild(oNCurr, oPPrefix, &ulChildID)) {
-         /* go to that child and continue with next prefix */
-         Path_free(oPPrefix);
-         oPPrefix = NULL;
+
+   for(i = Node_getDepth(oNStart); i < ulDepth; i++) {
+      if(Node_hasChildName(oNCurr, Path_getComponent(oPPath, i),
+                           &ulChildID)) {
+         /* go to that child and continue with next component */
          iStatus = Node_getChild(oNCurr, ulChildID, &oNChild);
          if(iStatus != SUCCESS) {
             *poNFurthest = NULL;
@@ -100,17 +253,42 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
          oNCurr = oNChild;
       }
       else {
-         /* oNCurr doesn't have child with path oPPrefix:
+         /* oNCurr doesn't have child with this name:
             this is as far as we can go */
          break;
       }
    }
-   Path_free(oPPrefix);
-   oPPrefix = NULL;
    *poNFurthest = oNCurr;
    return SUCCESS;
 }
 
+/*
+  Traverses the FT starting at the root as far as possible towards
+  absolute path oPPath. If able to traverse, returns an int SUCCESS
+  status and sets *poNFurthest to the furthest node reached (which may
+  be only a prefix of oPPath, or even NULL if the root is NULL).
+  Otherwise, sets *poNFurthest to NULL and returns with status:
+  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
+   assert(oPPath != NULL);
+   assert(poNFurthest != NULL);
+
+   /* root is NULL -> won't find anything */
+   if(oNRoot == NULL) {
+      *poNFurthest = NULL;
+      return SUCCESS;
+   }
+
+   if(strcmp(Node_getName(oNRoot), Path_getComponent(oPPath, 0))) {
+      *poNFurthest = NULL;
+      return CONFLICTING_PATH;
+   }
+
+   return FT_traverseFrom(oNRoot, oPPath, poNFurthest);
+}
+
 
 /*
   Traverses the FT to find a node with absolute path pcPath. Returns a
@@ -155,7 +333,9 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
       return NO_SUCH_PATH;
    }
 
-   if(Path_comparePath(Node_getPath(oNFound), oPPath) != 0) {
+   /* the traversal followed oPPath, so reaching its depth is reaching
+      it */
+   if(Node_getDepth(oNFound) != Path_getDepth(oPPath)) {
       Path_free(oPPath);
       *poNResult = NULL;
       return NO_SUCH_PATH;
@@ -165,241 +345,619 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
    *poNResult = oNFound;
    return SUCCESS;
 }
-/*--------------------------------------------------------------------*/
+/* --------------------------------------------------------------------
 
+  The following auxiliary functions keep the optional indexes in step
+  with the nodes in the tree. Every node is filed in the name index
+  under its name, and under its extension if it has one, and in the
+  substring index under the trigrams of its name. The iIndexes
+  arguments select indexes by the bits below.
+*/
 
-int FT_insertDir(const char *pcPath) {
-   int iStatus;
-   Path_T oPPath = NULL;
-   Node_T oNCurr = NULL;
-   Node_T oNFirstNew = NULL; 
-   size_t ulDepth, ulIndex;
-   size_t ulNewNodes = 0;
+/* Bits selecting the name and the substring index, and the node
+   index slots each index uses */
+enum { FT_NAME_INDEX = 1, FT_SUBSTRING_INDEX = 2 };
+enum { FT_NAME_SLOT, FT_EXTENSION_SLOT, FT_SUBSTRING_SLOT };
 
-   assert(pcPath != NULL);
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+/* Returns the bits of the indexes that are currently enabled. */
+static int FT_getIndexes(void) {
+   return (oNIByName != NULL ? FT_NAME_INDEX : 0) |
+          (oTIBySubstring != NULL ? FT_SUBSTRING_INDEX : 0);
+}
 
-   /* validate pcPath and generate a Path_T for it */
-   if(!bIsInitialized)
-      return INITIALIZATION_ERROR;
+/*
+  Returns the extension of name pcName: the text after its last '.',
+  or NULL if there is no '.', the only '.' starts a hidden name such
+  as ".bashrc", or the name ends with '.'.
+*/
+static const char *FT_getExtension(const char *pcName) {
+   const char *pcDot;
 
-   iStatus = Path_new(pcPath, &oPPath);
-   if(iStatus != SUCCESS)
-      return iStatus;
+   assert(pcName != NULL);
 
-   /* find the closest ancestor of oPPath already in the tree */
-   iStatus= FT_traversePath(oPPath, &oNCurr);
-   if(iStatus != SUCCESS)
-   {
-      Path_free(oPPath);
-      return iStatus;
-   }
+   pcDot = strrchr(pcName, '.');
+   if(pcDot == NULL || pcDot == pcName || pcDot[1] == '\0')
+      return NULL;
+   return pcDot + 1;
+}
 
-   /* no ancestor node found, so if root is not NULL,
-      pcPath isn't underneath root. */
-   if(oNCurr == NULL && oNRoot != NULL) {
-      Path_free(oPPath);
-      return CONFLICTING_PATH;
+/* Removes oNNode's entries, filed under the name pcName, from the
+   indexes selected by iIndexes. */
+static void FT_unindexName(Node_T oNNode, const char *pcName,
+                           int iIndexes) {
+   assert(oNNode != NULL);
+   assert(pcName != NULL);
+
+   if(iIndexes & FT_NAME_INDEX) {
+      const char *pcExtension = FT_getExtension(pcName);
+      NameIndex_remove(oNIByName, pcName, oNNode);
+      if(pcExtension != NULL)
+         NameIndex_remove(oNIByExtension, pcExtension, oNNode);
    }
+   if(iIndexes & FT_SUBSTRING_INDEX)
+      TrigramIndex_remove(oTIBySubstring, oNNode);
+}
 
-   ulDepth = Path_getDepth(oPPath);
-   if(oNCurr == NULL) /* new root! */
-      ulIndex = 1;
-   else {
-      ulIndex = Path_getDepth(Node_getPath(oNCurr))+1;
+/* Removes oNNode's entries from the indexes selected by iIndexes. */
+static void FT_unindexNode(Node_T oNNode, int iIndexes) {
+   assert(oNNode != NULL);
 
-      /* oNCurr is the node we're trying to insert */
-      if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                       Node_getPath(oNCurr))) {
-         Path_free(oPPath);
-         return ALREADY_IN_TREE;
-      }
-      if(Node_isFile(oNCurr) && ulIndex < ulDepth+1) {
-        Path_free(oPPath);
-        return NOT_A_DIRECTORY;
-      }
-   }
+   FT_unindexName(oNNode, Node_getName(oNNode), iIndexes);
+}
 
-   /* starting at oNCurr, build rest of the path one level at a time */
-   while(ulIndex <= ulDepth) {
-      Path_T oPPrefix = NULL;
-      Node_T oNNewNode = NULL;
+/*
+  Adds oNNode's entries to the indexes selected by iIndexes. Returns
+  SUCCESS, or MEMORY_ERROR after removing any entries it added.
+*/
+static int FT_indexNode(Node_T oNNode, int iIndexes) {
+   const char *pcExtension;
+   int iStatus;
 
-      /* generate a Path_T for this level */
-      iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-      if(iStatus != SUCCESS) {
-         Path_free(oPPath);
-         if(oNFirstNew != NULL) {
-           (void) Node_free(oNFirstNew);
-         }
-         assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+   assert(oNNode != NULL);
+
+   if(iIndexes & FT_NAME_INDEX) {
+      iStatus = NameIndex_add(oNIByName, Node_getName(oNNode), oNNode);
+      if(iStatus != SUCCESS)
          return iStatus;
+      pcExtension = FT_getExtension(Node_getName(oNNode));
+      if(pcExtension != NULL) {
+         iStatus = NameIndex_add(oNIByExtension, pcExtension, oNNode);
+         if(iStatus != SUCCESS) {
+            NameIndex_remove(oNIByName, Node_getName(oNNode), oNNode);
+            return iStatus;
+         }
       }
-
-      /* insert the new node for this level */
-      iStatus = Node_new(oPPrefix, oNCurr, FALSE, NULL, 0, &oNNewNode);
-      Path_free(oPPrefix);
+   }
+   if(iIndexes & FT_SUBSTRING_INDEX) {
+      iStatus = TrigramIndex_add(oTIBySubstring, oNNode);
       if(iStatus != SUCCESS) {
-         Path_free(oPPath); 
-         if(oNFirstNew != NULL) {
-           (void) Node_free(oNFirstNew);
-         }
-         assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+         FT_unindexNode(oNNode, iIndexes & FT_NAME_INDEX);
          return iStatus;
       }
-
-      /* set up for next level */
-      oNCurr = oNNewNode;
-      ulNewNodes++;
-      if(oNFirstNew == NULL) {
-        oNFirstNew = oNCurr;
-      }
-      ulIndex++;
    }
-   Path_free(oPPath);
-   if (oNRoot == NULL) {
-     oNRoot = oNFirstNew; 
-   }
-   ulCount += ulNewNodes;
-
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
    return SUCCESS;
 }
 
-int FT_insertFile(const char *pcPath, void *pvContents, size_t ulLength) {
+/* Removes the entries of every node in the subtree rooted at oNNode
+   from the indexes selected by iIndexes. */
+static void FT_unindexSubtree(Node_T oNNode, int iIndexes) {
+   size_t ulChildID;
+
+   assert(oNNode != NULL);
+
+   if(iIndexes == 0)
+      return;
+
+   for(ulChildID = 0; ulChildID < Node_getNumChildren(oNNode);
+       ulChildID++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      FT_unindexSubtree(oNChild, iIndexes);
+   }
+   FT_unindexNode(oNNode, iIndexes);
+}
+
+/*
+  Adds entries for every node in the subtree rooted at oNNode, in
+  pre-order, to the indexes selected by iIndexes, unsharing its shared
+  directories, since index entries are kept in the nodes. Returns
+  SUCCESS, or MEMORY_ERROR after removing any entries it added.
+*/
+static int FT_indexSubtree(Node_T oNNode, int iIndexes) {
+   size_t ulChildID;
    int iStatus;
-   Path_T oPPath = NULL;
-   Node_T oNCurr = NULL;
-   Node_T oNFirstNew = NULL;
-   size_t ulDepth, ulIndex;
-   size_t ulNewNodes = 0;
 
-   assert(pcPath != NULL);
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+   assert(oNNode != NULL);
 
-   /* validate pcPath and generate a Path_T for it */
-   if(!bIsInitialized)
-      return INITIALIZATION_ERROR;
+   if(iIndexes == 0)
+      return SUCCESS;
 
-   iStatus = Path_new(pcPath, &oPPath);
+   iStatus = Node_unshare(oNNode);
+   if(iStatus == SUCCESS)
+      iStatus = FT_indexNode(oNNode, iIndexes);
    if(iStatus != SUCCESS)
       return iStatus;
 
-   /* the root can't be a file */
-   if(oNRoot == NULL && Path_getDepth(oPPath) == 1) {
-     Path_free(oPPath);
-     return CONFLICTING_PATH;
+   for(ulChildID = 0; ulChildID < Node_getNumChildren(oNNode);
+       ulChildID++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      iStatus = FT_indexSubtree(oNChild, iIndexes);
+      if(iStatus != SUCCESS) {
+         /* undo the children already indexed, then this node */
+         while(ulChildID > 0) {
+            (void) Node_getChild(oNNode, --ulChildID, &oNChild);
+            FT_unindexSubtree(oNChild, iIndexes);
+         }
+         FT_unindexNode(oNNode, iIndexes);
+         return iStatus;
+      }
    }
+   return SUCCESS;
+}
 
-   /* find the closest ancestor of oPPath already in the tree */
-   iStatus= FT_traversePath(oPPath, &oNCurr);
-   if(iStatus != SUCCESS)
-   {
-      Path_free(oPPath);
-      return iStatus;
-   }
+/*
+  Frees and disables all the indexes at once, without removing their
+  entries one by one: the only way out when one can no longer be
+  kept in step with the tree.
+*/
+static void FT_dropIndexes(void) {
+   NameIndex_free(oNIByName);
+   NameIndex_free(oNIByExtension);
+   TrigramIndex_free(oTIBySubstring);
+   oNIByName = NULL;
+   oNIByExtension = NULL;
+   oTIBySubstring = NULL;
+}
 
-   ulDepth = Path_getDepth(oPPath);
-   if(oNCurr == NULL) /* new root! */
-      ulIndex = 1;
-   else {
-      ulIndex = Path_getDepth(Node_getPath(oNCurr))+1;
+/*
+  Frees the detached subtree rooted at oNNode a chunk of nodes at a
+  time, yielding the processor between chunks.
+*/
+static void FT_reclaimSubtree(Node_T oNNode) {
+   DynArray_T oDWork;
+   size_t ulFreed;
 
-      /* oNCurr is the node we're trying to insert */
-      if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                       Node_getPath(oNCurr))) {
-         Path_free(oPPath);
-         return ALREADY_IN_TREE;
+   oDWork = DynArray_new(0);
+   if(oDWork == NULL || !DynArray_add(oDWork, oNNode)) {
+      if(oDWork != NULL)
+         DynArray_free(oDWork);
+      (void) Node_free(oNNode);
+      return;
+   }
+   while(DynArray_getLength(oDWork) > 0) {
+      for(ulFreed = 0; ulFreed < FT_RECLAIM_CHUNK &&
+                       DynArray_getLength(oDWork) > 0; ulFreed++) {
+         Node_T oNTop = DynArray_removeAt(oDWork,
+                                          DynArray_getLength(oDWork) - 1);
+         if(Node_freeTop(oNTop, oDWork) != SUCCESS)
+            (void) Node_free(oNTop);
       }
+      (void) sched_yield();
    }
+   DynArray_free(oDWork);
+}
 
-    /* can't create file as the root. */
-   if(ulIndex == 1 && ulDepth == 1) {
-      Path_free(oPPath);
-      return CONFLICTING_PATH;
-   }
+/* The reclaimer thread: frees the queued subtrees until told to stop
+   with the queue empty. Has pthread_create's signature. */
+static void *FT_reclaim(void *pvUnused) {
+   (void) pvUnused;
+   (void) pthread_mutex_lock(&oReclaimLock);
+   for(;;) {
+      Node_T oNNode;
 
-   if(Node_isFile(oNCurr) && ulIndex < ulDepth+1) {
-     Path_free(oPPath);
-     return NOT_A_DIRECTORY;
+      while(DynArray_getLength(oDReclaimQueue) == 0 &&
+            !bReclaimerStopping)
+         (void) pthread_cond_wait(&oReclaimWork, &oReclaimLock);
+      if(DynArray_getLength(oDReclaimQueue) == 0)
+         break;
+      oNNode = DynArray_removeAt(oDReclaimQueue,
+                   DynArray_getLength(oDReclaimQueue) - 1);
+      (void) pthread_mutex_unlock(&oReclaimLock);
+      FT_reclaimSubtree(oNNode);
+      (void) pthread_mutex_lock(&oReclaimLock);
    }
+   (void) pthread_mutex_unlock(&oReclaimLock);
+   return NULL;
+}
 
+/*
+  Frees the detached subtree rooted at oNNode: at once if it is small,
+  and otherwise on the reclaimer thread, started on first use, so that
+  the caller's time does not depend on the subtree's size. Frees at
+  once after all if the thread or the queue can't be had.
+*/
+static void FT_freeLater(Node_T oNNode) {
+   boolean bQueued = FALSE;
 
-   /* starting at oNCurr, build rest of the path one level at a time */
-   while(ulIndex <= ulDepth) {
-      Path_T oPPrefix = NULL;
-      Node_T oNNewNode = NULL;
-      boolean bIsFinal = FALSE;
-      if (ulIndex == ulDepth) {
-        bIsFinal = TRUE;
-      }
+   assert(oNNode != NULL);
+   assert(Node_getParent(oNNode) == NULL);
 
-      /* generate a Path_T for this level */
-      iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-      if(iStatus != SUCCESS) {
-         Path_free(oPPath);
-         if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew); 
-         assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
-         return iStatus;
-      }
-      /* insert the new node for this level */
-      /*directory*/
-      if(!bIsFinal) {
-        iStatus = Node_new(oPPrefix, oNCurr, FALSE, NULL, 0,
-                           &oNNewNode);
-      }
-        
-      else {
-       /*file */
-       iStatus = Node_new(oPPrefix, oNCurr, TRUE, pvContents, ulLength,
-                           &oNNewNode);
-      }
-      Path_free(oPPrefix);
-      if(iStatus != SUCCESS) {
-         Path_free(oPPath);
-         if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew); 
-         assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
-         return iStatus;
+   if(Node_getNumNodes(oNNode) > FT_RECLAIM_MIN) {
+      (void) pthread_mutex_lock(&oReclaimLock);
+      if(oDReclaimQueue == NULL)
+         oDReclaimQueue = DynArray_new(0);
+      if(oDReclaimQueue != NULL && !bReclaimerStarted)
+         bReclaimerStarted = (boolean)
+            (pthread_create(&tReclaimer, NULL, FT_reclaim, NULL) == 0);
+      if(bReclaimerStarted && DynArray_add(oDReclaimQueue, oNNode)) {
+         bQueued = TRUE;
+         (void) pthread_cond_signal(&oReclaimWork);
       }
-
-      /* set up for next level */
-      oNCurr = oNNewNode;
-      ulNewNodes++;
-      if(oNFirstNew == NULL)
-         oNFirstNew = oNCurr; 
-      ulIndex++;
+      (void) pthread_mutex_unlock(&oReclaimLock);
    }
+   if(!bQueued)
+      (void) Node_free(oNNode);
+}
 
-   Path_free(oPPath);
-   /* update DT state variables to reflect insertion */
-   if(oNRoot == NULL)
-      oNRoot = oNFirstNew; 
-   ulCount += ulNewNodes;
+/* Waits for the reclaimer thread, if started, to free everything
+   queued, then stops it. */
+static void FT_stopReclaimer(void) {
+   if(!bReclaimerStarted)
+      return;
+   (void) pthread_mutex_lock(&oReclaimLock);
+   bReclaimerStopping = TRUE;
+   (void) pthread_cond_signal(&oReclaimWork);
+   (void) pthread_mutex_unlock(&oReclaimLock);
+   (void) pthread_join(tReclaimer, NULL);
 
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
-   return SUCCESS;
+   DynArray_free(oDReclaimQueue);
+   oDReclaimQueue = NULL;
+   bReclaimerStarted = FALSE;
+   bReclaimerStopping = FALSE;
 }
 
-boolean FT_containsDir(const char *pcPath) {
-   int iStatus;
-   Node_T oNFound = NULL;
-
-   assert(pcPath != NULL);
+/*
+  Removes the subtree rooted at oNNode from the FT and its indexes,
+  updating the FT's state variables at once, and frees it, perhaps on
+  the reclaimer thread (see FT_freeLater). The indexes are not shared
+  with that thread, so their entries go here, one node at a time.
+*/
+static void FT_removeSubtree(Node_T oNNode) {
+   assert(oNNode != NULL);
 
-   iStatus = FT_findNode(pcPath, &oNFound);
-   if (iStatus != SUCCESS) {
-     return FALSE;
-   }
-   return (boolean) (!Node_isFile(oNFound));
+   FT_unindexSubtree(oNNode, FT_getIndexes());
+   if(Node_getParent(oNNode) == NULL)
+      oNRoot = NULL;
+   else
+      Node_detach(oNNode);
+   ulCount -= Node_getNumNodes(oNNode);
+   FT_freeLater(oNNode);
 }
 
-boolean FT_containsFile(const char *pcPath) {
-   int iStatus;
-   Node_T oNFound = NULL;
+/* --------------------------------------------------------------------
 
-   assert(pcPath != NULL);
+  The following auxiliary functions keep the undo log of an open
+  transaction. Each logged change first reserves its record, so that
+  once done it can always be logged.
+*/
+
+/*
+  Makes room in the undo log for ulRecords more records, if a
+  transaction is open. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_reserveUndo(size_t ulRecords) {
+   struct FT_Undo *psNew;
+   size_t ulNewCap;
+
+   if(!bInTransaction || ulUndoCap - ulUndoLength >= ulRecords)
+      return SUCCESS;
+   ulNewCap = ulUndoCap == 0 ? 16 : 2 * ulUndoCap;
+   while(ulNewCap - ulUndoLength < ulRecords)
+      ulNewCap *= 2;
+   psNew = realloc(psUndoLog, ulNewCap * sizeof(struct FT_Undo));
+   if(psNew == NULL)
+      return MEMORY_ERROR;
+   psUndoLog = psNew;
+   ulUndoCap = ulNewCap;
+   return SUCCESS;
+}
+
+/* Appends a record of kind iKind with the given fields to the undo
+   log, which must have room for it, if a transaction is open. */
+static void FT_logUndo(int iKind, Node_T oNNode, Node_T oNParent,
+                       void *pvOld, size_t ulOldLength) {
+   struct FT_Undo *psRecord;
+
+   assert(oNNode != NULL);
+
+   if(!bInTransaction)
+      return;
+   assert(ulUndoLength < ulUndoCap);
+
+   psRecord = &psUndoLog[ulUndoLength++];
+   psRecord->iKind = iKind;
+   psRecord->oNNode = oNNode;
+   psRecord->oNParent = oNParent;
+   psRecord->pvOld = pvOld;
+   psRecord->ulOldLength = ulOldLength;
+}
+
+/* Frees the undo log and closes the transaction. */
+static void FT_endTransaction(void) {
+   free(psUndoLog);
+   psUndoLog = NULL;
+   ulUndoLength = 0;
+   ulUndoCap = 0;
+   bInTransaction = FALSE;
+}
+
+/*
+  Removes the subtree rooted at oNNode from the FT as FT_rmDir and
+  FT_rmFile do. Inside a transaction, the subtree is only unlinked
+  and logged, and freed on commit. Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_rmNode(Node_T oNNode) {
+   Node_T oNParent;
+
+   assert(oNNode != NULL);
+
+   if(!bInTransaction) {
+      FT_removeSubtree(oNNode);
+      return SUCCESS;
+   }
+   if(FT_reserveUndo(1) != SUCCESS)
+      return MEMORY_ERROR;
+
+   FT_unindexSubtree(oNNode, FT_getIndexes());
+   oNParent = Node_getParent(oNNode);
+   if(oNParent == NULL)
+      oNRoot = NULL;
+   else
+      Node_detach(oNNode);
+   ulCount -= Node_getNumNodes(oNNode);
+   FT_logUndo(FT_UNDO_REMOVE, oNNode, oNParent, NULL, 0);
+   return SUCCESS;
+}
+
+/*
+  Replaces file oNFile's contents with a copy of the ulLength bytes at
+  pvContents, logging the change if a transaction is open. Returns
+  SUCCESS and sets *ppvOld to the old contents, owned by the caller;
+  inside a transaction these are a copy, the log keeping the original
+  to restore. Otherwise leaves oNFile unchanged, sets *ppvOld to NULL
+  and returns MEMORY_ERROR.
+*/
+static int FT_replaceContents(Node_T oNFile, void *pvContents,
+                              size_t ulLength, void **ppvOld) {
+   size_t ulOldLength;
+   void *pvNew = NULL;
+   void *pvCopy = NULL;
+   void *pvOld;
+   int iStatus;
+
+   assert(oNFile != NULL);
+   assert(ppvOld != NULL);
+
+   *ppvOld = NULL;
+   if(FT_reserveUndo(1) != SUCCESS)
+      return MEMORY_ERROR;
+
+   ulOldLength = Node_getFileLength(oNFile);
+   if(ulLength > 0) {
+      pvNew = malloc(ulLength);
+      if(pvNew == NULL)
+         return MEMORY_ERROR;
+      memcpy(pvNew, pvContents, ulLength);
+   }
+   if(bInTransaction && ulOldLength > 0) {
+      pvCopy = malloc(ulOldLength);
+      if(pvCopy == NULL) {
+         free(pvNew);
+         return MEMORY_ERROR;
+      }
+      memcpy(pvCopy, Node_getFileContents(oNFile), ulOldLength);
+   }
+
+   iStatus = Node_takeFileContents(oNFile, pvNew, ulLength, &pvOld);
+   if(iStatus != SUCCESS) {
+      free(pvNew);
+      free(pvCopy);
+      return iStatus;
+   }
+   if(bInTransaction) {
+      FT_logUndo(FT_UNDO_CONTENTS, oNFile, NULL, pvOld, ulOldLength);
+      pvOld = pvCopy;
+   }
+   *ppvOld = pvOld;
+   return SUCCESS;
+}
+
+/*
+  Returns the deepest of oNNode and its ancestors whose path is a
+  prefix of oPPath, or NULL if there is none, comparing names on the
+  way up to the root.
+*/
+static Node_T FT_getAncestorOn(Node_T oNNode, Path_T oPPath) {
+   Node_T oNDeepest;
+   size_t ulDepth;
+
+   assert(oNNode != NULL);
+   assert(oPPath != NULL);
+
+   ulDepth = Node_getDepth(oNNode);
+   for(; ulDepth > Path_getDepth(oPPath); ulDepth--)
+      oNNode = Node_getParent(oNNode);
+
+   /* a mismatch anywhere rules out that node and all below it */
+   oNDeepest = oNNode;
+   for(; oNNode != NULL; oNNode = Node_getParent(oNNode), ulDepth--)
+      if(strcmp(Node_getName(oNNode),
+                Path_getComponent(oPPath, ulDepth - 1)) != 0)
+         oNDeepest = Node_getParent(oNNode);
+   return oNDeepest;
+}
+/*--------------------------------------------------------------------*/
+
+/*
+  Inserts a node with absolute path oPPath into the FT, building any
+  missing ancestors as directories. The node is a file with contents
+  pvContents of ulLength bytes if bIsFile, or a directory otherwise.
+  The closest existing ancestor is searched for from oNHint, climbing
+  its parent chain as needed, if oNHint is not NULL, and from the
+  root otherwise. Returns SUCCESS and sets *poNResult to the new node
+  if successful. If the path is already in the FT, sets *poNResult to
+  the node found there and returns ALREADY_IN_TREE. Otherwise, leaves
+  the FT unchanged, sets *poNResult to NULL and returns the statuses
+  documented for FT_insertDir and FT_insertFile.
+*/
+static int FT_insertNode(Path_T oPPath, Node_T oNHint, boolean bIsFile,
+                         void *pvContents, size_t ulLength,
+                         Node_T *poNResult) {
+   int iStatus;
+   Node_T oNCurr = NULL;
+   Node_T oNFirstNew = NULL;
+   size_t ulDepth, ulIndex;
+   size_t ulNewNodes = 0;
+
+   assert(oPPath != NULL);
+   assert(poNResult != NULL);
+
+   *poNResult = NULL;
+   ulDepth = Path_getDepth(oPPath);
+   if(FT_reserveUndo(1) != SUCCESS)
+      return MEMORY_ERROR;
+
+   /* the root can't be a file */
+   if(bIsFile && oNRoot == NULL && ulDepth == 1)
+      return CONFLICTING_PATH;
+
+   /* find the closest ancestor of oPPath already in the tree,
+      starting from the hint's deepest ancestor on oPPath if given */
+   if(oNHint != NULL)
+      oNHint = FT_getAncestorOn(oNHint, oPPath);
+   if(oNHint != NULL)
+      iStatus = FT_traverseFrom(oNHint, oPPath, &oNCurr);
+   else
+      iStatus = FT_traversePath(oPPath, &oNCurr);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   if(oNCurr == NULL) /* new root! */
+      ulIndex = 1;
+   else {
+      ulIndex = Node_getDepth(oNCurr)+1;
+
+      /* oNCurr is the node we're trying to insert */
+      if(ulIndex == ulDepth+1) {
+         *poNResult = oNCurr;
+         return ALREADY_IN_TREE;
+      }
+      if(Node_isFile(oNCurr))
+         return NOT_A_DIRECTORY;
+   }
+
+   /* starting at oNCurr, build rest of the path one level at a time */
+   while(ulIndex <= ulDepth) {
+      const char *pcName = Path_getComponent(oPPath, ulIndex - 1);
+      Node_T oNNewNode = NULL;
+      boolean bIsFinal = (boolean) (bIsFile && ulIndex == ulDepth);
+
+      /* insert the new node for this level: a file only at the end */
+      if(bIsFinal)
+         iStatus = Node_new(pcName, oNCurr, TRUE, pvContents,
+                            ulLength, &oNNewNode);
+      else
+         iStatus = Node_new(pcName, oNCurr, FALSE, NULL, 0,
+                            &oNNewNode);
+      if(iStatus != SUCCESS) {
+         if(oNFirstNew != NULL)
+            (void) Node_free(oNFirstNew);
+         return iStatus;
+      }
+
+      /* set up for next level */
+      oNCurr = oNNewNode;
+      ulNewNodes++;
+      if(oNFirstNew == NULL)
+         oNFirstNew = oNCurr;
+      ulIndex++;
+   }
+
+   /* file the new nodes in the indexes */
+   iStatus = FT_indexSubtree(oNFirstNew, FT_getIndexes());
+   if(iStatus != SUCCESS) {
+      (void) Node_free(oNFirstNew);
+      return iStatus;
+   }
+
+   /* update FT state variables to reflect insertion */
+   if(oNRoot == NULL)
+      oNRoot = oNFirstNew;
+   ulCount += ulNewNodes;
+   FT_logUndo(FT_UNDO_INSERT, oNFirstNew, NULL, NULL, 0);
+
+   *poNResult = oNCurr;
+   return SUCCESS;
+}
+/*--------------------------------------------------------------------*/
+
+
+int FT_insertDir(const char *pcPath) {
+   int iStatus;
+   Path_T oPPath = NULL;
+   Node_T oNNew = NULL;
+
+   assert(pcPath != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   /* validate pcPath and generate a Path_T for it */
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   iStatus = Path_new(pcPath, &oPPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = FT_insertNode(oPPath, NULL, FALSE, NULL, 0, &oNNew);
+   Path_free(oPPath);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return iStatus;
+}
+
+int FT_insertFile(const char *pcPath, void *pvContents, size_t ulLength) {
+   int iStatus;
+   Path_T oPPath = NULL;
+   Node_T oNNew = NULL;
+
+   assert(pcPath != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   /* validate pcPath and generate a Path_T for it */
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   iStatus = Path_new(pcPath, &oPPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = FT_insertNode(oPPath, NULL, TRUE, pvContents, ulLength,
+                           &oNNew);
+   Path_free(oPPath);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return iStatus;
+}
+
+boolean FT_containsDir(const char *pcPath) {
+   int iStatus;
+   Node_T oNFound = NULL;
+
+   assert(pcPath != NULL);
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if (iStatus != SUCCESS) {
+     return FALSE;
+   }
+   return (boolean) (!Node_isFile(oNFound));
+}
+
+boolean FT_containsFile(const char *pcPath) {
+   int iStatus;
+   Node_T oNFound = NULL;
+
+   assert(pcPath != NULL);
 
    iStatus = FT_findNode(pcPath, &oNFound);
    if (iStatus != SUCCESS) {
@@ -410,254 +968,4373 @@ boolean FT_containsFile(const char *pcPath) {
 
 
 
-int FT_rmDir(const char *pcPath) {
-   int iStatus;
-   Node_T oNFound = NULL;
+int FT_rmDir(const char *pcPath) {
+   int iStatus;
+   Node_T oNFound = NULL;
+
+   assert(pcPath != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+
+   if(iStatus != SUCCESS)
+       return iStatus;
+     
+   if(Node_isFile(oNFound)){
+      return NOT_A_DIRECTORY;
+   }
+
+   iStatus = FT_rmNode(oNFound);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return iStatus;
+}
+
+int FT_rmFile(const char *pcPath) {
+   int iStatus;
+   Node_T oNFound = NULL;
+
+   assert(pcPath != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+
+   if(iStatus != SUCCESS)
+       return iStatus;
+
+   if(!Node_isFile(oNFound)){
+     return NOT_A_FILE;
+   }
+
+   iStatus = FT_rmNode(oNFound);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return iStatus;
+}
+  
+
+
+/*
+  Finds where FT_mv or FT_cp is to put the node oNSrc: the directory
+  that is to be the parent of absolute path pcDst. Returns SUCCESS,
+  setting *poNParent to that directory and *ppcName to a newly
+  allocated copy of pcDst's final component, or returns the statuses
+  documented for FT_mv.
+*/
+static int FT_findDestination(Node_T oNSrc, const char *pcDst,
+                              Node_T *poNParent, char **ppcName) {
+   int iStatus;
+   Path_T oPDst = NULL;
+   Node_T oNFurthest = NULL;
+   Node_T oNAncestor;
+
+   assert(oNSrc != NULL);
+   assert(pcDst != NULL);
+   assert(poNParent != NULL);
+   assert(ppcName != NULL);
+
+   iStatus = Path_new(pcDst, &oPDst);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = FT_traversePath(oPDst, &oNFurthest);
+   if(iStatus != SUCCESS) {
+      Path_free(oPDst);
+      return iStatus;
+   }
+
+   /* pcDst must be new, outside oNSrc, and right below a directory */
+   for(oNAncestor = oNFurthest; oNAncestor != NULL &&
+          oNAncestor != oNSrc; oNAncestor = Node_getParent(oNAncestor))
+      ;
+   if(Node_getDepth(oNFurthest) == Path_getDepth(oPDst))
+      iStatus = ALREADY_IN_TREE;
+   else if(oNAncestor == oNSrc)
+      iStatus = CONFLICTING_PATH;
+   else if(Node_isFile(oNFurthest))
+      iStatus = NOT_A_DIRECTORY;
+   else if(Node_getDepth(oNFurthest) + 1 < Path_getDepth(oPDst))
+      iStatus = NO_SUCH_PATH;
+   if(iStatus != SUCCESS) {
+      Path_free(oPDst);
+      return iStatus;
+   }
+
+   *ppcName = FT_copyString(Path_getComponent(oPDst,
+                                              Path_getDepth(oPDst) - 1));
+   Path_free(oPDst);
+   if(*ppcName == NULL)
+      return MEMORY_ERROR;
+   *poNParent = oNFurthest;
+   return SUCCESS;
+}
+
+int FT_mv(const char *pcSrc, const char *pcDst) {
+   int iStatus;
+   Node_T oNSrc = NULL;
+   Node_T oNNewParent = NULL;
+   Node_T oNOldParent;
+   char *pcName = NULL;
+   int iIndexes;
+
+   assert(pcSrc != NULL);
+   assert(pcDst != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   iStatus = FT_findNode(pcSrc, &oNSrc);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* the root stays where it is */
+   oNOldParent = Node_getParent(oNSrc);
+   if(oNOldParent == NULL)
+      return CONFLICTING_PATH;
+
+   if(FT_reserveUndo(1) != SUCCESS)
+      return MEMORY_ERROR;
+   iStatus = FT_findDestination(oNSrc, pcDst, &oNNewParent, &pcName);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = Node_move(oNSrc, oNNewParent, &pcName);
+   if(iStatus != SUCCESS) {
+      free(pcName);
+      return iStatus;
+   }
+
+   /* only the moved node's own name changed, so only its own index
+      entries need refiling; pcName now holds its old name */
+   iIndexes = FT_getIndexes();
+   if(iIndexes != 0 && strcmp(pcName, Node_getName(oNSrc)) != 0) {
+      FT_unindexName(oNSrc, pcName, iIndexes);
+      iStatus = FT_indexNode(oNSrc, iIndexes);
+      if(iStatus != SUCCESS) {
+         /* moving back into the room just vacated cannot fail */
+         (void) Node_move(oNSrc, oNOldParent, &pcName);
+         if(FT_indexNode(oNSrc, iIndexes) != SUCCESS)
+            FT_dropIndexes();
+      }
+   }
+   /* a transaction keeps the old name to move back under */
+   if(iStatus == SUCCESS && bInTransaction)
+      FT_logUndo(FT_UNDO_MOVE, oNSrc, oNOldParent, pcName, 0);
+   else
+      free(pcName);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return iStatus;
+}
+
+int FT_cp(const char *pcSrc, const char *pcDst) {
+   int iStatus;
+   Node_T oNSrc = NULL;
+   Node_T oNParent = NULL;
+   Node_T oNCopy = NULL;
+   char *pcName = NULL;
+
+   assert(pcSrc != NULL);
+   assert(pcDst != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   iStatus = FT_findNode(pcSrc, &oNSrc);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   if(FT_reserveUndo(1) != SUCCESS)
+      return MEMORY_ERROR;
+   iStatus = FT_findDestination(oNSrc, pcDst, &oNParent, &pcName);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* a directory is shared with its copy, and unshared a level at a
+      time as either is changed, unless the copy's nodes are needed at
+      once: by the indexes, which keep entries in them, or by the undo
+      log, which keeps the original's nodes */
+   if(FT_getIndexes() == 0 && !bInTransaction)
+      iStatus = Node_share(oNSrc, oNParent, pcName, &oNCopy);
+   else
+      iStatus = Node_clone(oNSrc, oNParent, pcName, &oNCopy);
+   free(pcName);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* file the copies in the indexes */
+   iStatus = FT_indexSubtree(oNCopy, FT_getIndexes());
+   if(iStatus != SUCCESS) {
+      (void) Node_free(oNCopy);
+      return iStatus;
+   }
+   ulCount += Node_getNumNodes(oNCopy);
+   FT_logUndo(FT_UNDO_INSERT, oNCopy, NULL, NULL, 0);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return SUCCESS;
+}
+
+/*
+  Returns ALREADY_IN_TREE if merging directory oNSrc into directory
+  oNDst would meet a clash other than between two directories, and
+  SUCCESS otherwise, walking the two sorted children arrays side by
+  side.
+*/
+static int FT_findClash(Node_T oNDst, Node_T oNSrc) {
+   size_t i = 0;
+   size_t j = 0;
+
+   assert(oNDst != NULL);
+   assert(oNSrc != NULL);
+
+   while(i < Node_getNumChildren(oNDst) &&
+         j < Node_getNumChildren(oNSrc)) {
+      Node_T oNOld = Node_peekChild(oNDst, i);
+      Node_T oNNew = Node_peekChild(oNSrc, j);
+      int iCmp;
+
+      iCmp = strcmp(Node_getName(oNOld), Node_getName(oNNew));
+      if(iCmp <= 0)
+         i++;
+      if(iCmp >= 0)
+         j++;
+      if(iCmp == 0 && (Node_isFile(oNOld) || Node_isFile(oNNew) ||
+                       FT_findClash(oNOld, oNNew) != SUCCESS))
+         return ALREADY_IN_TREE;
+   }
+   return SUCCESS;
+}
+
+/*
+  Merges the children of directory oNSrc into directory oNDst as
+  described for FT_merge, settling clashes by iPolicy. What is left
+  in oNSrc is to be discarded: the source's losing entries, the
+  destination's replaced ones, and emptied directories. Moved nodes
+  keep their names, so their index entries stay valid. Returns
+  SUCCESS or MEMORY_ERROR.
+*/
+static int FT_mergeDirs(Node_T oNDst, Node_T oNSrc, int iPolicy) {
+   size_t i = 0;
+   size_t j;
+   int iStatus;
+
+   assert(oNDst != NULL);
+   assert(oNSrc != NULL);
+
+   iStatus = Node_adopt(oNDst, oNSrc);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* each child left in oNSrc has a namesake in oNDst, found in order
+      by the same side by side walk */
+   for(j = 0; j < Node_getNumChildren(oNSrc); j++) {
+      Node_T oNOld = NULL;
+      Node_T oNNew = NULL;
+
+      (void) Node_getChild(oNSrc, j, &oNNew);
+      do
+         (void) Node_getChild(oNDst, i++, &oNOld);
+      while(strcmp(Node_getName(oNOld), Node_getName(oNNew)) != 0);
+
+      if(!Node_isFile(oNOld) && !Node_isFile(oNNew)) {
+         iStatus = FT_mergeDirs(oNOld, oNNew, iPolicy);
+         if(iStatus != SUCCESS)
+            return iStatus;
+      }
+      else if(iPolicy == FT_MERGE_REPLACE)
+         Node_swap(oNOld, oNNew);
+   }
+   return SUCCESS;
+}
+
+int FT_merge(const char *pcDst, const char *pcSrc, int iPolicy) {
+   int iStatus;
+   Node_T oNSrc = NULL;
+   Node_T oNDst = NULL;
+   Node_T oNAncestor;
+   Node_T oNTop = NULL;
+   size_t ulChildID;
+
+   assert(pcDst != NULL);
+   assert(pcSrc != NULL);
+   assert(iPolicy == FT_MERGE_FAIL || iPolicy == FT_MERGE_KEEP ||
+          iPolicy == FT_MERGE_REPLACE);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(bInTransaction)
+      return INITIALIZATION_ERROR;
+
+   iStatus = FT_findNode(pcSrc, &oNSrc);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(Node_isFile(oNSrc))
+      return NOT_A_DIRECTORY;
+   if(Node_getParent(oNSrc) == NULL)
+      return CONFLICTING_PATH;
+
+   /* a new destination has the whole source grafted on */
+   iStatus = FT_findNode(pcDst, &oNDst);
+   if(iStatus == NO_SUCH_PATH)
+      return FT_mv(pcSrc, pcDst);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(Node_isFile(oNDst))
+      return NOT_A_DIRECTORY;
+
+   /* pcDst may not lie within pcSrc; pcSrc may lie within pcDst as
+      long as none of its entries would be merged into a directory
+      containing it, which could only begin with its namesake of the
+      directory it lies in just below pcDst */
+   for(oNAncestor = oNDst; oNAncestor != NULL && oNAncestor != oNSrc;
+       oNAncestor = Node_getParent(oNAncestor))
+      ;
+   if(oNAncestor == oNSrc)
+      return CONFLICTING_PATH;
+   for(oNAncestor = oNSrc; oNAncestor != NULL && oNAncestor != oNDst;
+       oNAncestor = Node_getParent(oNAncestor))
+      oNTop = oNAncestor;
+   if(oNAncestor == oNDst &&
+      Node_hasChildName(oNSrc, Node_getName(oNTop), &ulChildID))
+      return CONFLICTING_PATH;
+
+   if(iPolicy == FT_MERGE_FAIL) {
+      iStatus = FT_findClash(oNDst, oNSrc);
+      if(iStatus != SUCCESS)
+         return iStatus;
+   }
+
+   iStatus = FT_mergeDirs(oNDst, oNSrc, iPolicy);
+   if(iStatus == SUCCESS)
+      FT_removeSubtree(oNSrc);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return iStatus;
+}
+
+/* A detached subtree: just its root, which has no parent */
+struct FT_Subtree {
+   Node_T oNRoot;
+};
+
+int FT_detach(const char *pcPath, FT_Subtree_T *poSubtree) {
+   int iStatus;
+   Node_T oNFound = NULL;
+   FT_Subtree_T oSubtree;
+
+   assert(pcPath != NULL);
+   assert(poSubtree != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   *poSubtree = NULL;
+   if(bInTransaction)
+      return INITIALIZATION_ERROR;
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(Node_getParent(oNFound) == NULL)
+      return CONFLICTING_PATH;
+
+   oSubtree = malloc(sizeof(struct FT_Subtree));
+   if(oSubtree == NULL)
+      return MEMORY_ERROR;
+
+   FT_unindexSubtree(oNFound, FT_getIndexes());
+   Node_detach(oNFound);
+   ulCount -= Node_getNumNodes(oNFound);
+   oSubtree->oNRoot = oNFound;
+   *poSubtree = oSubtree;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return SUCCESS;
+}
+
+int FT_attach(const char *pcPath, FT_Subtree_T oSubtree) {
+   int iStatus;
+   Node_T oNParent = NULL;
+   char *pcName = NULL;
+
+   assert(pcPath != NULL);
+   assert(oSubtree != NULL);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bIsInitialized || bInTransaction)
+      return INITIALIZATION_ERROR;
+   if(oNRoot == NULL)
+      return NO_SUCH_PATH;
+
+   iStatus = FT_findDestination(oSubtree->oNRoot, pcPath, &oNParent,
+                                &pcName);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Node_attach(oSubtree->oNRoot, oNParent, &pcName);
+   free(pcName);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* a subtree whose indexing fails goes back to the client, under
+      its new name, which is of no consequence there */
+   iStatus = FT_indexSubtree(oSubtree->oNRoot, FT_getIndexes());
+   if(iStatus != SUCCESS) {
+      Node_detach(oSubtree->oNRoot);
+      return iStatus;
+   }
+   ulCount += Node_getNumNodes(oSubtree->oNRoot);
+   free(oSubtree);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return SUCCESS;
+}
+
+size_t FT_freeSubtree(FT_Subtree_T oSubtree) {
+   size_t ulFreed;
+
+   assert(oSubtree != NULL);
+
+   ulFreed = Node_free(oSubtree->oNRoot);
+   free(oSubtree);
+   return ulFreed;
+}
+
+int FT_begin(void) {
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bIsInitialized || bInTransaction)
+      return INITIALIZATION_ERROR;
+   bInTransaction = TRUE;
+   return SUCCESS;
+}
+
+int FT_commit(void) {
+   size_t ulIndex;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bInTransaction)
+      return INITIALIZATION_ERROR;
+
+   /* free what the changes removed or replaced */
+   for(ulIndex = 0; ulIndex < ulUndoLength; ulIndex++) {
+      struct FT_Undo *psRecord = &psUndoLog[ulIndex];
+      if(psRecord->iKind == FT_UNDO_REMOVE)
+         FT_freeLater(psRecord->oNNode);
+      else
+         free(psRecord->pvOld);
+   }
+   FT_endTransaction();
+   return SUCCESS;
+}
+
+int FT_abort(void) {
+   size_t ulIndex;
+   int iIndexes;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bInTransaction)
+      return INITIALIZATION_ERROR;
+
+   /* undo the changes from the last one back, so that each finds the
+      tree as it left it, with the room it vacated */
+   iIndexes = FT_getIndexes();
+   for(ulIndex = ulUndoLength; ulIndex-- > 0; ) {
+      struct FT_Undo *psRecord = &psUndoLog[ulIndex];
+      Node_T oNNode = psRecord->oNNode;
+      char *pcName;
+
+      if(psRecord->iKind == FT_UNDO_INSERT)
+         FT_removeSubtree(oNNode);
+      else if(psRecord->iKind == FT_UNDO_REMOVE) {
+         if(psRecord->oNParent == NULL)
+            oNRoot = oNNode;
+         else
+            (void) Node_attach(oNNode, psRecord->oNParent, NULL);
+         ulCount += Node_getNumNodes(oNNode);
+         if(FT_indexSubtree(oNNode, iIndexes) != SUCCESS)
+            FT_dropIndexes();
+      }
+      else if(psRecord->iKind == FT_UNDO_MOVE) {
+         pcName = psRecord->pvOld;
+         (void) Node_move(oNNode, psRecord->oNParent, &pcName);
+         if(iIndexes != 0 && strcmp(pcName, Node_getName(oNNode)) != 0) {
+            FT_unindexName(oNNode, pcName, iIndexes);
+            if(FT_indexNode(oNNode, iIndexes) != SUCCESS)
+               FT_dropIndexes();
+         }
+         free(pcName);
+      }
+      else
+         Node_restoreFileContents(oNNode, psRecord->pvOld,
+                                  psRecord->ulOldLength);
+      iIndexes = FT_getIndexes();
+   }
+   FT_endTransaction();
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return SUCCESS;
+}
+
+int FT_init(void) {
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+
+   if(bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   bIsInitialized = TRUE;
+   oNRoot = NULL;
+   ulCount = 0;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+   return SUCCESS;
+}
+
+int FT_destroy(void) {
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   /* an open transaction is kept, and the indexes go with the tree */
+   if(bInTransaction)
+      (void) FT_commit();
+   FT_dropIndexes();
+   bCacheStrings = FALSE;
+
+   if(oNRoot) {
+      ulCount -= Node_free(oNRoot);
+      oNRoot = NULL;
+   }
+   FT_stopReclaimer();
+
+   bIsInitialized = FALSE;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+   return SUCCESS;
+}
+
+void *FT_getFileContents(const char *pcPath) {
+  Node_T oNFound = NULL;
+  int iStatus;
+
+  assert(pcPath != NULL);
+
+  if(!bIsInitialized)
+    return NULL;
+  
+  iStatus = FT_findNode(pcPath, &oNFound);
+  if(iStatus != SUCCESS || !Node_isFile(oNFound)) {
+    return NULL;
+  }
+
+  if(!Node_isFile(oNFound))
+    return NULL;
+  
+  return Node_getFileContents(oNFound);
+}
+
+void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
+                             size_t ulNewLength) {
+  Node_T oNFound = NULL;
+  void *pvOld;
+  int iStatus;
+
+  assert(pcPath != NULL);
+
+  if(!bIsInitialized)
+    return NULL;
+  
+  iStatus = FT_findNode(pcPath, &oNFound);
+  if(iStatus != SUCCESS || !Node_isFile(oNFound)) {
+    return NULL;
+  }
+
+  if(!Node_isFile(oNFound))
+    return NULL;
+  
+  (void) FT_replaceContents(oNFound, pvNewContents, ulNewLength, &pvOld);
+  return pvOld;
+}
+
+int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize) {
+  Node_T oNFound = NULL;
+  int iStatus;
+
+  assert(pcPath != NULL);
+  assert(pbIsFile != NULL);
+  assert(pulSize != NULL);
+
+  if(!bIsInitialized)
+    return INITIALIZATION_ERROR;
+
+  iStatus = FT_findNode(pcPath, &oNFound);
+  if(iStatus != SUCCESS) {
+    return iStatus;
+  }
+
+  if(Node_isFile(oNFound)) {
+    *pbIsFile = TRUE;
+    *pulSize = Node_getFileLength(oNFound);
+  }   
+  else {
+    *pbIsFile = FALSE;
+  }
+  return SUCCESS;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions are used for generating the
+  string representation of the DT.
+*/
+
+/*
+  Returns the length of the lines of the subtree rooted at oNNode,
+  whose path is ulPathLength bytes long, in O(1) time from the
+  subtree's node count and length of the paths below it.
+*/
+static size_t FT_subtreeLength(Node_T oNNode, size_t ulPathLength) {
+   return Node_getNumNodes(oNNode) * (ulPathLength + 1) +
+          Node_getBelowLength(oNNode);
+}
+
+/*
+  Writes to pcOut the line of oNNode alone, and returns the length of
+  its path. The path of oNNode's parent, unless oNNode is the root, is
+  ulParentLength bytes long, and is at pcParent, or is written from
+  the parent if pcParent is NULL.
+*/
+static size_t FT_writeLine(Node_T oNNode, const char *pcParent,
+                           size_t ulParentLength, char *pcOut) {
+   size_t ulNameLength = strlen(Node_getName(oNNode));
+   size_t ulLength = ulNameLength;
+
+   if(Node_getParent(oNNode) != NULL) {
+      ulLength += ulParentLength + 1;
+      if(pcParent != NULL)
+         memcpy(pcOut, pcParent, ulParentLength);
+      else
+         (void) Node_writePath(Node_getParent(oNNode), pcOut);
+      pcOut[ulParentLength] = '/';
+   }
+   memcpy(pcOut + ulLength - ulNameLength, Node_getName(oNNode),
+          ulNameLength);
+   pcOut[ulLength] = '\n';
+   return ulLength;
+}
+
+/*
+  Writes to pcOut the lines of oNNode's subtree down to ulMaxDepth
+  levels below it ((size_t) -1 for all) in FT_toString order, and
+  returns their length. The path of oNNode's parent is passed as to
+  FT_writeLine; each line then starts with the path of its node's
+  parent, so each is written in time proportional to its length.
+*/
+static size_t FT_writeLines(Node_T oNNode, const char *pcParent,
+                            size_t ulParentLength, size_t ulMaxDepth,
+                            char *pcOut) {
+   size_t ulLength = FT_writeLine(oNNode, pcParent, ulParentLength,
+                                  pcOut);
+   size_t ulWritten = ulLength + 1;
+   size_t c;
+   int iPass;
+
+   if(ulMaxDepth == 0)
+      return ulWritten;
+   /* files on the first pass, directories on the second */
+   for(iPass = 0; iPass < 2; iPass++)
+      for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+         Node_T oNChild = Node_peekChild(oNNode, c);
+         if(Node_isFile(oNChild) != (iPass == 0))
+            continue;
+         ulWritten += FT_writeLines(oNChild, pcOut, ulLength,
+                                    ulMaxDepth - 1, pcOut + ulWritten);
+      }
+   return ulWritten;
+}
+
+/*
+  Returns the length of the lines FT_writeLines writes for oNNode's
+  subtree down to ulMaxDepth levels below it, where oNNode's path is
+  ulPathLength bytes long: in O(1) time for the whole subtree, and
+  otherwise visiting only the nodes within the depth.
+*/
+static size_t FT_linesLength(Node_T oNNode, size_t ulPathLength,
+                             size_t ulMaxDepth) {
+   size_t ulLength = ulPathLength + 1;
+   size_t c;
+
+   if(ulMaxDepth == (size_t) -1)
+      return FT_subtreeLength(oNNode, ulPathLength);
+   if(ulMaxDepth == 0)
+      return ulLength;
+   for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+      Node_T oNChild = Node_peekChild(oNNode, c);
+      ulLength += FT_linesLength(oNChild, ulPathLength + 1 +
+                                 strlen(Node_getName(oNChild)),
+                                 ulMaxDepth - 1);
+   }
+   return ulLength;
+}
+
+/*
+  Writes to pcOut the lines of oNNode's subtree like FT_writeLines,
+  but copying those of the directories with an up-to-date fragment
+  from it, and returns their length. Unless bOwned (an ancestor's
+  fragment is being made), the directories whose lines take at most
+  FT_FRAGMENT_MAX bytes but whose parents' take more, or the root if
+  its do, keep their lines as their fragment; all others drop theirs,
+  so the fragments hold each line at most once. The nodes below a
+  shared directory are the snapshot's, so they keep no fragments.
+*/
+static size_t FT_writeCached(Node_T oNNode, const char *pcParent,
+                             size_t ulParentLength, char *pcOut,
+                             boolean bOwned) {
+   size_t ulLength = FT_writeLine(oNNode, pcParent, ulParentLength,
+                                  pcOut);
+   size_t ulWritten = ulLength + 1;
+   size_t ulSubtree;
+   size_t ulFragment;
+   const char *pcFragment;
+   boolean bKeeps;
+   size_t c;
+   int iPass;
+
+   if(Node_isFile(oNNode))
+      return ulWritten;
+   ulSubtree = FT_subtreeLength(oNNode, ulLength);
+   bKeeps = (boolean) (!bOwned && ulSubtree <= FT_FRAGMENT_MAX);
+
+   /* a fragment is up to date if no change below dropped it, and the
+      subtree was not moved since: its first line is still this one */
+   pcFragment = Node_getFragment(oNNode, &ulFragment);
+   if(pcFragment != NULL && ulFragment == ulSubtree &&
+      memcmp(pcFragment, pcOut, ulWritten) == 0) {
+      memcpy(pcOut + ulWritten, pcFragment + ulWritten,
+             ulSubtree - ulWritten);
+      if(!bKeeps)
+         Node_setFragment(oNNode, NULL, 0);
+      return ulSubtree;
+   }
+
+   /* files on the first pass, directories on the second */
+   for(iPass = 0; iPass < 2; iPass++)
+      for(c = 0; c < Node_getNumChildren(oNNode); c++) {
+         Node_T oNChild = Node_peekChild(oNNode, c);
+         if(Node_isFile(oNChild) != (iPass == 0))
+            continue;
+         if(Node_isShared(oNNode))
+            ulWritten += FT_writeLines(oNChild, pcOut, ulLength,
+                                       (size_t) -1, pcOut + ulWritten);
+         else
+            ulWritten += FT_writeCached(oNChild, pcOut, ulLength,
+                                        pcOut + ulWritten,
+                                        (boolean) (bOwned || bKeeps));
+      }
+
+   /* a failure to cache only costs the next call a rewrite */
+   pcFragment = NULL;
+   if(bKeeps) {
+      char *pcNew = malloc(ulWritten);
+      if(pcNew != NULL)
+         memcpy(pcNew, pcOut, ulWritten);
+      pcFragment = pcNew;
+   }
+   Node_setFragment(oNNode, (char *) pcFragment, ulWritten);
+   return ulWritten;
+}
+
+/* Drops the fragments cached in the subtree rooted at oNNode. */
+static void FT_dropFragments(Node_T oNNode) {
+   size_t c;
+
+   if(Node_isFile(oNNode))
+      return;
+   Node_setFragment(oNNode, NULL, 0);
+   if(Node_isShared(oNNode))
+      return;
+   for(c = 0; c < Node_getNumChildren(oNNode); c++)
+      FT_dropFragments(Node_peekChild(oNNode, c));
+}
+
+/* Writes the FT_toString representation, without its '\0', to pcOut,
+   through the fragments if the string cache is enabled. */
+static void FT_writeString(char *pcOut) {
+   if(oNRoot == NULL)
+      return;
+   if(bCacheStrings)
+      (void) FT_writeCached(oNRoot, NULL, 0, pcOut, FALSE);
+   else
+      (void) FT_writeLines(oNRoot, NULL, 0, (size_t) -1, pcOut);
+}
+
+/* Returns the length of the FT_toString representation, without its
+   '\0', in O(1) time. */
+static size_t FT_stringLength(void) {
+   if(oNRoot == NULL)
+      return 0;
+   return FT_subtreeLength(oNRoot, strlen(Node_getName(oNRoot)));
+}
+/*--------------------------------------------------------------------*/
+
+char *FT_toString(void) {
+   size_t ulLength;
+   char *pcResult;
+
+   if(!bIsInitialized)
+      return NULL;
+
+   ulLength = FT_stringLength();
+   pcResult = malloc(ulLength + 1);
+   if(pcResult == NULL)
+      return NULL;
+   FT_writeString(pcResult);
+   pcResult[ulLength] = '\0';
+
+   return pcResult;
+}
+
+int FT_toStringInto(char *pcBuf, size_t ulCap, size_t *pulLength) {
+   size_t ulLength;
+
+   assert(pcBuf != NULL || ulCap == 0);
+   assert(pulLength != NULL);
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   ulLength = FT_stringLength();
+   *pulLength = ulLength;
+   if(ulLength >= ulCap)
+      return MEMORY_ERROR;
+   FT_writeString(pcBuf);
+   pcBuf[ulLength] = '\0';
+   return SUCCESS;
+}
+
+int FT_setStringCache(boolean bEnable) {
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   if(!bEnable && bCacheStrings && oNRoot != NULL)
+      FT_dropFragments(oNRoot);
+   bCacheStrings = bEnable;
+   return SUCCESS;
+}
+
+char *FT_toStringAt(const char *pcPath, size_t ulMaxDepth) {
+   Node_T oNFound = NULL;
+   Node_T oNParent;
+   size_t ulParentLength = 0;
+   size_t ulLength;
+   char *pcResult;
+
+   assert(pcPath != NULL);
+
+   if(FT_findNode(pcPath, &oNFound) != SUCCESS)
+      return NULL;
+
+   /* the length is measured first, so the lines are written once, in
+      place, the first from the parent's path */
+   oNParent = Node_getParent(oNFound);
+   if(oNParent != NULL)
+      ulParentLength = Node_getPathLength(oNParent);
+   ulLength = FT_linesLength(oNFound, Node_getPathLength(oNFound),
+                             ulMaxDepth);
+   pcResult = malloc(ulLength + 1);
+   if(pcResult == NULL)
+      return NULL;
+   (void) FT_writeLines(oNFound, NULL, ulParentLength, ulMaxDepth,
+                        pcResult);
+   pcResult[ulLength] = '\0';
+   return pcResult;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions are used for streaming tar
+  archives into and out of the FT.
+*/
+
+/* Buffering and batching limits for tar import and export */
+enum { FT_TAR_READ_BLOCKS = 64, FT_TAR_IOV_BATCH = 64,
+       FT_TAR_SCRATCH = 64 * TAR_BLOCK_SIZE };
+
+/* Zero bytes used for data padding and the end-of-archive marker */
+static char acTarZeros[2 * TAR_BLOCK_SIZE];
+
+/* A buffered reader over the archive's file descriptor */
+struct FT_TarReader {
+   /* the descriptor being read */
+   int iFd;
+   /* bytes read from iFd but not yet consumed, at acBuf[ulPos..ulEnd) */
+   char acBuf[FT_TAR_READ_BLOCKS * TAR_BLOCK_SIZE];
+   size_t ulPos;
+   size_t ulEnd;
+};
+
+/*
+  Refills psReader's buffer if it is empty. Returns SUCCESS, or
+  IO_ERROR if the read fails. Leaves the buffer empty at end of file.
+*/
+static int FT_tarFill(struct FT_TarReader *psReader) {
+   ssize_t lRead;
+
+   assert(psReader != NULL);
+
+   if(psReader->ulPos < psReader->ulEnd)
+      return SUCCESS;
+
+   do
+      lRead = read(psReader->iFd, psReader->acBuf,
+                   sizeof(psReader->acBuf));
+   while(lRead < 0 && errno == EINTR);
+   if(lRead < 0)
+      return IO_ERROR;
+
+   psReader->ulPos = 0;
+   psReader->ulEnd = (size_t) lRead;
+   return SUCCESS;
+}
+
+/*
+  Consumes the next ulLength bytes from psReader, copying them to
+  pvDest unless it is NULL. Returns SUCCESS, or IO_ERROR if the read
+  fails or the archive ends first.
+*/
+static int FT_tarRead(struct FT_TarReader *psReader, void *pvDest,
+                      size_t ulLength) {
+   char *pcDest = pvDest;
+   int iStatus;
+
+   assert(psReader != NULL);
+
+   while(ulLength > 0) {
+      size_t ulChunk;
+
+      iStatus = FT_tarFill(psReader);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      if(psReader->ulPos == psReader->ulEnd)
+         return IO_ERROR;
+
+      ulChunk = psReader->ulEnd - psReader->ulPos;
+      if(ulChunk > ulLength)
+         ulChunk = ulLength;
+      if(pcDest != NULL) {
+         memcpy(pcDest, psReader->acBuf + psReader->ulPos, ulChunk);
+         pcDest += ulChunk;
+      }
+      psReader->ulPos += ulChunk;
+      ulLength -= ulChunk;
+   }
+   return SUCCESS;
+}
+
+/*
+  Reads the ulSize data bytes of the current member (plus padding)
+  from psReader into *ppcBuf, growing it (and *pulCap) if necessary,
+  and '\0'-terminates them. Returns SUCCESS, IO_ERROR or MEMORY_ERROR.
+*/
+static int FT_tarReadData(struct FT_TarReader *psReader, size_t ulSize,
+                          char **ppcBuf, size_t *pulCap) {
+   int iStatus;
+
+   assert(psReader != NULL);
+   assert(ppcBuf != NULL);
+   assert(pulCap != NULL);
+
+   if(ulSize + 1 > *pulCap) {
+      char *pcNew = realloc(*ppcBuf, ulSize + 1);
+      if(pcNew == NULL)
+         return MEMORY_ERROR;
+      *ppcBuf = pcNew;
+      *pulCap = ulSize + 1;
+   }
+
+   iStatus = FT_tarRead(psReader, *ppcBuf, ulSize);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   (*ppcBuf)[ulSize] = '\0';
+   return FT_tarRead(psReader, NULL, Tar_getPadding(ulSize));
+}
+
+/*
+  Adds the archive member named pcName to the FT: a file with
+  contents pvData of ulSize bytes if bIsFile, or a directory. Leading
+  "./" and '/' and trailing '/' are ignored. An existing directory
+  is left alone and an existing file gets the new contents, as when
+  tar extracts over a tree. *poNFinger is the node touched by the
+  previous member; insertion searches from there, and it is updated
+  to this member's directory. Returns SUCCESS or the status of the
+  failed insertion.
+*/
+static int FT_tarImportMember(char *pcName, boolean bIsFile,
+                              void *pvData, size_t ulSize,
+                              Node_T *poNFinger) {
+   Path_T oPPath = NULL;
+   Node_T oNNode = NULL;
+   size_t ulLen;
+   int iStatus;
+
+   assert(pcName != NULL);
+   assert(poNFinger != NULL);
+
+   for(;;) {
+      if(pcName[0] == '/')
+         pcName++;
+      else if(pcName[0] == '.' && pcName[1] == '/')
+         pcName += 2;
+      else
+         break;
+   }
+   ulLen = strlen(pcName);
+   while(ulLen > 0 && pcName[ulLen - 1] == '/')
+      pcName[--ulLen] = '\0';
+   if(ulLen == 0 || !strcmp(pcName, "."))
+      return SUCCESS;
+
+   iStatus = Path_new(pcName, &oPPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = FT_insertNode(oPPath, *poNFinger, bIsFile, pvData, ulSize,
+                           &oNNode);
+   Path_free(oPPath);
+
+   if(iStatus == ALREADY_IN_TREE && Node_isFile(oNNode) == bIsFile) {
+      iStatus = SUCCESS;
+      if(bIsFile) {
+         void *pvOld;
+         iStatus = FT_replaceContents(oNNode, pvData, ulSize, &pvOld);
+         free(pvOld);
+      }
+   }
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   *poNFinger = bIsFile ? Node_getParent(oNNode) : oNNode;
+   return SUCCESS;
+}
+
+int FT_importTar(int iFd) {
+   struct FT_TarReader *psReader;
+   struct TarHeader sHeader;
+   char acBlock[TAR_BLOCK_SIZE];
+   char *pcLongName = NULL;
+   size_t ulPaxSize = 0;
+   boolean bHasPaxSize = FALSE;
+   char *pcData = NULL;
+   size_t ulDataCap = 0;
+   Node_T oNFinger = NULL;
+   int iStatus = SUCCESS;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   psReader = malloc(sizeof(struct FT_TarReader));
+   if(psReader == NULL)
+      return MEMORY_ERROR;
+   psReader->iFd = iFd;
+   psReader->ulPos = psReader->ulEnd = 0;
+
+   for(;;) {
+      /* a missing end-of-archive marker is tolerated */
+      iStatus = FT_tarFill(psReader);
+      if(iStatus != SUCCESS || psReader->ulPos == psReader->ulEnd)
+         break;
+      iStatus = FT_tarRead(psReader, acBlock, TAR_BLOCK_SIZE);
+      if(iStatus != SUCCESS || Tar_isZeroBlock(acBlock))
+         break;
+      iStatus = Tar_parseHeader(acBlock, &sHeader);
+      if(iStatus != SUCCESS)
+         break;
+
+      if(sHeader.iType == TAR_PAX) {
+         iStatus = FT_tarReadData(psReader, sHeader.ulSize, &pcData,
+                                  &ulDataCap);
+         if(iStatus == SUCCESS)
+            iStatus = Tar_parsePax(pcData, sHeader.ulSize, &pcLongName,
+                                   &ulPaxSize, &bHasPaxSize);
+      }
+      else if(sHeader.iType == TAR_LONGNAME) {
+         iStatus = FT_tarReadData(psReader, sHeader.ulSize, &pcData,
+                                  &ulDataCap);
+         if(iStatus == SUCCESS) {
+            free(pcLongName);
+            pcLongName = malloc(strlen(pcData) + 1);
+            if(pcLongName == NULL)
+               iStatus = MEMORY_ERROR;
+            else
+               strcpy(pcLongName, pcData);
+         }
+      }
+      else if(sHeader.iType == TAR_FILE || sHeader.iType == TAR_DIR) {
+         boolean bIsFile = (boolean) (sHeader.iType == TAR_FILE);
+         size_t ulSize = 0;
+
+         if(bIsFile) {
+            ulSize = bHasPaxSize ? ulPaxSize : sHeader.ulSize;
+            iStatus = FT_tarReadData(psReader, ulSize, &pcData,
+                                     &ulDataCap);
+         }
+         if(iStatus == SUCCESS)
+            iStatus = FT_tarImportMember(pcLongName != NULL ?
+                                            pcLongName : sHeader.acName,
+                                         bIsFile, pcData, ulSize,
+                                         &oNFinger);
+         free(pcLongName);
+         pcLongName = NULL;
+         bHasPaxSize = FALSE;
+      }
+      else {
+         /* global headers and members the FT can't represent */
+         iStatus = FT_tarRead(psReader, NULL, sHeader.ulSize +
+                              Tar_getPadding(sHeader.ulSize));
+         if(sHeader.iType != TAR_GLOBAL_PAX) {
+            free(pcLongName);
+            pcLongName = NULL;
+            bHasPaxSize = FALSE;
+         }
+      }
+      if(iStatus != SUCCESS)
+         break;
+   }
+
+   free(pcLongName);
+   free(pcData);
+   free(psReader);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return iStatus;
+}
+
+/*
+  Writes the ulVecs buffers described by aoVec to iFd, retrying after
+  short writes. Returns SUCCESS or IO_ERROR.
+*/
+static int FT_writevAll(int iFd, struct iovec *aoVec, size_t ulVecs) {
+   while(ulVecs > 0) {
+      ssize_t lWritten = writev(iFd, aoVec, (int) ulVecs);
+      size_t ulDone;
+
+      if(lWritten < 0) {
+         if(errno == EINTR)
+            continue;
+         return IO_ERROR;
+      }
+
+      /* skip the buffers written, and the written part of the next */
+      ulDone = (size_t) lWritten;
+      while(ulVecs > 0 && ulDone >= aoVec->iov_len) {
+         ulDone -= aoVec->iov_len;
+         aoVec++;
+         ulVecs--;
+      }
+      if(ulVecs > 0) {
+         aoVec->iov_base = (char *) aoVec->iov_base + ulDone;
+         aoVec->iov_len -= ulDone;
+      }
+   }
+   return SUCCESS;
+}
+
+int FT_exportTar(int iFd) {
+   struct FT_Scan sScan = { NULL, 0, 0 };
+   Node_T oNNode;
+   struct iovec aoVec[FT_TAR_IOV_BATCH];
+   size_t ulVecs = 0;
+   char *pcScratch;
+   size_t ulScratchCap = FT_TAR_SCRATCH;
+   size_t ulScratchUsed = 0;
+   struct FT_PathBuf sBuf = { NULL, 0, SUCCESS };
+   int iStatus = SUCCESS;
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   pcScratch = malloc(ulScratchCap);
+   if(pcScratch == NULL)
+      return MEMORY_ERROR;
+
+   /* the nodes are reached in FT_toString order with a stack of one
+      frame per ancestor; headers are formatted into pcScratch, while
+      file contents and padding are written straight from where they
+      already live */
+   for(oNNode = oNRoot; oNNode != NULL && iStatus == SUCCESS;
+       oNNode = FT_scanNextLine(&sScan)) {
+      const char *pcName = FT_getPath(oNNode, &sBuf);
+      boolean bIsFile = Node_isFile(oNNode);
+      size_t ulSize = Node_getFileLength(oNNode);
+      size_t ulHeader;
+
+      if(pcName == NULL) {
+         iStatus = MEMORY_ERROR;
+         break;
+      }
+      ulHeader = Tar_getHeaderLength(pcName, !bIsFile, ulSize);
+
+      if(ulVecs + 4 > FT_TAR_IOV_BATCH ||
+         ulScratchUsed + ulHeader > ulScratchCap) {
+         iStatus = FT_writevAll(iFd, aoVec, ulVecs);
+         ulVecs = 0;
+         ulScratchUsed = 0;
+         if(iStatus != SUCCESS)
+            break;
+      }
+      if(ulHeader > ulScratchCap) {
+         char *pcNew = realloc(pcScratch, ulHeader);
+         if(pcNew == NULL) {
+            iStatus = MEMORY_ERROR;
+            break;
+         }
+         pcScratch = pcNew;
+         ulScratchCap = ulHeader;
+      }
+
+      Tar_formatHeader(pcScratch + ulScratchUsed, pcName, !bIsFile,
+                       ulSize);
+      aoVec[ulVecs].iov_base = pcScratch + ulScratchUsed;
+      aoVec[ulVecs++].iov_len = ulHeader;
+      ulScratchUsed += ulHeader;
+
+      if(ulSize > 0) {
+         aoVec[ulVecs].iov_base = Node_getFileContents(oNNode);
+         aoVec[ulVecs++].iov_len = ulSize;
+         if(Tar_getPadding(ulSize) > 0) {
+            aoVec[ulVecs].iov_base = acTarZeros;
+            aoVec[ulVecs++].iov_len = Tar_getPadding(ulSize);
+         }
+      }
+      if(Node_getNumChildren(oNNode) > 0) {
+         iStatus = Node_unshare(oNNode);
+         if(iStatus == SUCCESS)
+            iStatus = FT_scanPush(&sScan, oNNode, 0);
+      }
+   }
+
+   if(iStatus == SUCCESS) {
+      aoVec[ulVecs].iov_base = acTarZeros;
+      aoVec[ulVecs++].iov_len = sizeof(acTarZeros);
+      iStatus = FT_writevAll(iFd, aoVec, ulVecs);
+   }
+
+   free(pcScratch);
+   free(sBuf.pcPath);
+   free(sScan.psFrames);
+   return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions are used for matching glob
+  patterns against the FT.
+*/
+
+/* Number of levels of pattern states an FT_glob call starts with */
+enum { FT_GLOB_LEVELS = 16 };
+
+/* The state of one FT_glob call */
+struct FT_Glob {
+   /* the pattern's components, and how many there are */
+   char **ppcComps;
+   size_t ulComps;
+   /* for each component, whether it is "**" / free of wildcards */
+   boolean *pbIsAnyDepth;
+   boolean *pbIsLiteral;
+   /* the components each level of the search may match next, as
+      ulComps + 1 flags per level, in one array of ulLevels levels
+      that the nodes at each level reuse; level 0 is above the root */
+   boolean *pbStates;
+   size_t ulLevels;
+   /* the client's visitor and its extra argument */
+   FT_Visitor_T pfVisit;
+   void *pvExtra;
+   /* set once the visitor asks to stop, or on allocation failure */
+   boolean bStopped;
+   int iStatus;
+   /* where the paths of matches are assembled */
+   struct FT_PathBuf sBuf;
+};
+
+/*
+  Matches the single character c against the pattern element at
+  *ppcPat ('?', a "[...]" set, an escaped or a plain character),
+  advancing *ppcPat past the element. Returns TRUE if c matches.
+*/
+static boolean FT_matchElement(const char **ppcPat, char c) {
+   const char *pcPat = *ppcPat;
+   boolean bNegate = FALSE;
+   boolean bFound = FALSE;
+   const char *pcEnd;
+
+   if(*pcPat == '?') {
+      *ppcPat = pcPat + 1;
+      return TRUE;
+   }
+   if(*pcPat == '\\' && pcPat[1] != '\0') {
+      *ppcPat = pcPat + 2;
+      return (boolean) (pcPat[1] == c);
+   }
+   if(*pcPat != '[') {
+      *ppcPat = pcPat + 1;
+      return (boolean) (*pcPat == c);
+   }
+
+   /* find the end of the set; a ']' right after '[' is a member */
+   pcEnd = pcPat + 1;
+   if(*pcEnd == '!' || *pcEnd == '^')
+      pcEnd++;
+   if(*pcEnd == ']')
+      pcEnd++;
+   while(*pcEnd != '\0' && *pcEnd != ']')
+      pcEnd++;
+   if(*pcEnd == '\0') {
+      /* unterminated: the '[' is an ordinary character */
+      *ppcPat = pcPat + 1;
+      return (boolean) (c == '[');
+   }
+
+   pcPat++;
+   if(*pcPat == '!' || *pcPat == '^') {
+      bNegate = TRUE;
+      pcPat++;
+   }
+   do {
+      if(pcPat[1] == '-' && pcPat + 2 < pcEnd) {
+         if((unsigned char) c >= (unsigned char) pcPat[0] &&
+            (unsigned char) c <= (unsigned char) pcPat[2])
+            bFound = TRUE;
+         pcPat += 3;
+      }
+      else {
+         if(*pcPat == c)
+            bFound = TRUE;
+         pcPat++;
+      }
+   } while(pcPat < pcEnd);
+
+   *ppcPat = pcEnd + 1;
+   return (boolean) (bFound != bNegate);
+}
+
+/* Returns TRUE if path component pcName matches the pattern
+   component pcPat. */
+static boolean FT_matchComponent(const char *pcPat, const char *pcName) {
+   const char *pcStarPat = NULL;
+   const char *pcStarName = NULL;
+
+   assert(pcPat != NULL);
+   assert(pcName != NULL);
+
+   while(*pcName != '\0') {
+      if(*pcPat == '*') {
+         /* remember the star; first try matching it to nothing */
+         pcStarPat = ++pcPat;
+         pcStarName = pcName;
+      }
+      else if(*pcPat != '\0' && FT_matchElement(&pcPat, *pcName))
+         pcName++;
+      else if(pcStarPat != NULL) {
+         /* let the last star swallow one more character */
+         pcPat = pcStarPat;
+         pcName = ++pcStarName;
+      }
+      else
+         return FALSE;
+   }
+   while(*pcPat == '*')
+      pcPat++;
+   return (boolean) (*pcPat == '\0');
+}
+
+/* Returns the pattern states of level ulLevel of psGlob's search. */
+static boolean *FT_globLevel(struct FT_Glob *psGlob, size_t ulLevel) {
+   assert(ulLevel < psGlob->ulLevels);
+   return psGlob->pbStates + ulLevel * (psGlob->ulComps + 1);
+}
+
+/*
+  Visits oNNode at level ulLevel of psGlob's search, reached with
+  level ulLevel - 1's flag i TRUE for each pattern component i that
+  its name may match next: reports oNNode if it completes the
+  pattern, then visits the children that the pattern can still
+  match, files before directories. The states it leaves for them are
+  level ulLevel's, which the levels array doubles to hold when deeper
+  than ever before, so the search allocates only O(log depth) times.
+*/
+static void FT_globVisit(struct FT_Glob *psGlob, Node_T oNNode,
+                         size_t ulLevel) {
+   const boolean *pbIn;
+   boolean *pbOut;
+   boolean bAlive = FALSE;
+   boolean bAllLiteral = TRUE;
+   const char *pcName = Node_getName(oNNode);
+   size_t ulComps = psGlob->ulComps;
+   size_t i;
+
+   if(ulLevel == psGlob->ulLevels) {
+      boolean *pbNew = realloc(psGlob->pbStates, 2 * ulLevel *
+                               (ulComps + 1) * sizeof(boolean));
+      if(pbNew == NULL) {
+         psGlob->iStatus = MEMORY_ERROR;
+         psGlob->bStopped = TRUE;
+         return;
+      }
+      psGlob->pbStates = pbNew;
+      psGlob->ulLevels = 2 * ulLevel;
+   }
+   pbIn = FT_globLevel(psGlob, ulLevel - 1);
+   pbOut = FT_globLevel(psGlob, ulLevel);
+   for(i = 0; i <= ulComps; i++)
+      pbOut[i] = FALSE;
+
+   /* consume this node's name, then follow "**" components, which
+      may also match nothing */
+   for(i = 0; i < ulComps; i++) {
+      if(!pbIn[i])
+         continue;
+      if(psGlob->pbIsAnyDepth[i])
+         pbOut[i] = TRUE;
+      else if(FT_matchComponent(psGlob->ppcComps[i], pcName))
+         pbOut[i + 1] = TRUE;
+   }
+   for(i = 0; i < ulComps; i++)
+      if(pbOut[i] && psGlob->pbIsAnyDepth[i])
+         pbOut[i + 1] = TRUE;
+
+   if(pbOut[ulComps]) {
+      const char *pcPath = FT_getPath(oNNode, &psGlob->sBuf);
+      if(pcPath == NULL) {
+         psGlob->iStatus = MEMORY_ERROR;
+         psGlob->bStopped = TRUE;
+      }
+      else if(psGlob->pfVisit(pcPath, Node_isFile(oNNode),
+                              Node_getFileLength(oNNode),
+                              psGlob->pvExtra) != 0)
+         psGlob->bStopped = TRUE;
+   }
+
+   for(i = 0; i < ulComps; i++) {
+      if(pbOut[i]) {
+         bAlive = TRUE;
+         if(!psGlob->pbIsLiteral[i])
+            bAllLiteral = FALSE;
+      }
+   }
+
+   /* the children's paths are written from their parent chains, so a
+      shared directory is unshared before they are visited */
+   if(bAlive && !psGlob->bStopped && !Node_isFile(oNNode) &&
+      Node_unshare(oNNode) != SUCCESS) {
+      psGlob->iStatus = MEMORY_ERROR;
+      psGlob->bStopped = TRUE;
+   }
+   if(bAlive && !psGlob->bStopped && !Node_isFile(oNNode)) {
+      Node_T oNChild = NULL;
+      size_t ulChildID;
+      int iPass;
+
+      /* two passes to list files before directories */
+      for(iPass = 0; iPass < 2 && !psGlob->bStopped; iPass++) {
+         if(bAllLiteral) {
+            /* literals name their children directly */
+            for(i = 0; i < ulComps && !psGlob->bStopped; i++) {
+               size_t j;
+               boolean bSeen = FALSE;
+               if(!pbOut[i] ||
+                  !Node_hasChildName(oNNode, psGlob->ppcComps[i],
+                                     &ulChildID))
+                  continue;
+               /* the same literal may be reached in two states */
+               for(j = 0; j < i; j++)
+                  if(pbOut[j] && !strcmp(psGlob->ppcComps[j],
+                                         psGlob->ppcComps[i]))
+                     bSeen = TRUE;
+               (void) Node_getChild(oNNode, ulChildID, &oNChild);
+               if(!bSeen && Node_isFile(oNChild) == (iPass == 0)) {
+                  FT_globVisit(psGlob, oNChild, ulLevel + 1);
+                  pbOut = FT_globLevel(psGlob, ulLevel);
+               }
+            }
+         }
+         else {
+            for(ulChildID = 0;
+                ulChildID < Node_getNumChildren(oNNode) &&
+                   !psGlob->bStopped;
+                ulChildID++) {
+               (void) Node_getChild(oNNode, ulChildID, &oNChild);
+               if(Node_isFile(oNChild) == (iPass == 0)) {
+                  FT_globVisit(psGlob, oNChild, ulLevel + 1);
+                  pbOut = FT_globLevel(psGlob, ulLevel);
+               }
+            }
+         }
+      }
+   }
+}
+/*--------------------------------------------------------------------*/
+
+int FT_glob(const char *pcPattern, FT_Visitor_T pfVisit,
+            void *pvExtra) {
+   struct FT_Glob sGlob;
+   char *pcCopy;
+   boolean *pbStart;
+   size_t ulLength;
+   size_t i, j;
+
+   assert(pcPattern != NULL);
+   assert(pfVisit != NULL);
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   /* same well-formedness rules as for paths */
+   ulLength = strlen(pcPattern);
+   if(ulLength == 0 || pcPattern[0] == '/' ||
+      pcPattern[ulLength - 1] == '/' || strstr(pcPattern, "//") != NULL)
+      return BAD_PATH;
+
+   pcCopy = malloc(ulLength + 1);
+   if(pcCopy == NULL)
+      return MEMORY_ERROR;
+   strcpy(pcCopy, pcPattern);
+
+   sGlob.ulComps = 1;
+   for(i = 0; i < ulLength; i++)
+      if(pcCopy[i] == '/')
+         sGlob.ulComps++;
+
+   sGlob.ppcComps = malloc(sGlob.ulComps * sizeof(char *));
+   sGlob.pbIsAnyDepth = malloc(sGlob.ulComps * sizeof(boolean));
+   sGlob.pbIsLiteral = malloc(sGlob.ulComps * sizeof(boolean));
+   sGlob.ulLevels = FT_GLOB_LEVELS;
+   sGlob.pbStates = calloc(sGlob.ulLevels * (sGlob.ulComps + 1),
+                           sizeof(boolean));
+   if(sGlob.ppcComps == NULL || sGlob.pbIsAnyDepth == NULL ||
+      sGlob.pbIsLiteral == NULL || sGlob.pbStates == NULL) {
+      free(sGlob.ppcComps);
+      free(sGlob.pbIsAnyDepth);
+      free(sGlob.pbIsLiteral);
+      free(sGlob.pbStates);
+      free(pcCopy);
+      return MEMORY_ERROR;
+   }
+
+   /* split in place */
+   sGlob.ppcComps[0] = pcCopy;
+   for(i = 0, j = 1; i < ulLength; i++) {
+      if(pcCopy[i] == '/') {
+         pcCopy[i] = '\0';
+         sGlob.ppcComps[j++] = pcCopy + i + 1;
+      }
+   }
+   for(i = 0; i < sGlob.ulComps; i++) {
+      sGlob.pbIsAnyDepth[i] =
+         (boolean) !strcmp(sGlob.ppcComps[i], "**");
+      sGlob.pbIsLiteral[i] =
+         (boolean) (strpbrk(sGlob.ppcComps[i], "*?[\\") == NULL);
+   }
+
+   sGlob.pfVisit = pfVisit;
+   sGlob.pvExtra = pvExtra;
+   sGlob.bStopped = FALSE;
+   sGlob.iStatus = SUCCESS;
+   sGlob.sBuf.pcPath = NULL;
+   sGlob.sBuf.ulCap = 0;
+   sGlob.sBuf.iStatus = SUCCESS;
+
+   /* the root may match the first component, or a leading "**" may
+      match nothing */
+   pbStart = FT_globLevel(&sGlob, 0);
+   pbStart[0] = TRUE;
+   for(i = 0; i < sGlob.ulComps && sGlob.pbIsAnyDepth[i]; i++)
+      pbStart[i + 1] = TRUE;
+   if(oNRoot != NULL)
+      FT_globVisit(&sGlob, oNRoot, 1);
+
+   free(sGlob.pbStates);
+   free(sGlob.sBuf.pcPath);
+   free(sGlob.pbIsLiteral);
+   free(sGlob.pbIsAnyDepth);
+   free(sGlob.ppcComps);
+   free(pcCopy);
+   return sGlob.iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions are used for size queries, which
+  use the per-directory file size aggregates to skip subtrees.
+*/
+
+/*
+  Visits, in FT_toString order, the files in oNNode's subtree whose
+  sizes are in [ulMin, ulMax], calling pfVisit on each until it
+  returns non-zero. Returns TRUE if pfVisit asked to stop.
+*/
+static boolean FT_findBySizeFrom(Node_T oNNode, size_t ulMin,
+                                 size_t ulMax, FT_Visitor_T pfVisit,
+                                 void *pvExtra,
+                                 struct FT_PathBuf *psBuf) {
+   Node_T oNChild = NULL;
+   size_t ulChildID;
+   int iPass;
+
+   assert(oNNode != NULL);
+   assert(pfVisit != NULL);
+
+   if(!Node_mayHaveSizeIn(oNNode, ulMin, ulMax))
+      return FALSE;
+
+   if(Node_isFile(oNNode)) {
+      const char *pcPath = FT_getPath(oNNode, psBuf);
+      return (boolean) (pcPath == NULL ||
+                        pfVisit(pcPath, TRUE, Node_getFileLength(oNNode),
+                                pvExtra) != 0);
+   }
+   if(Node_unshare(oNNode) != SUCCESS) {
+      psBuf->iStatus = MEMORY_ERROR;
+      return TRUE;
+   }
+
+   /* two passes to list files before directories */
+   for(iPass = 0; iPass < 2; iPass++) {
+      for(ulChildID = 0; ulChildID < Node_getNumChildren(oNNode);
+          ulChildID++) {
+         (void) Node_getChild(oNNode, ulChildID, &oNChild);
+         if(Node_isFile(oNChild) == (iPass == 0) &&
+            FT_findBySizeFrom(oNChild, ulMin, ulMax, pfVisit, pvExtra,
+                              psBuf))
+            return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/*
+  Returns TRUE if oNFirst should come out of the FT_topKLargest
+  frontier before oNSecond: it may hold a larger file, or it holds
+  an equally large one and is a file rather than a directory.
+*/
+static boolean FT_isLarger(Node_T oNFirst, Node_T oNSecond) {
+   size_t ulFirst = Node_getMaxFileSize(oNFirst);
+   size_t ulSecond = Node_getMaxFileSize(oNSecond);
+
+   if(ulFirst != ulSecond)
+      return (boolean) (ulFirst > ulSecond);
+   return (boolean) (Node_isFile(oNFirst) && !Node_isFile(oNSecond));
+}
+
+/* Adds oNNode to the binary max-heap of *pulLength nodes in
+   poNHeap, which must have room for it. */
+static void FT_heapPush(Node_T *poNHeap, size_t *pulLength,
+                        Node_T oNNode) {
+   size_t ulPos = (*pulLength)++;
+
+   while(ulPos > 0 && FT_isLarger(oNNode, poNHeap[(ulPos - 1) / 2])) {
+      poNHeap[ulPos] = poNHeap[(ulPos - 1) / 2];
+      ulPos = (ulPos - 1) / 2;
+   }
+   poNHeap[ulPos] = oNNode;
+}
+
+/* Removes and returns the largest node of the non-empty binary
+   max-heap of *pulLength nodes in poNHeap. */
+static Node_T FT_heapPop(Node_T *poNHeap, size_t *pulLength) {
+   Node_T oNTop = poNHeap[0];
+   Node_T oNLast = poNHeap[--(*pulLength)];
+   size_t ulPos = 0;
+
+   for(;;) {
+      size_t ulChild = 2 * ulPos + 1;
+      if(ulChild >= *pulLength)
+         break;
+      if(ulChild + 1 < *pulLength &&
+         FT_isLarger(poNHeap[ulChild + 1], poNHeap[ulChild]))
+         ulChild++;
+      if(!FT_isLarger(poNHeap[ulChild], oNLast))
+         break;
+      poNHeap[ulPos] = poNHeap[ulChild];
+      ulPos = ulChild;
+   }
+   poNHeap[ulPos] = oNLast;
+   return oNTop;
+}
+/*--------------------------------------------------------------------*/
+
+int FT_findBySize(const char *pcPath, size_t ulMin, size_t ulMax,
+                  FT_Visitor_T pfVisit, void *pvExtra) {
+   Node_T oNFound = NULL;
+   struct FT_PathBuf sBuf = { NULL, 0, SUCCESS };
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(pfVisit != NULL);
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   (void) FT_findBySizeFrom(oNFound, ulMin, ulMax, pfVisit, pvExtra,
+                            &sBuf);
+   free(sBuf.pcPath);
+   return sBuf.iStatus;
+}
+
+int FT_topKLargest(const char *pcPath, size_t ulK, char **ppcPaths,
+                   size_t *pulSizes, size_t *pulFound) {
+   Node_T oNFound = NULL;
+   Node_T *poNHeap;
+   size_t ulHeapCap = 16;
+   size_t ulHeapLength = 0;
+   size_t ulFound = 0;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(ulK == 0 || ppcPaths != NULL);
+   assert(pulFound != NULL);
+
+   *pulFound = 0;
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   poNHeap = malloc(ulHeapCap * sizeof(Node_T));
+   if(poNHeap == NULL)
+      return MEMORY_ERROR;
+
+   /* best-first search: a directory's largest file bounds everything
+      below it, so only directories that could still hold one of the
+      k largest are ever expanded */
+   if(Node_getNumFiles(oNFound) != 0)
+      FT_heapPush(poNHeap, &ulHeapLength, oNFound);
+   while(ulFound < ulK && ulHeapLength > 0) {
+      Node_T oNTop = FT_heapPop(poNHeap, &ulHeapLength);
+      size_t ulChildID;
+
+      if(Node_isFile(oNTop)) {
+         ppcPaths[ulFound] = Node_toString(oNTop);
+         if(ppcPaths[ulFound] == NULL) {
+            iStatus = MEMORY_ERROR;
+            break;
+         }
+         if(pulSizes != NULL)
+            pulSizes[ulFound] = Node_getFileLength(oNTop);
+         ulFound++;
+         continue;
+      }
+
+      if(Node_unshare(oNTop) != SUCCESS) {
+         iStatus = MEMORY_ERROR;
+         break;
+      }
+      if(ulHeapLength + Node_getNumChildren(oNTop) > ulHeapCap) {
+         Node_T *poNNew;
+         while(ulHeapLength + Node_getNumChildren(oNTop) > ulHeapCap)
+            ulHeapCap *= 2;
+         poNNew = realloc(poNHeap, ulHeapCap * sizeof(Node_T));
+         if(poNNew == NULL) {
+            iStatus = MEMORY_ERROR;
+            break;
+         }
+         poNHeap = poNNew;
+      }
+      for(ulChildID = 0; ulChildID < Node_getNumChildren(oNTop);
+          ulChildID++) {
+         Node_T oNChild = NULL;
+         (void) Node_getChild(oNTop, ulChildID, &oNChild);
+         if(Node_getNumFiles(oNChild) != 0)
+            FT_heapPush(poNHeap, &ulHeapLength, oNChild);
+      }
+   }
+
+   free(poNHeap);
+   if(iStatus != SUCCESS) {
+      while(ulFound > 0)
+         free(ppcPaths[--ulFound]);
+      return iStatus;
+   }
+   *pulFound = ulFound;
+   return SUCCESS;
+}
+
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions support lookups by name and by
+  extension, through the indexes when enabled and by a full traversal
+  otherwise. Either way the matches are reported in path order.
+*/
+
+/* qsort comparison of the nodes at pvFirst and pvSecond by path. */
+static int FT_compareNodes(const void *pvFirst, const void *pvSecond) {
+   return Node_compare(*(Node_T const *) pvFirst,
+                       *(Node_T const *) pvSecond);
+}
+
+/*
+  Appends to oDMatches every node in the subtree rooted at oNNode whose
+  name (if bByExtension is FALSE) or extension (if TRUE) is pcKey.
+  Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_collectMatches(Node_T oNNode, const char *pcKey,
+                             boolean bByExtension,
+                             DynArray_T oDMatches) {
+   const char *pcField = Node_getName(oNNode);
+   size_t ulChildID;
+
+   if(bByExtension)
+      pcField = FT_getExtension(pcField);
+   if(pcField != NULL && !strcmp(pcField, pcKey))
+      if(!DynArray_add(oDMatches, oNNode))
+         return MEMORY_ERROR;
+   if(Node_unshare(oNNode) != SUCCESS)
+      return MEMORY_ERROR;
+
+   for(ulChildID = 0; ulChildID < Node_getNumChildren(oNNode);
+       ulChildID++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      if(FT_collectMatches(oNChild, pcKey, bByExtension, oDMatches)
+         != SUCCESS)
+         return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+/*
+  Calls pfVisit on every node whose name (if bByExtension is FALSE)
+  or extension (if TRUE) is pcKey, in path order, until pfVisit
+  returns non-zero. Returns SUCCESS, INITIALIZATION_ERROR or
+  MEMORY_ERROR.
+*/
+static int FT_findByKey(const char *pcKey, boolean bByExtension,
+                        FT_Visitor_T pfVisit, void *pvExtra) {
+   Node_T *poNMatches;
+   size_t ulMatches;
+   struct FT_PathBuf sBuf = { NULL, 0, SUCCESS };
+   size_t i;
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   if(oNIByName != NULL) {
+      Node_T *poNFiled;
+      ulMatches = NameIndex_lookup(bByExtension ? oNIByExtension
+                                                : oNIByName,
+                                   pcKey, &poNFiled);
+      if(ulMatches == 0)
+         return SUCCESS;
+      /* copy the matches, to sort them without disturbing the
+         positions the index keeps in the nodes */
+      poNMatches = malloc(ulMatches * sizeof(Node_T));
+      if(poNMatches == NULL)
+         return MEMORY_ERROR;
+      memcpy(poNMatches, poNFiled, ulMatches * sizeof(Node_T));
+   }
+   else {
+      DynArray_T oDMatches;
+
+      if(oNRoot == NULL)
+         return SUCCESS;
+      oDMatches = DynArray_new(0);
+      if(oDMatches == NULL)
+         return MEMORY_ERROR;
+      if(FT_collectMatches(oNRoot, pcKey, bByExtension, oDMatches)
+         != SUCCESS) {
+         DynArray_free(oDMatches);
+         return MEMORY_ERROR;
+      }
+      ulMatches = DynArray_getLength(oDMatches);
+      poNMatches = malloc((ulMatches + 1) * sizeof(Node_T));
+      if(poNMatches == NULL) {
+         DynArray_free(oDMatches);
+         return MEMORY_ERROR;
+      }
+      DynArray_toArray(oDMatches, (void **) poNMatches);
+      DynArray_free(oDMatches);
+   }
+
+   qsort(poNMatches, ulMatches, sizeof(Node_T), FT_compareNodes);
+   for(i = 0; i < ulMatches; i++) {
+      const char *pcPath = FT_getPath(poNMatches[i], &sBuf);
+      if(pcPath == NULL ||
+         (*pfVisit)(pcPath, Node_isFile(poNMatches[i]),
+                    Node_getFileLength(poNMatches[i]), pvExtra))
+         break;
+   }
+
+   free(sBuf.pcPath);
+   free(poNMatches);
+   return sBuf.iStatus;
+}
+/*--------------------------------------------------------------------*/
+
+int FT_setNameIndex(boolean bEnable) {
+   int iStatus;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   if(!bEnable) {
+      NameIndex_free(oNIByName);
+      NameIndex_free(oNIByExtension);
+      oNIByName = NULL;
+      oNIByExtension = NULL;
+      return SUCCESS;
+   }
+   if(oNIByName != NULL)
+      return SUCCESS;
+
+   oNIByName = NameIndex_new(FT_NAME_SLOT);
+   oNIByExtension = NameIndex_new(FT_EXTENSION_SLOT);
+   if(oNIByName == NULL || oNIByExtension == NULL) {
+      NameIndex_free(oNIByName);
+      NameIndex_free(oNIByExtension);
+      oNIByName = NULL;
+      oNIByExtension = NULL;
+      return MEMORY_ERROR;
+   }
+
+   if(oNRoot != NULL) {
+      iStatus = FT_indexSubtree(oNRoot, FT_NAME_INDEX);
+      if(iStatus != SUCCESS) {
+         NameIndex_free(oNIByName);
+         NameIndex_free(oNIByExtension);
+         oNIByName = NULL;
+         oNIByExtension = NULL;
+         return iStatus;
+      }
+   }
+   return SUCCESS;
+}
+
+int FT_findByName(const char *pcName, FT_Visitor_T pfVisit,
+                  void *pvExtra) {
+   assert(pcName != NULL);
+   assert(pfVisit != NULL);
+
+   return FT_findByKey(pcName, FALSE, pfVisit, pvExtra);
+}
+
+int FT_findByExtension(const char *pcExtension, FT_Visitor_T pfVisit,
+                       void *pvExtra) {
+   assert(pcExtension != NULL);
+   assert(pfVisit != NULL);
+
+   if(*pcExtension == '.')
+      pcExtension++;
+   return FT_findByKey(pcExtension, TRUE, pfVisit, pvExtra);
+}
+
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions support substring search. A path
+  contains the query exactly when some ancestor-or-self's path does,
+  so the search finds the minimal matching nodes (those whose parent's
+  path does not contain the query) and reports their whole subtrees.
+  The occurrence of the query in a minimal node's path ends within
+  that node's "/name", so splitting the query at its '/'s into pieces
+  p0/.../pm, the node's name starts with pm (or contains the query if
+  m is 0), the ancestors above it are named by the middle pieces, and
+  the next one's name ends with p0. The substring index yields the
+  nodes whose names contain the trigrams of the longest piece, and
+  the minimal nodes are found from those by walking down the pieces
+  that follow it.
+*/
+
+/* Appends oNNode to oDMinimal if its path contains pcQuery and its
+   parent's path does not, assembling the path in psBuf. Returns
+   SUCCESS or MEMORY_ERROR. */
+static int FT_addIfMinimal(Node_T oNNode, const char *pcQuery,
+                           DynArray_T oDMinimal,
+                           struct FT_PathBuf *psBuf) {
+   char *pcPath;
+   size_t ulParentLength;
+   boolean bInParent;
+
+   if(FT_getPath(oNNode, psBuf) == NULL)
+      return MEMORY_ERROR;
+   pcPath = psBuf->pcPath;
+   if(strstr(pcPath, pcQuery) == NULL)
+      return SUCCESS;
+
+   /* the parent's path is this one without the final "/name" */
+   if(Node_getParent(oNNode) != NULL) {
+      ulParentLength = strlen(pcPath) - strlen(Node_getName(oNNode)) - 1;
+      pcPath[ulParentLength] = '\0';
+      bInParent = (boolean) (strstr(pcPath, pcQuery) != NULL);
+      pcPath[ulParentLength] = '/';
+      if(bInParent)
+         return SUCCESS;
+   }
+   return DynArray_add(oDMinimal, oNNode) ? SUCCESS : MEMORY_ERROR;
+}
+
+/*
+  Appends to oDMinimal the minimal nodes matching pcQuery in the
+  subtree rooted at oNNode, by testing every path, assembled in psBuf.
+  Returns SUCCESS or MEMORY_ERROR.
+*/
+static int FT_scanSubstring(Node_T oNNode, const char *pcQuery,
+                            DynArray_T oDMinimal,
+                            struct FT_PathBuf *psBuf) {
+   const char *pcPath;
+   size_t ulChildID;
+
+   pcPath = FT_getPath(oNNode, psBuf);
+   if(pcPath == NULL)
+      return MEMORY_ERROR;
+   if(strstr(pcPath, pcQuery) != NULL)
+      return DynArray_add(oDMinimal, oNNode) ? SUCCESS : MEMORY_ERROR;
+   if(Node_unshare(oNNode) != SUCCESS)
+      return MEMORY_ERROR;
+
+   for(ulChildID = 0; ulChildID < Node_getNumChildren(oNNode);
+       ulChildID++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      if(FT_scanSubstring(oNChild, pcQuery, oDMinimal, psBuf)
+         != SUCCESS)
+         return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+/*
+  Walks down from oNNode through the children named ppcPieces[ulPiece]
+  to ppcPieces[ulLast - 1], then appends the children there whose names
+  start with ppcPieces[ulLast] to oDMinimal if they are minimal nodes
+  matching pcQuery, assembling paths in psBuf. Returns SUCCESS or
+  MEMORY_ERROR.
+*/
+static int FT_descendPieces(Node_T oNNode, char **ppcPieces,
+                            size_t ulPiece, size_t ulLast,
+                            const char *pcQuery, DynArray_T oDMinimal,
+                            struct FT_PathBuf *psBuf) {
+   Node_T oNChild = NULL;
+   size_t ulChildID;
+
+   if(ulPiece < ulLast) {
+      if(!Node_hasChildName(oNNode, ppcPieces[ulPiece], &ulChildID))
+         return SUCCESS;
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      return FT_descendPieces(oNChild, ppcPieces, ulPiece + 1, ulLast,
+                              pcQuery, oDMinimal, psBuf);
+   }
+
+   /* the children named with the last piece as a prefix are
+      consecutive, starting where that piece would be inserted */
+   (void) Node_hasChildName(oNNode, ppcPieces[ulLast], &ulChildID);
+   for(; ulChildID < Node_getNumChildren(oNNode); ulChildID++) {
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      if(strncmp(Node_getName(oNChild), ppcPieces[ulLast],
+                 strlen(ppcPieces[ulLast])) != 0)
+         break;
+      if(FT_addIfMinimal(oNChild, pcQuery, oDMinimal, psBuf) != SUCCESS)
+         return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+/*
+  Appends to oDMinimal the minimal nodes matching pcQuery, using the
+  substring index. ppcPieces holds the ulPieces pieces of pcQuery, and
+  ulLongest is the index of a longest one, which must have at least
+  three characters. Paths are assembled in psBuf. Returns SUCCESS or
+  MEMORY_ERROR.
+*/
+static int FT_indexedSubstring(const char *pcQuery, char **ppcPieces,
+                               size_t ulPieces, size_t ulLongest,
+                               DynArray_T oDMinimal,
+                               struct FT_PathBuf *psBuf) {
+   Node_T *poNCandidates;
+   size_t ulCandidates;
+   size_t i;
+   int iStatus;
+
+   iStatus = TrigramIndex_search(oTIBySubstring, ppcPieces[ulLongest],
+                                 &poNCandidates, &ulCandidates);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   for(i = 0; i < ulCandidates && iStatus == SUCCESS; i++) {
+      if(ulLongest == ulPieces - 1)
+         iStatus = FT_addIfMinimal(poNCandidates[i], pcQuery,
+                                   oDMinimal, psBuf);
+      else
+         iStatus = FT_descendPieces(poNCandidates[i], ppcPieces,
+                                    ulLongest + 1, ulPieces - 1,
+                                    pcQuery, oDMinimal, psBuf);
+   }
+   free(poNCandidates);
+   return iStatus;
+}
+
+/* Calls pfVisit on every node in the subtree rooted at oNNode, in
+   pre-order, assembling paths in psBuf. Returns TRUE if pfVisit
+   stopped the traversal or a path could not be assembled. */
+static boolean FT_visitSubtree(Node_T oNNode, FT_Visitor_T pfVisit,
+                               void *pvExtra, struct FT_PathBuf *psBuf) {
+   const char *pcPath;
+   size_t ulChildID;
+
+   pcPath = FT_getPath(oNNode, psBuf);
+   if(pcPath == NULL ||
+      (*pfVisit)(pcPath, Node_isFile(oNNode), Node_getFileLength(oNNode),
+                 pvExtra))
+      return TRUE;
+   if(Node_unshare(oNNode) != SUCCESS) {
+      psBuf->iStatus = MEMORY_ERROR;
+      return TRUE;
+   }
+
+   for(ulChildID = 0; ulChildID < Node_getNumChildren(oNNode);
+       ulChildID++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      if(FT_visitSubtree(oNChild, pfVisit, pvExtra, psBuf))
+         return TRUE;
+   }
+   return FALSE;
+}
+/*--------------------------------------------------------------------*/
+
+int FT_setSubstringIndex(boolean bEnable) {
+   int iStatus;
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   if(!bEnable) {
+      TrigramIndex_free(oTIBySubstring);
+      oTIBySubstring = NULL;
+      return SUCCESS;
+   }
+   if(oTIBySubstring != NULL)
+      return SUCCESS;
+
+   oTIBySubstring = TrigramIndex_new(FT_SUBSTRING_SLOT);
+   if(oTIBySubstring == NULL)
+      return MEMORY_ERROR;
+
+   if(oNRoot != NULL) {
+      iStatus = FT_indexSubtree(oNRoot, FT_SUBSTRING_INDEX);
+      if(iStatus != SUCCESS) {
+         TrigramIndex_free(oTIBySubstring);
+         oTIBySubstring = NULL;
+         return iStatus;
+      }
+   }
+   return SUCCESS;
+}
+
+int FT_searchSubstring(const char *pcQuery, FT_Visitor_T pfVisit,
+                       void *pvExtra) {
+   DynArray_T oDMinimal;
+   struct FT_PathBuf sBuf = { NULL, 0, SUCCESS };
+   char *pcPieces;
+   char **ppcPieces;
+   size_t ulPieces = 1;
+   size_t ulLongest = 0;
+   size_t i;
+   int iStatus;
+
+   assert(pcQuery != NULL);
+   assert(pfVisit != NULL);
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if(oNRoot == NULL)
+      return SUCCESS;
+
+   /* split a copy of the query into its '/'-separated pieces */
+   for(i = 0; pcQuery[i] != '\0'; i++)
+      if(pcQuery[i] == '/')
+         ulPieces++;
+   pcPieces = malloc(strlen(pcQuery) + 1);
+   ppcPieces = malloc(ulPieces * sizeof(char *));
+   oDMinimal = DynArray_new(0);
+   if(pcPieces == NULL || ppcPieces == NULL || oDMinimal == NULL) {
+      free(pcPieces);
+      free(ppcPieces);
+      if(oDMinimal != NULL)
+         DynArray_free(oDMinimal);
+      return MEMORY_ERROR;
+   }
+   strcpy(pcPieces, pcQuery);
+   ppcPieces[0] = pcPieces;
+   for(i = 1; i < ulPieces; i++) {
+      ppcPieces[i] = strchr(ppcPieces[i - 1], '/');
+      *ppcPieces[i]++ = '\0';
+      if(strlen(ppcPieces[i]) > strlen(ppcPieces[ulLongest]))
+         ulLongest = i;
+   }
+
+   /* find the minimal matching nodes, through the index if it is
+      enabled and some piece has a trigram to look up */
+   if(oTIBySubstring != NULL && strlen(ppcPieces[ulLongest]) >= 3)
+      iStatus = FT_indexedSubstring(pcQuery, ppcPieces, ulPieces,
+                                    ulLongest, oDMinimal, &sBuf);
+   else
+      iStatus = FT_scanSubstring(oNRoot, pcQuery, oDMinimal, &sBuf);
+
+   if(iStatus == SUCCESS) {
+      DynArray_sort(oDMinimal,
+                    (int (*)(const void *, const void *)) Node_compare);
+      for(i = 0; i < DynArray_getLength(oDMinimal); i++)
+         if(FT_visitSubtree(DynArray_get(oDMinimal, i), pfVisit,
+                            pvExtra, &sBuf))
+            break;
+      iStatus = sBuf.iStatus;
+   }
+
+   free(sBuf.pcPath);
+   DynArray_free(oDMinimal);
+   free(ppcPieces);
+   free(pcPieces);
+   return iStatus;
+}
+
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions support range scans. A scan walks
+  the tree in path order with an explicit stack of frames, each frame
+  naming a directory and the index of the next of its children to
+  visit; the bottom frame has no directory and holds just the root.
+*/
+
+/* A resumable range scan: its bounds and flags, and the last path it
+   reached (NULL before the first call) */
+struct FT_RangeCursor {
+   char *pcLo;
+   char *pcHi;
+   int iFlags;
+   char *pcLast;
+   boolean bDone;
+};
+
+/* Number of entries a directory iterator fetches at a time */
+enum { FT_DIR_PAGE = 64 };
+
+/* An open directory: its path, and the page of entries fetched last
+   with copies of their names, of which ulNext have been read */
+struct FT_DirIter {
+   char *pcPath;
+   struct FT_DirEntry asPage[FT_DIR_PAGE];
+   size_t ulPage;
+   size_t ulNext;
+   char *pcNames;
+   size_t ulNamesCap;
+   boolean bDone;
+};
+
+/*
+  Compares paths pcFirst and pcSecond in path order: component by
+  component, with a path preceding the paths below it. Returns <0, 0
+  or >0 as pcFirst is before, equal to or after pcSecond.
+*/
+static int FT_comparePathOrder(const char *pcFirst,
+                               const char *pcSecond) {
+   int iFirst, iSecond;
+
+   while(*pcFirst == *pcSecond && *pcFirst != '\0') {
+      pcFirst++;
+      pcSecond++;
+   }
+   /* a component that ends first sorts first */
+   iFirst = *pcFirst == '\0' ? 0 :
+            *pcFirst == '/' ? 1 : (unsigned char) *pcFirst + 2;
+   iSecond = *pcSecond == '\0' ? 0 :
+             *pcSecond == '/' ? 1 : (unsigned char) *pcSecond + 2;
+   return iFirst - iSecond;
+}
+
+/* Returns the number of children of oNDir, treating NULL as the
+   parent of the root. */
+static size_t FT_scanNumChildren(Node_T oNDir) {
+   if(oNDir == NULL)
+      return oNRoot != NULL ? 1 : 0;
+   return Node_getNumChildren(oNDir);
+}
+
+/* Returns the next node psScan will visit, or NULL if it has run off
+   the end of the tree. */
+static Node_T FT_scanPeek(struct FT_Scan *psScan) {
+   struct FT_ScanFrame *psTop;
+   Node_T oNChild = NULL;
+
+   while(psScan->ulFrames > 0) {
+      psTop = &psScan->psFrames[psScan->ulFrames - 1];
+      if(psTop->ulNext < FT_scanNumChildren(psTop->oNDir))
+         break;
+      psScan->ulFrames--;
+   }
+   if(psScan->ulFrames == 0)
+      return NULL;
+
+   if(psTop->oNDir == NULL)
+      return oNRoot;
+   (void) Node_getChild(psTop->oNDir, psTop->ulNext, &oNChild);
+   return oNChild;
+}
+
+/* Moves psScan past oNNode, the node FT_scanPeek returned, and on to
+   its children, unsharing it so that they have their own paths.
+   Returns SUCCESS or MEMORY_ERROR. */
+static int FT_scanAdvance(struct FT_Scan *psScan, Node_T oNNode) {
+   psScan->psFrames[psScan->ulFrames - 1].ulNext++;
+   if(Node_getNumChildren(oNNode) == 0)
+      return SUCCESS;
+   if(Node_unshare(oNNode) != SUCCESS)
+      return MEMORY_ERROR;
+   return FT_scanPush(psScan, oNNode, 0);
+}
+
+/*
+  Sets up psScan, which must be empty, at the first node whose path
+  is at or (if bAfter) after oPLo in path order, using one binary
+  search of the children at each level of oPLo. Returns SUCCESS or
+  MEMORY_ERROR.
+*/
+static int FT_scanSeek(struct FT_Scan *psScan, Path_T oPLo,
+                       boolean bAfter) {
+   Node_T oNDir = NULL;
+   size_t ulLevel;
+   int iStatus;
+
+   iStatus = FT_scanPush(psScan, NULL, 0);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   for(ulLevel = 0; ulLevel < Path_getDepth(oPLo); ulLevel++) {
+      const char *pcComponent = Path_getComponent(oPLo, ulLevel);
+      struct FT_ScanFrame *psTop = &psScan->psFrames[psScan->ulFrames - 1];
+      Node_T oNChild = NULL;
+      boolean bFound;
+
+      /* find the first child at or after this level's component */
+      if(oNDir == NULL) {
+         int iCompare = oNRoot == NULL ? -1 :
+                        strcmp(Node_getName(oNRoot), pcComponent);
+         bFound = (boolean) (iCompare == 0);
+         psTop->ulNext = iCompare < 0 ? 1 : 0;
+      }
+      else
+         bFound = Node_hasChildName(oNDir, pcComponent, &psTop->ulNext);
+      if(!bFound)
+         return SUCCESS;
+
+      /* a proper prefix of oPLo precedes it: pass it and go down */
+      oNChild = FT_scanPeek(psScan);
+      if(ulLevel + 1 < Path_getDepth(oPLo) || bAfter) {
+         psTop->ulNext++;
+         iStatus = Node_unshare(oNChild);
+         if(iStatus == SUCCESS)
+            iStatus = FT_scanPush(psScan, oNChild, 0);
+         if(iStatus != SUCCESS)
+            return iStatus;
+      }
+      oNDir = oNChild;
+   }
+   return SUCCESS;
+}
+
+/* Returns TRUE if oNNode is of a kind that iFlags selects. */
+static boolean FT_scanSelects(int iFlags, Node_T oNNode) {
+   if((iFlags & (FT_SCAN_FILES | FT_SCAN_DIRS)) == 0)
+      return TRUE;
+   return (boolean) ((iFlags & (Node_isFile(oNNode) ? FT_SCAN_FILES
+                                                    : FT_SCAN_DIRS))
+                     != 0);
+}
+
+/*
+  Replaces oIter's page with the next FT_DIR_PAGE children of its
+  directory, after the last name in the current page, copying their
+  names. Returns SUCCESS or the errors of FT_listDir.
+*/
+static int FT_fetchDirPage(FT_DirIter_T oIter) {
+   Node_T oNDir = NULL;
+   size_t ulChildID = 0;
+   size_t ulLength = 0;
+   size_t ulEntries;
+   size_t i;
+   char *pcName;
+   int iStatus;
+
+   iStatus = FT_findNode(oIter->pcPath, &oNDir);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(Node_isFile(oNDir))
+      return NOT_A_DIRECTORY;
+
+   if(oIter->ulPage > 0 &&
+      Node_hasChildName(oNDir, oIter->asPage[oIter->ulPage - 1].pcName,
+                        &ulChildID))
+      ulChildID++;
+   ulEntries = Node_getNumChildren(oNDir) - ulChildID;
+   if(ulEntries > FT_DIR_PAGE)
+      ulEntries = FT_DIR_PAGE;
+
+   /* make room for the names, then copy the entries */
+   for(i = 0; i < ulEntries; i++)
+      ulLength += strlen(Node_getName(Node_peekChild(oNDir,
+                                                     ulChildID + i))) + 1;
+   if(ulLength > oIter->ulNamesCap) {
+      char *pcNew = realloc(oIter->pcNames, ulLength);
+      if(pcNew == NULL)
+         return MEMORY_ERROR;
+      oIter->pcNames = pcNew;
+      oIter->ulNamesCap = ulLength;
+   }
+   pcName = oIter->pcNames;
+   for(i = 0; i < ulEntries; i++) {
+      Node_T oNChild = Node_peekChild(oNDir, ulChildID + i);
+      strcpy(pcName, Node_getName(oNChild));
+      oIter->asPage[i].pcName = pcName;
+      oIter->asPage[i].bIsFile = Node_isFile(oNChild);
+      oIter->asPage[i].ulSize = Node_getFileLength(oNChild);
+      pcName += strlen(pcName) + 1;
+   }
+
+   oIter->ulPage = ulEntries;
+   oIter->ulNext = 0;
+   oIter->bDone = (boolean) (ulEntries < FT_DIR_PAGE);
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int FT_openRange(const char *pcLo, const char *pcHi, int iFlags,
+                 FT_RangeCursor_T *poCursor) {
+   FT_RangeCursor_T oCursor;
+   Path_T oPBound = NULL;
+   int iStatus;
+
+   assert(poCursor != NULL);
+
+   *poCursor = NULL;
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   /* validate the bounds */
+   if(pcLo != NULL) {
+      iStatus = Path_new(pcLo, &oPBound);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      Path_free(oPBound);
+   }
+   if(pcHi != NULL) {
+      iStatus = Path_new(pcHi, &oPBound);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      Path_free(oPBound);
+   }
+
+   oCursor = malloc(sizeof(struct FT_RangeCursor));
+   if(oCursor == NULL)
+      return MEMORY_ERROR;
+   oCursor->pcLo = FT_copyString(pcLo);
+   oCursor->pcHi = FT_copyString(pcHi);
+   if((pcLo != NULL && oCursor->pcLo == NULL) ||
+      (pcHi != NULL && oCursor->pcHi == NULL)) {
+      FT_closeRange(oCursor);
+      return MEMORY_ERROR;
+   }
+   oCursor->iFlags = iFlags;
+   oCursor->pcLast = NULL;
+   oCursor->bDone = FALSE;
+
+   *poCursor = oCursor;
+   return SUCCESS;
+}
+
+int FT_continueRange(FT_RangeCursor_T oCursor, size_t ulLimit,
+                     FT_Visitor_T pfVisit, void *pvExtra) {
+   struct FT_Scan sScan = { NULL, 0, 0 };
+   struct FT_PathBuf sBuf = { NULL, 0, SUCCESS };
+   Path_T oPFrom = NULL;
+   Node_T oNLast = NULL;
+   size_t ulVisited = 0;
+   int iStatus = SUCCESS;
+
+   assert(oCursor != NULL);
+   assert(pfVisit != NULL);
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if(oCursor->bDone)
+      return SUCCESS;
+
+   /* seek to just after the last path reached, or to the lower bound */
+   if(oCursor->pcLast != NULL || oCursor->pcLo != NULL) {
+      iStatus = Path_new(oCursor->pcLast != NULL ? oCursor->pcLast
+                                                 : oCursor->pcLo,
+                         &oPFrom);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      iStatus = FT_scanSeek(&sScan, oPFrom,
+                            (boolean) (oCursor->pcLast != NULL ||
+                              (oCursor->iFlags & FT_SCAN_AFTER_LO)));
+      Path_free(oPFrom);
+   }
+   else
+      iStatus = FT_scanPush(&sScan, NULL, 0);
+
+   while(iStatus == SUCCESS && ulVisited < ulLimit) {
+      Node_T oNNode = FT_scanPeek(&sScan);
+      const char *pcPath;
+
+      if(oNNode == NULL) {
+         oCursor->bDone = TRUE;
+         break;
+      }
+      pcPath = FT_getPath(oNNode, &sBuf);
+      if(pcPath == NULL) {
+         iStatus = MEMORY_ERROR;
+         break;
+      }
+      if(oCursor->pcHi != NULL) {
+         int iCompare = FT_comparePathOrder(pcPath, oCursor->pcHi);
+         if(iCompare > 0 ||
+            (iCompare == 0 && !(oCursor->iFlags & FT_SCAN_THROUGH_HI))) {
+            oCursor->bDone = TRUE;
+            break;
+         }
+      }
+
+      iStatus = FT_scanAdvance(&sScan, oNNode);
+      if(iStatus != SUCCESS)
+         break;
+      oNLast = oNNode;
+      if(FT_scanSelects(oCursor->iFlags, oNNode)) {
+         ulVisited++;
+         if((*pfVisit)(pcPath, Node_isFile(oNNode),
+                       Node_getFileLength(oNNode), pvExtra))
+            break;
+      }
+   }
+   free(sScan.psFrames);
+   free(sBuf.pcPath);
+
+   /* remember where to resume */
+   if(oNLast != NULL) {
+      char *pcLast = Node_toString(oNLast);
+      if(pcLast == NULL)
+         return MEMORY_ERROR;
+      free(oCursor->pcLast);
+      oCursor->pcLast = pcLast;
+   }
+   return iStatus;
+}
+
+boolean FT_isRangeDone(FT_RangeCursor_T oCursor) {
+   assert(oCursor != NULL);
+   return oCursor->bDone;
+}
+
+void FT_closeRange(FT_RangeCursor_T oCursor) {
+   if(oCursor == NULL)
+      return;
+   free(oCursor->pcLo);
+   free(oCursor->pcHi);
+   free(oCursor->pcLast);
+   free(oCursor);
+}
+
+int FT_scanRange(const char *pcLo, const char *pcHi, int iFlags,
+                 FT_Visitor_T pfVisit, void *pvExtra) {
+   FT_RangeCursor_T oCursor = NULL;
+   int iStatus;
+
+   assert(pfVisit != NULL);
+
+   iStatus = FT_openRange(pcLo, pcHi, iFlags, &oCursor);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = FT_continueRange(oCursor, (size_t) -1, pfVisit, pvExtra);
+   FT_closeRange(oCursor);
+   return iStatus;
+}
+
+int FT_listDir(const char *pcPath, const char *pcAfterName,
+               size_t ulLimit, struct FT_DirEntry *psOut,
+               size_t *pulFound) {
+   Node_T oNDir = NULL;
+   size_t ulChildID = 0;
+   size_t ulFound = 0;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(ulLimit == 0 || psOut != NULL);
+   assert(pulFound != NULL);
+
+   *pulFound = 0;
+   iStatus = FT_findNode(pcPath, &oNDir);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(Node_isFile(oNDir))
+      return NOT_A_DIRECTORY;
+   /* the names handed out must outlast a later unsharing */
+   if(Node_unshare(oNDir) != SUCCESS)
+      return MEMORY_ERROR;
+
+   /* start at the first child after pcAfterName: its insertion
+      index, or one past it if it is a child */
+   if(pcAfterName != NULL &&
+      Node_hasChildName(oNDir, pcAfterName, &ulChildID))
+      ulChildID++;
+
+   for(; ulFound < ulLimit && ulChildID < Node_getNumChildren(oNDir);
+       ulChildID++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNDir, ulChildID, &oNChild);
+      psOut[ulFound].pcName = Node_getName(oNChild);
+      psOut[ulFound].bIsFile = Node_isFile(oNChild);
+      psOut[ulFound].ulSize = Node_getFileLength(oNChild);
+      ulFound++;
+   }
+
+   *pulFound = ulFound;
+   return SUCCESS;
+}
+
+int FT_openDir(const char *pcPath, FT_DirIter_T *poIter) {
+   FT_DirIter_T oIter;
+   Node_T oNDir = NULL;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(poIter != NULL);
+
+   *poIter = NULL;
+   iStatus = FT_findNode(pcPath, &oNDir);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(Node_isFile(oNDir))
+      return NOT_A_DIRECTORY;
+
+   oIter = malloc(sizeof(struct FT_DirIter));
+   if(oIter == NULL)
+      return MEMORY_ERROR;
+   oIter->pcPath = FT_copyString(pcPath);
+   if(oIter->pcPath == NULL) {
+      free(oIter);
+      return MEMORY_ERROR;
+   }
+   oIter->ulPage = 0;
+   oIter->ulNext = 0;
+   oIter->pcNames = NULL;
+   oIter->ulNamesCap = 0;
+   oIter->bDone = FALSE;
+
+   *poIter = oIter;
+   return SUCCESS;
+}
+
+int FT_readDir(FT_DirIter_T oIter, const struct FT_DirEntry **ppsEntry) {
+   int iStatus;
+
+   assert(oIter != NULL);
+   assert(ppsEntry != NULL);
+
+   *ppsEntry = NULL;
+   if(oIter->ulNext == oIter->ulPage) {
+      if(oIter->bDone)
+         return SUCCESS;
+      iStatus = FT_fetchDirPage(oIter);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      if(oIter->ulPage == 0)
+         return SUCCESS;
+   }
+   *ppsEntry = &oIter->asPage[oIter->ulNext++];
+   return SUCCESS;
+}
+
+void FT_closeDir(FT_DirIter_T oIter) {
+   if(oIter == NULL)
+      return;
+   free(oIter->pcPath);
+   free(oIter->pcNames);
+   free(oIter);
+}
+
+int FT_walk(const char *pcPath, FT_Visitor_T pfPre, FT_Visitor_T pfPost,
+            void *pvExtra) {
+   struct FT_Scan sScan = { NULL, 0, 0 };
+   struct FT_PathBuf sBuf = { NULL, 0, SUCCESS };
+   Node_T oNNode = NULL;
+   const char *pcNodePath;
+   int iStatus;
+
+   assert(pcPath != NULL);
+
+   iStatus = FT_findNode(pcPath, &oNNode);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* oNNode is the node to enter next, or NULL to carry on with the
+      top frame: its next child, or leaving it once there are none */
+   for(;;) {
+      struct FT_ScanFrame *psTop;
+      int iVisit = 0;
+
+      if(oNNode != NULL) {
+         if(pfPre != NULL) {
+            pcNodePath = FT_getPath(oNNode, &sBuf);
+            if(pcNodePath == NULL) {
+               iStatus = MEMORY_ERROR;
+               break;
+            }
+            iVisit = (*pfPre)(pcNodePath, Node_isFile(oNNode),
+                              Node_getFileLength(oNNode), pvExtra);
+         }
+         if(iVisit == 0) {
+            iStatus = Node_unshare(oNNode);
+            if(iStatus == SUCCESS)
+               iStatus = FT_scanPush(&sScan, oNNode, 0);
+         }
+         else if(iVisit != FT_WALK_SKIP)
+            break;
+         if(iStatus != SUCCESS)
+            break;
+         oNNode = NULL;
+         continue;
+      }
+
+      if(sScan.ulFrames == 0)
+         break;
+      psTop = &sScan.psFrames[sScan.ulFrames - 1];
+      if(psTop->ulNext < Node_getNumChildren(psTop->oNDir)) {
+         (void) Node_getChild(psTop->oNDir, psTop->ulNext++, &oNNode);
+         continue;
+      }
+
+      sScan.ulFrames--;
+      if(pfPost != NULL) {
+         pcNodePath = FT_getPath(psTop->oNDir, &sBuf);
+         if(pcNodePath == NULL) {
+            iStatus = MEMORY_ERROR;
+            break;
+         }
+         iVisit = (*pfPost)(pcNodePath, Node_isFile(psTop->oNDir),
+                            Node_getFileLength(psTop->oNDir), pvExtra);
+         if(iVisit != 0 && iVisit != FT_WALK_SKIP)
+            break;
+      }
+   }
+   free(sScan.psFrames);
+   free(sBuf.pcPath);
+   return iStatus;
+}
+
+int FT_rank(const char *pcPath, size_t *pulRank) {
+   Node_T oNNode = NULL;
+   Node_T oNParent;
+   size_t ulRank = 0;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(pulRank != NULL);
+
+   iStatus = FT_findNode(pcPath, &oNNode);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* every ancestor precedes the node, as do the subtrees of the
+      earlier siblings of the node and of each of its ancestors */
+   for(oNParent = Node_getParent(oNNode); oNParent != NULL;
+       oNNode = oNParent, oNParent = Node_getParent(oNNode)) {
+      size_t ulChildID;
+      (void) Node_hasChildName(oNParent, Node_getName(oNNode),
+                               &ulChildID);
+      ulRank += 1 + Node_getNodesBefore(oNParent, ulChildID);
+   }
+
+   *pulRank = ulRank;
+   return SUCCESS;
+}
+
+int FT_select(const char *pcDirPath, size_t ulK, char **ppcPath) {
+   Node_T oNNode = NULL;
+   int iStatus;
+
+   assert(pcDirPath != NULL);
+   assert(ppcPath != NULL);
+
+   *ppcPath = NULL;
+   iStatus = FT_findNode(pcDirPath, &oNNode);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   if(ulK + 1 >= Node_getNumNodes(oNNode))
+      return NO_SUCH_PATH;
+
+   /* descend into the child whose subtree holds position ulK, until
+      position ulK is that child itself */
+   for(;;) {
+      size_t ulBefore;
+      size_t ulChildID = Node_findChildByNodes(oNNode, ulK, &ulBefore);
+      iStatus = Node_getChild(oNNode, ulChildID, &oNNode);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      ulK -= ulBefore;
+      if(ulK == 0)
+         break;
+      ulK--;
+   }
+
+   *ppcPath = Node_toString(oNNode);
+   return *ppcPath != NULL ? SUCCESS : MEMORY_ERROR;
+}
+
+int FT_countDescendants(const char *pcPath, size_t *pulCount) {
+   Node_T oNNode = NULL;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(pulCount != NULL);
+
+   iStatus = FT_findNode(pcPath, &oNNode);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   *pulCount = Node_getNumNodes(oNNode) - 1;
+   return SUCCESS;
+}
+
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions support the shape analysis. The
+  pass adds each node's samples to the histograms and offers each
+  directory to two bounded min-heaps of the best directories so far.
+*/
+
+/* A candidate for a ranking, and the value it ranks by */
+struct FT_Ranked {
+   Node_T oNNode;
+   size_t ulValue;
+};
+
+/* A ranking of at most ulCap nodes, kept as a binary min-heap so the
+   weakest is at the root */
+struct FT_Ranking {
+   struct FT_Ranked *psHeap;
+   size_t ulLength;
+   size_t ulCap;
+};
+
+/* Adds ulValue as a sample to psHistogram. */
+static void FT_addSample(struct FT_Histogram *psHistogram,
+                         size_t ulValue) {
+   size_t ulBucket = 0;
+
+   if(psHistogram->bIsLogScale) {
+      size_t ulRest;
+      for(ulRest = ulValue; ulRest != 0; ulRest >>= 1)
+         ulBucket++;
+   }
+   else
+      ulBucket = ulValue;
+   if(ulBucket >= FT_HIST_BUCKETS)
+      ulBucket = FT_HIST_BUCKETS - 1;
+
+   psHistogram->aulCounts[ulBucket]++;
+   if(psHistogram->ulSamples == 0 || ulValue < psHistogram->ulMin)
+      psHistogram->ulMin = ulValue;
+   if(psHistogram->ulSamples == 0 || ulValue > psHistogram->ulMax)
+      psHistogram->ulMax = ulValue;
+   psHistogram->ulSamples++;
+   psHistogram->ulSum += ulValue;
+}
+
+/* Offers oNNode, ranked by ulValue, to psRanking. On ties the node
+   offered first is kept. */
+static void FT_offerRanked(struct FT_Ranking *psRanking, Node_T oNNode,
+                           size_t ulValue) {
+   size_t ulPos;
+
+   if(psRanking->ulCap == 0)
+      return;
+
+   if(psRanking->ulLength < psRanking->ulCap) {
+      /* sift up from a new leaf */
+      ulPos = psRanking->ulLength++;
+      while(ulPos > 0 &&
+            psRanking->psHeap[(ulPos - 1) / 2].ulValue > ulValue) {
+         psRanking->psHeap[ulPos] = psRanking->psHeap[(ulPos - 1) / 2];
+         ulPos = (ulPos - 1) / 2;
+      }
+   }
+   else {
+      /* replace the weakest, if beaten, and sift down */
+      if(ulValue <= psRanking->psHeap[0].ulValue)
+         return;
+      ulPos = 0;
+      for(;;) {
+         size_t ulChild = 2 * ulPos + 1;
+         if(ulChild >= psRanking->ulLength)
+            break;
+         if(ulChild + 1 < psRanking->ulLength &&
+            psRanking->psHeap[ulChild + 1].ulValue <
+               psRanking->psHeap[ulChild].ulValue)
+            ulChild++;
+         if(psRanking->psHeap[ulChild].ulValue >= ulValue)
+            break;
+         psRanking->psHeap[ulPos] = psRanking->psHeap[ulChild];
+         ulPos = ulChild;
+      }
+   }
+   psRanking->psHeap[ulPos].oNNode = oNNode;
+   psRanking->psHeap[ulPos].ulValue = ulValue;
+}
+
+/* qsort comparison putting the candidates at pvFirst and pvSecond in
+   order of decreasing value, and of path on ties. */
+static int FT_compareRanked(const void *pvFirst, const void *pvSecond) {
+   const struct FT_Ranked *psFirst = pvFirst;
+   const struct FT_Ranked *psSecond = pvSecond;
+
+   if(psFirst->ulValue != psSecond->ulValue)
+      return psFirst->ulValue > psSecond->ulValue ? -1 : 1;
+   return Node_compare(psFirst->oNNode, psSecond->oNNode);
+}
+
+/*
+  Sorts psRanking best first and stores it in *ppsOut (newly allocated)
+  and *pulOut, copying each node's path. Returns SUCCESS or
+  MEMORY_ERROR.
+*/
+static int FT_storeRanking(struct FT_Ranking *psRanking,
+                           struct FT_RankedDir **ppsOut,
+                           size_t *pulOut) {
+   size_t i;
+
+   qsort(psRanking->psHeap, psRanking->ulLength,
+         sizeof(struct FT_Ranked), FT_compareRanked);
+
+   *ppsOut = calloc(psRanking->ulLength + 1,
+                    sizeof(struct FT_RankedDir));
+   if(*ppsOut == NULL)
+      return MEMORY_ERROR;
+   for(i = 0; i < psRanking->ulLength; i++) {
+      (*ppsOut)[i].pcPath = Node_toString(psRanking->psHeap[i].oNNode);
+      if((*ppsOut)[i].pcPath == NULL)
+         return MEMORY_ERROR;
+      (*ppsOut)[i].ulValue = psRanking->psHeap[i].ulValue;
+      (*pulOut)++;
+   }
+   return SUCCESS;
+}
+
+/* Adds the samples of the subtree rooted at oNNode, at depth ulDepth,
+   to psAnalysis and offers its directories to the two rankings,
+   unsharing them so that their paths can be written. Returns SUCCESS
+   or MEMORY_ERROR. */
+static int FT_analyzeFrom(Node_T oNNode, size_t ulDepth,
+                          struct FT_Analysis *psAnalysis,
+                          struct FT_Ranking *psWidest,
+                          struct FT_Ranking *psDeepest) {
+   size_t ulChildren, ulFiles = 0;
+   size_t ulChildID;
+
+   FT_addSample(&psAnalysis->sDepth, ulDepth);
+   FT_addSample(&psAnalysis->sNameLength, strlen(Node_getName(oNNode)));
+   if(Node_isFile(oNNode)) {
+      psAnalysis->ulFiles++;
+      FT_addSample(&psAnalysis->sFileSize, Node_getFileLength(oNNode));
+      return SUCCESS;
+   }
+   if(Node_unshare(oNNode) != SUCCESS)
+      return MEMORY_ERROR;
+
+   psAnalysis->ulDirs++;
+   ulChildren = Node_getNumChildren(oNNode);
+   FT_addSample(&psAnalysis->sFanout, ulChildren);
+   FT_offerRanked(psWidest, oNNode, ulChildren);
+   FT_offerRanked(psDeepest, oNNode, ulDepth);
+
+   for(ulChildID = 0; ulChildID < ulChildren; ulChildID++) {
+      Node_T oNChild = NULL;
+      (void) Node_getChild(oNNode, ulChildID, &oNChild);
+      if(Node_isFile(oNChild))
+         ulFiles++;
+      if(FT_analyzeFrom(oNChild, ulDepth + 1, psAnalysis, psWidest,
+                        psDeepest) != SUCCESS)
+         return MEMORY_ERROR;
+   }
+   if(ulChildren > 0)
+      FT_addSample(&psAnalysis->sFileShare, 10 * ulFiles / ulChildren);
+   return SUCCESS;
+}
+/*--------------------------------------------------------------------*/
+
+int FT_analyze(size_t ulTopN, struct FT_Analysis **ppsAnalysis) {
+   struct FT_Analysis *psAnalysis;
+   struct FT_Ranking sWidest, sDeepest;
+   int iStatus = SUCCESS;
+
+   assert(ppsAnalysis != NULL);
+
+   *ppsAnalysis = NULL;
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+
+   psAnalysis = calloc(1, sizeof(struct FT_Analysis));
+   sWidest.psHeap = malloc((ulTopN + 1) * sizeof(struct FT_Ranked));
+   sDeepest.psHeap = malloc((ulTopN + 1) * sizeof(struct FT_Ranked));
+   if(psAnalysis == NULL || sWidest.psHeap == NULL ||
+      sDeepest.psHeap == NULL) {
+      free(psAnalysis);
+      free(sWidest.psHeap);
+      free(sDeepest.psHeap);
+      return MEMORY_ERROR;
+   }
+   sWidest.ulLength = sDeepest.ulLength = 0;
+   sWidest.ulCap = sDeepest.ulCap = ulTopN;
+   psAnalysis->sFanout.bIsLogScale = TRUE;
+   psAnalysis->sNameLength.bIsLogScale = TRUE;
+   psAnalysis->sFileSize.bIsLogScale = TRUE;
+   psAnalysis->ulTopN = ulTopN;
+
+   if(oNRoot != NULL)
+      iStatus = FT_analyzeFrom(oNRoot, 1, psAnalysis, &sWidest,
+                               &sDeepest);
+
+   if(iStatus == SUCCESS)
+      iStatus = FT_storeRanking(&sWidest, &psAnalysis->psWidest,
+                                &psAnalysis->ulWidest);
+   if(iStatus == SUCCESS)
+      iStatus = FT_storeRanking(&sDeepest, &psAnalysis->psDeepest,
+                                &psAnalysis->ulDeepest);
+   free(sWidest.psHeap);
+   free(sDeepest.psHeap);
+   if(iStatus != SUCCESS) {
+      FT_freeAnalysis(psAnalysis);
+      return iStatus;
+   }
+
+   *ppsAnalysis = psAnalysis;
+   return SUCCESS;
+}
+
+void FT_freeAnalysis(struct FT_Analysis *psAnalysis) {
+   size_t i;
+
+   if(psAnalysis == NULL)
+      return;
+   for(i = 0; psAnalysis->psWidest != NULL &&
+              i < psAnalysis->ulWidest; i++)
+      free(psAnalysis->psWidest[i].pcPath);
+   for(i = 0; psAnalysis->psDeepest != NULL &&
+              i < psAnalysis->ulDeepest; i++)
+      free(psAnalysis->psDeepest[i].pcPath);
+   free(psAnalysis->psWidest);
+   free(psAnalysis->psDeepest);
+   free(psAnalysis);
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions support batch insertion. Sorted
+  in path order, the entries passing through any directory form a
+  run, split by their next component into one run per child. A run
+  reaching a node that is not yet there is settled by its earliest
+  entry in the batch, as one-at-a-time insertion would settle it: that
+  entry creates the node, a file only if the entry is a file ending
+  there, and the run's other entries then find the node in place. New
+  nodes are built off the tree, and each existing directory takes all
+  of its new children at once with Node_adopt.
+*/
+
+/* A batch entry's parsed path and its position in the batch */
+struct FT_BatchItem {
+   Path_T oPPath;
+   size_t ulIndex;
+};
+
+/* A batch insertion or removal in progress: the entries (NULL for a
+   removal), their items in path order, the results to set, and for a
+   removal a stack of the nodes found to be removed */
+struct FT_Batch {
+   const struct FT_InsertEntry *psEntries;
+   struct FT_BatchItem *psItems;
+   int *piResults;
+   Node_T *poNDoomed;
+   size_t ulDoomed;
+};
+
+/* Compares batch items in path order, and items of the same path by
+   position in the batch, for qsort. */
+static int FT_compareBatchItems(const void *pvFirst,
+                                const void *pvSecond) {
+   const struct FT_BatchItem *psFirst = pvFirst;
+   const struct FT_BatchItem *psSecond = pvSecond;
+   int iCompare;
+
+   iCompare = FT_comparePathOrder(Path_getPathname(psFirst->oPPath),
+                                  Path_getPathname(psSecond->oPPath));
+   if(iCompare != 0)
+      return iCompare;
+   return psFirst->ulIndex < psSecond->ulIndex ? -1 : 1;
+}
+
+/* Sorts the batch's ulItems items for FT_compareBatchItems, unless
+   they are already in order. */
+static void FT_batchSort(struct FT_Batch *psBatch, size_t ulItems) {
+   size_t i;
+
+   for(i = 1; i < ulItems; i++)
+      if(FT_compareBatchItems(&psBatch->psItems[i - 1],
+                              &psBatch->psItems[i]) > 0) {
+         qsort(psBatch->psItems, ulItems, sizeof(struct FT_BatchItem),
+               FT_compareBatchItems);
+         return;
+      }
+}
+
+/* Returns the end of the run of items from ulLo, before ulHi, whose
+   component at level ulLevel is that of item ulLo. */
+static size_t FT_batchRunEnd(struct FT_Batch *psBatch, size_t ulLo,
+                             size_t ulHi, size_t ulLevel) {
+   const char *pcName;
+   size_t ulEnd;
+
+   pcName = Path_getComponent(psBatch->psItems[ulLo].oPPath, ulLevel);
+   for(ulEnd = ulLo + 1; ulEnd < ulHi; ulEnd++)
+      if(strcmp(Path_getComponent(psBatch->psItems[ulEnd].oPPath,
+                                  ulLevel), pcName) != 0)
+         break;
+   return ulEnd;
+}
+
+/* Returns the end of the items from ulLo, before ulHi, whose paths
+   end at level ulLevel: they sort first in their run. */
+static size_t FT_batchExactEnd(struct FT_Batch *psBatch, size_t ulLo,
+                               size_t ulHi, size_t ulLevel) {
+   while(ulLo < ulHi &&
+         Path_getDepth(psBatch->psItems[ulLo].oPPath) == ulLevel + 1)
+      ulLo++;
+   return ulLo;
+}
+
+/* Returns the item, from ulLo to before ulHi, that comes first in the
+   batch. */
+static size_t FT_batchFirst(struct FT_Batch *psBatch, size_t ulLo,
+                            size_t ulHi) {
+   size_t ulFirst = ulLo;
+
+   for(ulLo++; ulLo < ulHi; ulLo++)
+      if(psBatch->psItems[ulLo].ulIndex <
+         psBatch->psItems[ulFirst].ulIndex)
+         ulFirst = ulLo;
+   return ulFirst;
+}
+
+/* Sets the results of the items from ulLo to before ulHi to
+   iStatus. */
+static void FT_batchSettle(struct FT_Batch *psBatch, size_t ulLo,
+                           size_t ulHi, int iStatus) {
+   for(; ulLo < ulHi; ulLo++)
+      psBatch->piResults[psBatch->psItems[ulLo].ulIndex] = iStatus;
+}
+
+/*
+  Builds under oNParent, a node off the tree, the new nodes that the
+  items from ulLo to before ulHi reach from level ulLevel of their
+  paths on, in path order so that each is appended to its parent, and
+  sets the items' results. Returns SUCCESS, or MEMORY_ERROR leaving
+  what was built for the caller to free and the results of the items
+  not yet reached unset.
+*/
+static int FT_batchBuild(struct FT_Batch *psBatch, Node_T oNParent,
+                         size_t ulLo, size_t ulHi, size_t ulLevel) {
+   struct FT_BatchItem *psItems = psBatch->psItems;
+   size_t ulEnd, ulExact, ulFirst;
+
+   assert(oNParent != NULL);
+
+   for(; ulLo < ulHi; ulLo = ulEnd) {
+      const struct FT_InsertEntry *psFirst;
+      Node_T oNNew = NULL;
+      boolean bIsFile;
+      int iStatus;
+
+      ulEnd = FT_batchRunEnd(psBatch, ulLo, ulHi, ulLevel);
+      ulExact = FT_batchExactEnd(psBatch, ulLo, ulEnd, ulLevel);
+      ulFirst = FT_batchFirst(psBatch, ulLo, ulEnd);
+      psFirst = &psBatch->psEntries[psItems[ulFirst].ulIndex];
+
+      /* the run's first entry makes the node: a file only if it is a
+         file ending here */
+      bIsFile = (boolean) (ulFirst < ulExact && psFirst->bIsFile);
+      if(bIsFile)
+         iStatus = Node_new(Path_getComponent(psItems[ulFirst].oPPath,
+                                              ulLevel),
+                            oNParent, TRUE, psFirst->pvContents,
+                            psFirst->ulLength, &oNNew);
+      else
+         iStatus = Node_new(Path_getComponent(psItems[ulFirst].oPPath,
+                                              ulLevel),
+                            oNParent, FALSE, NULL, 0, &oNNew);
+      if(iStatus != SUCCESS)
+         return iStatus;
+
+      FT_batchSettle(psBatch, ulLo, ulExact, ALREADY_IN_TREE);
+      if(ulFirst < ulExact)
+         psBatch->piResults[psItems[ulFirst].ulIndex] = SUCCESS;
+      if(bIsFile)
+         FT_batchSettle(psBatch, ulExact, ulEnd, NOT_A_DIRECTORY);
+      else {
+         iStatus = FT_batchBuild(psBatch, oNNew, ulExact, ulEnd,
+                                 ulLevel + 1);
+         if(iStatus != SUCCESS)
+            return iStatus;
+      }
+   }
+   return SUCCESS;
+}
+
+/*
+  Moves the new children gathered under oNHolder, indexed and ready,
+  into oNDir in one merge, logging each as an insertion. If that
+  fails, drops them instead and sets MEMORY_ERROR as the result of
+  every item, from ulLo to before ulHi, whose run at level ulLevel
+  reached one. Frees oNHolder either way.
+*/
+static void FT_batchAdopt(struct FT_Batch *psBatch, Node_T oNDir,
+                          Node_T oNHolder, size_t ulLo, size_t ulHi,
+                          size_t ulLevel) {
+   size_t ulChildren = Node_getNumChildren(oNHolder);
+   size_t ulNodes = Node_getNumNodes(oNHolder) - 1;
+   size_t ulChildID, ulEnd;
+   Node_T oNChild = NULL;
+   int iStatus;
+
+   iStatus = FT_reserveUndo(ulChildren);
+   if(iStatus == SUCCESS) {
+      for(ulChildID = 0; ulChildID < ulChildren; ulChildID++) {
+         (void) Node_getChild(oNHolder, ulChildID, &oNChild);
+         FT_logUndo(FT_UNDO_INSERT, oNChild, NULL, NULL, 0);
+      }
+      iStatus = Node_adopt(oNDir, oNHolder);
+      if(iStatus != SUCCESS && bInTransaction)
+         ulUndoLength -= ulChildren;
+   }
+
+   if(iStatus == SUCCESS)
+      ulCount += ulNodes;
+   else {
+      for(; ulLo < ulHi; ulLo = ulEnd) {
+         ulEnd = FT_batchRunEnd(psBatch, ulLo, ulHi, ulLevel);
+         if(Node_hasChildName(oNHolder,
+               Path_getComponent(psBatch->psItems[ulLo].oPPath,
+                                 ulLevel), &ulChildID))
+            FT_batchSettle(psBatch, ulLo, ulEnd, iStatus);
+      }
+      for(ulChildID = 0; ulChildID < ulChildren; ulChildID++) {
+         (void) Node_getChild(oNHolder, ulChildID, &oNChild);
+         FT_unindexSubtree(oNChild, FT_getIndexes());
+      }
+   }
+   (void) Node_free(oNHolder);
+}
+
+/*
+  Inserts the items from ulLo to before ulHi, whose paths pass
+  through oNDir, a directory in the FT at level ulLevel - 1, and sets
+  their results. Runs reaching existing children are settled there or
+  carried on below them; new children are built and indexed under a
+  holder off the tree, then adopted by oNDir all at once.
+*/
+static void FT_batchInto(struct FT_Batch *psBatch, Node_T oNDir,
+                         size_t ulLo, size_t ulHi, size_t ulLevel) {
+   Node_T oNHolder = NULL;
+   size_t ulRun, ulEnd, ulExact, ulChildID;
+
+   assert(oNDir != NULL);
+
+   if(Node_unshare(oNDir) != SUCCESS) {
+      FT_batchSettle(psBatch, ulLo, ulHi, MEMORY_ERROR);
+      return;
+   }
+
+   for(ulRun = ulLo; ulRun < ulHi; ulRun = ulEnd) {
+      const char *pcName;
+      Node_T oNChild = NULL;
+      int iStatus = SUCCESS;
+
+      ulEnd = FT_batchRunEnd(psBatch, ulRun, ulHi, ulLevel);
+      pcName = Path_getComponent(psBatch->psItems[ulRun].oPPath,
+                                 ulLevel);
+
+      if(Node_hasChildName(oNDir, pcName, &ulChildID)) {
+         (void) Node_getChild(oNDir, ulChildID, &oNChild);
+         ulExact = FT_batchExactEnd(psBatch, ulRun, ulEnd, ulLevel);
+         FT_batchSettle(psBatch, ulRun, ulExact, ALREADY_IN_TREE);
+         if(Node_isFile(oNChild))
+            FT_batchSettle(psBatch, ulExact, ulEnd, NOT_A_DIRECTORY);
+         else
+            FT_batchInto(psBatch, oNChild, ulExact, ulEnd,
+                         ulLevel + 1);
+         continue;
+      }
+
+      if(oNHolder == NULL)
+         iStatus = Node_new(Node_getName(oNDir), NULL, FALSE, NULL, 0,
+                            &oNHolder);
+      if(iStatus == SUCCESS) {
+         size_t ulBuilt = Node_getNumChildren(oNHolder);
+         iStatus = FT_batchBuild(psBatch, oNHolder, ulRun, ulEnd,
+                                 ulLevel);
+         if(Node_getNumChildren(oNHolder) > ulBuilt) {
+            (void) Node_getChild(oNHolder, ulBuilt, &oNChild);
+            if(iStatus == SUCCESS)
+               iStatus = FT_indexSubtree(oNChild, FT_getIndexes());
+            if(iStatus != SUCCESS)
+               (void) Node_free(oNChild);
+         }
+      }
+      if(iStatus != SUCCESS)
+         FT_batchSettle(psBatch, ulRun, ulEnd, iStatus);
+   }
+
+   if(oNHolder != NULL)
+      FT_batchAdopt(psBatch, oNDir, oNHolder, ulLo, ulHi, ulLevel);
+}
+
+/* One thread's share of a bulk build: the items, from ulLo to before
+   ulHi, whose paths it parses or whose nodes it builds below a root
+   named pcRoot, under a holder of its own */
+struct FT_BuildPart {
+   struct FT_Batch *psBatch;
+   size_t ulLo;
+   size_t ulHi;
+   const char *pcRoot;
+   Node_T oNHolder;
+   int iStatus;
+};
+
+/* Parses the paths of the part's entries into the items at the same
+   positions, setting a bad path's item's to NULL and its result.
+   Has pthread_create's signature. */
+static void *FT_parsePart(void *pvPart) {
+   struct FT_BuildPart *psPart = pvPart;
+   struct FT_Batch *psBatch = psPart->psBatch;
+   size_t i;
+
+   for(i = psPart->ulLo; i < psPart->ulHi; i++) {
+      psBatch->psItems[i].ulIndex = i;
+      psBatch->piResults[i] = Path_new(psBatch->psEntries[i].pcPath,
+                                       &psBatch->psItems[i].oPPath);
+   }
+   return NULL;
+}
+
+/* Builds the nodes the part's items reach below the root under a new
+   holder off the tree, as FT_batchBuild does, setting iStatus. Has
+   pthread_create's signature. */
+static void *FT_buildPart(void *pvPart) {
+   struct FT_BuildPart *psPart = pvPart;
+
+   psPart->iStatus = Node_new(psPart->pcRoot, NULL, FALSE, NULL, 0,
+                              &psPart->oNHolder);
+   if(psPart->iStatus == SUCCESS)
+      psPart->iStatus = FT_batchBuild(psPart->psBatch,
+                                      psPart->oNHolder, psPart->ulLo,
+                                      psPart->ulHi, 1);
+   return NULL;
+}
+
+/*
+  Runs pfRun on each of the ulParts parts, of ulPartSize bytes each,
+  at pvParts at once: each part but the first on a thread of its own,
+  the first on the calling thread, as is any part whose thread could
+  not be created.
+*/
+static void FT_runParts(void *pvParts, size_t ulPartSize,
+                        size_t ulParts, void *(*pfRun)(void *)) {
+   pthread_t *ptThreads;
+   boolean *pbStarted;
+   size_t i;
+
+   ptThreads = malloc(ulParts * sizeof(pthread_t));
+   pbStarted = calloc(ulParts, sizeof(boolean));
+   for(i = 1; i < ulParts && ptThreads != NULL && pbStarted != NULL;
+       i++)
+      pbStarted[i] = (boolean)
+         (pthread_create(&ptThreads[i], NULL, pfRun,
+                         (char *) pvParts + i * ulPartSize) == 0);
+   (void) pfRun(pvParts);
+   for(i = 1; i < ulParts; i++) {
+      if(pbStarted != NULL && pbStarted[i])
+         (void) pthread_join(ptThreads[i], NULL);
+      else
+         (void) pfRun((char *) pvParts + i * ulPartSize);
+   }
+   free(ptThreads);
+   free(pbStarted);
+}
+
+/*
+  Builds under oNNewRoot, off the tree, the nodes that the items from
+  ulLo to before ulHi reach below the root, as FT_batchBuild does, but
+  in up to ulParts parts at once, each taking whole runs of the root's
+  children and built under its own holder, then merged in order into
+  oNNewRoot. Returns SUCCESS, or MEMORY_ERROR leaving what was built
+  for the caller to free.
+*/
+static int FT_batchBuildParts(struct FT_Batch *psBatch,
+                              Node_T oNNewRoot, size_t ulLo,
+                              size_t ulHi, struct FT_BuildPart *psParts,
+                              size_t ulParts) {
+   size_t ulUsed = 0;
+   size_t ulStart, ulCut, i;
+   int iStatus = SUCCESS;
+
+   /* cut evenly by items, then on to the end of the cut run */
+   for(i = 1, ulStart = ulLo; i <= ulParts && ulStart < ulHi; i++) {
+      ulCut = ulLo + (ulHi - ulLo) * i / ulParts;
+      if(ulCut <= ulStart)
+         continue;
+      if(ulCut < ulHi)
+         ulCut = FT_batchRunEnd(psBatch, ulCut - 1, ulHi, 1);
+      psParts[ulUsed].ulLo = ulStart;
+      psParts[ulUsed].ulHi = ulCut;
+      psParts[ulUsed].pcRoot = Node_getName(oNNewRoot);
+      psParts[ulUsed].oNHolder = NULL;
+      ulUsed++;
+      ulStart = ulCut;
+   }
+   if(ulUsed == 0)
+      return SUCCESS;
+
+   FT_runParts(psParts, sizeof(*psParts), ulUsed, FT_buildPart);
+   for(i = 0; i < ulUsed; i++) {
+      if(iStatus == SUCCESS)
+         iStatus = psParts[i].iStatus;
+      if(iStatus == SUCCESS)
+         iStatus = Node_adopt(oNNewRoot, psParts[i].oNHolder);
+      if(psParts[i].oNHolder != NULL)
+         (void) Node_free(psParts[i].oNHolder);
+   }
+   return iStatus;
+}
+
+/*
+  Inserts the batch's ulItems items, all with good paths, and sets
+  their results, starting with the root: an existing root takes the
+  runs under its name, and into an empty FT the batch's first entry
+  that is not a would-be root file brings the root. A new root's
+  subtree is built in up to ulParts parts at once with the parts at
+  psParts if ulParts is more than 1.
+*/
+static void FT_batchFromRoot(struct FT_Batch *psBatch, size_t ulItems,
+                             struct FT_BuildPart *psParts,
+                             size_t ulParts) {
+   struct FT_BatchItem *psItems = psBatch->psItems;
+   size_t ulRun, ulEnd, ulExact, ulFirst, i;
+   const char *pcRoot;
+
+   if(oNRoot != NULL) {
+      for(ulRun = 0; ulRun < ulItems; ulRun = ulEnd) {
+         ulEnd = FT_batchRunEnd(psBatch, ulRun, ulItems, 0);
+         if(strcmp(Path_getComponent(psItems[ulRun].oPPath, 0),
+                   Node_getName(oNRoot)) != 0) {
+            FT_batchSettle(psBatch, ulRun, ulEnd, CONFLICTING_PATH);
+            continue;
+         }
+         ulExact = FT_batchExactEnd(psBatch, ulRun, ulEnd, 0);
+         FT_batchSettle(psBatch, ulRun, ulExact, ALREADY_IN_TREE);
+         FT_batchInto(psBatch, oNRoot, ulExact, ulEnd, 1);
+      }
+      return;
+   }
+
+   /* files one level deep can't make the root, and conflict until it
+      exists */
+   ulFirst = ulItems;
+   for(i = 0; i < ulItems; i++)
+      if(!(psBatch->psEntries[psItems[i].ulIndex].bIsFile &&
+           Path_getDepth(psItems[i].oPPath) == 1) &&
+         (ulFirst == ulItems ||
+          psItems[i].ulIndex < psItems[ulFirst].ulIndex))
+         ulFirst = i;
+   if(ulFirst == ulItems) {
+      FT_batchSettle(psBatch, 0, ulItems, CONFLICTING_PATH);
+      return;
+   }
+   pcRoot = Path_getComponent(psItems[ulFirst].oPPath, 0);
+
+   for(ulRun = 0; ulRun < ulItems; ulRun = ulEnd) {
+      Node_T oNNewRoot = NULL;
+      int iStatus;
+
+      ulEnd = FT_batchRunEnd(psBatch, ulRun, ulItems, 0);
+      if(strcmp(Path_getComponent(psItems[ulRun].oPPath, 0),
+                pcRoot) != 0) {
+         FT_batchSettle(psBatch, ulRun, ulEnd, CONFLICTING_PATH);
+         continue;
+      }
+
+      ulExact = FT_batchExactEnd(psBatch, ulRun, ulEnd, 0);
+      iStatus = FT_reserveUndo(1);
+      if(iStatus == SUCCESS)
+         iStatus = Node_new(pcRoot, NULL, FALSE, NULL, 0, &oNNewRoot);
+      if(iStatus == SUCCESS && ulParts > 1)
+         iStatus = FT_batchBuildParts(psBatch, oNNewRoot, ulExact,
+                                      ulEnd, psParts, ulParts);
+      else if(iStatus == SUCCESS)
+         iStatus = FT_batchBuild(psBatch, oNNewRoot, ulExact, ulEnd, 1);
+      if(iStatus == SUCCESS)
+         iStatus = FT_indexSubtree(oNNewRoot, FT_getIndexes());
+      if(iStatus != SUCCESS) {
+         if(oNNewRoot != NULL)
+            (void) Node_free(oNNewRoot);
+         FT_batchSettle(psBatch, ulRun, ulEnd, iStatus);
+         continue;
+      }
+
+      /* root files before the root conflicted, those after find it */
+      for(i = ulRun; i < ulExact; i++) {
+         size_t ulIndex = psItems[i].ulIndex;
+         if(i == ulFirst)
+            psBatch->piResults[ulIndex] = SUCCESS;
+         else if(psBatch->psEntries[ulIndex].bIsFile &&
+                 ulIndex < psItems[ulFirst].ulIndex)
+            psBatch->piResults[ulIndex] = CONFLICTING_PATH;
+         else
+            psBatch->piResults[ulIndex] = ALREADY_IN_TREE;
+      }
+      oNRoot = oNNewRoot;
+      ulCount = Node_getNumNodes(oNRoot);
+      FT_logUndo(FT_UNDO_INSERT, oNRoot, NULL, NULL, 0);
+   }
+}
+
+int FT_insertBatch(const struct FT_InsertEntry *psEntries,
+                   size_t ulEntries, int *piResults) {
+   struct FT_Batch sBatch;
+   size_t ulItems = 0;
+   size_t i;
+
+   assert(psEntries != NULL || ulEntries == 0);
+   assert(piResults != NULL || ulEntries == 0);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if(ulEntries == 0)
+      return SUCCESS;
+
+   sBatch.psEntries = psEntries;
+   sBatch.piResults = piResults;
+   sBatch.poNDoomed = NULL;
+   sBatch.ulDoomed = 0;
+   sBatch.psItems = malloc(ulEntries * sizeof(struct FT_BatchItem));
+   if(sBatch.psItems == NULL) {
+      /* no room to sort: insert one at a time instead */
+      for(i = 0; i < ulEntries; i++)
+         if(psEntries[i].bIsFile)
+            piResults[i] = FT_insertFile(psEntries[i].pcPath,
+                                         psEntries[i].pvContents,
+                                         psEntries[i].ulLength);
+         else
+            piResults[i] = FT_insertDir(psEntries[i].pcPath);
+      return SUCCESS;
+   }
+
+   for(i = 0; i < ulEntries; i++) {
+      Path_T oPPath = NULL;
+      piResults[i] = Path_new(psEntries[i].pcPath, &oPPath);
+      if(piResults[i] == SUCCESS) {
+         sBatch.psItems[ulItems].oPPath = oPPath;
+         sBatch.psItems[ulItems++].ulIndex = i;
+      }
+   }
+   FT_batchSort(&sBatch, ulItems);
+
+   if(ulItems > 0)
+      FT_batchFromRoot(&sBatch, ulItems, NULL, 0);
+
+   for(i = 0; i < ulItems; i++)
+      Path_free(sBatch.psItems[i].oPPath);
+   free(sBatch.psItems);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
+   return SUCCESS;
+}
+
+int FT_bulkBuild(const struct FT_InsertEntry *psEntries,
+                 size_t ulEntries, size_t ulThreads, int *piResults) {
+   struct FT_Batch sBatch;
+   struct FT_BuildPart *psParts;
+   size_t ulItems = 0;
+   size_t i;
+
+   assert(psEntries != NULL || ulEntries == 0);
+   assert(piResults != NULL || ulEntries == 0);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
 
-   assert(pcPath != NULL);
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
+   if(ulThreads > ulEntries)
+      ulThreads = ulEntries;
+   if(oNRoot != NULL || ulThreads <= 1)
+      return FT_insertBatch(psEntries, ulEntries, piResults);
 
-   iStatus = FT_findNode(pcPath, &oNFound);
+   sBatch.psEntries = psEntries;
+   sBatch.piResults = piResults;
+   sBatch.poNDoomed = NULL;
+   sBatch.ulDoomed = 0;
+   sBatch.psItems = malloc(ulEntries * sizeof(struct FT_BatchItem));
+   psParts = malloc(ulThreads * sizeof(struct FT_BuildPart));
+   if(sBatch.psItems == NULL || psParts == NULL) {
+      free(sBatch.psItems);
+      free(psParts);
+      return FT_insertBatch(psEntries, ulEntries, piResults);
+   }
 
-   if(iStatus != SUCCESS)
-       return iStatus;
-     
-   if(Node_isFile(oNFound)){
-      return NOT_A_DIRECTORY;
+   /* parse in even slices at once, then squeeze out the bad paths */
+   for(i = 0; i < ulThreads; i++) {
+      psParts[i].psBatch = &sBatch;
+      psParts[i].ulLo = ulEntries * i / ulThreads;
+      psParts[i].ulHi = ulEntries * (i + 1) / ulThreads;
    }
+   FT_runParts(psParts, sizeof(*psParts), ulThreads,
+               FT_parsePart);
+   for(i = 0; i < ulEntries; i++)
+      if(sBatch.psItems[i].oPPath != NULL)
+         sBatch.psItems[ulItems++] = sBatch.psItems[i];
+   FT_batchSort(&sBatch, ulItems);
 
-   ulCount -= Node_free(oNFound);
-   if(ulCount == 0)
-      oNRoot = NULL;
+   if(ulItems > 0)
+      FT_batchFromRoot(&sBatch, ulItems, psParts, ulThreads);
+
+   for(i = 0; i < ulItems; i++)
+      Path_free(sBatch.psItems[i].oPPath);
+   free(sBatch.psItems);
+   free(psParts);
 
    assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
    return SUCCESS;
 }
 
-int FT_rmFile(const char *pcPath) {
-   int iStatus;
-   Node_T oNFound = NULL;
+/* --------------------------------------------------------------------
 
-   assert(pcPath != NULL);
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+  The following auxiliary functions support batch removal, which
+  walks the runs of a sorted batch as batch insertion does. A path in
+  the tree is removed by its earliest entry in the batch, unless an
+  ancestor's removal came earlier still; the nodes to remove are only
+  unlinked, each directory's all at once, where no ancestor is
+  removed as well.
+*/
+
+/*
+  Removes the FT file or directory with absolute path pcPath, as
+  FT_rmFile or FT_rmDir would. Returns their statuses.
+*/
+static int FT_rmPath(const char *pcPath) {
+   Node_T oNFound = NULL;
+   int iStatus;
 
    iStatus = FT_findNode(pcPath, &oNFound);
+   if(iStatus == SUCCESS)
+      iStatus = FT_rmNode(oNFound);
+   return iStatus;
+}
 
-   if(iStatus != SUCCESS)
-       return iStatus;
+/*
+  Unlinks the ulDoomed children of oNDir at aoNDoomed, which are in
+  oNDir's order, in one compaction, then removes them from the FT as
+  FT_rmNode would: freed, or kept and logged inside a transaction,
+  whose log must have room for them.
+*/
+static void FT_rmChildren(Node_T oNDir, Node_T *aoNDoomed,
+                          size_t ulDoomed) {
+   size_t i;
 
-   if(!Node_isFile(oNFound)){
-     return NOT_A_FILE;
+   Node_detachChildren(oNDir, aoNDoomed, ulDoomed);
+   for(i = 0; i < ulDoomed; i++) {
+      FT_unindexSubtree(aoNDoomed[i], FT_getIndexes());
+      ulCount -= Node_getNumNodes(aoNDoomed[i]);
+      if(bInTransaction)
+         FT_logUndo(FT_UNDO_REMOVE, aoNDoomed[i], oNDir, NULL, 0);
+      else
+         FT_freeLater(aoNDoomed[i]);
    }
+}
 
-   ulCount -= Node_free(oNFound);
-   if(ulCount == 0) 
-      oNRoot = NULL;
+/*
+  Settles the items from ulLo to before ulHi, whose paths pass through
+  oNDir, a directory in the FT at level ulLevel - 1, that the batch
+  removes at position ulCut (ulCut is the batch's length if it does
+  not), as do ancestors of it if bDoomed. Unless bDoomed, removes the
+  children of oNDir to be removed.
+*/
+static void FT_rmBatchFrom(struct FT_Batch *psBatch, Node_T oNDir,
+                           size_t ulLo, size_t ulHi, size_t ulLevel,
+                           size_t ulCut, boolean bDoomed) {
+   struct FT_BatchItem *psItems = psBatch->psItems;
+   size_t ulBase = psBatch->ulDoomed;
+   size_t ulRun, ulEnd, ulExact, ulChildID;
 
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
-   return SUCCESS;
-}
-  
+   /* only a directory that keeps its place has children unlinked */
+   if(!bDoomed && Node_unshare(oNDir) != SUCCESS) {
+      FT_batchSettle(psBatch, ulLo, ulHi, MEMORY_ERROR);
+      return;
+   }
 
+   for(ulRun = ulLo; ulRun < ulHi; ulRun = ulEnd) {
+      Node_T oNChild;
+      size_t ulChildCut = ulCut;
 
-int FT_init(void) {
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+      ulEnd = FT_batchRunEnd(psBatch, ulRun, ulHi, ulLevel);
+      if(!Node_hasChildName(oNDir,
+                            Path_getComponent(psItems[ulRun].oPPath,
+                                              ulLevel), &ulChildID)) {
+         FT_batchSettle(psBatch, ulRun, ulEnd, NO_SUCH_PATH);
+         continue;
+      }
+      oNChild = Node_peekChild(oNDir, ulChildID);
 
-   if(bIsInitialized)
-      return INITIALIZATION_ERROR;
+      /* the child's first item, if before the cut, removes it; the
+         run's items in order of position follow its own */
+      ulExact = FT_batchExactEnd(psBatch, ulRun, ulEnd, ulLevel);
+      FT_batchSettle(psBatch, ulRun, ulExact, NO_SUCH_PATH);
+      if(ulExact > ulRun && psItems[ulRun].ulIndex < ulCut) {
+         ulChildCut = psItems[ulRun].ulIndex;
+         psBatch->piResults[ulChildCut] = SUCCESS;
+      }
 
-   bIsInitialized = TRUE;
-   oNRoot = NULL;
-   ulCount = 0;
+      if(Node_isFile(oNChild))
+         FT_batchSettle(psBatch, ulExact, ulEnd, NO_SUCH_PATH);
+      else
+         FT_rmBatchFrom(psBatch, oNChild, ulExact, ulEnd, ulLevel + 1,
+                        ulChildCut,
+                        (boolean) (bDoomed || ulChildCut != ulCut));
+      if(!bDoomed && ulChildCut != ulCut)
+         psBatch->poNDoomed[psBatch->ulDoomed++] = oNChild;
+   }
 
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
-   return SUCCESS;
+   if(psBatch->ulDoomed > ulBase) {
+      FT_rmChildren(oNDir, &psBatch->poNDoomed[ulBase],
+                    psBatch->ulDoomed - ulBase);
+      psBatch->ulDoomed = ulBase;
+   }
 }
 
-int FT_destroy(void) {
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+int FT_rmBatch(const char **ppcPaths, size_t ulPaths, int *piResults) {
+   struct FT_Batch sBatch;
+   size_t ulItems = 0;
+   size_t ulRootCut = ulPaths;
+   size_t ulRun, ulEnd, ulExact, i;
+
+   assert(ppcPaths != NULL || ulPaths == 0);
+   assert(piResults != NULL || ulPaths == 0);
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
 
    if(!bIsInitialized)
       return INITIALIZATION_ERROR;
+   if(ulPaths == 0)
+      return SUCCESS;
 
-   if(oNRoot) {
-      ulCount -= Node_free(oNRoot);
-      oNRoot = NULL;
+   /* everything that can fail comes first, the log included */
+   sBatch.psEntries = NULL;
+   sBatch.piResults = piResults;
+   sBatch.psItems = malloc(ulPaths * sizeof(struct FT_BatchItem));
+   sBatch.poNDoomed = malloc(ulPaths * sizeof(Node_T));
+   sBatch.ulDoomed = 0;
+   if(sBatch.psItems == NULL || sBatch.poNDoomed == NULL ||
+      FT_reserveUndo(ulPaths) != SUCCESS) {
+      /* remove one at a time instead */
+      free(sBatch.psItems);
+      free(sBatch.poNDoomed);
+      for(i = 0; i < ulPaths; i++)
+         piResults[i] = FT_rmPath(ppcPaths[i]);
+      return SUCCESS;
    }
 
-   bIsInitialized = FALSE;
+   for(i = 0; i < ulPaths; i++) {
+      Path_T oPPath = NULL;
+      piResults[i] = Path_new(ppcPaths[i], &oPPath);
+      if(piResults[i] == SUCCESS) {
+         sBatch.psItems[ulItems].oPPath = oPPath;
+         sBatch.psItems[ulItems++].ulIndex = i;
+      }
+   }
+   FT_batchSort(&sBatch, ulItems);
 
-   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount)); 
+   /* paths below the root go once it is gone, and others conflict
+      with it until then */
+   for(ulRun = 0; ulRun < ulItems; ulRun = ulEnd) {
+      ulEnd = FT_batchRunEnd(&sBatch, ulRun, ulItems, 0);
+      if(oNRoot == NULL) {
+         FT_batchSettle(&sBatch, ulRun, ulEnd, NO_SUCH_PATH);
+         continue;
+      }
+      if(strcmp(Path_getComponent(sBatch.psItems[ulRun].oPPath, 0),
+                Node_getName(oNRoot)) != 0)
+         continue;
+      ulExact = FT_batchExactEnd(&sBatch, ulRun, ulEnd, 0);
+      FT_batchSettle(&sBatch, ulRun, ulExact, NO_SUCH_PATH);
+      if(ulExact > ulRun) {
+         ulRootCut = sBatch.psItems[ulRun].ulIndex;
+         piResults[ulRootCut] = SUCCESS;
+      }
+      FT_rmBatchFrom(&sBatch, oNRoot, ulExact, ulEnd, 1, ulRootCut,
+                     (boolean) (ulRootCut < ulPaths));
+   }
+   for(ulRun = 0; oNRoot != NULL && ulRun < ulItems; ulRun = ulEnd) {
+      ulEnd = FT_batchRunEnd(&sBatch, ulRun, ulItems, 0);
+      if(strcmp(Path_getComponent(sBatch.psItems[ulRun].oPPath, 0),
+                Node_getName(oNRoot)) == 0)
+         continue;
+      for(i = ulRun; i < ulEnd; i++)
+         piResults[sBatch.psItems[i].ulIndex] =
+            sBatch.psItems[i].ulIndex < ulRootCut ?
+            CONFLICTING_PATH : NO_SUCH_PATH;
+   }
+   if(ulRootCut < ulPaths)
+      (void) FT_rmNode(oNRoot);
+
+   for(i = 0; i < ulItems; i++)
+      Path_free(sBatch.psItems[i].oPPath);
+   free(sBatch.psItems);
+   free(sBatch.poNDoomed);
+
+   assert(CheckerFT_isValid(bIsInitialized, oNRoot, ulCount));
    return SUCCESS;
 }
 
-void *FT_getFileContents(const char *pcPath) {
-  Node_T oNFound = NULL;
-  int iStatus;
 
-  assert(pcPath != NULL);
+/* --------------------------------------------------------------------
 
-  if(!bIsInitialized)
-    return NULL;
-  
-  iStatus = FT_findNode(pcPath, &oNFound);
-  if(iStatus != SUCCESS || !Node_isFile(oNFound)) {
-    return NULL;
-  }
+  The following auxiliary functions support parallel serialization.
+  The tree is cut, in FT_toString order, into pieces of about equal
+  numbers of nodes, found from the subtree counts without visiting
+  the nodes. Parts of the pieces are measured on threads of their own,
+  each piece from the subtree lengths of its children, the prefix sums
+  of the lengths give each piece its offset in the result, and the
+  parts then write their pieces there at once.
+*/
 
-  if(!Node_isFile(oNFound))
-    return NULL;
-  
-  return Node_getFileContents(oNFound);
+/* Bounds on the number of nodes per piece: at least FT_PIECE_MIN, and
+   for FT_PIECES_PER_THREAD pieces per thread otherwise */
+enum { FT_PIECE_MIN = 1024, FT_PIECES_PER_THREAD = 8 };
+
+/* Kinds of piece: a directory's own line, or the subtrees of its file
+   or directory children among those from ulLo to before ulHi */
+enum { FT_PIECE_LINE, FT_PIECE_FILES, FT_PIECE_DIRS };
+
+/* A piece of the serialization, and its length and offset */
+struct FT_Piece {
+   Node_T oNDir;
+   size_t ulLo;
+   size_t ulHi;
+   int iKind;
+   size_t ulLength;
+   size_t ulOffset;
+};
+
+/* The pieces cut so far, and the number of nodes to cut them at */
+struct FT_Pieces {
+   struct FT_Piece *psPieces;
+   size_t ulPieces;
+   size_t ulCap;
+   size_t ulGrain;
+};
+
+/* One thread's share of a serialization: the pieces from ulLo to
+   before ulHi, and the result they are written into */
+struct FT_StringPart {
+   struct FT_Piece *psPieces;
+   size_t ulLo;
+   size_t ulHi;
+   char *pcResult;
+};
+
+/* Appends a piece of kind iKind for oNDir's children from ulLo to
+   before ulHi to psPieces. Returns SUCCESS or MEMORY_ERROR. */
+static int FT_addPiece(struct FT_Pieces *psPieces, Node_T oNDir,
+                       size_t ulLo, size_t ulHi, int iKind) {
+   struct FT_Piece *psPiece;
+
+   if(psPieces->ulPieces == psPieces->ulCap) {
+      size_t ulNewCap = psPieces->ulCap == 0 ? 64 : 2 * psPieces->ulCap;
+      struct FT_Piece *psNew =
+         realloc(psPieces->psPieces, ulNewCap * sizeof(*psNew));
+      if(psNew == NULL)
+         return MEMORY_ERROR;
+      psPieces->psPieces = psNew;
+      psPieces->ulCap = ulNewCap;
+   }
+   psPiece = &psPieces->psPieces[psPieces->ulPieces++];
+   psPiece->oNDir = oNDir;
+   psPiece->ulLo = ulLo;
+   psPiece->ulHi = ulHi;
+   psPiece->iKind = iKind;
+   return SUCCESS;
 }
 
-void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
-                             size_t ulNewLength) {
-  Node_T oNFound = NULL;
-  int iStatus;
+/*
+  Cuts the serialization of oNDir's subtree into pieces appended to
+  psPieces: its own line, then runs of its children of up to ulGrain
+  nodes, first for their files, then for their directories, cutting a
+  directory of more than ulGrain nodes in turn. Returns SUCCESS or
+  MEMORY_ERROR.
+*/
+static int FT_cutPieces(struct FT_Pieces *psPieces, Node_T oNDir) {
+   size_t ulChildren = Node_getNumChildren(oNDir);
+   size_t ulBelow = Node_getNumNodes(oNDir) - 1;
+   size_t ulLo, ulHi, ulBefore;
+   int iKind;
+   int iStatus;
 
-  assert(pcPath != NULL);
+   /* a piece's directory writes its own path, so it is unshared here,
+      before the pieces are handed to other threads that only read */
+   iStatus = Node_unshare(oNDir);
+   if(iStatus == SUCCESS)
+      iStatus = FT_addPiece(psPieces, oNDir, 0, 0, FT_PIECE_LINE);
+   for(iKind = FT_PIECE_FILES; iKind <= FT_PIECE_DIRS; iKind++)
+      for(ulLo = 0; iStatus == SUCCESS && ulLo < ulChildren;
+          ulLo = ulHi) {
+         Node_T oNChild;
 
-  if(!bIsInitialized)
-    return NULL;
-  
-  iStatus = FT_findNode(pcPath, &oNFound);
-  if(iStatus != SUCCESS || !Node_isFile(oNFound)) {
-    return NULL;
-  }
+         /* up to the child holding the ulGrain-th node from ulLo's */
+         ulBefore = Node_getNodesBefore(oNDir, ulLo);
+         if(ulBefore + psPieces->ulGrain >= ulBelow)
+            ulHi = ulChildren;
+         else
+            ulHi = Node_findChildByNodes(oNDir,
+                                         ulBefore + psPieces->ulGrain,
+                                         &ulBefore);
+         if(ulHi == ulLo)
+            ulHi++;
 
-  if(!Node_isFile(oNFound))
-    return NULL;
-  
-  return Node_replaceFileContents(oNFound, pvNewContents, ulNewLength);
+         oNChild = Node_peekChild(oNDir, ulLo);
+         if(iKind == FT_PIECE_DIRS && ulHi == ulLo + 1 &&
+            !Node_isFile(oNChild) &&
+            Node_getNumNodes(oNChild) > psPieces->ulGrain)
+            iStatus = FT_cutPieces(psPieces, oNChild);
+         else
+            iStatus = FT_addPiece(psPieces, oNDir, ulLo, ulHi, iKind);
+      }
+   return iStatus;
 }
 
-int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize) {
-  Node_T oNFound = NULL;
-  int iStatus;
+/* Returns the length of psPiece, from the subtree counts of its
+   nodes. */
+static size_t FT_pieceLength(const struct FT_Piece *psPiece) {
+   size_t ulParentLength = Node_getPathLength(psPiece->oNDir);
+   size_t ulLength = 0;
+   size_t c;
 
-  assert(pcPath != NULL);
-  assert(pbIsFile != NULL);
-  assert(pulSize != NULL);
+   if(psPiece->iKind == FT_PIECE_LINE)
+      return ulParentLength + 1;
+   for(c = psPiece->ulLo; c < psPiece->ulHi; c++) {
+      Node_T oNChild = Node_peekChild(psPiece->oNDir, c);
+      if(Node_isFile(oNChild) == (psPiece->iKind == FT_PIECE_FILES))
+         ulLength += FT_subtreeLength(oNChild, ulParentLength + 1 +
+                                      strlen(Node_getName(oNChild)));
+   }
+   return ulLength;
+}
 
-  if(!bIsInitialized)
-    return INITIALIZATION_ERROR;
+/* Writes psPiece into pcOut. */
+static void FT_writePiece(const struct FT_Piece *psPiece, char *pcOut) {
+   size_t ulParentLength = Node_getPathLength(psPiece->oNDir);
+   const char *pcParent = NULL;
+   size_t ulWritten = 0;
+   size_t c;
 
-  iStatus = FT_findNode(pcPath, &oNFound);
-  if(iStatus != SUCCESS) {
-    return iStatus;
-  }
+   if(psPiece->iKind == FT_PIECE_LINE) {
+      (void) Node_writePath(psPiece->oNDir, pcOut);
+      pcOut[ulParentLength] = '\n';
+      return;
+   }
 
-  if(Node_isFile(oNFound)) {
-    *pbIsFile = TRUE;
-    *pulSize = Node_getFileLength(oNFound);
-  }   
-  else {
-    *pbIsFile = FALSE;
-  }
-  return SUCCESS;
+   /* later lines copy the directory's path from the first one */
+   for(c = psPiece->ulLo; c < psPiece->ulHi; c++) {
+      Node_T oNChild = Node_peekChild(psPiece->oNDir, c);
+      if(Node_isFile(oNChild) != (psPiece->iKind == FT_PIECE_FILES))
+         continue;
+      ulWritten += FT_writeLines(oNChild, pcParent, ulParentLength,
+                                 (size_t) -1, pcOut + ulWritten);
+      pcParent = pcOut;
+   }
+}
+
+/* Sets the length of each of the part's pieces. Has pthread_create's
+   signature. */
+static void *FT_measurePart(void *pvPart) {
+   struct FT_StringPart *psPart = pvPart;
+   size_t i;
+
+   for(i = psPart->ulLo; i < psPart->ulHi; i++)
+      psPart->psPieces[i].ulLength =
+         FT_pieceLength(&psPart->psPieces[i]);
+   return NULL;
+}
+
+/* Writes each of the part's pieces at its offset in the result. Has
+   pthread_create's signature. */
+static void *FT_writePart(void *pvPart) {
+   struct FT_StringPart *psPart = pvPart;
+   size_t i;
+
+   for(i = psPart->ulLo; i < psPart->ulHi; i++)
+      FT_writePiece(&psPart->psPieces[i],
+                    psPart->pcResult + psPart->psPieces[i].ulOffset);
+   return NULL;
+}
+/*--------------------------------------------------------------------*/
+
+char *FT_toStringParallel(size_t ulThreads) {
+   struct FT_Pieces sPieces = { NULL, 0, 0, 0 };
+   struct FT_StringPart *psParts;
+   size_t ulLength = 0;
+   size_t i;
+   char *pcResult;
+
+   if(!bIsInitialized)
+      return NULL;
+   if(oNRoot == NULL)
+      return calloc(1, 1);
+   if(ulThreads == 0)
+      ulThreads = 1;
+
+   sPieces.ulGrain = ulCount / ulThreads / FT_PIECES_PER_THREAD;
+   if(sPieces.ulGrain < FT_PIECE_MIN)
+      sPieces.ulGrain = FT_PIECE_MIN;
+   if(FT_cutPieces(&sPieces, oNRoot) != SUCCESS) {
+      free(sPieces.psPieces);
+      return NULL;
+   }
+   if(ulThreads > sPieces.ulPieces)
+      ulThreads = sPieces.ulPieces;
+   psParts = malloc(ulThreads * sizeof(struct FT_StringPart));
+   if(psParts == NULL) {
+      free(sPieces.psPieces);
+      return NULL;
+   }
+   for(i = 0; i < ulThreads; i++) {
+      psParts[i].psPieces = sPieces.psPieces;
+      psParts[i].ulLo = sPieces.ulPieces * i / ulThreads;
+      psParts[i].ulHi = sPieces.ulPieces * (i + 1) / ulThreads;
+   }
+
+   FT_runParts(psParts, sizeof(*psParts), ulThreads, FT_measurePart);
+   for(i = 0; i < sPieces.ulPieces; i++) {
+      sPieces.psPieces[i].ulOffset = ulLength;
+      ulLength += sPieces.psPieces[i].ulLength;
+   }
+   pcResult = malloc(ulLength + 1);
+   if(pcResult != NULL) {
+      for(i = 0; i < ulThreads; i++)
+         psParts[i].pcResult = pcResult;
+      FT_runParts(psParts, sizeof(*psParts), ulThreads, FT_writePart);
+      pcResult[ulLength] = '\0';
+   }
+
+   free(psParts);
+   free(sPieces.psPieces);
+   return pcResult;
 }
 
+
 /* --------------------------------------------------------------------
 
-  The following auxiliary functions are used for generating the
-  string representation of the DT.
+  The following auxiliary functions support streaming the FT_toString
+  representation to a sink. Each line is gathered as a list of buffers
+  pointing at the names stored in the nodes, with '/' and newline
+  constants between them, so no path byte is copied or assembled. The
+  buffers are handed to the sink in large batches.
 */
 
-/*
-  Performs a pre-order traversal of the tree rooted at n,
-  inserting each payload to DynArray_T d beginning at index i.
-  Returns the next unused index in d after the insertion(s).
-*/
-static size_t FT_preOrderTraversal(Node_T n, DynArray_T d, size_t i) {
-   size_t c;
-   Node_T oNChild = NULL;
-   int iStatus;
-  
-   assert(d != NULL);
+/* The most buffers a sink takes at once */
+#if defined(IOV_MAX) && IOV_MAX < 1024
+enum { FT_SINK_BATCH = IOV_MAX };
+#else
+enum { FT_SINK_BATCH = 1024 };
+#endif
 
-   if(n != NULL) {
-      (void) DynArray_set(d, i, n); 
-      i++;
+/* The separator and terminator of the names in a line */
+static char acLineBytes[] = "/\n";
 
-      /* for files */ 
-      for(c = 0; c < Node_getNumChildren(n); c++) {
-         iStatus = Node_getChild(n,c, &oNChild); 
-         assert(iStatus == SUCCESS); 
-         if(Node_isFile(oNChild)) {
-           i = FT_preOrderTraversal(oNChild, d, i);
-          }
-      }
+/* A destination for the lines: a file descriptor written with writev,
+   a stream, or a client's writer; and the buffers not yet given it */
+struct FT_Sink {
+   int iFd;
+   FILE *psFile;
+   FT_Writer_T pfWrite;
+   void *pvExtra;
+   struct iovec aoVec[FT_SINK_BATCH];
+   size_t ulVecs;
+};
 
-      /* for directories */
-      for(c = 0; c < Node_getNumChildren(n); c++) {
-         iStatus = Node_getChild(n,c, &oNChild); 
-         assert(iStatus == SUCCESS); 
-         if(!Node_isFile(oNChild)) {
-           i = FT_preOrderTraversal(oNChild, d, i);
-          }
-      }
-     
+/* Hands psSink's buffers to its destination and empties them. Returns
+   SUCCESS or IO_ERROR. */
+static int FT_flushSink(struct FT_Sink *psSink) {
+   size_t i;
+   int iStatus = SUCCESS;
+
+   if(psSink->pfWrite != NULL) {
+      for(i = 0; i < psSink->ulVecs && iStatus == SUCCESS; i++)
+         if((*psSink->pfWrite)(psSink->aoVec[i].iov_base,
+                               psSink->aoVec[i].iov_len,
+                               psSink->pvExtra) != 0)
+            iStatus = IO_ERROR;
+   }
+   else if(psSink->psFile != NULL) {
+      for(i = 0; i < psSink->ulVecs && iStatus == SUCCESS; i++)
+         if(fwrite(psSink->aoVec[i].iov_base, 1,
+                   psSink->aoVec[i].iov_len, psSink->psFile) !=
+            psSink->aoVec[i].iov_len)
+            iStatus = IO_ERROR;
    }
-   return i;
+   else
+      iStatus = FT_writevAll(psSink->iFd, psSink->aoVec, psSink->ulVecs);
+   psSink->ulVecs = 0;
+   return iStatus;
 }
 
-/*
-  Alternate version of strlen that uses pulAcc as an in-out parameter
-  to accumulate a string length, rather than returning the length of
-  oNNode's path, and also always adds one addition byte to the sum.
-*/
-static void FT_strlenAccumulate(Node_T oNNode, size_t *pulAcc) {
-   assert(pulAcc != NULL);
+/* Adds the ulLength bytes at pvBytes to psSink, flushing it first if
+   it is full. Returns SUCCESS or IO_ERROR. */
+static int FT_addToSink(struct FT_Sink *psSink, const void *pvBytes,
+                        size_t ulLength) {
+   int iStatus = SUCCESS;
+
+   if(psSink->ulVecs == FT_SINK_BATCH)
+      iStatus = FT_flushSink(psSink);
+   psSink->aoVec[psSink->ulVecs].iov_base = (void *) pvBytes;
+   psSink->aoVec[psSink->ulVecs++].iov_len = ulLength;
+   return iStatus;
+}
 
-   if(oNNode != NULL)
-      *pulAcc += (Path_getStrLength(Node_getPath(oNNode)) + 1);
+/* Adds to psSink the line of oNNode, whose ancestors are the
+   directories of psScan's frames. Returns SUCCESS or IO_ERROR. */
+static int FT_addLine(struct FT_Sink *psSink, struct FT_Scan *psScan,
+                      Node_T oNNode) {
+   const char *pcName;
+   size_t i;
+   int iStatus = SUCCESS;
+
+   for(i = 0; i < psScan->ulFrames && iStatus == SUCCESS; i++) {
+      pcName = Node_getName(psScan->psFrames[i].oNDir);
+      iStatus = FT_addToSink(psSink, pcName, strlen(pcName));
+      if(iStatus == SUCCESS)
+         iStatus = FT_addToSink(psSink, acLineBytes, 1);
+   }
+   pcName = Node_getName(oNNode);
+   if(iStatus == SUCCESS)
+      iStatus = FT_addToSink(psSink, pcName, strlen(pcName));
+   if(iStatus == SUCCESS)
+      iStatus = FT_addToSink(psSink, acLineBytes + 1, 1);
+   return iStatus;
 }
 
 /*
-  Alternate version of strcat that inverts the typical argument
-  order, appending oNNode's path onto pcAcc, and also always adds one
-  newline at the end of the concatenated string.
+  Writes the FT_toString representation to psSink, walking the tree
+  with a stack of frames, one per ancestor of the node reached (see
+  FT_scanNextLine). Returns SUCCESS or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if the sink fails
+  * MEMORY_ERROR if memory could not be allocated to complete request
 */
-static void FT_strcatAccumulate(Node_T oNNode, char *pcAcc) {
-   assert(pcAcc != NULL);
+static int FT_writeToSink(struct FT_Sink *psSink) {
+   struct FT_Scan sScan = { NULL, 0, 0 };
+   Node_T oNNode;
+   int iStatus = SUCCESS;
+
+   if(!bIsInitialized)
+      return INITIALIZATION_ERROR;
 
-   if(oNNode != NULL) {
-      strcat(pcAcc, Path_getPathname(Node_getPath(oNNode)));
-      strcat(pcAcc, "\n");
+   for(oNNode = oNRoot; oNNode != NULL && iStatus == SUCCESS;
+       oNNode = FT_scanNextLine(&sScan)) {
+      iStatus = FT_addLine(psSink, &sScan, oNNode);
+      if(iStatus == SUCCESS && Node_getNumChildren(oNNode) > 0)
+         iStatus = FT_scanPush(&sScan, oNNode, 0);
    }
+   if(iStatus == SUCCESS)
+      iStatus = FT_flushSink(psSink);
+
+   free(sScan.psFrames);
+   return iStatus;
 }
 /*--------------------------------------------------------------------*/
 
-char *FT_toString(void) {
-   DynArray_T nodes;
-   size_t totalStrlen = 1;
-   char *result = NULL;
+int FT_writeTo(int iFd) {
+   struct FT_Sink sSink;
 
-   if(!bIsInitialized)
-      return NULL;
+   sSink.iFd = iFd;
+   sSink.psFile = NULL;
+   sSink.pfWrite = NULL;
+   sSink.pvExtra = NULL;
+   sSink.ulVecs = 0;
+   return FT_writeToSink(&sSink);
+}
+
+int FT_writeToFile(FILE *psFile) {
+   struct FT_Sink sSink;
+
+   assert(psFile != NULL);
+
+   sSink.iFd = -1;
+   sSink.psFile = psFile;
+   sSink.pfWrite = NULL;
+   sSink.pvExtra = NULL;
+   sSink.ulVecs = 0;
+   return FT_writeToSink(&sSink);
+}
+
+int FT_writeWith(FT_Writer_T pfWrite, void *pvExtra) {
+   struct FT_Sink sSink;
+
+   assert(pfWrite != NULL);
+
+   sSink.iFd = -1;
+   sSink.psFile = NULL;
+   sSink.pfWrite = pfWrite;
+   sSink.pvExtra = pvExtra;
+   sSink.ulVecs = 0;
+   return FT_writeToSink(&sSink);
+}
+
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions support comparing subtrees by
+  their hashes, descending only into the children whose hashes differ.
+*/
+
+/* The state of an FT_diff: its visitor, the buffer for the paths
+   handed to it, and whether it has asked to stop */
+struct FT_Diff {
+   FT_DiffVisitor_T pfVisit;
+   void *pvExtra;
+   struct FT_PathBuf sBuf;
+   boolean bStopped;
+};
+
+/* Reports the difference iChange at oNNode to psDiff's visitor.
+   Returns SUCCESS or MEMORY_ERROR. */
+static int FT_reportDiff(struct FT_Diff *psDiff, int iChange,
+                         Node_T oNNode) {
+   const char *pcPath = FT_getPath(oNNode, &psDiff->sBuf);
 
-   nodes = DynArray_new(ulCount);
-   if(nodes == NULL) {
-     return NULL;
+   if(pcPath == NULL)
+      return MEMORY_ERROR;
+   if((*psDiff->pfVisit)(iChange, pcPath, Node_isFile(oNNode),
+                         psDiff->pvExtra) != 0)
+      psDiff->bStopped = TRUE;
+   return SUCCESS;
+}
+
+/*
+  Reports to psDiff the differences between the subtrees rooted at
+  oNOld and oNNew, merging the sorted children of two directories and
+  skipping the pairs of namesakes with equal hashes. Returns SUCCESS
+  or MEMORY_ERROR.
+*/
+static int FT_diffNodes(struct FT_Diff *psDiff, Node_T oNOld,
+                        Node_T oNNew) {
+   size_t ulOld = 0, ulNew = 0;
+   int iStatus = SUCCESS;
+
+   if(Node_getHash(oNOld) == Node_getHash(oNNew))
+      return SUCCESS;
+   if(Node_isFile(oNOld) && Node_isFile(oNNew))
+      return FT_reportDiff(psDiff, FT_DIFF_MODIFIED, oNNew);
+   if(Node_isFile(oNOld) || Node_isFile(oNNew)) {
+      iStatus = FT_reportDiff(psDiff, FT_DIFF_REMOVED, oNOld);
+      if(iStatus == SUCCESS && !psDiff->bStopped)
+         iStatus = FT_reportDiff(psDiff, FT_DIFF_ADDED, oNNew);
+      return iStatus;
    }
-  
-   (void) FT_preOrderTraversal(oNRoot, nodes, 0);
+   if(Node_unshare(oNOld) != SUCCESS || Node_unshare(oNNew) != SUCCESS)
+      return MEMORY_ERROR;
 
-   DynArray_map(nodes, (void (*)(void *, void*)) FT_strlenAccumulate,
-                (void*) &totalStrlen);
+   while(iStatus == SUCCESS && !psDiff->bStopped &&
+         (ulOld < Node_getNumChildren(oNOld) ||
+          ulNew < Node_getNumChildren(oNNew))) {
+      Node_T oNOldChild = NULL;
+      Node_T oNNewChild = NULL;
+      int iCompare;
 
-   result = malloc(totalStrlen);
-   if(result == NULL) {
-      DynArray_free(nodes);
-      return NULL;
+      (void) Node_getChild(oNOld, ulOld, &oNOldChild);
+      (void) Node_getChild(oNNew, ulNew, &oNNewChild);
+      if(ulOld == Node_getNumChildren(oNOld))
+         iCompare = 1;
+      else if(ulNew == Node_getNumChildren(oNNew))
+         iCompare = -1;
+      else
+         iCompare = strcmp(Node_getName(oNOldChild),
+                           Node_getName(oNNewChild));
+
+      if(iCompare < 0) {
+         iStatus = FT_reportDiff(psDiff, FT_DIFF_REMOVED, oNOldChild);
+         ulOld++;
+      }
+      else if(iCompare > 0) {
+         iStatus = FT_reportDiff(psDiff, FT_DIFF_ADDED, oNNewChild);
+         ulNew++;
+      }
+      else {
+         iStatus = FT_diffNodes(psDiff, oNOldChild, oNNewChild);
+         ulOld++;
+         ulNew++;
+      }
    }
-   *result = '\0';
+   return iStatus;
+}
+/*--------------------------------------------------------------------*/
+
+int FT_getHash(const char *pcPath, size_t *pulHash) {
+   Node_T oNFound = NULL;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(pulHash != NULL);
+
+   iStatus = FT_findNode(pcPath, &oNFound);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   *pulHash = Node_getHash(oNFound);
+   return SUCCESS;
+}
 
-   DynArray_map(nodes, (void (*)(void *, void*)) FT_strcatAccumulate,
-                (void *) result);
+int FT_diff(const char *pcOld, const char *pcNew,
+            FT_DiffVisitor_T pfVisit, void *pvExtra) {
+   struct FT_Diff sDiff;
+   Node_T oNOld = NULL;
+   Node_T oNNew = NULL;
+   int iStatus;
+
+   assert(pcOld != NULL);
+   assert(pcNew != NULL);
+   assert(pfVisit != NULL);
 
-   DynArray_free(nodes);
+   iStatus = FT_findNode(pcOld, &oNOld);
+   if(iStatus == SUCCESS)
+      iStatus = FT_findNode(pcNew, &oNNew);
+   if(iStatus != SUCCESS)
+      return iStatus;
 
-   return result;
+   sDiff.pfVisit = pfVisit;
+   sDiff.pvExtra = pvExtra;
+   sDiff.sBuf.pcPath = NULL;
+   sDiff.sBuf.ulCap = 0;
+   sDiff.sBuf.iStatus = SUCCESS;
+   sDiff.bStopped = FALSE;
+   iStatus = FT_diffNodes(&sDiff, oNOld, oNNew);
+   free(sDiff.sBuf.pcPath);
+   return iStatus;
 }
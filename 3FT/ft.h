@@ -13,8 +13,19 @@
 */
 
 #include <stddef.h>
+#include <stdio.h>
 #include "a4def.h"
 
+/*
+  A visitor is called by the FT's enumeration functions once per
+  matching entry, with the entry's absolute path pcPath (valid only
+  for the duration of the call), whether it is a file, its size in
+  bytes (0 for directories), and the pvExtra given by the client.
+  It returns 0 to continue the enumeration or non-zero to stop it.
+*/
+typedef int (*FT_Visitor_T)(const char *pcPath, boolean bIsFile,
+                            size_t ulSize, void *pvExtra);
+
 /*
    Inserts a new directory into the FT with absolute path pcPath.
    Returns SUCCESS if the new directory is inserted successfully.
@@ -36,7 +47,14 @@ boolean FT_containsDir(const char *pcPath);
 
 /*
   Removes the FT hierarchy (subtree) at the directory with absolute
-  path pcPath. Returns SUCCESS if found and removed.
+  path pcPath. The subtree is unlinked and the FT's node count updated
+  at once; a large subtree's nodes are then freed in the background,
+  on a reclaimer thread, so that the time taken does not depend on
+  the subtree's size. That holds only while the name and substring
+  indexes are disabled: an enabled index has its entries for every
+  node of the subtree removed on the calling thread before this
+  returns, in time proportional to the subtree's size. Returns
+  SUCCESS if found and removed.
   Otherwise, returns:
   * INITIALIZATION_ERROR if the FT is not in an initialized state
   * BAD_PATH if pcPath does not represent a well-formatted path
@@ -83,6 +101,231 @@ boolean FT_containsFile(const char *pcPath);
 */
 int FT_rmFile(const char *pcPath);
 
+/* One entry of a batch insertion: a directory, or a file with the
+   ulLength bytes of contents at pvContents */
+struct FT_InsertEntry {
+   const char *pcPath;
+   boolean bIsFile;
+   void *pvContents;
+   size_t ulLength;
+};
+
+/*
+  Inserts the ulEntries entries at psEntries into the FT, setting
+  piResults[i] to the status of entry i: exactly what FT_insertDir or
+  FT_insertFile would have returned for it had the entries been
+  inserted one at a time in order, and with the same resulting FT.
+  The batch is sorted by path, so that entries sharing a prefix share
+  one traversal, and each directory takes all of its new children in
+  one merge of its sorted children rather than one shifting insertion
+  each. Returns SUCCESS, or INITIALIZATION_ERROR, setting no results,
+  if the FT is not in an initialized state.
+*/
+int FT_insertBatch(const struct FT_InsertEntry *psEntries,
+                   size_t ulEntries, int *piResults);
+
+/*
+  Populates an empty FT from the ulEntries entries at psEntries, as
+  FT_insertBatch would, using up to ulThreads threads: the paths are
+  parsed in parallel, the sort is skipped if they are already in path
+  order (as a sorted manifest is), and the entries below the root are
+  split, between its children, into up to ulThreads parts that are
+  built off the tree at once, each by its own thread, before being
+  linked under the root. The results and the FT are those of
+  FT_insertBatch. If the FT is not empty, or ulThreads is at most 1,
+  this is FT_insertBatch. Returns SUCCESS, or INITIALIZATION_ERROR,
+  setting no results, if the FT is not in an initialized state.
+*/
+int FT_bulkBuild(const struct FT_InsertEntry *psEntries,
+                 size_t ulEntries, size_t ulThreads, int *piResults);
+
+/*
+  Removes the ulPaths files or directories, with their subtrees, at
+  the absolute paths ppcPaths, setting piResults[i] to the status of
+  path i: exactly what FT_rmFile (for a file) or FT_rmDir (for a
+  directory) would have returned for it had the paths been removed
+  one at a time in order, so NO_SUCH_PATH for a path removed earlier
+  in the batch, on its own or with an ancestor. The batch is sorted
+  by path, so that paths sharing a prefix share one traversal, and
+  each directory loses all of its removed children in one compaction
+  of its children array rather than one shifting removal each. As
+  with FT_rmDir, an enabled index costs time proportional to the
+  sizes of the removed subtrees.
+  Returns SUCCESS, or INITIALIZATION_ERROR, setting no results, if the
+  FT is not in an initialized state.
+*/
+int FT_rmBatch(const char **ppcPaths, size_t ulPaths, int *piResults);
+
+/*
+  Moves the file or directory with absolute path pcSrc, with all of
+  its descendants, to absolute path pcDst, whose parent must already
+  be a directory in the FT. Only the moved node is unlinked, renamed
+  and relinked, so this takes time proportional to the depths of the
+  two paths and the logarithms of the parents' fanouts, however large
+  the subtree is.
+  Returns SUCCESS if moved.
+  Otherwise, leaves the FT unchanged and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcSrc or pcDst does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcSrc
+                     or pcDst, if pcSrc is the root, or if pcDst lies
+                     below pcSrc
+  * NO_SUCH_PATH if pcSrc, or the parent of pcDst, does not exist in
+                 the FT
+  * ALREADY_IN_TREE if pcDst already exists in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcDst exists as a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_mv(const char *pcSrc, const char *pcDst);
+
+/*
+  Copies the file or directory with absolute path pcSrc, with all of
+  its descendants, to absolute path pcDst, whose parent must already
+  be a directory in the FT. The copied files share their contents
+  with the originals until either side's contents are replaced with
+  FT_replaceFileContents, so copying never copies contents;
+  accordingly, contents obtained with FT_getFileContents must not be
+  changed in place. A directory other than the root is likewise
+  shared, taking time independent of its size: the entries on the
+  way to a change, or to a path handed to a visitor, are copied the
+  first time they are reached, a directory's children at a time.
+  With an index enabled or a transaction open, all the new entries
+  are made at once instead.
+  Returns SUCCESS if copied.
+  Otherwise, leaves the FT unchanged and returns the statuses of
+  FT_mv.
+*/
+int FT_cp(const char *pcSrc, const char *pcDst);
+
+/*
+  How FT_merge settles an entry of the source that clashes with an
+  entry of the destination, where the two are not both directories
+  (a file/file or file/directory clash): fail before changing
+  anything, keep the destination's entry and discard the source's,
+  or replace the destination's entry, with its subtree, by the
+  source's.
+*/
+enum { FT_MERGE_FAIL, FT_MERGE_KEEP, FT_MERGE_REPLACE };
+
+/*
+  Merges the directory with absolute path pcSrc, typically a staging
+  area where a subtree was built, into the directory with absolute
+  path pcDst, and removes pcSrc. If pcDst does not exist, pcSrc is
+  simply moved there as by FT_mv. Otherwise each of pcSrc's children
+  without a namesake in pcDst is moved there, subtree and all, in one
+  linear merge of the two sorted children lists; two directories of
+  the same name are merged in turn, and other clashes are settled by
+  iPolicy, one of the FT_MERGE values above. Only the nodes that are
+  moved or discarded are touched.
+  Returns SUCCESS if merged.
+  Otherwise returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcSrc or pcDst does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcSrc
+                     or pcDst, if pcSrc is the root, if pcDst lies
+                     within pcSrc, or if pcSrc lies within pcDst and
+                     has an entry that would be merged into a
+                     directory containing pcSrc
+  * NO_SUCH_PATH if pcSrc, or the parent of a new pcDst, does not
+                 exist in the FT
+  * NOT_A_DIRECTORY if pcSrc or pcDst, or a proper prefix of pcDst,
+                    exists as a file
+  * ALREADY_IN_TREE if iPolicy is FT_MERGE_FAIL and some entry clashes
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  All these leave the FT unchanged except MEMORY_ERROR, which may
+  leave the merge partly done, each entry being then either under
+  pcDst or still under pcSrc.
+*/
+int FT_merge(const char *pcDst, const char *pcSrc, int iPolicy);
+
+/* A subtree detached from the FT, owned by the client */
+typedef struct FT_Subtree *FT_Subtree_T;
+
+/*
+  Detaches the file or directory with absolute path pcPath, with all
+  of its descendants, from the FT, and sets *poSubtree to it as a
+  standalone object owned by the client, who must in time attach it
+  again with FT_attach or free it with FT_freeSubtree. Only the
+  subtree's root is unlinked, and the FT's count drops by the node
+  count the subtree keeps, so this takes time proportional to the
+  depth of pcPath, however large the subtree is; only an enabled
+  index adds time proportional to its size, to drop its entries.
+  Returns SUCCESS if detached.
+  Otherwise, leaves the FT unchanged, sets *poSubtree to NULL and
+  returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath,
+                     or if pcPath is the root
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_detach(const char *pcPath, FT_Subtree_T *poSubtree);
+
+/*
+  Attaches the subtree oSubtree at absolute path pcPath, whose parent
+  must already be a directory in the FT, naming its root after
+  pcPath's final component, and releases the oSubtree object. Takes
+  the time FT_detach does, including for the indexes.
+  Returns SUCCESS if attached.
+  Otherwise, leaves the FT unchanged and oSubtree with the client, and
+  returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcPath
+  * NO_SUCH_PATH if the parent of pcPath does not exist in the FT
+  * ALREADY_IN_TREE if pcPath already exists in the FT
+  * NOT_A_DIRECTORY if a proper prefix of pcPath exists as a file
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_attach(const char *pcPath, FT_Subtree_T oSubtree);
+
+/*
+  Frees oSubtree with all of its nodes and file contents, and returns
+  the number of nodes freed. The FT is not touched, so this may run
+  on another thread while the FT is in use, even if oSubtree holds
+  files copied with FT_cp or copied from: the counts of shared
+  contents are updated under a lock.
+*/
+size_t FT_freeSubtree(FT_Subtree_T oSubtree);
+
+/*
+  Transactions group changes to the FT so that they take effect
+  together or not at all. Between FT_begin and FT_commit or FT_abort,
+  FT_insertDir, FT_insertFile, FT_insertBatch, FT_bulkBuild, FT_rmDir,
+  FT_rmFile, FT_rmBatch, FT_mv, FT_cp, FT_replaceFileContents and
+  FT_importTar append one fixed-size record per change to an undo
+  log, and what they remove or replace (nodes, names and contents) is
+  kept rather than freed until the transaction ends. A call that
+  fails logs nothing, and the transaction may go on or be aborted.
+  Inside a transaction, FT_replaceFileContents returns a copy of the
+  old contents, the log keeping the original. FT_merge, FT_detach and
+  FT_attach, which are not logged, return INITIALIZATION_ERROR while a
+  transaction is open.
+*/
+
+/*
+  Opens a transaction. Returns SUCCESS, or INITIALIZATION_ERROR if the
+  FT is not in an initialized state or a transaction is already open.
+*/
+int FT_begin(void);
+
+/*
+  Closes the open transaction, keeping its changes and freeing what
+  they removed or replaced. Returns SUCCESS, or INITIALIZATION_ERROR
+  if no transaction is open.
+*/
+int FT_commit(void);
+
+/*
+  Closes the open transaction, undoing its changes from the last one
+  back, which needs no memory: the FT is left as FT_begin found it.
+  Only the indexes may need memory to re-file restored entries; if
+  that fails they are disabled. Returns SUCCESS, or
+  INITIALIZATION_ERROR if no transaction is open.
+*/
+int FT_abort(void);
+
 /*
   Returns the contents of the file with absolute path pcPath.
   Returns NULL if unable to complete the request for any reason.
@@ -129,7 +372,9 @@ int FT_init(void);
 
 /*
   Removes all contents of the data structure and
-  returns it to an uninitialized state.
+  returns it to an uninitialized state, committing any open
+  transaction first and waiting for the background freeing of removed
+  subtrees to finish.
   Returns INITIALIZATION_ERROR if not already initialized,
   and SUCCESS otherwise.
 */
@@ -143,10 +388,537 @@ int FT_destroy(void);
   The representation is depth-first with files
   before directories at any given level, and nodes
   of the same type ordered lexicographically.
+  Its length is known in O(1) time from counts kept
+  up to date by every change, so the string is sized
+  exactly and written in one pass, in time linear in
+  its length.
 
   Allocates memory for the returned string,
   which is then owned by client!
 */
 char *FT_toString(void);
 
+/*
+  Sets *pulLength to the length, without its '\0', of the string
+  FT_toString would return, in O(1) time, and writes that string into
+  the ulCap bytes at pcBuf if it fits. Returns SUCCESS if it was
+  written, or (leaving pcBuf unchanged):
+  * INITIALIZATION_ERROR if the FT is not in an initialized state,
+                         leaving *pulLength unchanged
+  * MEMORY_ERROR if ulCap is less than *pulLength + 1
+*/
+int FT_toStringInto(char *pcBuf, size_t ulCap, size_t *pulLength);
+
+/*
+  Enables (if bEnable is TRUE) or disables caching by FT_toString and
+  FT_toStringInto of the lines of subtrees, as fragments kept on the
+  directories whose lines take up to 64KB. A change to the tree drops
+  only the fragments of the directories above it, so while the cache
+  is enabled a call after a few changes rewrites only the subtrees
+  they touched, plus the lines of the directories too big to cache,
+  and copies the rest from the fragments; the fragments take about as
+  much memory as the string. Disabling frees them, in O(n) time, and
+  so does FT_destroy, which disables the cache. Returns SUCCESS, or
+  INITIALIZATION_ERROR if the FT is not in an initialized state.
+*/
+int FT_setStringCache(boolean bEnable);
+
+/*
+  Returns a string representation of the part of the FT rooted at
+  absolute path pcPath and extending at most ulMaxDepth levels below
+  it (0 for just pcPath; (size_t) -1 for the whole hierarchy), in the
+  format of FT_toString. The string is sized exactly, in one pass over
+  only the nodes it represents. Returns NULL if the FT is not in an
+  initialized state, pcPath is not in the FT, or there is an
+  allocation error.
+
+  Allocates memory for the returned string,
+  which is then owned by client!
+*/
+char *FT_toStringAt(const char *pcPath, size_t ulMaxDepth);
+
+/*
+  Returns the string FT_toString would, built on up to ulThreads
+  threads at once (0 meaning 1). The tree is cut into pieces of about
+  equal numbers of nodes, each piece's length is measured and its
+  offset in the result found before any is written, and the threads
+  then write their pieces in place. Returns NULL if the FT is not in
+  an initialized state or there is an allocation error.
+
+  Allocates memory for the returned string,
+  which is then owned by client!
+*/
+char *FT_toStringParallel(size_t ulThreads);
+
+/*
+  A writer is called by FT_writeWith with each of the ulLength-byte
+  pieces at pvBytes that make up the output in turn, and the pvExtra
+  given by the client. It returns 0 to continue or non-zero to fail
+  the write.
+*/
+typedef int (*FT_Writer_T)(const void *pvBytes, size_t ulLength,
+                           void *pvExtra);
+
+/*
+  Writes the string FT_toString would return, without its '\0', to
+  file descriptor iFd, without building it: each line is written with
+  writev straight from the names stored in the FT, with '/' and
+  newline constants between them, in batches of many lines, so that
+  no path is copied and the extra memory used is proportional only to
+  the depth of the FT. Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if writing to iFd fails
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_writeTo(int iFd);
+
+/* Writes as FT_writeTo does, but to stream psFile with fwrite. Returns
+   the errors of FT_writeTo. */
+int FT_writeToFile(FILE *psFile);
+
+/* Writes as FT_writeTo does, but by calling pfWrite(bytes, length,
+   pvExtra) on each piece of the output, failing with IO_ERROR if
+   pfWrite does. Returns the errors of FT_writeTo. */
+int FT_writeWith(FT_Writer_T pfWrite, void *pvExtra);
+
+/*
+  Reads a POSIX ustar or pax archive from file descriptor iFd until
+  its end-of-archive marker (or end of file), adding each directory
+  and regular file member to the FT in archive order. Missing
+  ancestors are created as directories; a member that is already in
+  the FT with the same type is kept (directory) or gets the archive's
+  contents (file). Other member types are skipped. Returns SUCCESS if
+  the whole archive was imported.
+  Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if iFd could not be read or the archive is malformed
+  * BAD_PATH if a member name is not a well-formatted path
+  * CONFLICTING_PATH if a member is not underneath the FT's root,
+                     or if a file member would be the FT root
+  * NOT_A_DIRECTORY if a proper prefix of a member exists as a file
+  * ALREADY_IN_TREE if a member is in the FT with the other type
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  Members preceding the failing one remain in the FT.
+*/
+int FT_importTar(int iFd);
+
+/*
+  Writes the FT to file descriptor iFd as a POSIX ustar archive (with
+  pax records for names or sizes ustar can't hold), members in the
+  same order as FT_toString. File contents are written directly from
+  the FT, without intermediate copies.
+  Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if writing to iFd fails
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_exportTar(int iFd);
+
+/*
+  Calls pfVisit(path, isFile, size, pvExtra) on every path in the FT
+  matching pattern pcPattern, in FT_toString order, until pfVisit
+  returns non-zero. Pattern components are separated by '/' and match
+  one path component each, where '*' matches any run of characters,
+  '?' any one character, "[...]" any character in the set (ranges
+  allowed, '!' or '^' first negates it) and '\\' quotes the next
+  character; a component that is exactly "**" matches zero or more
+  whole path components. Only directories that the pattern can still
+  match are visited, and literal components are looked up directly.
+  Returns SUCCESS (also when stopped by pfVisit), or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPattern is empty, begins or ends with a '/',
+             or contains consecutive '/' delimiters
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_glob(const char *pcPattern, FT_Visitor_T pfVisit,
+            void *pvExtra);
+
+/*
+  Calls pfVisit(path, TRUE, size, pvExtra) on every file in the FT
+  hierarchy rooted at absolute path pcPath whose size in bytes is
+  between ulMin and ulMax inclusive, in FT_toString order, until
+  pfVisit returns non-zero. Subtrees whose per-directory size
+  aggregates rule out any match are skipped without being visited.
+  Returns SUCCESS (also when stopped by pfVisit), or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_findBySize(const char *pcPath, size_t ulMin, size_t ulMax,
+                  FT_Visitor_T pfVisit, void *pvExtra);
+
+/*
+  Finds the (at most) ulK largest files in the FT hierarchy rooted at
+  absolute path pcPath, expanding only directories whose largest file
+  could still rank. Stores their paths, largest first, in
+  ppcPaths[0..] and, if pulSizes is not NULL, their sizes in
+  pulSizes[0..]; both must have room for ulK entries. Sets *pulFound
+  to the number of files found. Each stored path is allocated, and
+  then owned by the client! Files of equal size are ranked
+  arbitrarily. Returns SUCCESS, or (setting *pulFound to 0):
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_topKLargest(const char *pcPath, size_t ulK, char **ppcPaths,
+                   size_t *pulSizes, size_t *pulFound);
+
+/*
+  Enables (if bEnable is TRUE) or disables the inverted indexes that
+  map every name, and every extension (the text after a name's last
+  '.', as in "so" for "libc.so"; names such as ".bashrc" have none), to
+  the nodes bearing it. Enabling builds the indexes from the current
+  tree in O(n) time; from then on they are kept up to date by every
+  insertion and removal, and FT_findByName and FT_findByExtension no
+  longer traverse the tree. The price is that removing a subtree then
+  takes time proportional to its size, to drop its entries, however
+  little time freeing it takes (see FT_rmDir). FT_destroy disables
+  the indexes. Returns
+  SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+                 (the indexes are then left disabled)
+*/
+int FT_setNameIndex(boolean bEnable);
+
+/*
+  Calls pfVisit(path, isFile, size, pvExtra) on every file or
+  directory in the FT whose last path component is exactly pcName, in
+  path order, until pfVisit returns non-zero. pfVisit must not change
+  the FT. Takes time proportional to the number of matches (times the
+  log of it, to sort them) when the name index is enabled, and a full
+  traversal otherwise. Returns SUCCESS (also when stopped by pfVisit),
+  or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_findByName(const char *pcName, FT_Visitor_T pfVisit,
+                  void *pvExtra);
+
+/*
+  Like FT_findByName, but visits the files and directories whose
+  extension is pcExtension, which may be given with or without its
+  leading '.'.
+*/
+int FT_findByExtension(const char *pcExtension, FT_Visitor_T pfVisit,
+                       void *pvExtra);
+
+/*
+  Enables (if bEnable is TRUE) or disables the substring index, which
+  files every node under each three-character substring (trigram) of
+  its name in compressed, sorted posting lists. Enabling builds the
+  index from the current tree; from then on it is kept up to date by
+  every insertion and removal, and FT_searchSubstring answers any
+  query with a piece of three or more characters (see there) from
+  the posting lists instead of testing every path. Like the name
+  indexes, it makes each removal take time proportional to the size
+  of the removed subtree. FT_destroy disables the index. Returns SUCCESS, or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+                 (the index is then left disabled)
+*/
+int FT_setSubstringIndex(boolean bEnable);
+
+/*
+  Calls pfVisit(path, isFile, size, pvExtra) on every file or
+  directory in the FT whose absolute path contains pcQuery, until
+  pfVisit returns non-zero. The shallowest matching paths are reported
+  in path order, each followed by the rest of its hierarchy
+  (all of which matches too) in pre-order. With the substring index
+  enabled, only nodes whose names hold every trigram of the longest
+  '/'-free piece of pcQuery are examined, so such a piece should have
+  at least three characters; shorter queries test every path.
+  Returns SUCCESS (also when stopped by pfVisit), or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_searchSubstring(const char *pcQuery, FT_Visitor_T pfVisit,
+                       void *pvExtra);
+
+/*
+  Range scans enumerate paths in path order: component by component,
+  each path directly followed by the hierarchy below it, and siblings
+  ordered by name. (This is strcmp order on whole paths unless names
+  contain characters that sort before '/'.) Flags for the scans:
+  * FT_SCAN_FILES, FT_SCAN_DIRS select the kinds of node to visit;
+    giving neither visits both
+  * FT_SCAN_AFTER_LO excludes the lower bound itself from the range
+  * FT_SCAN_THROUGH_HI includes the upper bound itself in the range
+*/
+enum { FT_SCAN_FILES = 1, FT_SCAN_DIRS = 2, FT_SCAN_AFTER_LO = 4,
+       FT_SCAN_THROUGH_HI = 8 };
+
+/* A resumable scan over a range of paths */
+typedef struct FT_RangeCursor *FT_RangeCursor_T;
+
+/*
+  Calls pfVisit(path, isFile, size, pvExtra) on every path in the FT
+  from pcLo (inclusive) up to pcHi (exclusive), as adjusted by iFlags,
+  in path order, until pfVisit returns non-zero. A NULL bound leaves
+  that end of the range open. Neither bound need exist in the FT: the
+  scan seeks to the first path in range with one binary search per
+  level of pcLo and stops at the first path past pcHi. pfVisit must
+  not change the FT. Returns SUCCESS (also when stopped by pfVisit),
+  or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if a bound does not represent a well-formatted path
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_scanRange(const char *pcLo, const char *pcHi, int iFlags,
+                 FT_Visitor_T pfVisit, void *pvExtra);
+
+/*
+  Opens a cursor over the range FT_scanRange(pcLo, pcHi, iFlags, ...)
+  would scan, and sets *poCursor to it. The cursor is owned by the
+  client, who must release it with FT_closeRange. Returns SUCCESS or,
+  setting *poCursor to NULL, the errors of FT_scanRange.
+*/
+int FT_openRange(const char *pcLo, const char *pcHi, int iFlags,
+                 FT_RangeCursor_T *poCursor);
+
+/*
+  Continues the scan of oCursor, visiting at most ulLimit more paths
+  as FT_scanRange would, and stopping early if pfVisit returns
+  non-zero. The cursor remembers the last path it reached and the
+  next call resumes just after it, with a fresh seek, so the FT may
+  be changed between calls. Returns SUCCESS or the errors of
+  FT_scanRange.
+*/
+int FT_continueRange(FT_RangeCursor_T oCursor, size_t ulLimit,
+                     FT_Visitor_T pfVisit, void *pvExtra);
+
+/* Returns TRUE once oCursor's scan has passed the end of its range. */
+boolean FT_isRangeDone(FT_RangeCursor_T oCursor);
+
+/* Releases oCursor, which may be NULL. */
+void FT_closeRange(FT_RangeCursor_T oCursor);
+
+/* One entry of a directory listing */
+struct FT_DirEntry {
+   /* the entry's name (final path component), which belongs to the
+      FT and is valid until the FT is next changed */
+   const char *pcName;
+   /* whether the entry is a file, and its size (0 for directories) */
+   boolean bIsFile;
+   size_t ulSize;
+};
+
+/*
+  Lists the children of the directory with absolute path pcPath in
+  order of name, starting just after name pcAfterName (from the first
+  child if pcAfterName is NULL; pcAfterName need not be a child). Fills
+  psOut[0..] with at most ulLimit entries and sets *pulFound to their
+  number. A page shorter than ulLimit is the last; to fetch the next
+  page, pass the name of the last entry returned as pcAfterName. Takes
+  O(log n + ulLimit) time beyond finding the directory, for n
+  children. Returns SUCCESS, or (setting *pulFound to 0):
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * NOT_A_DIRECTORY if pcPath is in the FT as a file not a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_listDir(const char *pcPath, const char *pcAfterName,
+               size_t ulLimit, struct FT_DirEntry *psOut,
+               size_t *pulFound);
+
+/* An open directory, read one entry at a time */
+typedef struct FT_DirIter *FT_DirIter_T;
+
+/*
+  Opens the directory with absolute path pcPath for reading with
+  FT_readDir, and sets *poIter to it. The iterator is owned by the
+  client, who must release it with FT_closeDir. Returns SUCCESS or,
+  setting *poIter to NULL, the errors of FT_listDir.
+*/
+int FT_openDir(const char *pcPath, FT_DirIter_T *poIter);
+
+/*
+  Sets *ppsEntry to the next child of oIter's directory in order of
+  name, or to NULL once all have been read. The entry and its name
+  belong to oIter and are valid until its next FT_readDir or
+  FT_closeDir, even if the FT changes. Children are fetched a page at
+  a time, so no memory is allocated per entry; a page is read from the
+  directory as it is when the page is fetched, resuming just after the
+  last name read. Returns SUCCESS or (setting *ppsEntry to NULL) the
+  errors of FT_listDir, e.g. if the directory has been removed.
+*/
+int FT_readDir(FT_DirIter_T oIter, const struct FT_DirEntry **ppsEntry);
+
+/* Releases oIter, which may be NULL. */
+void FT_closeDir(FT_DirIter_T oIter);
+
+/* Returned by a pre-order visitor of FT_walk to skip a subtree */
+enum { FT_WALK_SKIP = -1 };
+
+/*
+  Walks the subtree rooted at absolute path pcPath depth-first, with
+  siblings in order of name, calling pfPre(path, isFile, size,
+  pvExtra) on entering each node and pfPost(...) on leaving it; either
+  may be NULL. If pfPre returns FT_WALK_SKIP, the node's children and
+  its pfPost call are skipped; any other non-zero return from either
+  visitor stops the walk. The visitors must not change the FT. Uses
+  memory proportional to the depth of the subtree, not its size.
+  Returns SUCCESS (also when stopped by a visitor), or:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_walk(const char *pcPath, FT_Visitor_T pfPre, FT_Visitor_T pfPost,
+            void *pvExtra);
+
+/*
+  Order statistics over paths in path order (see the range scans
+  above), answered from per-node subtree counts in O(depth * log
+  fanout) time.
+*/
+
+/*
+  Sets *pulRank to the number of paths in the FT that come before
+  absolute path pcPath in path order (so the root's rank is 0).
+  Returns SUCCESS, or (leaving *pulRank unchanged):
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPath does not represent a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcPath
+  * NO_SUCH_PATH if absolute path pcPath does not exist in the FT
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_rank(const char *pcPath, size_t *pulRank);
+
+/*
+  Finds the path at 0-based position ulK, in path order, among the
+  paths strictly below the directory with absolute path pcDirPath, and
+  sets *ppcPath to a newly allocated copy of it, owned by the client.
+  Returns SUCCESS, or (setting *ppcPath to NULL) the errors of FT_rank
+  or:
+  * NO_SUCH_PATH also if ulK is not less than the number of paths
+                 below pcDirPath
+*/
+int FT_select(const char *pcDirPath, size_t ulK, char **ppcPath);
+
+/*
+  Sets *pulCount to the number of paths strictly below absolute path
+  pcPath (0 for a file). Returns SUCCESS, or the errors of FT_rank.
+*/
+int FT_countDescendants(const char *pcPath, size_t *pulCount);
+
+/* Number of buckets in each histogram of an FT_Analysis */
+enum { FT_HIST_BUCKETS = 65 };
+
+/*
+  A histogram of values sampled over a tree. On a logarithmic scale,
+  bucket 0 counts the values 0 and bucket b > 0 the values in
+  [2^(b-1), 2^b). On a linear scale, bucket b counts the value b, and
+  the last bucket also counts every larger value.
+*/
+struct FT_Histogram {
+   boolean bIsLogScale;
+   size_t aulCounts[FT_HIST_BUCKETS];
+   /* the number of samples, their sum, and the extreme values */
+   size_t ulSamples;
+   size_t ulSum;
+   size_t ulMin;
+   size_t ulMax;
+};
+
+/* A directory ranked in an FT_Analysis, and the value it ranks by */
+struct FT_RankedDir {
+   /* the directory's absolute path, owned by the analysis */
+   char *pcPath;
+   size_t ulValue;
+};
+
+/* The shape of an FT, as computed by FT_analyze */
+struct FT_Analysis {
+   size_t ulDirs;
+   size_t ulFiles;
+   /* children per directory (log scale) */
+   struct FT_Histogram sFanout;
+   /* depth of every node, the root being at depth 1 (linear) */
+   struct FT_Histogram sDepth;
+   /* length of every node's name (log scale) */
+   struct FT_Histogram sNameLength;
+   /* size of every file in bytes (log scale) */
+   struct FT_Histogram sFileSize;
+   /* share of files among the children of every non-empty directory,
+      in tenths rounded down, so bucket 10 is all files (linear) */
+   struct FT_Histogram sFileShare;
+   /* the (at most) ulTopN directories with the most children, and
+      the ulTopN deepest directories, best first and ties in path
+      order */
+   size_t ulTopN;
+   size_t ulWidest;
+   struct FT_RankedDir *psWidest;
+   size_t ulDeepest;
+   struct FT_RankedDir *psDeepest;
+};
+
+/*
+  Analyzes the shape of the FT in one pass over its nodes, keeping the
+  ulTopN widest and deepest directories, and sets *ppsAnalysis to the
+  newly allocated result, which the client must release with
+  FT_freeAnalysis. Every statistic is a sum or a bounded ranking, so
+  the pass can be split across subtrees. Returns SUCCESS, or (setting
+  *ppsAnalysis to NULL):
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_analyze(size_t ulTopN, struct FT_Analysis **ppsAnalysis);
+
+/* Releases psAnalysis, which may be NULL, and the paths it holds. */
+void FT_freeAnalysis(struct FT_Analysis *psAnalysis);
+
+/*
+  Sets *pulHash to the hash of the subtree rooted at absolute path
+  pcPath: of a file's contents, or of a directory's children's names
+  and hashes. The name of pcPath itself does not enter it, so a copy
+  made with FT_cp, or a subtree moved with FT_mv, hashes as the
+  original did. Every node keeps its hash, outdated along the parent
+  chain by each change and recomputed on demand, so this takes O(1)
+  time beyond finding pcPath if the subtree has not changed since the
+  last call, and two subtrees, or the whole FT and a hash taken of it
+  before, are equal (but for a 2^-64 chance of a collision) exactly
+  when their hashes are. Returns SUCCESS or the errors of FT_walk
+  but MEMORY_ERROR.
+*/
+int FT_getHash(const char *pcPath, size_t *pulHash);
+
+/* The kinds of differences reported by FT_diff */
+enum { FT_DIFF_ADDED, FT_DIFF_REMOVED, FT_DIFF_MODIFIED };
+
+/*
+  A visitor of FT_diff is called once per difference, with its kind,
+  one of the FT_DIFF values above, and the absolute path pcPath of the
+  entry on the side where it is found (the old side only for
+  FT_DIFF_REMOVED), valid only for the duration of the call, whether
+  it is a file, and the pvExtra given by the client. It returns 0 to
+  continue or non-zero to stop.
+*/
+typedef int (*FT_DiffVisitor_T)(int iChange, const char *pcPath,
+                                boolean bIsFile, void *pvExtra);
+
+/*
+  Compares the subtree rooted at absolute path pcOld with the one at
+  pcNew, such as a copy kept with FT_cp as a checkpoint and the tree
+  it was copied from, calling pfVisit for each difference in order of
+  name: an entry only under pcNew is FT_DIFF_ADDED and one only under
+  pcOld is FT_DIFF_REMOVED, with their subtrees (which are not
+  reported entry by entry); a file whose contents differ is
+  FT_DIFF_MODIFIED; a file that became a directory, or the other way
+  round, is removed and added. Subtrees with the same hash (see
+  FT_getHash) are skipped without being visited, so this takes time
+  proportional to the changed paths and the directories along them.
+  The visitor must not change the FT. Returns SUCCESS (also when
+  stopped by the visitor) or the errors of FT_walk.
+*/
+int FT_diff(const char *pcOld, const char *pcNew,
+            FT_DiffVisitor_T pfVisit, void *pvExtra);
+
 #endif
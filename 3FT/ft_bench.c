@@ -0,0 +1,539 @@
+/*--------------------------------------------------------------------*/
+/* ft_bench.c                                                         */
+/* Author: Helenia                                                    */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include "ft.h"
+
+/*
+  Benchmarks for the FT. Each benchmark is selected by name on the
+  command line, optionally followed by a size parameter, and prints
+  one line per measurement to stdout. Build with NDEBUG (as the
+  Makefile's ftbench target does): the checker's whole-tree
+  validation would otherwise dominate every measurement.
+*/
+
+/* Returns the processor time used so far, in seconds. */
+static double seconds(void) {
+   return (double) clock() / CLOCKS_PER_SEC;
+}
+
+/* Returns the wall-clock time, in seconds, for benchmarks running
+   threads, whose processor time is summed over all of them. */
+static double wallSeconds(void) {
+   struct timeval sNow;
+
+   (void) gettimeofday(&sNow, NULL);
+   return sNow.tv_sec + sNow.tv_usec / 1e6;
+}
+
+/*
+  Builds a tree under "root" with ulDirs project directories, each
+  holding ulFiles files in each of src, src/sub and doc.
+*/
+static void buildTree(size_t ulDirs, size_t ulFiles) {
+   char acPath[128];
+   size_t i, j;
+   int iStatus;
+
+   iStatus = FT_init();
+   assert(iStatus == SUCCESS);
+   for(i = 0; i < ulDirs; i++) {
+      for(j = 0; j < ulFiles; j++) {
+         sprintf(acPath, "root/d%lu/src/f%lu.c", (unsigned long) i,
+                 (unsigned long) j);
+         iStatus = FT_insertFile(acPath, acPath, strlen(acPath));
+         assert(iStatus == SUCCESS);
+         sprintf(acPath, "root/d%lu/src/sub/f%lu.h", (unsigned long) i,
+                 (unsigned long) j);
+         iStatus = FT_insertFile(acPath, acPath, strlen(acPath));
+         assert(iStatus == SUCCESS);
+         sprintf(acPath, "root/d%lu/doc/f%lu.txt", (unsigned long) i,
+                 (unsigned long) j);
+         iStatus = FT_insertFile(acPath, acPath, strlen(acPath));
+         assert(iStatus == SUCCESS);
+      }
+   }
+   (void) iStatus;
+}
+
+/* Visitor counting visited paths in the size_t at pvExtra. */
+static int countPath(const char *pcPath, boolean bIsFile,
+                     size_t ulSize, void *pvExtra) {
+   (*(size_t *) pvExtra)++;
+   return 0;
+}
+
+/*
+  Counts the lines of FT_toString's output that match pcPattern
+  (which must not use "**"), the way clients filtered before FT_glob.
+*/
+static size_t filterToString(const char *pcPattern) {
+   char *pcAll = FT_toString();
+   char *pcLine;
+   size_t ulMatches = 0;
+
+   assert(pcAll != NULL);
+   for(pcLine = strtok(pcAll, "\n"); pcLine != NULL;
+       pcLine = strtok(NULL, "\n"))
+      if(fnmatch(pcPattern, pcLine, FNM_PATHNAME) == 0)
+         ulMatches++;
+   free(pcAll);
+   return ulMatches;
+}
+
+/* Compares FT_glob with toString-and-filter on a tree of ulDirs
+   project directories. */
+static void benchGlob(size_t ulDirs) {
+   static const char *apcPatterns[] = {
+      "root/*/src/*.c", "root/d7/src/*.c", "root/d7*/doc/f1*"
+   };
+   size_t i;
+
+   buildTree(ulDirs, 20);
+   for(i = 0; i < sizeof(apcPatterns) / sizeof(apcPatterns[0]); i++) {
+      size_t ulGlob = 0;
+      size_t ulFilter;
+      double dStart, dGlob, dFilter;
+
+      dStart = seconds();
+      (void) FT_glob(apcPatterns[i], countPath, &ulGlob);
+      dGlob = seconds() - dStart;
+
+      dStart = seconds();
+      ulFilter = filterToString(apcPatterns[i]);
+      dFilter = seconds() - dStart;
+
+      printf("glob %-18s %7lu/%lu matches  glob %.4fs  "
+             "toString+filter %.4fs\n", apcPatterns[i],
+             (unsigned long) ulGlob, (unsigned long) ulFilter, dGlob,
+             dFilter);
+   }
+   (void) FT_destroy();
+}
+
+/* Counts the lines of FT_toString's output that contain pcQuery. */
+static size_t scanToString(const char *pcQuery) {
+   char *pcAll = FT_toString();
+   char *pcLine;
+   size_t ulMatches = 0;
+
+   assert(pcAll != NULL);
+   for(pcLine = strtok(pcAll, "\n"); pcLine != NULL;
+       pcLine = strtok(NULL, "\n"))
+      if(strstr(pcLine, pcQuery) != NULL)
+         ulMatches++;
+   free(pcAll);
+   return ulMatches;
+}
+
+/* Compares FT_searchSubstring, with and without the substring index,
+   with scanning FT_toString on a tree of ulDirs project directories,
+   before and after removing most of the tree. */
+static void benchSubstring(size_t ulDirs) {
+   static const char *apcQueries[] = {
+      "d7/src", "sub/f1", "f19.txt", "d42"
+   };
+   char acPath[32];
+   size_t i, j;
+
+   buildTree(ulDirs, 20);
+   for(j = 0; j < 2; j++) {
+      for(i = 0; i < sizeof(apcQueries) / sizeof(apcQueries[0]); i++) {
+         size_t ulScan = 0;
+         size_t ulIndexed = 0;
+         size_t ulToString;
+         double dStart, dScan, dIndexed, dToString;
+
+         (void) FT_setSubstringIndex(FALSE);
+         dStart = seconds();
+         (void) FT_searchSubstring(apcQueries[i], countPath, &ulScan);
+         dScan = seconds() - dStart;
+
+         dStart = seconds();
+         (void) FT_setSubstringIndex(TRUE);
+         dIndexed = seconds() - dStart;
+         if(i == 0)
+            printf("substring index built in %.4fs\n", dIndexed);
+
+         dStart = seconds();
+         (void) FT_searchSubstring(apcQueries[i], countPath, &ulIndexed);
+         dIndexed = seconds() - dStart;
+
+         dStart = seconds();
+         ulToString = scanToString(apcQueries[i]);
+         dToString = seconds() - dStart;
+
+         printf("substring %-8s %6lu/%lu/%lu matches  indexed %.5fs  "
+                "scan %.5fs  toString %.4fs\n", apcQueries[i],
+                (unsigned long) ulIndexed, (unsigned long) ulScan,
+                (unsigned long) ulToString, dIndexed, dScan, dToString);
+      }
+
+      /* removals leave dead postings until the index compacts */
+      if(j == 0) {
+         for(i = 0; i < ulDirs; i += 2) {
+            sprintf(acPath, "root/d%lu", (unsigned long) i);
+            (void) FT_rmDir(acPath);
+         }
+         printf("removed every other project directory\n");
+      }
+   }
+   (void) FT_destroy();
+}
+
+/* Pages through a directory of ulEntries files with FT_listDir, and
+   fetches single pages from its start, middle and end. */
+static void benchListDir(size_t ulEntries) {
+   struct FT_DirEntry asPage[1000];
+   char acName[32];
+   size_t i, ulFound, ulPages = 0, ulTotal = 0;
+   const char *pcAfter = NULL;
+   double dStart, dAll;
+   int iStatus;
+
+   iStatus = FT_init();
+   assert(iStatus == SUCCESS);
+   for(i = 0; i < ulEntries; i++) {
+      sprintf(acName, "root/big/e%09lu", (unsigned long) i);
+      iStatus = FT_insertFile(acName, NULL, 0);
+      assert(iStatus == SUCCESS);
+   }
+
+   dStart = seconds();
+   do {
+      iStatus = FT_listDir("root/big", pcAfter, 1000, asPage, &ulFound);
+      assert(iStatus == SUCCESS);
+      ulTotal += ulFound;
+      ulPages++;
+      if(ulFound > 0)
+         pcAfter = asPage[ulFound - 1].pcName;
+   } while(ulFound == 1000);
+   dAll = seconds() - dStart;
+   printf("listDir %lu entries in %lu pages of 1000: %.4fs "
+          "(%.2fus/page)\n", (unsigned long) ulTotal,
+          (unsigned long) ulPages, dAll, 1e6 * dAll / ulPages);
+
+   for(i = 0; i < 3; i++) {
+      size_t ulAt = i * (ulEntries / 2);
+      int j;
+      sprintf(acName, "e%09lu", (unsigned long) ulAt);
+      dStart = seconds();
+      for(j = 0; j < 1000; j++)
+         (void) FT_listDir("root/big", acName, 100, asPage, &ulFound);
+      printf("listDir page of 100 after entry %lu: %.2fus\n",
+             (unsigned long) ulAt, 1e3 * (seconds() - dStart));
+   }
+   (void) iStatus;
+   (void) FT_destroy();
+}
+
+/* Prints the non-empty buckets of psHistogram, labelled pcName. */
+static void printHistogram(const char *pcName,
+                           const struct FT_Histogram *psHistogram) {
+   size_t ulBucket;
+
+   printf("%s: %lu samples, min %lu, max %lu, mean %.2f\n", pcName,
+          (unsigned long) psHistogram->ulSamples,
+          (unsigned long) psHistogram->ulMin,
+          (unsigned long) psHistogram->ulMax,
+          psHistogram->ulSamples == 0 ? 0.0 :
+             (double) psHistogram->ulSum / psHistogram->ulSamples);
+   for(ulBucket = 0; ulBucket < FT_HIST_BUCKETS; ulBucket++) {
+      if(psHistogram->aulCounts[ulBucket] == 0)
+         continue;
+      if(psHistogram->bIsLogScale && ulBucket > 0)
+         printf("  [%lu, %lu): %lu\n",
+                (unsigned long) 1 << (ulBucket - 1),
+                (unsigned long) 1 << ulBucket,
+                (unsigned long) psHistogram->aulCounts[ulBucket]);
+      else
+         printf("  %lu: %lu\n", (unsigned long) ulBucket,
+                (unsigned long) psHistogram->aulCounts[ulBucket]);
+   }
+}
+
+/* Times FT_analyze on a tree of ulDirs project directories and prints
+   its report. */
+static void benchAnalyze(size_t ulDirs) {
+   struct FT_Analysis *psShape;
+   double dStart;
+   size_t i;
+   int iStatus;
+
+   buildTree(ulDirs, 20);
+   dStart = seconds();
+   iStatus = FT_analyze(5, &psShape);
+   assert(iStatus == SUCCESS);
+   printf("analyze %lu dirs, %lu files: %.4fs\n",
+          (unsigned long) psShape->ulDirs,
+          (unsigned long) psShape->ulFiles, seconds() - dStart);
+   printHistogram("fanout", &psShape->sFanout);
+   printHistogram("depth", &psShape->sDepth);
+   printHistogram("name length", &psShape->sNameLength);
+   printHistogram("file size", &psShape->sFileSize);
+   printHistogram("file share (tenths)", &psShape->sFileShare);
+   for(i = 0; i < psShape->ulWidest; i++)
+      printf("widest %lu: %s (%lu)\n", (unsigned long) i,
+             psShape->psWidest[i].pcPath,
+             (unsigned long) psShape->psWidest[i].ulValue);
+   for(i = 0; i < psShape->ulDeepest; i++)
+      printf("deepest %lu: %s (%lu)\n", (unsigned long) i,
+             psShape->psDeepest[i].pcPath,
+             (unsigned long) psShape->psDeepest[i].ulValue);
+   FT_freeAnalysis(psShape);
+   (void) iStatus;
+   (void) FT_destroy();
+}
+
+/* Reports the time of the populating function since dStart, checking
+   that all ulFiles entries in aiResults succeeded and that the FT
+   holds the files and their 64 + 4096 directories, then empties it. */
+static void reportBuild(const char *pcHow, double dStart, size_t ulFiles,
+                        const int *aiResults) {
+   double dAll = wallSeconds() - dStart;
+   size_t ulCount, i;
+   int iStatus;
+
+   for(i = 0; i < ulFiles; i++)
+      assert(aiResults == NULL || aiResults[i] == SUCCESS);
+   iStatus = FT_countDescendants("root", &ulCount);
+   assert(iStatus == SUCCESS);
+   assert(ulCount == ulFiles + 64 + 4096);
+   printf("%s: %lu files in %.4fs (%.3fus/file)\n", pcHow,
+          (unsigned long) ulFiles, dAll, 1e6 * dAll / ulFiles);
+   (void) iStatus;
+   (void) FT_destroy();
+}
+
+/*
+  Returns a sorted manifest of ulFiles files, at least 4096, spread
+  evenly over 64 top-level directories of 64 directories each, whose
+  paths are in *ppcPaths. The client frees both.
+*/
+static struct FT_InsertEntry *makeManifest(size_t ulFiles,
+                                           char **ppcPaths) {
+   struct FT_InsertEntry *psEntries;
+   char *pcPaths;
+   size_t i;
+
+   psEntries = malloc(ulFiles * sizeof(struct FT_InsertEntry));
+   pcPaths = malloc(ulFiles * 32);
+   assert(psEntries != NULL && pcPaths != NULL);
+   for(i = 0; i < ulFiles; i++) {
+      /* file i goes in directory i / ulFiles of the 4096, in order */
+      size_t ulDir = (size_t) ((double) i / ulFiles * 4096);
+      sprintf(pcPaths + 32 * i, "root/t%02lu/d%02lu/f%09lu",
+              (unsigned long) (ulDir / 64), (unsigned long) (ulDir % 64),
+              (unsigned long) i);
+      psEntries[i].pcPath = pcPaths + 32 * i;
+      psEntries[i].bIsFile = TRUE;
+      psEntries[i].pvContents = pcPaths + 32 * i;
+      psEntries[i].ulLength = 8;
+   }
+   *ppcPaths = pcPaths;
+   return psEntries;
+}
+
+/*
+  Populates an empty FT from the manifest of makeManifest(ulFiles):
+  one at a time, with FT_insertBatch, and with FT_bulkBuild on 2 to 16
+  threads.
+*/
+static void benchBuild(size_t ulFiles) {
+   struct FT_InsertEntry *psEntries;
+   char *pcPaths;
+   int *aiResults;
+   size_t i, ulThreads;
+   double dStart;
+   char acHow[32];
+   int iStatus;
+
+   psEntries = makeManifest(ulFiles, &pcPaths);
+   aiResults = malloc(ulFiles * sizeof(int));
+   assert(aiResults != NULL);
+
+   iStatus = FT_init();
+   assert(iStatus == SUCCESS);
+   dStart = wallSeconds();
+   for(i = 0; i < ulFiles; i++)
+      if(FT_insertFile(psEntries[i].pcPath, psEntries[i].pvContents,
+                       psEntries[i].ulLength) != SUCCESS)
+         assert(FALSE);
+   reportBuild("one at a time", dStart, ulFiles, NULL);
+
+   iStatus = FT_init();
+   assert(iStatus == SUCCESS);
+   dStart = wallSeconds();
+   iStatus = FT_insertBatch(psEntries, ulFiles, aiResults);
+   assert(iStatus == SUCCESS);
+   reportBuild("insertBatch", dStart, ulFiles, aiResults);
+
+   for(ulThreads = 2; ulThreads <= 16; ulThreads *= 2) {
+      iStatus = FT_init();
+      assert(iStatus == SUCCESS);
+      dStart = wallSeconds();
+      iStatus = FT_bulkBuild(psEntries, ulFiles, ulThreads, aiResults);
+      assert(iStatus == SUCCESS);
+      sprintf(acHow, "bulkBuild, %lu threads", (unsigned long) ulThreads);
+      reportBuild(acHow, dStart, ulFiles, aiResults);
+   }
+
+   free(psEntries);
+   free(pcPaths);
+   free(aiResults);
+   (void) iStatus;
+}
+
+/*
+  Serializes an FT holding the manifest of makeManifest(ulFiles) with
+  FT_toStringParallel on 1 to 32 threads, checking that each gives the
+  string that 1 thread gives, then streams it with FT_writeTo.
+*/
+static void benchToString(size_t ulFiles) {
+   struct FT_InsertEntry *psEntries;
+   char *pcPaths;
+   int *aiResults;
+   char *pcFirst = NULL;
+   size_t ulThreads;
+   double dStart, dAll;
+   int iFd;
+   int iStatus;
+
+   psEntries = makeManifest(ulFiles, &pcPaths);
+   aiResults = malloc(ulFiles * sizeof(int));
+   assert(aiResults != NULL);
+   iStatus = FT_init();
+   assert(iStatus == SUCCESS);
+   iStatus = FT_bulkBuild(psEntries, ulFiles, 4, aiResults);
+   assert(iStatus == SUCCESS);
+   free(psEntries);
+   free(pcPaths);
+   free(aiResults);
+
+   for(ulThreads = 1; ulThreads <= 32; ulThreads *= 2) {
+      char *pcResult;
+      dStart = wallSeconds();
+      pcResult = FT_toStringParallel(ulThreads);
+      dAll = wallSeconds() - dStart;
+      assert(pcResult != NULL);
+      if(pcFirst == NULL)
+         pcFirst = pcResult;
+      else {
+         assert(!strcmp(pcResult, pcFirst));
+         free(pcResult);
+      }
+      printf("toStringParallel, %2lu threads: %lu bytes in %.4fs\n",
+             (unsigned long) ulThreads, (unsigned long) strlen(pcFirst),
+             dAll);
+   }
+
+   /* the same output streamed without building it */
+   iFd = open("/dev/null", O_WRONLY);
+   assert(iFd >= 0);
+   dStart = wallSeconds();
+   iStatus = FT_writeTo(iFd);
+   dAll = wallSeconds() - dStart;
+   assert(iStatus == SUCCESS);
+   (void) close(iFd);
+   printf("writeTo /dev/null: %lu bytes in %.4fs\n",
+          (unsigned long) strlen(pcFirst), dAll);
+
+   free(pcFirst);
+   (void) FT_destroy();
+   (void) iStatus;
+}
+
+/*
+  Serializes FTs holding the manifests of makeManifest for 10000 files
+  and ten times as many each step up to ulMax, with FT_toString and
+  FT_toStringInto, reporting the time per byte, which stays flat as
+  the FT grows.
+*/
+static void benchSerialize(size_t ulMax) {
+   size_t ulFiles;
+
+   for(ulFiles = 10000; ulFiles <= ulMax; ulFiles *= 10) {
+      struct FT_InsertEntry *psEntries;
+      char *pcPaths;
+      int *aiResults;
+      char *pcResult;
+      size_t ulLength;
+      double dStart, dString, dInto;
+      int iStatus;
+
+      psEntries = makeManifest(ulFiles, &pcPaths);
+      aiResults = malloc(ulFiles * sizeof(int));
+      assert(aiResults != NULL);
+      iStatus = FT_init();
+      assert(iStatus == SUCCESS);
+      iStatus = FT_bulkBuild(psEntries, ulFiles, 4, aiResults);
+      assert(iStatus == SUCCESS);
+      free(psEntries);
+      free(pcPaths);
+      free(aiResults);
+
+      dStart = wallSeconds();
+      pcResult = FT_toString();
+      dString = wallSeconds() - dStart;
+      assert(pcResult != NULL);
+      ulLength = strlen(pcResult);
+
+      dStart = wallSeconds();
+      iStatus = FT_toStringInto(pcResult, ulLength + 1, &ulLength);
+      dInto = wallSeconds() - dStart;
+      assert(iStatus == SUCCESS);
+
+      printf("%9lu nodes, %10lu bytes: toString %.4fs (%.2fns/byte), "
+             "toStringInto %.4fs (%.2fns/byte)\n",
+             (unsigned long) (ulFiles + 64 + 4096 + 1),
+             (unsigned long) ulLength, dString, 1e9 * dString / ulLength,
+             dInto, 1e9 * dInto / ulLength);
+      free(pcResult);
+      (void) FT_destroy();
+      (void) iStatus;
+   }
+}
+
+/* Runs the benchmark named by argv[1], sized by argv[2] if given. */
+int main(int argc, char *argv[]) {
+   size_t ulSize = 0;
+
+   if(argc < 2) {
+      fprintf(stderr, "usage: %s glob|substring|listdir|analyze|build|"
+              "tostring|serialize [size]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+   if(argc > 2)
+      ulSize = (size_t) strtoul(argv[2], NULL, 10);
+
+   if(!strcmp(argv[1], "glob"))
+      benchGlob(ulSize != 0 ? ulSize : 500);
+   else if(!strcmp(argv[1], "substring"))
+      benchSubstring(ulSize != 0 ? ulSize : 500);
+   else if(!strcmp(argv[1], "listdir"))
+      benchListDir(ulSize != 0 ? ulSize : 2000000);
+   else if(!strcmp(argv[1], "analyze"))
+      benchAnalyze(ulSize != 0 ? ulSize : 20000);
+   else if(!strcmp(argv[1], "build"))
+      benchBuild(ulSize != 0 ? ulSize : 1000000);
+   else if(!strcmp(argv[1], "tostring"))
+      benchToString(ulSize != 0 ? ulSize : 1000000);
+   else if(!strcmp(argv[1], "serialize"))
+      benchSerialize(ulSize != 0 ? ulSize : 10000000);
+   else {
+      fprintf(stderr, "%s: unknown benchmark %s\n", argv[0], argv[1]);
+      return EXIT_FAILURE;
+   }
+   return 0;
+}
@@ -8,8 +8,484 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "ft.h"
 
+/* Visitor appending each visited path and a newline to the string
+   buffer pvExtra. Always continues. */
+static int appendPath(const char *pcPath, boolean bIsFile,
+                      size_t ulSize, void *pvExtra) {
+  strcat((char *) pvExtra, pcPath);
+  strcat((char *) pvExtra, "\n");
+  return 0;
+}
+
+/* Visitor that stops the enumeration after the first path. */
+static int stopAtFirst(const char *pcPath, boolean bIsFile,
+                       size_t ulSize, void *pvExtra) {
+  (*(size_t *) pvExtra)++;
+  return 1;
+}
+
+/* Pre-order visitor appending "<", the path and a newline to the
+   string buffer pvExtra, and skipping directories named CHILD2DIR. */
+static int enterPath(const char *pcPath, boolean bIsFile,
+                     size_t ulSize, void *pvExtra) {
+  strcat((char *) pvExtra, "<");
+  strcat((char *) pvExtra, pcPath);
+  strcat((char *) pvExtra, "\n");
+  if(strlen(pcPath) >= 10 &&
+     !strcmp(pcPath + strlen(pcPath) - 10, "/CHILD2DIR"))
+    return FT_WALK_SKIP;
+  return 0;
+}
+
+/* Post-order visitor appending ">", the path and a newline to the
+   string buffer pvExtra. Always continues. */
+static int leavePath(const char *pcPath, boolean bIsFile,
+                     size_t ulSize, void *pvExtra) {
+  strcat((char *) pvExtra, ">");
+  strcat((char *) pvExtra, pcPath);
+  strcat((char *) pvExtra, "\n");
+  return 0;
+}
+
+/*
+  Checks that inserting the ulEntries entries at psEntries with
+  FT_insertBatch, or with FT_bulkBuild on 3 threads, gives the results
+  and the FT that inserting them one at a time gives, and that a
+  transaction aborts each insertion.
+*/
+static void checkBatch(const struct FT_InsertEntry *psEntries,
+                       size_t ulEntries) {
+  int aiBatch[16], aiBulk[16], aiSingle[16];
+  char *pcBefore, *pcBatch, *pcBulk, *pcSingle, *pcAfter;
+  size_t i;
+
+  assert(ulEntries <= 16);
+  pcBefore = FT_toString();
+  assert(pcBefore != NULL);
+  assert(FT_begin() == SUCCESS);
+  assert(FT_insertBatch(psEntries, ulEntries, aiBatch) == SUCCESS);
+  assert((pcBatch = FT_toString()) != NULL);
+  assert(FT_abort() == SUCCESS);
+  assert(FT_begin() == SUCCESS);
+  assert(FT_bulkBuild(psEntries, ulEntries, 3, aiBulk) == SUCCESS);
+  assert((pcBulk = FT_toString()) != NULL);
+  assert(FT_abort() == SUCCESS);
+  assert(FT_begin() == SUCCESS);
+  for(i = 0; i < ulEntries; i++)
+    if(psEntries[i].bIsFile)
+      aiSingle[i] = FT_insertFile(psEntries[i].pcPath,
+                                  psEntries[i].pvContents,
+                                  psEntries[i].ulLength);
+    else
+      aiSingle[i] = FT_insertDir(psEntries[i].pcPath);
+  assert((pcSingle = FT_toString()) != NULL);
+  assert(FT_abort() == SUCCESS);
+  assert((pcAfter = FT_toString()) != NULL);
+
+  for(i = 0; i < ulEntries; i++)
+    assert(aiBatch[i] == aiSingle[i] && aiBulk[i] == aiSingle[i]);
+  assert(!strcmp(pcBatch, pcSingle));
+  assert(!strcmp(pcBulk, pcSingle));
+  assert(!strcmp(pcBefore, pcAfter));
+  free(pcBefore);
+  free(pcBatch);
+  free(pcBulk);
+  free(pcSingle);
+  free(pcAfter);
+}
+
+/* Checks that FT_toStringParallel gives the string FT_toString gives
+   on 1, 3 and 32 threads, and that FT_toStringInto gives it in a
+   buffer just large enough but not in one a byte smaller. */
+static void checkToStrings(void) {
+  char *pcSerial, *pcOther;
+  size_t ulThreads, ulLength;
+
+  assert((pcSerial = FT_toString()) != NULL);
+  for(ulThreads = 1; ulThreads <= 32; ulThreads = 3 * ulThreads + 2) {
+    assert((pcOther = FT_toStringParallel(ulThreads)) != NULL);
+    assert(!strcmp(pcSerial, pcOther));
+    free(pcOther);
+  }
+
+  assert(FT_toStringInto(NULL, 0, &ulLength) == MEMORY_ERROR);
+  assert(ulLength == strlen(pcSerial));
+  assert((pcOther = malloc(ulLength + 1)) != NULL);
+  memset(pcOther, 'x', ulLength + 1);
+  assert(FT_toStringInto(pcOther, ulLength, &ulLength) == MEMORY_ERROR);
+  assert(pcOther[0] == 'x');
+  assert(FT_toStringInto(pcOther, ulLength + 1, &ulLength) == SUCCESS);
+  assert(!strcmp(pcSerial, pcOther));
+  free(pcOther);
+  free(pcSerial);
+}
+
+/* Diff visitor appending "+", "-" or "~" for an added, removed or
+   modified entry, its path and a newline to the string buffer pvExtra.
+   Always continues. */
+static int appendDiff(int iChange, const char *pcPath, boolean bIsFile,
+                      void *pvExtra) {
+  strcat((char *) pvExtra, iChange == FT_DIFF_ADDED ? "+" :
+                           iChange == FT_DIFF_REMOVED ? "-" : "~");
+  strcat((char *) pvExtra, pcPath);
+  strcat((char *) pvExtra, "\n");
+  return 0;
+}
+
+/* Diff visitor counting differences in *(size_t *) pvExtra, and
+   stopping at the first. */
+static int stopAtDiff(int iChange, const char *pcPath, boolean bIsFile,
+                      void *pvExtra) {
+  (*(size_t *) pvExtra)++;
+  return 1;
+}
+
+/* Writer appending the ulLength bytes at pvBytes to the string at
+   *(char **) pvExtra, reallocating it. Fails if it cannot grow it. */
+static int appendBytes(const void *pvBytes, size_t ulLength,
+                       void *pvExtra) {
+  char **ppcOut = pvExtra;
+  size_t ulOld = strlen(*ppcOut);
+  char *pcNew = realloc(*ppcOut, ulOld + ulLength + 1);
+  if(pcNew == NULL)
+    return 1;
+  memcpy(pcNew + ulOld, pvBytes, ulLength);
+  pcNew[ulOld + ulLength] = '\0';
+  *ppcOut = pcNew;
+  return 0;
+}
+
+/* Writer that always fails. */
+static int failBytes(const void *pvBytes, size_t ulLength,
+                     void *pvExtra) {
+  return 1;
+}
+
+/* The read end of a pipe, drained into the ulCap bytes at pcOut, and
+   the number of bytes read, including any that did not fit */
+struct PipeReader {
+  int iFd;
+  char *pcOut;
+  size_t ulCap;
+  size_t ulRead;
+};
+
+/* Thread reading the pipe of the PipeReader pvReader to its end, so
+   that a writer never blocks on a full pipe. */
+static void *readPipe(void *pvReader) {
+  struct PipeReader *psReader = pvReader;
+  char acSpill[512];
+  ssize_t lRead;
+
+  do {
+    if(psReader->ulRead < psReader->ulCap)
+      lRead = read(psReader->iFd, psReader->pcOut + psReader->ulRead,
+                   psReader->ulCap - psReader->ulRead);
+    else
+      lRead = read(psReader->iFd, acSpill, sizeof(acSpill));
+    if(lRead > 0)
+      psReader->ulRead += (size_t) lRead;
+  } while(lRead > 0);
+  return NULL;
+}
+
+/* Checks that FT_writeTo a pipe, FT_writeToFile and FT_writeWith each
+   write what FT_toString returns. The pipe is read on another thread,
+   so the string may be larger than a pipe holds. */
+static void checkWriteTo(void) {
+  char *pcExpected, *pcOut;
+  size_t ulLength;
+  int aiPipe[2];
+  pthread_t tReader;
+  struct PipeReader sReader;
+  FILE *psFile;
+
+  assert((pcExpected = FT_toString()) != NULL);
+  ulLength = strlen(pcExpected);
+  assert((pcOut = malloc(ulLength + 2)) != NULL);
+
+  assert(pipe(aiPipe) == 0);
+  sReader.iFd = aiPipe[0];
+  sReader.pcOut = pcOut;
+  sReader.ulCap = ulLength + 1;
+  sReader.ulRead = 0;
+  assert(pthread_create(&tReader, NULL, readPipe, &sReader) == 0);
+  assert(FT_writeTo(aiPipe[1]) == SUCCESS);
+  assert(close(aiPipe[1]) == 0);
+  assert(pthread_join(tReader, NULL) == 0);
+  assert(close(aiPipe[0]) == 0);
+  assert(sReader.ulRead == ulLength &&
+         !memcmp(pcOut, pcExpected, ulLength));
+
+  assert((psFile = tmpfile()) != NULL);
+  assert(FT_writeToFile(psFile) == SUCCESS);
+  rewind(psFile);
+  assert(fread(pcOut, 1, ulLength + 1, psFile) == ulLength);
+  assert(!memcmp(pcOut, pcExpected, ulLength));
+  assert(fclose(psFile) == 0);
+
+  pcOut[0] = '\0';
+  assert(FT_writeWith(appendBytes, &pcOut) == SUCCESS);
+  assert(!strcmp(pcOut, pcExpected));
+  assert(FT_writeWith(failBytes, NULL) ==
+         (ulLength > 0 ? IO_ERROR : SUCCESS));
+  free(pcOut);
+  free(pcExpected);
+}
+
+/* Checks that FT_toString and FT_toStringInto, with the string cache
+   enabled, give the string FT_toStringParallel builds afresh. */
+static void checkCachedString(void) {
+  char *pcCached, *pcFresh;
+  size_t ulLength;
+
+  assert((pcCached = FT_toString()) != NULL);
+  assert((pcFresh = FT_toStringParallel(1)) != NULL);
+  assert(!strcmp(pcCached, pcFresh));
+  assert(FT_toStringInto(pcCached, strlen(pcFresh) + 1, &ulLength) ==
+         SUCCESS);
+  assert(!strcmp(pcCached, pcFresh));
+  free(pcCached);
+  free(pcFresh);
+}
+
+/*
+  Checks the string cache over changes to a subtree 1root/cache of
+  about 90KB, whose directories d0 to d7 cache their lines, and after
+  which 1root/cache is removed.
+*/
+static void checkStringCache(void) {
+  char acPath[200];
+  size_t i, j;
+
+  assert(FT_setStringCache(TRUE) == SUCCESS);
+  checkCachedString();
+  for(i = 0; i < 8; i++)
+    for(j = 0; j < 80; j++) {
+      sprintf(acPath, "1root/cache/d%lu/", (unsigned long) i);
+      memset(acPath + strlen(acPath), 'c', 120);
+      sprintf(acPath + 133, "%lu", (unsigned long) j);
+      assert(FT_insertFile(acPath, NULL, 0) == SUCCESS);
+    }
+  checkCachedString();
+  checkWriteTo();
+  checkCachedString();
+
+  /* changes below a directory, and moves of it, outdate its lines */
+  assert(FT_insertFile("1root/cache/d3/new", NULL, 0) == SUCCESS);
+  checkCachedString();
+  assert(FT_rmFile("1root/cache/d3/new") == SUCCESS);
+  checkCachedString();
+  assert(FT_mv("1root/cache/d2", "1root/cache/e2") == SUCCESS);
+  checkCachedString();
+  assert(FT_mv("1root/cache/e2", "1root/cache/d2") == SUCCESS);
+  checkCachedString();
+  assert(FT_mv("1root/cache/d5", "1root/cache/d6/d5") == SUCCESS);
+  checkCachedString();
+  assert(FT_insertDir("1root/cache/d6/d5/sub") == SUCCESS);
+  checkCachedString();
+
+  /* as the subtree shrinks, 1root comes to cache all of its lines */
+  for(i = 0; i < 8; i++) {
+    sprintf(acPath, "1root/cache/d%lu", (unsigned long) i);
+    if(i != 5)
+      assert(FT_rmDir(acPath) == SUCCESS);
+    checkCachedString();
+  }
+  assert(FT_rmDir("1root/cache") == SUCCESS);
+  checkCachedString();
+  assert(FT_setStringCache(FALSE) == SUCCESS);
+  checkCachedString();
+}
+
+/* Removes the file or directory at pcPath as FT_rmFile or FT_rmDir
+   would. Returns their status. */
+static int rmPath(const char *pcPath) {
+  int iStatus = FT_rmFile(pcPath);
+  if(iStatus == NOT_A_FILE)
+    iStatus = FT_rmDir(pcPath);
+  return iStatus;
+}
+
+/*
+  Checks that removing the ulPaths paths at ppcPaths with FT_rmBatch
+  gives the results and the FT that removing them one at a time gives,
+  and that a transaction aborts either removal.
+*/
+static void checkRmBatch(const char **ppcPaths, size_t ulPaths) {
+  int aiBatch[16], aiSingle[16];
+  char *pcBefore, *pcBatch, *pcSingle, *pcAfter;
+  size_t i;
+
+  assert(ulPaths <= 16);
+  assert((pcBefore = FT_toString()) != NULL);
+  assert(FT_begin() == SUCCESS);
+  assert(FT_rmBatch(ppcPaths, ulPaths, aiBatch) == SUCCESS);
+  assert((pcBatch = FT_toString()) != NULL);
+  assert(FT_abort() == SUCCESS);
+  assert(FT_begin() == SUCCESS);
+  for(i = 0; i < ulPaths; i++)
+    aiSingle[i] = rmPath(ppcPaths[i]);
+  assert((pcSingle = FT_toString()) != NULL);
+  assert(FT_abort() == SUCCESS);
+  assert((pcAfter = FT_toString()) != NULL);
+
+  for(i = 0; i < ulPaths; i++)
+    assert(aiBatch[i] == aiSingle[i]);
+  assert(!strcmp(pcBatch, pcSingle));
+  assert(!strcmp(pcBefore, pcAfter));
+  free(pcBefore);
+  free(pcBatch);
+  free(pcSingle);
+  free(pcAfter);
+}
+
+/* Visitor checking that the visited paths come in rank order, and
+   that selecting each one's rank below the root finds it again. The
+   size_t at pvExtra counts the paths visited. */
+static int checkRank(const char *pcPath, boolean bIsFile,
+                     size_t ulSize, void *pvExtra) {
+  size_t *pulSeen = pvExtra;
+  size_t ulRank;
+  char *pcSelected;
+
+  assert(FT_rank(pcPath, &ulRank) == SUCCESS);
+  assert(ulRank == *pulSeen);
+  if(ulRank > 0) {
+    assert(FT_select("1root", ulRank - 1, &pcSelected) == SUCCESS);
+    assert(!strcmp(pcSelected, pcPath));
+    free(pcSelected);
+  }
+  (*pulSeen)++;
+  return 0;
+}
+
+/*
+  Runs a script of copies, and of changes to both the copies and
+  their originals, under 1root/cow, with only the name index enabled
+  if bIndexed and no index otherwise, so that FT_cp clones or shares
+  directories. Returns a newly allocated log of what FT_toString, the
+  visitors and the lookups gave along the way, which should not
+  depend on bIndexed. Removes 1root/cow, and leaves both indexes
+  enabled.
+*/
+static char *runCopies(boolean bIndexed) {
+  enum {LOGLEN = 20000};
+  static char acLog[LOGLEN];
+  char *pcString;
+  size_t ulSeen;
+  FT_Subtree_T oSubtree;
+
+  assert(FT_setSubstringIndex(FALSE) == SUCCESS);
+  assert(FT_setNameIndex(bIndexed) == SUCCESS);
+  acLog[0] = '\0';
+  assert(FT_insertFile("1root/cow/a/f1", "one", 4) == SUCCESS);
+  assert(FT_insertFile("1root/cow/a/b/f2", "two", 4) == SUCCESS);
+  assert(FT_insertFile("1root/cow/a/b/c/f3", "three", 6) == SUCCESS);
+  assert(FT_insertFile("1root/cow/a/b/g", NULL, 0) == SUCCESS);
+  assert(FT_insertDir("1root/cow/a/e") == SUCCESS);
+
+  /* copies of copies, and of directories within them */
+  assert(FT_cp("1root/cow/a", "1root/cow/a2") == SUCCESS);
+  assert(FT_cp("1root/cow/a2", "1root/cow/a3") == SUCCESS);
+  assert(FT_cp("1root/cow/a/b", "1root/cow/bb") == SUCCESS);
+  assert(FT_cp("1root/cow/a2/b/c", "1root/cow/a3/c") == SUCCESS);
+  assert(FT_cp("1root/cow/a", "1root/cow/a/e/a") == CONFLICTING_PATH);
+  assert((pcString = FT_toStringAt("1root/cow", (size_t) -1)) != NULL);
+  strcat(acLog, pcString);
+  free(pcString);
+  assert(FT_countDescendants("1root/cow", &ulSeen) == SUCCESS);
+  assert(ulSeen == 31);
+
+  /* a change on either side stays there */
+  assert(FT_getFileContents("1root/cow/a3/b/c/f3") ==
+         FT_getFileContents("1root/cow/a/b/c/f3"));
+  pcString = FT_replaceFileContents("1root/cow/a2/b/c/f3", "3", 2);
+  assert(pcString != NULL && !strcmp(pcString, "three"));
+  free(pcString);
+  assert(!strcmp(FT_getFileContents("1root/cow/a/b/c/f3"), "three"));
+  assert(!strcmp(FT_getFileContents("1root/cow/a3/b/c/f3"), "three"));
+  assert(!strcmp(FT_getFileContents("1root/cow/a2/b/c/f3"), "3"));
+  assert(FT_insertFile("1root/cow/a/b/new", "new", 4) == SUCCESS);
+  assert(FT_insertFile("1root/cow/a3/f1", NULL, 0) == ALREADY_IN_TREE);
+  assert(FT_rmDir("1root/cow/a3/b") == SUCCESS);
+  assert(FT_mv("1root/cow/a2/e", "1root/cow/a/e2") == SUCCESS);
+  assert(FT_mv("1root/cow/bb", "1root/cow/a3/bb") == SUCCESS);
+  assert(FT_rmFile("1root/cow/a3/bb/c/f3") == SUCCESS);
+  assert((pcString = FT_toStringAt("1root/cow", (size_t) -1)) != NULL);
+  strcat(acLog, pcString);
+  free(pcString);
+  checkToStrings();
+
+  /* visitors see the copies' own paths */
+  assert(FT_glob("1root/cow/**/f3", appendPath, acLog) == SUCCESS);
+  assert(FT_walk("1root/cow/a3", enterPath, leavePath, acLog) ==
+         SUCCESS);
+  assert(FT_diff("1root/cow/a", "1root/cow/a2", appendDiff, acLog) ==
+         SUCCESS);
+  assert(FT_findBySize("1root/cow", 4, 4, appendPath, acLog) ==
+         SUCCESS);
+  ulSeen = 0;
+  assert(FT_scanRange(NULL, NULL, 0, checkRank, &ulSeen) == SUCCESS);
+
+  /* merges, detaching and the string cache go through the copies */
+  assert(FT_merge("1root/cow/a2", "1root/cow/a3", FT_MERGE_KEEP) ==
+         SUCCESS);
+  assert(FT_detach("1root/cow/a2/b", &oSubtree) == SUCCESS);
+  assert(FT_attach("1root/cow/a/b2", oSubtree) == SUCCESS);
+  assert(FT_setStringCache(TRUE) == SUCCESS);
+  checkCachedString();
+  assert(FT_cp("1root/cow/a", "1root/cow/a4") == SUCCESS);
+  checkCachedString();
+  assert(FT_insertFile("1root/cow/a4/b2/c/z", NULL, 0) == SUCCESS);
+  checkCachedString();
+  assert(FT_setStringCache(FALSE) == SUCCESS);
+
+  /* a transaction copies nodes it can restore */
+  assert(FT_begin() == SUCCESS);
+  assert(FT_cp("1root/cow/a", "1root/cow/t") == SUCCESS);
+  assert(FT_rmDir("1root/cow/a") == SUCCESS);
+  assert(FT_abort() == SUCCESS);
+  assert(FT_begin() == SUCCESS);
+  assert(FT_cp("1root/cow/a4", "1root/cow/t") == SUCCESS);
+  assert(FT_commit() == SUCCESS);
+  assert((pcString = FT_toStringAt("1root/cow", (size_t) -1)) != NULL);
+  strcat(acLog, pcString);
+  free(pcString);
+
+  /* a large copy and its original are freed on the reclaimer thread
+     while the other is being changed */
+  for(ulSeen = 0; ulSeen < 1100; ulSeen++) {
+    char acPath[40];
+    sprintf(acPath, "1root/cow/big/d%lu/f%lu",
+            (unsigned long) (ulSeen % 20), (unsigned long) ulSeen);
+    assert(FT_insertFile(acPath, "Kernighan", 10) == SUCCESS);
+  }
+  assert(FT_cp("1root/cow/big", "1root/cow/big2") == SUCCESS);
+  assert(FT_rmDir("1root/cow/big") == SUCCESS);
+  pcString = FT_replaceFileContents("1root/cow/big2/d7/f107", "Pike", 5);
+  assert(pcString != NULL && !strcmp(pcString, "Kernighan"));
+  free(pcString);
+  assert(FT_cp("1root/cow/big2", "1root/cow/big") == SUCCESS);
+  assert(FT_rmDir("1root/cow/big2") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/cow/big/d7/f107"), "Pike"));
+  assert(FT_rmDir("1root/cow/big") == SUCCESS);
+
+  /* the indexes see every node */
+  assert(FT_setNameIndex(TRUE) == SUCCESS);
+  assert(FT_setSubstringIndex(TRUE) == SUCCESS);
+  assert(FT_findByName("f3", appendPath, acLog) == SUCCESS);
+  assert(FT_searchSubstring("b2/c", appendPath, acLog) == SUCCESS);
+  checkToStrings();
+  assert(FT_rmDir("1root/cow") == SUCCESS);
+  assert(strlen(acLog) < LOGLEN / 2);
+  return strcpy(malloc(strlen(acLog) + 1), acLog);
+}
+
 /* Tests the FT implementation with an assortment of checks.
    Prints the status of the data structure along the way to stderr.
    Returns 0. */
@@ -17,8 +493,9 @@ int main(void) {
   enum {ARRLEN = 1000};
   char* temp;
   boolean bIsFile;
-  size_t l;
+  size_t l, l2;
   char arr[ARRLEN];
+  FT_Subtree_T oSubtree;
   arr[0] = '\0';
 
   /* Before the data structure is initialized:
@@ -34,6 +511,11 @@ int main(void) {
   assert(FT_containsFile("1root/2child/3gkid/4ggk") == FALSE);
   assert(FT_rmFile("1root/2child/3gkid/4ggk") == INITIALIZATION_ERROR);
   assert((temp = FT_toString()) == NULL);
+  assert((temp = FT_toStringParallel(4)) == NULL);
+  assert(FT_toStringInto(arr, ARRLEN, &l) == INITIALIZATION_ERROR);
+  assert(FT_setStringCache(TRUE) == INITIALIZATION_ERROR);
+  assert(FT_getHash("1root", &l) == INITIALIZATION_ERROR);
+  assert(FT_writeTo(2) == INITIALIZATION_ERROR);
   assert(FT_destroy() == INITIALIZATION_ERROR);
 
   /* After initialization, the data structure is empty, so
@@ -46,6 +528,8 @@ int main(void) {
   assert((temp = FT_toString()) != NULL);
   assert(!strcmp(temp,""));
   free(temp);
+  checkToStrings();
+  checkWriteTo();
 
   /* A valid path must not:
      * be the empty string
@@ -125,6 +609,7 @@ int main(void) {
   assert((temp = FT_toString()) != NULL);
   fprintf(stderr, "Checkpoint 2:\n%s\n", temp);
   free(temp);
+  checkToStrings();
 
   /* Attempting to insert a child of a file is illegal */
   assert(FT_insertDir("1root/2third/3nopeD") == NOT_A_DIRECTORY);
@@ -235,11 +720,826 @@ int main(void) {
   fprintf(stderr, "Checkpoint 4.5:\n%s\n", temp);
   free(temp);
 
+  /* subtree and depth-limited representations match FT_toString */
+  {
+    char *temp2;
+    assert((temp = FT_toString()) != NULL);
+    assert((temp2 = FT_toStringAt("1root", (size_t) -1)) != NULL);
+    assert(!strcmp(temp, temp2));
+    free(temp);
+    free(temp2);
+    assert((temp = FT_toStringAt("1root/y", 1)) != NULL);
+    assert(!strcmp(temp, "1root/y\n1root/y/CHILD1FILE\n"
+                   "1root/y/CHILD2FILE\n1root/y/CHILD1DIR\n"
+                   "1root/y/CHILD2DIR\n1root/y/CHILD3DIR\n"));
+    free(temp);
+    assert((temp = FT_toStringAt("1root/x/B", 0)) != NULL);
+    assert(!strcmp(temp, "1root/x/B\n"));
+    free(temp);
+    assert(FT_toStringAt("1root/nope", 3) == NULL);
+  }
+
+  /* the shape analysis counts every node once */
+  {
+    struct FT_Analysis *psShape;
+    assert(FT_analyze(2, &psShape) == SUCCESS);
+    assert(psShape->ulDirs == 8 && psShape->ulFiles == 4);
+    assert(psShape->sDepth.aulCounts[3] == 8);
+    assert(psShape->sDepth.ulMax == 4);
+    assert(psShape->sFanout.ulSamples == 8 && psShape->sFanout.ulSum == 11);
+    assert(psShape->sFileShare.aulCounts[0] == 2);
+    assert(psShape->sFileShare.aulCounts[4] == 1);
+    assert(psShape->sFileShare.aulCounts[6] == 1);
+    assert(psShape->sFileSize.ulMax == 9);
+    assert(psShape->ulWidest == 2);
+    assert(!strcmp(psShape->psWidest[0].pcPath, "1root/y"));
+    assert(psShape->psWidest[0].ulValue == 5);
+    assert(!strcmp(psShape->psWidest[1].pcPath, "1root/x"));
+    assert(!strcmp(psShape->psDeepest[0].pcPath,
+                   "1root/y/CHILD2DIR/CHILD4DIR"));
+    FT_freeAnalysis(psShape);
+  }
+
+  /* glob patterns visit matching paths in toString order */
+  arr[0] = '\0';
+  assert(FT_glob("1root/*/C*", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/C\n1root/y/CHILD1FILE\n"
+                 "1root/y/CHILD2FILE\n1root/y/CHILD1DIR\n"
+                 "1root/y/CHILD2DIR\n1root/y/CHILD3DIR\n"));
+  arr[0] = '\0';
+  assert(FT_glob("1root/**/CHILD?DIR", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/CHILD1DIR\n1root/y/CHILD2DIR\n"
+                 "1root/y/CHILD2DIR/CHILD4DIR\n1root/y/CHILD3DIR\n"));
+  arr[0] = '\0';
+  assert(FT_glob("**/[!a-z]*", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root\n1root/x/B\n1root/x/C\n"
+                 "1root/y/CHILD1FILE\n1root/y/CHILD2FILE\n"
+                 "1root/y/CHILD1DIR\n1root/y/CHILD2DIR\n"
+                 "1root/y/CHILD2DIR/CHILD4DIR\n1root/y/CHILD3DIR\n"));
+  arr[0] = '\0';
+  assert(FT_glob("1root/x/c\\+?", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/c++\n"));
+  l = 0;
+  assert(FT_glob("1root/**", stopAtFirst, &l) == SUCCESS);
+  assert(l == 1);
+  assert(FT_glob("1root//x", appendPath, arr) == BAD_PATH);
+  /* a match deeper than the levels a glob starts out with */
+  strcpy(arr, "1root");
+  for(l = 0; l < 20; l++)
+    strcat(arr, "/d");
+  strcat(arr, "/f");
+  assert(FT_insertFile(arr, NULL, 0) == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_glob("**/f", appendPath, arr) == SUCCESS);
+  assert(strlen(arr) == strlen("1root") + 2 * 20 + 3);
+  arr[0] = '\0';
+  assert(FT_glob("1root/d/**/d/f", appendPath, arr) == SUCCESS);
+  assert(strlen(arr) == strlen("1root") + 2 * 20 + 3);
+  assert(FT_rmDir("1root/d") == SUCCESS);
+
+  /* size queries see sizes as files come, change and go */
+  arr[0] = '\0';
+  assert(FT_findBySize("1root", 1, 100, appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/B\n1root/x/C\n"));
+  arr[0] = '\0';
+  assert(FT_findBySize("1root/y", 0, 0, appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/CHILD1FILE\n1root/y/CHILD2FILE\n"));
+  assert(FT_findBySize("1root/z", 0, 0, appendPath, arr) ==
+         NO_SUCH_PATH);
+  {
+    char *apcTop[3];
+    size_t aulTop[3];
+    assert(FT_topKLargest("1root", 3, apcTop, aulTop, &l) == SUCCESS);
+    assert(l == 3);
+    assert(!strcmp(apcTop[0], "1root/x/B") && aulTop[0] == 9);
+    assert(!strcmp(apcTop[1], "1root/x/C") && aulTop[1] == 8);
+    assert(aulTop[2] == 0);
+    free(apcTop[0]);
+    free(apcTop[1]);
+    free(apcTop[2]);
+    assert(FT_replaceFileContents("1root/y/CHILD2FILE", "Lovelace",
+                                  strlen("Lovelace")+1) == NULL);
+    temp = FT_replaceFileContents("1root/x/B", NULL, 0);
+    assert(temp != NULL && !strcmp(temp, "Thompson"));
+    free(temp);
+    assert(FT_topKLargest("1root", 3, apcTop, NULL, &l) == SUCCESS);
+    assert(l == 3);
+    assert(!strcmp(apcTop[0], "1root/y/CHILD2FILE"));
+    assert(!strcmp(apcTop[1], "1root/x/C"));
+    free(apcTop[0]);
+    free(apcTop[1]);
+    free(apcTop[2]);
+    assert(FT_rmFile("1root/y/CHILD2FILE") == SUCCESS);
+    assert(FT_topKLargest("1root/y", 3, apcTop, NULL, &l) == SUCCESS);
+    assert(l == 1);
+    assert(!strcmp(apcTop[0], "1root/y/CHILD1FILE"));
+    free(apcTop[0]);
+    assert(FT_insertFile("1root/y/CHILD2FILE", NULL, 0) == SUCCESS);
+    assert(FT_replaceFileContents("1root/x/B", "Thompson",
+                                  strlen("Thompson")+1) == NULL);
+  }
+
+  /* name and extension lookups agree with and without the index,
+     which follows insertions and subtree removals */
+  assert(FT_insertFile("1root/y/CHILD1DIR/lib.so", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/x/lib.so", NULL, 0) == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_findByName("lib.so", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/lib.so\n1root/y/CHILD1DIR/lib.so\n"));
+  assert(FT_setNameIndex(TRUE) == SUCCESS);
+  assert(FT_insertFile("1root/y/a.so", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/y/.so", NULL, 0) == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_findByName("lib.so", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/lib.so\n1root/y/CHILD1DIR/lib.so\n"));
+  arr[0] = '\0';
+  assert(FT_findByExtension(".so", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/lib.so\n1root/y/CHILD1DIR/lib.so\n"
+                 "1root/y/a.so\n"));
+  assert(FT_rmDir("1root/y/CHILD1DIR") == SUCCESS);
+  assert(FT_rmFile("1root/y/a.so") == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_findByExtension("so", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/lib.so\n"));
+  arr[0] = '\0';
+  assert(FT_findByName("CHILD1DIR", appendPath, arr) == SUCCESS);
+  assert(arr[0] == '\0');
+  assert(FT_insertDir("1root/y/CHILD1DIR") == SUCCESS);
+  assert(FT_findByName("CHILD1DIR", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/CHILD1DIR\n"));
+  assert(FT_setNameIndex(FALSE) == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_findByExtension("so", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/lib.so\n"));
+  assert(FT_rmFile("1root/y/.so") == SUCCESS);
+  assert(FT_setNameIndex(TRUE) == SUCCESS);
+
+  /* substring search answers the same with and without the index,
+     including queries spanning components and after removals */
+  assert(FT_insertFile("1root/y/CHILD3DIR/cache.db", NULL, 0) ==
+         SUCCESS);
+  assert(FT_insertDir("1root/x/cached/v2/api") == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_searchSubstring("cache", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/cached\n1root/x/cached/v2\n"
+                 "1root/x/cached/v2/api\n1root/y/CHILD3DIR/cache.db\n"));
+  {
+    static const char *apcQueries[] = {
+      "cache", "v2/api", "d/v2/a", "ILD3DIR/c", "/cache", "2/", "x",
+      "CHILD", "zzz/api", ""
+    };
+    char *temp2;
+    size_t i;
+    assert(FT_setSubstringIndex(TRUE) == SUCCESS);
+    for(i = 0; i < 2 * sizeof(apcQueries) / sizeof(apcQueries[0]);
+        i++) {
+      const char *pcQuery = apcQueries[i / 2];
+      assert(FT_setSubstringIndex(i % 2 == 0) == SUCCESS);
+      arr[0] = '\0';
+      assert(FT_searchSubstring(pcQuery, appendPath, arr) == SUCCESS);
+      if(i % 2 == 0)
+        temp2 = strcpy(malloc(strlen(arr) + 1), arr);
+      else {
+        assert(!strcmp(arr, temp2));
+        free(temp2);
+      }
+    }
+    assert(FT_setSubstringIndex(TRUE) == SUCCESS);
+  }
+  arr[0] = '\0';
+  assert(FT_searchSubstring("v2/api", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/cached/v2/api\n"));
+  assert(FT_rmDir("1root/x/cached") == SUCCESS);
+  assert(FT_rmFile("1root/y/CHILD3DIR/cache.db") == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_searchSubstring("cache", appendPath, arr) == SUCCESS);
+  assert(arr[0] == '\0');
+  assert(FT_insertFile("1root/y/CHILD3DIR/cache.db", NULL, 0) ==
+         SUCCESS);
+  assert(FT_searchSubstring("e.d", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/CHILD3DIR/cache.db\n"));
+  assert(FT_rmFile("1root/y/CHILD3DIR/cache.db") == SUCCESS);
+
+  /* range scans seek to the lower bound, stop at the upper bound and
+     resume from a cursor after the FT changes */
+  arr[0] = '\0';
+  assert(FT_scanRange("1root/y/CHILD2", "1root/y/CHILD3DIR", 0,
+                      appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/CHILD2DIR\n1root/y/CHILD2DIR/CHILD4DIR\n"
+                 "1root/y/CHILD2FILE\n"));
+  arr[0] = '\0';
+  assert(FT_scanRange("1root/y/CHILD2DIR", "1root/y/CHILD3DIR",
+                      FT_SCAN_FILES | FT_SCAN_AFTER_LO |
+                      FT_SCAN_THROUGH_HI, appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/CHILD2FILE\n"));
+  arr[0] = '\0';
+  assert(FT_scanRange("1root/y/CHILD3DIR/a/b", NULL, FT_SCAN_DIRS,
+                      appendPath, arr) == SUCCESS);
+  assert(arr[0] == '\0');
+  arr[0] = '\0';
+  assert(FT_scanRange(NULL, "1root/x", FT_SCAN_THROUGH_HI, appendPath,
+                      arr) == SUCCESS);
+  assert(!strcmp(arr, "1root\n1root/x\n"));
+  assert(FT_scanRange("1root//y", NULL, 0, appendPath, arr) ==
+         BAD_PATH);
+  {
+    FT_RangeCursor_T oCursor;
+    assert(FT_openRange("1root/y", NULL, 0, &oCursor) == SUCCESS);
+    arr[0] = '\0';
+    assert(FT_continueRange(oCursor, 2, appendPath, arr) == SUCCESS);
+    assert(!strcmp(arr, "1root/y\n1root/y/CHILD1DIR\n"));
+    assert(FT_rmDir("1root/y/CHILD1DIR") == SUCCESS);
+    assert(FT_insertDir("1root/y/CHILD1DIR") == SUCCESS);
+    assert(FT_continueRange(oCursor, 1, appendPath, arr) == SUCCESS);
+    assert(FT_continueRange(oCursor, 1, stopAtFirst, &l) == SUCCESS);
+    assert(FT_continueRange(oCursor, 100, appendPath, arr) == SUCCESS);
+    assert(FT_isRangeDone(oCursor));
+    assert(!strcmp(arr, "1root/y\n1root/y/CHILD1DIR\n"
+                   "1root/y/CHILD1FILE\n1root/y/CHILD2DIR/CHILD4DIR\n"
+                   "1root/y/CHILD2FILE\n1root/y/CHILD3DIR\n"));
+    FT_closeRange(oCursor);
+  }
+
+  /* ranks, selections and descendant counts agree with the scan
+     order, and follow insertions and removals */
+  {
+    char *pcSelected;
+    l = 0;
+    assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+    assert(FT_countDescendants("1root", &l2) == SUCCESS);
+    assert(l == l2 + 1);
+    assert(FT_countDescendants("1root/y/CHILD2DIR", &l) == SUCCESS);
+    assert(l == 1);
+    assert(FT_countDescendants("1root/x/B", &l) == SUCCESS);
+    assert(l == 0);
+    assert(FT_insertDir("1root/y/CHILD2DIR/a/b") == SUCCESS);
+    assert(FT_countDescendants("1root/y", &l) == SUCCESS);
+    assert(l == 8);
+    assert(FT_select("1root/y", 4, &pcSelected) == SUCCESS);
+    assert(!strcmp(pcSelected, "1root/y/CHILD2DIR/a"));
+    free(pcSelected);
+    assert(FT_select("1root/y", 8, &pcSelected) == NO_SUCH_PATH);
+    assert(pcSelected == NULL);
+    assert(FT_rank("1root/y/CHILD2FILE", &l) == SUCCESS);
+    assert(FT_rmDir("1root/y/CHILD2DIR/a") == SUCCESS);
+    assert(FT_rank("1root/y/CHILD2FILE", &l2) == SUCCESS);
+    assert(l2 == l - 2);
+    l = 0;
+    assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+    assert(FT_rank("1root/nope", &l) == NO_SUCH_PATH);
+  }
+
+  /* directory listings page through children in name order */
+  {
+    struct FT_DirEntry asPage[2];
+    assert(FT_listDir("1root/y", NULL, 2, asPage, &l) == SUCCESS);
+    assert(l == 2);
+    assert(!strcmp(asPage[0].pcName, "CHILD1DIR") && !asPage[0].bIsFile);
+    assert(!strcmp(asPage[1].pcName, "CHILD1FILE") && asPage[1].bIsFile);
+    assert(FT_listDir("1root/y", asPage[1].pcName, 2, asPage, &l) ==
+           SUCCESS);
+    assert(l == 2);
+    assert(!strcmp(asPage[0].pcName, "CHILD2DIR"));
+    assert(!strcmp(asPage[1].pcName, "CHILD2FILE"));
+    assert(FT_listDir("1root/y", "CHILD2G", 2, asPage, &l) == SUCCESS);
+    assert(l == 1);
+    assert(!strcmp(asPage[0].pcName, "CHILD3DIR"));
+    assert(FT_listDir("1root/x/B", NULL, 2, asPage, &l) ==
+           NOT_A_DIRECTORY);
+    assert(FT_listDir("1root/z", NULL, 2, asPage, &l) == NO_SUCH_PATH);
+    assert(l == 0);
+    assert(FT_listDir("1root/x", "B", 1, asPage, &l) == SUCCESS);
+    assert(l == 1);
+    assert(!strcmp(asPage[0].pcName, "C") && asPage[0].ulSize == 8);
+  }
+
+  /* a directory iterator reads children a page at a time, resuming
+     after the last name read; a walk enters and leaves each node */
+  {
+    FT_DirIter_T oIter = NULL;
+    const struct FT_DirEntry *psEntry;
+    char acFill[150];
+    memset(acFill, 'x', sizeof(acFill));
+    assert(FT_openDir("1root/x/B", &oIter) == NOT_A_DIRECTORY);
+    assert(oIter == NULL);
+    for(l = 0; l < 150; l++) {
+      sprintf(arr, "1root/it/f%03lu", (unsigned long) l);
+      assert(FT_insertFile(arr, acFill, l) == SUCCESS);
+    }
+    assert(FT_openDir("1root/it", &oIter) == SUCCESS);
+    for(l = 0; l < 150; l++) {
+      assert(FT_readDir(oIter, &psEntry) == SUCCESS);
+      sprintf(arr, "f%03lu", (unsigned long) l);
+      assert(psEntry != NULL && !strcmp(psEntry->pcName, arr));
+      assert(psEntry->bIsFile && psEntry->ulSize == l);
+      if(l == 10) {
+        /* changes after the current page show up when it is read */
+        assert(FT_rmFile("1root/it/f100") == SUCCESS);
+        assert(FT_insertFile("1root/it/f100", acFill, 100) == SUCCESS);
+        assert(FT_rmFile("1root/it/f149") == SUCCESS);
+        assert(!strcmp(psEntry->pcName, "f010"));
+      }
+      if(l == 148)
+        break;
+    }
+    assert(FT_readDir(oIter, &psEntry) == SUCCESS && psEntry == NULL);
+    assert(FT_readDir(oIter, &psEntry) == SUCCESS && psEntry == NULL);
+    FT_closeDir(oIter);
+    assert(FT_openDir("1root/it", &oIter) == SUCCESS);
+    assert(FT_readDir(oIter, &psEntry) == SUCCESS && psEntry != NULL);
+    assert(FT_rmDir("1root/it") == SUCCESS);
+    for(l = 1; l < 64; l++)
+      assert(FT_readDir(oIter, &psEntry) == SUCCESS && psEntry != NULL);
+    assert(FT_readDir(oIter, &psEntry) == NO_SUCH_PATH);
+    assert(psEntry == NULL);
+    FT_closeDir(oIter);
+
+    arr[0] = '\0';
+    assert(FT_walk("1root/y", enterPath, leavePath, arr) == SUCCESS);
+    assert(!strcmp(arr, "<1root/y\n"
+                        "<1root/y/CHILD1DIR\n>1root/y/CHILD1DIR\n"
+                        "<1root/y/CHILD1FILE\n>1root/y/CHILD1FILE\n"
+                        "<1root/y/CHILD2DIR\n"
+                        "<1root/y/CHILD2FILE\n>1root/y/CHILD2FILE\n"
+                        "<1root/y/CHILD3DIR\n>1root/y/CHILD3DIR\n"
+                        ">1root/y\n"));
+    arr[0] = '\0';
+    assert(FT_walk("1root/x/B", enterPath, leavePath, arr) == SUCCESS);
+    assert(!strcmp(arr, "<1root/x/B\n>1root/x/B\n"));
+    l = 0;
+    assert(FT_walk("1root", stopAtFirst, leavePath, &l) == SUCCESS);
+    assert(l == 1);
+    assert(FT_walk("1root/z", enterPath, NULL, arr) == NO_SUCH_PATH);
+  }
+
+  /* moving a subtree renames every path below it, and keeps counts
+     and the name index up to date */
+  assert(FT_countDescendants("1root/x", &l2) == SUCCESS);
+  assert(FT_insertFile("1root/y/CHILD2DIR/CHILD4DIR/g.txt", "Go", 3) ==
+         SUCCESS);
+  assert(FT_mv("1root/y/CHILD2DIR", "1root/x/moved") == SUCCESS);
+  assert(FT_containsDir("1root/y/CHILD2DIR") == FALSE);
+  assert(FT_containsFile("1root/x/moved/CHILD4DIR/g.txt") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/x/moved/CHILD4DIR/g.txt"),
+                 "Go"));
+  assert(FT_countDescendants("1root/x", &l) == SUCCESS);
+  assert(l == l2 + 3);
+  assert(FT_countDescendants("1root/y", &l2) == SUCCESS);
+  arr[0] = '\0';
+  assert(FT_findByName("moved", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/moved\n"));
+  arr[0] = '\0';
+  assert(FT_findByName("CHILD2DIR", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, ""));
+  assert(FT_searchSubstring("moved/CHILD4", appendPath, arr) ==
+         SUCCESS);
+  assert(!strcmp(arr, "1root/x/moved/CHILD4DIR\n"
+                      "1root/x/moved/CHILD4DIR/g.txt\n"));
+  l = 0;
+  assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+  assert(FT_mv("1root/x/moved", "1root/y/CHILD2DIR") == SUCCESS);
+  assert(FT_mv("1root/y/CHILD2DIR/CHILD4DIR/g.txt", "1root/y/g.txt") ==
+         SUCCESS);
+  assert(FT_rmFile("1root/y/g.txt") == SUCCESS);
+  assert(FT_mv("1root/y/CHILD2DIR", "1root/y/CHILD2DIR/CHILD4DIR/z") ==
+         CONFLICTING_PATH);
+  assert(FT_mv("1root/y", "1root/y/z") == CONFLICTING_PATH);
+  assert(FT_mv("1root", "2root") == CONFLICTING_PATH);
+  assert(FT_mv("1root/y/CHILD2DIR", "2root/z") == CONFLICTING_PATH);
+  assert(FT_mv("1root/y/nope", "1root/y/z") == NO_SUCH_PATH);
+  assert(FT_mv("1root/y/CHILD2DIR", "1root/y/nope/z") == NO_SUCH_PATH);
+  assert(FT_mv("1root/y/CHILD2DIR", "1root/y/CHILD1FILE") ==
+         ALREADY_IN_TREE);
+  assert(FT_mv("1root/y/CHILD2DIR", "1root/y/CHILD2DIR") ==
+         ALREADY_IN_TREE);
+  assert(FT_mv("1root/y/CHILD2DIR", "1root/y/CHILD1FILE/z") ==
+         NOT_A_DIRECTORY);
+  assert(FT_mv("1root/y/CHILD2DIR", "1root//z") == BAD_PATH);
+  assert(FT_countDescendants("1root/y", &l) == SUCCESS);
+  assert(l == l2 + 2);
+
+  /* a copy shares file contents with the original until one side
+     replaces them, and is indexed and counted like any insertion */
+  assert(FT_cp("1root/y", "1root/x/y2") == SUCCESS);
+  assert(FT_countDescendants("1root/x/y2", &l2) == SUCCESS);
+  assert(l == l2);
+  assert(FT_cp("1root/x/B", "1root/x/y2/B") == SUCCESS);
+  assert(FT_getFileContents("1root/x/y2/B") ==
+         FT_getFileContents("1root/x/B"));
+  temp = FT_replaceFileContents("1root/x/y2/B", "Ken", 4);
+  assert(temp != NULL && !strcmp(temp, "Thompson"));
+  assert(temp != FT_getFileContents("1root/x/B"));
+  free(temp);
+  assert(!strcmp(FT_getFileContents("1root/x/y2/B"), "Ken"));
+  assert(!strcmp(FT_getFileContents("1root/x/B"), "Thompson"));
+  arr[0] = '\0';
+  assert(FT_findByName("CHILD4DIR", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/y2/CHILD2DIR/CHILD4DIR\n"
+                      "1root/y/CHILD2DIR/CHILD4DIR\n"));
+  assert(FT_cp("1root/y", "1root/y/CHILD1DIR/y") == CONFLICTING_PATH);
+  assert(FT_cp("1root/y", "1root/x/y2") == ALREADY_IN_TREE);
+  assert(FT_cp("1root/nope", "1root/z") == NO_SUCH_PATH);
+  assert(FT_rmDir("1root/x/y2") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/x/B"), "Thompson"));
+  l = 0;
+  assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+
+  /* merging a staging directory grafts what is new, merges
+     directories of the same name and settles other clashes by the
+     policy, then removes the staging directory */
+  assert(FT_countDescendants("1root", &l2) == SUCCESS);
+  assert(FT_insertFile("1root/st/y/CHILD1FILE", "new", 4) == SUCCESS);
+  assert(FT_insertFile("1root/st/y/CHILD2DIR", NULL, 0) == SUCCESS);
+  assert(FT_insertFile("1root/st/y/fresh/a", NULL, 0) == SUCCESS);
+  assert(FT_insertDir("1root/st/w/q") == SUCCESS);
+  assert(FT_merge("1root", "1root/st", FT_MERGE_FAIL) ==
+         ALREADY_IN_TREE);
+  assert(FT_containsDir("1root/st/w/q") == TRUE);
+  assert(FT_merge("1root", "1root/st", FT_MERGE_KEEP) == SUCCESS);
+  assert(FT_containsDir("1root/st") == FALSE);
+  assert(FT_containsFile("1root/y/fresh/a") == TRUE);
+  assert(FT_containsDir("1root/w/q") == TRUE);
+  assert(FT_containsDir("1root/y/CHILD2DIR") == TRUE);
+  assert(FT_stat("1root/y/CHILD1FILE", &bIsFile, &l) == SUCCESS);
+  assert(l == 0);
+  assert(FT_countDescendants("1root", &l) == SUCCESS);
+  assert(l == l2 + 4);
+  arr[0] = '\0';
+  assert(FT_findByName("fresh", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/fresh\n"));
+  assert(FT_insertFile("1root/st/y/fresh", "F", 2) == SUCCESS);
+  assert(FT_insertFile("1root/st/w/q/r", NULL, 0) == SUCCESS);
+  assert(FT_merge("1root", "1root/st", FT_MERGE_REPLACE) == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/y/fresh"), "F"));
+  assert(FT_containsFile("1root/w/q/r") == TRUE);
+  assert(FT_countDescendants("1root", &l) == SUCCESS);
+  assert(l == l2 + 4);
+  assert(FT_merge("1root/z", "1root/w", FT_MERGE_FAIL) == SUCCESS);
+  assert(FT_containsFile("1root/z/q/r") == TRUE);
+  assert(FT_merge("1root/y", "1root", FT_MERGE_KEEP) ==
+         CONFLICTING_PATH);
+  assert(FT_merge("1root/z/q", "1root/z", FT_MERGE_KEEP) ==
+         CONFLICTING_PATH);
+  assert(FT_insertDir("1root/z/q/q") == SUCCESS);
+  assert(FT_merge("1root/z", "1root/z/q", FT_MERGE_KEEP) ==
+         CONFLICTING_PATH);
+  assert(FT_merge("1root/z", "1root/y/fresh", FT_MERGE_KEEP) ==
+         NOT_A_DIRECTORY);
+  assert(FT_merge("1root/y/fresh", "1root/z", FT_MERGE_KEEP) ==
+         NOT_A_DIRECTORY);
+  assert(FT_merge("1root/nope/z", "1root/z", FT_MERGE_KEEP) ==
+         NO_SUCH_PATH);
+  assert(FT_rmDir("1root/z") == SUCCESS);
+  assert(FT_rmFile("1root/y/fresh") == SUCCESS);
+  assert(FT_countDescendants("1root", &l) == SUCCESS);
+  assert(l == l2);
+  l = 0;
+  assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+
+  /* a detached subtree leaves the FT and its count at once, and can
+     be attached elsewhere or freed */
+  assert(FT_countDescendants("1root", &l2) == SUCCESS);
+  assert(FT_countDescendants("1root/y/CHILD2DIR", &l) == SUCCESS);
+  l2 -= l + 1;
+  assert(FT_detach("1root/y/CHILD2DIR", &oSubtree) == SUCCESS);
+  assert(FT_containsDir("1root/y/CHILD2DIR") == FALSE);
+  assert(FT_countDescendants("1root", &l) == SUCCESS);
+  assert(l == l2);
+  arr[0] = '\0';
+  assert(FT_findByName("CHILD4DIR", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, ""));
+  assert(FT_attach("1root/y/CHILD1FILE/z", oSubtree) == NOT_A_DIRECTORY);
+  assert(FT_attach("1root/x", oSubtree) == ALREADY_IN_TREE);
+  assert(FT_attach("2root/x", oSubtree) == CONFLICTING_PATH);
+  assert(FT_attach("1root/x/c2", oSubtree) == SUCCESS);
+  assert(FT_findByName("CHILD4DIR", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/x/c2/CHILD4DIR\n"));
+  assert(FT_mv("1root/x/c2", "1root/y/CHILD2DIR") == SUCCESS);
+  assert(FT_detach("1root", &oSubtree) == CONFLICTING_PATH);
+  assert(oSubtree == NULL);
+  assert(FT_detach("1root/nope", &oSubtree) == NO_SUCH_PATH);
+  assert(FT_insertFile("1root/tmp/a", "A", 2) == SUCCESS);
+  assert(FT_detach("1root/tmp", &oSubtree) == SUCCESS);
+  assert(FT_freeSubtree(oSubtree) == 2);
+  assert(FT_insertFile("1root/tmpfile", "B", 2) == SUCCESS);
+  assert(FT_detach("1root/tmpfile", &oSubtree) == SUCCESS);
+  assert(FT_containsFile("1root/tmpfile") == FALSE);
+  assert(FT_attach("1root/x/bfile", oSubtree) == SUCCESS);
+  assert(FT_containsFile("1root/x/bfile") == TRUE);
+  assert(!strcmp(FT_getFileContents("1root/x/bfile"), "B"));
+  assert(FT_detach("1root/x/bfile", &oSubtree) == SUCCESS);
+  assert(FT_freeSubtree(oSubtree) == 1);
+  assert(FT_countDescendants("1root/y/CHILD2DIR", &l) == SUCCESS);
+  l2 += l + 1;
+  assert(FT_countDescendants("1root", &l) == SUCCESS);
+  assert(l == l2);
+  l = 0;
+  assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+
+  /* an aborted transaction leaves the FT as it found it, and a
+     committed one keeps its changes */
+  assert(FT_commit() == INITIALIZATION_ERROR);
+  assert(FT_abort() == INITIALIZATION_ERROR);
+  assert((temp = FT_toString()) != NULL);
+  assert(FT_begin() == SUCCESS);
+  assert(FT_begin() == INITIALIZATION_ERROR);
+  assert(FT_insertFile("1root/t/u/f", "F", 2) == SUCCESS);
+  assert(FT_rmDir("1root/y/CHILD2DIR") == SUCCESS);
+  assert(FT_mv("1root/x/B", "1root/t/B2") == SUCCESS);
+  {
+    char *temp2 = FT_replaceFileContents("1root/t/B2", "Ritchie", 8);
+    assert(temp2 != NULL && !strcmp(temp2, "Thompson"));
+    free(temp2);
+  }
+  assert(FT_cp("1root/t", "1root/t2") == SUCCESS);
+  assert(FT_rmDir("1root/t") == SUCCESS);
+  assert(!strcmp(FT_getFileContents("1root/t2/B2"), "Ritchie"));
+  assert(FT_merge("1root/x", "1root/t2", FT_MERGE_KEEP) ==
+         INITIALIZATION_ERROR);
+  assert(FT_abort() == SUCCESS);
+  {
+    char *temp2 = FT_toString();
+    assert(temp2 != NULL && !strcmp(temp, temp2));
+    free(temp2);
+  }
+  free(temp);
+  assert(!strcmp(FT_getFileContents("1root/x/B"), "Thompson"));
+  arr[0] = '\0';
+  assert(FT_findByName("CHILD4DIR", appendPath, arr) == SUCCESS);
+  assert(!strcmp(arr, "1root/y/CHILD2DIR/CHILD4DIR\n"));
+  assert(FT_begin() == SUCCESS);
+  assert(FT_insertFile("1root/t/f", "F", 2) == SUCCESS);
+  assert(FT_rmFile("1root/t/f") == SUCCESS);
+  assert(FT_commit() == SUCCESS);
+  assert(FT_containsDir("1root/t") == TRUE);
+  assert(FT_rmDir("1root/t") == SUCCESS);
+  l = 0;
+  assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+
+  /* a batch insertion settles each entry as one-at-a-time insertion
+     would, in the batch's order */
+  {
+    static const struct FT_InsertEntry asBatch[] = {
+      {"1root/b/f", TRUE, "F", 2},
+      {"1root/b", FALSE, NULL, 0},
+      {"1root/b/f/g", FALSE, NULL, 0},
+      {"1root/b/f", FALSE, NULL, 0},
+      {"1root//x", FALSE, NULL, 0},
+      {"2root/z", FALSE, NULL, 0},
+      {"1root/x/B", TRUE, NULL, 0},
+      {"1root/y/CHILD1FILE/q", FALSE, NULL, 0},
+      {"1root/b/d/e/h", TRUE, "H", 2},
+      {"1root/b/d", FALSE, NULL, 0},
+      {"1root/a", FALSE, NULL, 0}
+    };
+    static const int aiExpected[] = {
+      SUCCESS, ALREADY_IN_TREE, NOT_A_DIRECTORY, ALREADY_IN_TREE,
+      BAD_PATH, CONFLICTING_PATH, ALREADY_IN_TREE, NOT_A_DIRECTORY,
+      SUCCESS, ALREADY_IN_TREE, SUCCESS
+    };
+    int aiResults[11];
+    size_t i;
+
+    checkBatch(asBatch, 11);
+    assert(FT_countDescendants("1root", &l2) == SUCCESS);
+    assert(FT_insertBatch(asBatch, 11, aiResults) == SUCCESS);
+    for(i = 0; i < 11; i++)
+      assert(aiResults[i] == aiExpected[i]);
+    assert(FT_countDescendants("1root", &l) == SUCCESS);
+    assert(l == l2 + 6);
+    assert(!strcmp(FT_getFileContents("1root/b/d/e/h"), "H"));
+    assert(FT_rmDir("1root/a") == SUCCESS);
+    assert(FT_rmDir("1root/b") == SUCCESS);
+    l = 0;
+    assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+  }
+
+  /* a batch removal settles each path as one-at-a-time removal would,
+     each directory losing its removed children at once */
+  {
+    static const struct FT_InsertEntry asGarbage[] = {
+      {"1root/gc/a/f1", TRUE, NULL, 0},
+      {"1root/gc/a/f2", TRUE, NULL, 0},
+      {"1root/gc/b/f3", TRUE, NULL, 0},
+      {"1root/gc/c", TRUE, NULL, 0}
+    };
+    static const char *apcPaths[] = {
+      "1root/gc/a/f1", "1root/gc/a/f1", "1root/gc/c/x", "1root/gc/b/f3",
+      "1root/gc/b", "2root/gc", "1root/gc//a", "1root/gc",
+      "1root/gc/a/f2"
+    };
+    static const int aiExpected[] = {
+      SUCCESS, NO_SUCH_PATH, NO_SUCH_PATH, SUCCESS, SUCCESS,
+      CONFLICTING_PATH, BAD_PATH, SUCCESS, NO_SUCH_PATH
+    };
+    static const char *apcRoot[] = {
+      "1root/x", "2root", "1root", "2root", "1root/y", "1root"
+    };
+    int aiResults[9];
+    size_t i;
+
+    assert(FT_countDescendants("1root", &l2) == SUCCESS);
+    assert(FT_insertBatch(asGarbage, 4, aiResults) == SUCCESS);
+    checkRmBatch(apcPaths, 9);
+    checkRmBatch(apcPaths + 1, 8);
+    checkRmBatch(apcRoot, 6);
+    assert(FT_rmBatch(apcPaths, 9, aiResults) == SUCCESS);
+    for(i = 0; i < 9; i++)
+      assert(aiResults[i] == aiExpected[i]);
+    assert(FT_countDescendants("1root", &l) == SUCCESS);
+    assert(l == l2);
+    l = 0;
+    assert(FT_scanRange(NULL, NULL, 0, checkRank, &l) == SUCCESS);
+  }
+
+  /* a large removed subtree is freed in the background, while files
+     copied from it keep the contents they share with it */
+  assert(FT_countDescendants("1root", &l2) == SUCCESS);
+  {
+    struct FT_InsertEntry *psBig = malloc(1100 * sizeof(*psBig));
+    char *pcBig = malloc(1100 * 32);
+    int *aiBig = malloc(1100 * sizeof(int));
+    assert(psBig != NULL && pcBig != NULL && aiBig != NULL);
+    for(l = 0; l < 1100; l++) {
+      sprintf(pcBig + 32 * l, "1root/big/d%lu/f%lu",
+              (unsigned long) (l % 20), (unsigned long) l);
+      psBig[l].pcPath = pcBig + 32 * l;
+      psBig[l].bIsFile = TRUE;
+      psBig[l].pvContents = "Kernighan";
+      psBig[l].ulLength = 10;
+    }
+    assert(FT_insertBatch(psBig, 1100, aiBig) == SUCCESS);
+    for(l = 0; l < 1100; l++)
+      assert(aiBig[l] == SUCCESS);
+    free(psBig);
+    free(pcBig);
+    free(aiBig);
+  }
+  assert(FT_cp("1root/big", "1root/big2") == SUCCESS);
+  checkToStrings();
+  assert(FT_rmDir("1root/big") == SUCCESS);
+  assert(FT_countDescendants("1root", &l) == SUCCESS);
+  assert(l == l2 + 1121);
+  for(l = 0; l < 1100; l += 97) {
+    sprintf(arr, "1root/big2/d%lu/f", (unsigned long) (l % 20));
+    sprintf(arr + strlen(arr), "%lu", (unsigned long) l);
+    assert(!strcmp(FT_getFileContents(arr), "Kernighan"));
+    temp = FT_replaceFileContents(arr, "Ritchie", 8);
+    assert(temp != NULL && !strcmp(temp, "Kernighan"));
+    free(temp);
+  }
+  assert(FT_rmDir("1root/big2") == SUCCESS);
+  assert(FT_countDescendants("1root", &l) == SUCCESS);
+  assert(l == l2);
+  checkStringCache();
+
+  /* hashes follow contents, not names, and diffs visit only what
+     changed since a checkpoint copy */
+  {
+    size_t ulWhole, ulOld, ulNew;
+    assert(FT_getHash("1root", &ulWhole) == SUCCESS);
+    assert(FT_insertFile("1root/h/a", "Thompson", 9) == SUCCESS);
+    assert(FT_insertFile("1root/h/d/b", "Ken", 4) == SUCCESS);
+    assert(FT_insertFile("1root/h/d/e/c", NULL, 0) == SUCCESS);
+    assert(FT_insertDir("1root/h/f") == SUCCESS);
+    assert(FT_getHash("1root", &l) == SUCCESS);
+    assert(l != ulWhole);
+    assert(FT_cp("1root/h", "1root/hsnap") == SUCCESS);
+    assert(FT_getHash("1root/h", &ulOld) == SUCCESS);
+    assert(FT_getHash("1root/hsnap", &ulNew) == SUCCESS);
+    assert(ulOld == ulNew);
+    assert(FT_getHash("1root/h/d/e", &ulOld) == SUCCESS);
+    assert(FT_getHash("1root/h/f", &ulNew) == SUCCESS);
+    assert(ulOld != ulNew);
+    arr[0] = '\0';
+    assert(FT_diff("1root/hsnap", "1root/h", appendDiff, arr) ==
+           SUCCESS);
+    assert(!strcmp(arr, ""));
+
+    temp = FT_replaceFileContents("1root/h/a", "Ritchie", 8);
+    assert(temp != NULL && !strcmp(temp, "Thompson"));
+    free(temp);
+    assert(FT_rmFile("1root/h/d/e/c") == SUCCESS);
+    assert(FT_insertFile("1root/h/d/e/g", NULL, 0) == SUCCESS);
+    assert(FT_rmDir("1root/h/f") == SUCCESS);
+    assert(FT_insertFile("1root/h/f", NULL, 0) == SUCCESS);
+    assert(FT_mv("1root/h/d/b", "1root/h/b") == SUCCESS);
+    assert(FT_getHash("1root/h", &ulNew) == SUCCESS);
+    assert(FT_getHash("1root/hsnap", &ulOld) == SUCCESS);
+    assert(ulOld != ulNew);
+    arr[0] = '\0';
+    assert(FT_diff("1root/hsnap", "1root/h", appendDiff, arr) ==
+           SUCCESS);
+    assert(!strcmp(arr, "~1root/h/a\n+1root/h/b\n-1root/hsnap/d/b\n"
+                        "-1root/hsnap/d/e/c\n+1root/h/d/e/g\n"
+                        "-1root/hsnap/f\n+1root/h/f\n"));
+    l = 0;
+    assert(FT_diff("1root/hsnap", "1root/h", stopAtDiff, &l) ==
+           SUCCESS);
+    assert(l == 1);
+    arr[0] = '\0';
+    assert(FT_diff("1root/hsnap/a", "1root/h/d", appendDiff, arr) ==
+           SUCCESS);
+    assert(!strcmp(arr, "-1root/hsnap/a\n+1root/h/d\n"));
+    assert(FT_diff("1root/nope", "1root/h", appendDiff, arr) ==
+           NO_SUCH_PATH);
+    assert(FT_getHash("1root/nope", &l) == NO_SUCH_PATH);
+
+    /* undoing the changes restores the hash of the whole FT */
+    assert(FT_rmDir("1root/h") == SUCCESS);
+    assert(FT_mv("1root/hsnap", "1root/h") == SUCCESS);
+    assert(FT_getHash("1root/h", &l) == SUCCESS);
+    assert(FT_getHash("1root/h/d", &ulOld) == SUCCESS);
+    assert(l != ulOld);
+    assert(FT_rmDir("1root/h") == SUCCESS);
+    assert(FT_getHash("1root", &l) == SUCCESS);
+    assert(l == ulWhole);
+  }
+
+  /* copies shared until changed read and change like cloned ones */
+  {
+    char *pcShared, *pcCloned;
+    assert(FT_countDescendants("1root", &l2) == SUCCESS);
+    pcShared = runCopies(FALSE);
+    pcCloned = runCopies(TRUE);
+    assert(!strcmp(pcShared, pcCloned));
+    free(pcShared);
+    free(pcCloned);
+    assert(FT_countDescendants("1root", &l) == SUCCESS);
+    assert(l == l2);
+  }
+  arr[0] = '\0';
+
+  /* a tar export imported into a fresh FT reproduces the FT,
+     including names too long for a plain ustar header */
+  memset(arr, 'n', 150);
+  arr[150] = '\0';
+  strcpy(arr, "1root/x/");
+  arr[8] = 'n';
+  assert(FT_insertFile(arr, "Pike", strlen("Pike")+1) == SUCCESS);
+  strcat(arr, "/");
+  memset(arr + strlen(arr), 'm', 150);
+  arr[301] = '\0';
+  assert(FT_insertFile(arr, NULL, 0) == NOT_A_DIRECTORY);
+  arr[150] = 'd';
+  assert(FT_insertFile(arr, NULL, 0) == SUCCESS);
+  {
+    int aiPipe[2];
+    char *temp2;
+    assert(pipe(aiPipe) == 0);
+    assert(FT_exportTar(aiPipe[1]) == SUCCESS);
+    assert(close(aiPipe[1]) == 0);
+    assert((temp = FT_toString()) != NULL);
+    assert(FT_destroy() == SUCCESS);
+    assert(FT_importTar(aiPipe[0]) == INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    assert(FT_importTar(aiPipe[0]) == SUCCESS);
+    assert(close(aiPipe[0]) == 0);
+    assert((temp2 = FT_toString()) != NULL);
+    assert(!strcmp(temp, temp2));
+    free(temp);
+    free(temp2);
+  }
+  checkWriteTo();
+  assert(!strcmp(FT_getFileContents("1root/x/B"), "Thompson"));
+  assert(FT_stat("1root/y/CHILD1FILE", &bIsFile, &l) == SUCCESS);
+  assert(bIsFile == TRUE);
+  assert(l == 0);
+
   assert(FT_destroy() == SUCCESS);
   assert(FT_destroy() == INITIALIZATION_ERROR);
   assert(FT_containsDir("1root") == FALSE);
   assert(FT_containsFile("1root") == FALSE);
   assert((temp = FT_toString()) == NULL);
 
+  /* into an empty FT, a batch's root comes from its first entry that
+     is not a file at the root */
+  {
+    static const struct FT_InsertEntry asBatch[] = {
+      {"r", TRUE, NULL, 0},
+      {"q/a", FALSE, NULL, 0},
+      {"q", TRUE, NULL, 0},
+      {"r/x", FALSE, NULL, 0},
+      {"q", FALSE, NULL, 0}
+    };
+    static const int aiExpected[] = {
+      CONFLICTING_PATH, SUCCESS, ALREADY_IN_TREE, CONFLICTING_PATH,
+      ALREADY_IN_TREE
+    };
+    int aiResults[5];
+    size_t i;
+
+    assert(FT_insertBatch(asBatch, 5, aiResults) ==
+           INITIALIZATION_ERROR);
+    assert(FT_init() == SUCCESS);
+    checkBatch(asBatch, 5);
+    checkBatch(asBatch + 2, 3);
+    assert(FT_insertBatch(asBatch, 5, aiResults) == SUCCESS);
+    for(i = 0; i < 5; i++)
+      assert(aiResults[i] == aiExpected[i]);
+    assert(FT_containsDir("q/a") == TRUE);
+    assert(FT_destroy() == SUCCESS);
+  }
+
   return 0;
 }
@@ -0,0 +1,221 @@
+/*--------------------------------------------------------------------*/
+/* nameIndex.c                                                        */
+/* Author: Helenia                                                    */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nameIndex.h"
+
+/* Initial number of hash buckets; the table doubles whenever it
+   holds more keys than buckets */
+enum { NAMEINDEX_INITIAL_BUCKETS = 64 };
+
+/* The set of nodes filed under one key */
+struct NameIndexEntry {
+   /* the key, owned by the entry, and its hash */
+   char *pcKey;
+   size_t ulHash;
+   /* the nodes, in an array of ulLength used and ulCap allocated */
+   Node_T *poNNodes;
+   size_t ulLength;
+   size_t ulCap;
+   /* the next entry in the same bucket */
+   struct NameIndexEntry *psNext;
+};
+
+/* A hash table of entries, chained per bucket */
+struct NameIndex {
+   struct NameIndexEntry **ppsBuckets;
+   size_t ulBuckets;
+   size_t ulKeys;
+   /* the node index slot this index maintains */
+   size_t ulSlot;
+};
+
+/* Returns the hash of string pcKey. */
+static size_t NameIndex_hash(const char *pcKey) {
+   size_t ulHash = 5381;
+
+   while(*pcKey != '\0')
+      ulHash = ulHash * 33 + (unsigned char) *pcKey++;
+   return ulHash;
+}
+
+/* Returns oNIIndex's entry for pcKey, whose hash is ulHash, or NULL if
+   there is none. Sets *pppsLink to the link that points to it. */
+static struct NameIndexEntry *NameIndex_find(NameIndex_T oNIIndex,
+                                             const char *pcKey,
+                                             size_t ulHash,
+                                        struct NameIndexEntry ***pppsLink) {
+   struct NameIndexEntry **ppsLink;
+
+   ppsLink = &oNIIndex->ppsBuckets[ulHash % oNIIndex->ulBuckets];
+   while(*ppsLink != NULL && ((*ppsLink)->ulHash != ulHash ||
+                              strcmp((*ppsLink)->pcKey, pcKey)))
+      ppsLink = &(*ppsLink)->psNext;
+   *pppsLink = ppsLink;
+   return *ppsLink;
+}
+
+/* Doubles oNIIndex's number of buckets, if memory allows. */
+static void NameIndex_grow(NameIndex_T oNIIndex) {
+   struct NameIndexEntry **ppsNew;
+   size_t ulNewBuckets = 2 * oNIIndex->ulBuckets;
+   size_t i;
+
+   ppsNew = calloc(ulNewBuckets, sizeof(struct NameIndexEntry *));
+   if(ppsNew == NULL)
+      return;
+
+   for(i = 0; i < oNIIndex->ulBuckets; i++) {
+      struct NameIndexEntry *psEntry = oNIIndex->ppsBuckets[i];
+      while(psEntry != NULL) {
+         struct NameIndexEntry *psNext = psEntry->psNext;
+         psEntry->psNext = ppsNew[psEntry->ulHash % ulNewBuckets];
+         ppsNew[psEntry->ulHash % ulNewBuckets] = psEntry;
+         psEntry = psNext;
+      }
+   }
+   free(oNIIndex->ppsBuckets);
+   oNIIndex->ppsBuckets = ppsNew;
+   oNIIndex->ulBuckets = ulNewBuckets;
+}
+
+NameIndex_T NameIndex_new(size_t ulSlot) {
+   NameIndex_T oNIIndex;
+
+   assert(ulSlot < NODE_INDEX_SLOTS);
+
+   oNIIndex = malloc(sizeof(struct NameIndex));
+   if(oNIIndex == NULL)
+      return NULL;
+   oNIIndex->ppsBuckets = calloc(NAMEINDEX_INITIAL_BUCKETS,
+                                 sizeof(struct NameIndexEntry *));
+   if(oNIIndex->ppsBuckets == NULL) {
+      free(oNIIndex);
+      return NULL;
+   }
+   oNIIndex->ulBuckets = NAMEINDEX_INITIAL_BUCKETS;
+   oNIIndex->ulKeys = 0;
+   oNIIndex->ulSlot = ulSlot;
+   return oNIIndex;
+}
+
+void NameIndex_free(NameIndex_T oNIIndex) {
+   size_t i;
+
+   if(oNIIndex == NULL)
+      return;
+
+   for(i = 0; i < oNIIndex->ulBuckets; i++) {
+      struct NameIndexEntry *psEntry = oNIIndex->ppsBuckets[i];
+      while(psEntry != NULL) {
+         struct NameIndexEntry *psNext = psEntry->psNext;
+         free(psEntry->poNNodes);
+         free(psEntry->pcKey);
+         free(psEntry);
+         psEntry = psNext;
+      }
+   }
+   free(oNIIndex->ppsBuckets);
+   free(oNIIndex);
+}
+
+int NameIndex_add(NameIndex_T oNIIndex, const char *pcKey,
+                  Node_T oNNode) {
+   struct NameIndexEntry *psEntry;
+   struct NameIndexEntry **ppsLink;
+   size_t ulHash;
+
+   assert(oNIIndex != NULL);
+   assert(pcKey != NULL);
+   assert(oNNode != NULL);
+
+   ulHash = NameIndex_hash(pcKey);
+   psEntry = NameIndex_find(oNIIndex, pcKey, ulHash, &ppsLink);
+
+   if(psEntry == NULL) {
+      psEntry = malloc(sizeof(struct NameIndexEntry));
+      if(psEntry == NULL)
+         return MEMORY_ERROR;
+      psEntry->pcKey = malloc(strlen(pcKey) + 1);
+      psEntry->poNNodes = malloc(sizeof(Node_T));
+      if(psEntry->pcKey == NULL || psEntry->poNNodes == NULL) {
+         free(psEntry->pcKey);
+         free(psEntry->poNNodes);
+         free(psEntry);
+         return MEMORY_ERROR;
+      }
+      strcpy(psEntry->pcKey, pcKey);
+      psEntry->ulHash = ulHash;
+      psEntry->ulLength = 0;
+      psEntry->ulCap = 1;
+      psEntry->psNext = NULL;
+      *ppsLink = psEntry;
+      if(++oNIIndex->ulKeys > oNIIndex->ulBuckets)
+         NameIndex_grow(oNIIndex);
+   }
+   else if(psEntry->ulLength == psEntry->ulCap) {
+      Node_T *poNNew = realloc(psEntry->poNNodes,
+                               2 * psEntry->ulCap * sizeof(Node_T));
+      if(poNNew == NULL)
+         return MEMORY_ERROR;
+      psEntry->poNNodes = poNNew;
+      psEntry->ulCap *= 2;
+   }
+
+   Node_setIndexSlot(oNNode, oNIIndex->ulSlot, psEntry->ulLength);
+   psEntry->poNNodes[psEntry->ulLength++] = oNNode;
+   return SUCCESS;
+}
+
+void NameIndex_remove(NameIndex_T oNIIndex, const char *pcKey,
+                      Node_T oNNode) {
+   struct NameIndexEntry *psEntry;
+   struct NameIndexEntry **ppsLink;
+   size_t ulPos;
+
+   assert(oNIIndex != NULL);
+   assert(pcKey != NULL);
+   assert(oNNode != NULL);
+
+   psEntry = NameIndex_find(oNIIndex, pcKey, NameIndex_hash(pcKey),
+                            &ppsLink);
+   assert(psEntry != NULL);
+
+   /* move the last node into the vacated position */
+   ulPos = Node_getIndexSlot(oNNode, oNIIndex->ulSlot);
+   assert(ulPos < psEntry->ulLength &&
+          psEntry->poNNodes[ulPos] == oNNode);
+   psEntry->poNNodes[ulPos] = psEntry->poNNodes[--psEntry->ulLength];
+   Node_setIndexSlot(psEntry->poNNodes[ulPos], oNIIndex->ulSlot, ulPos);
+
+   if(psEntry->ulLength == 0) {
+      *ppsLink = psEntry->psNext;
+      free(psEntry->poNNodes);
+      free(psEntry->pcKey);
+      free(psEntry);
+      oNIIndex->ulKeys--;
+   }
+}
+
+size_t NameIndex_lookup(NameIndex_T oNIIndex, const char *pcKey,
+                        Node_T **ppoNNodes) {
+   struct NameIndexEntry *psEntry;
+   struct NameIndexEntry **ppsLink;
+
+   assert(oNIIndex != NULL);
+   assert(pcKey != NULL);
+   assert(ppoNNodes != NULL);
+
+   psEntry = NameIndex_find(oNIIndex, pcKey, NameIndex_hash(pcKey),
+                            &ppsLink);
+   if(psEntry == NULL) {
+      *ppoNNodes = NULL;
+      return 0;
+   }
+   *ppoNNodes = psEntry->poNNodes;
+   return psEntry->ulLength;
+}
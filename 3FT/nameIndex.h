@@ -0,0 +1,52 @@
+/*--------------------------------------------------------------------*/
+/* nameIndex.h                                                        */
+/* Author: Helenia                                                    */
+/*--------------------------------------------------------------------*/
+
+#ifndef NAMEINDEX_INCLUDED
+#define NAMEINDEX_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "nodeFT.h"
+
+/*
+  A NameIndex_T is an inverted index from strings (names, extensions)
+  to the set of File Tree nodes filed under each string. Each index
+  uses one of the nodes' index slots to remember where a node sits in
+  its set, so that both adding and removing a node take O(1) expected
+  time. A node can be filed under at most one key per index.
+*/
+typedef struct NameIndex *NameIndex_T;
+
+/*
+  Returns a new empty index that keeps its bookkeeping in node index
+  slot ulSlot (less than NODE_INDEX_SLOTS, and not used by any other
+  live index), or NULL if there is not enough memory.
+*/
+NameIndex_T NameIndex_new(size_t ulSlot);
+
+/* Frees oNIIndex. The indexed nodes themselves are not affected. */
+void NameIndex_free(NameIndex_T oNIIndex);
+
+/*
+  Files oNNode under key pcKey in oNIIndex. Returns SUCCESS, or
+  MEMORY_ERROR (leaving oNIIndex unchanged) if there is not enough
+  memory.
+*/
+int NameIndex_add(NameIndex_T oNIIndex, const char *pcKey,
+                  Node_T oNNode);
+
+/* Removes oNNode, which must be filed under pcKey, from oNIIndex. */
+void NameIndex_remove(NameIndex_T oNIIndex, const char *pcKey,
+                      Node_T oNNode);
+
+/*
+  Returns the number of nodes filed under pcKey in oNIIndex and sets
+  *ppoNNodes to an array of them, in no particular order. The array
+  belongs to oNIIndex and is only valid until it next changes.
+*/
+size_t NameIndex_lookup(NameIndex_T oNIIndex, const char *pcKey,
+                        Node_T **ppoNNodes);
+
+#endif
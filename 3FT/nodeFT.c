@@ -6,14 +6,16 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
 #include "dynarray.h"
 #include "nodeFT.h"
 #include "checkerFT.h" 
 
 /* A node in a DT */
 struct node {
-   /* the object corresponding to the node's absolute path */
-   Path_T oPPath;
+   /* the node's name, the final component of its path; paths are
+      not stored, so that moving a subtree only touches its root */
+   char *pcName;
    /* this node's parent */
    Node_T oNParent;
    /* the object containing links to this node's children */
@@ -24,9 +26,375 @@ struct node {
    void *pvContents;
    /* size of file cotents */
    size_t ulLength;
+   /* the number of files sharing pvContents since a Node_clone, or
+      NULL if this file has never shared them */
+   size_t *pulShares;
+   /* aggregates over the files in a directory's subtree (directories
+      only): file count, largest and smallest size (0 if no files),
+      and file counts per size bucket (see Node_getSizeBucket) */
+   size_t ulFiles;
+   size_t ulMaxSize;
+   size_t ulMinSize;
+   size_t *pulBuckets;
+   /* positions of this node within the sets of the inverted indexes
+      that file it, owned by those indexes */
+   size_t aulIndexSlots[NODE_INDEX_SLOTS];
+   /* the number of nodes in this node's subtree, itself included */
+   size_t ulNodes;
+   /* the total length of the paths of the nodes strictly below this
+      node, each taken from just after this node's name */
+   size_t ulBelowLength;
+   /* a Fenwick tree over the children's subtree node counts, in
+      entries 1..number of children of ulFenwickCap allocated
+      (directories only; NULL until the first child) */
+   size_t *pulFenwick;
+   size_t ulFenwickCap;
+   /* a cached copy of the lines of this directory's subtree and their
+      length, owned by the node, or NULL; any change to the subtree's
+      structure drops it (see Node_setFragment) */
+   char *pcFragment;
+   size_t ulFragmentLength;
+   /* the hash of this node's contents, or of its children's names and
+      hashes, and whether it is up to date; it is computed on demand,
+      and a change below a node outdates it and its ancestors', so the
+      hashes of a node's subtree are up to date if its own is */
+   size_t ulHash;
+   boolean bHashIsValid;
+   /* for a directory copied by sharing (see Node_share) that has no
+      children of its own yet, the directory in a snapshot whose
+      children it reads instead, and that snapshot; oDChildren and
+      pulFenwick are then NULL. Both are NULL otherwise */
+   Node_T oNShared;
+   struct NodeSnapshot *psSnapshot;
+};
 
+/* A subtree frozen by Node_share, which no longer changes, and the
+   number of shared directories that read their children from it */
+struct NodeSnapshot {
+   Node_T oNRoot;
+   size_t ulRefs;
 };
 
+/* The offset basis and prime of the 64-bit FNV-1a hash */
+static const size_t ulHashBasis = 14695981039346656037UL;
+static const size_t ulHashPrime = 1099511628211UL;
+
+
+/* Share counts, of contents and of snapshots, are all that a detached
+   subtree being freed on another thread (see Node_freeTop) has in
+   common with the rest of the nodes, so they change only under this
+   lock. */
+static pthread_mutex_t oShareLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns the node holding directory oNDir's children: oNDir, or the
+   directory in a snapshot that it shares them with. */
+static Node_T Node_getHolder(Node_T oNDir) {
+   return oNDir->oNShared != NULL ? oNDir->oNShared : oNDir;
+}
+
+/* Aggregate accessors that treat a file as a subtree of one file */
+
+size_t Node_getNumFiles(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return oNNode->bIsFile ? 1 : oNNode->ulFiles;
+}
+
+size_t Node_getMaxFileSize(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return oNNode->bIsFile ? oNNode->ulLength : oNNode->ulMaxSize;
+}
+
+size_t Node_getMinFileSize(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return oNNode->bIsFile ? oNNode->ulLength : oNNode->ulMinSize;
+}
+
+size_t Node_getSizeBucket(size_t ulSize) {
+   size_t ulBucket = 0;
+
+   /* bucket 0 holds empty files, then one bucket per factor of 16 */
+   while(ulSize != 0) {
+      ulBucket++;
+      ulSize >>= 4;
+   }
+   return ulBucket;
+}
+
+size_t Node_getBucketCount(Node_T oNNode, size_t ulBucket) {
+   assert(oNNode != NULL);
+   assert(ulBucket < NODE_SIZE_BUCKETS);
+
+   if(oNNode->bIsFile)
+      return Node_getSizeBucket(oNNode->ulLength) == ulBucket;
+   return oNNode->pulBuckets[ulBucket];
+}
+
+boolean Node_mayHaveSizeIn(Node_T oNNode, size_t ulMin, size_t ulMax) {
+   size_t ulBucket;
+
+   assert(oNNode != NULL);
+
+   if(Node_getNumFiles(oNNode) == 0 || ulMin > ulMax ||
+      Node_getMaxFileSize(oNNode) < ulMin ||
+      Node_getMinFileSize(oNNode) > ulMax)
+      return FALSE;
+
+   for(ulBucket = Node_getSizeBucket(ulMin);
+       ulBucket <= Node_getSizeBucket(ulMax); ulBucket++)
+      if(Node_getBucketCount(oNNode, ulBucket) != 0)
+         return TRUE;
+   return FALSE;
+}
+
+/*
+  Recomputes directory oNDir's largest and smallest file sizes from
+  its children's aggregates.
+*/
+static void Node_recomputeExtremes(Node_T oNDir) {
+   size_t ulIndex;
+   boolean bAny = FALSE;
+
+   assert(oNDir != NULL);
+   assert(!oNDir->bIsFile);
+   assert(oNDir->oNShared == NULL);
+
+   oNDir->ulMaxSize = 0;
+   oNDir->ulMinSize = 0;
+   for(ulIndex = 0; ulIndex < DynArray_getLength(oNDir->oDChildren);
+       ulIndex++) {
+      Node_T oNChild = DynArray_get(oNDir->oDChildren, ulIndex);
+      if(Node_getNumFiles(oNChild) == 0)
+         continue;
+      if(!bAny || Node_getMaxFileSize(oNChild) > oNDir->ulMaxSize)
+         oNDir->ulMaxSize = Node_getMaxFileSize(oNChild);
+      if(!bAny || Node_getMinFileSize(oNChild) < oNDir->ulMinSize)
+         oNDir->ulMinSize = Node_getMinFileSize(oNChild);
+      bAny = TRUE;
+   }
+}
+
+/* A snapshot of a subtree's file aggregates */
+struct NodeSizes {
+   size_t ulFiles;
+   size_t ulMaxSize;
+   size_t ulMinSize;
+   size_t aulBuckets[NODE_SIZE_BUCKETS];
+};
+
+/* Stores oNSub's current file aggregates in *psSizes. */
+static void Node_getSizes(Node_T oNSub, struct NodeSizes *psSizes) {
+   size_t ulBucket;
+
+   assert(oNSub != NULL);
+   assert(psSizes != NULL);
+
+   psSizes->ulFiles = Node_getNumFiles(oNSub);
+   psSizes->ulMaxSize = Node_getMaxFileSize(oNSub);
+   psSizes->ulMinSize = Node_getMinFileSize(oNSub);
+   for(ulBucket = 0; ulBucket < NODE_SIZE_BUCKETS; ulBucket++)
+      psSizes->aulBuckets[ulBucket] = Node_getBucketCount(oNSub, ulBucket);
+}
+
+/*
+  Adds the file aggregates *psSizes of a subtree that has just been
+  linked into the tree to every directory from oNAncestor up to the
+  root.
+*/
+static void Node_addSizes(Node_T oNAncestor,
+                          const struct NodeSizes *psSizes) {
+   size_t ulBucket;
+
+   assert(psSizes != NULL);
+
+   if(psSizes->ulFiles == 0)
+      return;
+
+   for(; oNAncestor != NULL; oNAncestor = oNAncestor->oNParent) {
+      if(oNAncestor->ulFiles == 0 ||
+         psSizes->ulMaxSize > oNAncestor->ulMaxSize)
+         oNAncestor->ulMaxSize = psSizes->ulMaxSize;
+      if(oNAncestor->ulFiles == 0 ||
+         psSizes->ulMinSize < oNAncestor->ulMinSize)
+         oNAncestor->ulMinSize = psSizes->ulMinSize;
+      oNAncestor->ulFiles += psSizes->ulFiles;
+      for(ulBucket = 0; ulBucket < NODE_SIZE_BUCKETS; ulBucket++)
+         oNAncestor->pulBuckets[ulBucket] +=
+            psSizes->aulBuckets[ulBucket];
+   }
+}
+
+/*
+  Removes the file aggregates *psSizes of a subtree that has just been
+  unlinked from (or changed in) the tree from every directory from
+  oNAncestor up to the root. A directory's extremes are recomputed
+  from its children only if the subtree held one of them.
+*/
+static void Node_removeSizes(Node_T oNAncestor,
+                             const struct NodeSizes *psSizes) {
+   size_t ulBucket;
+
+   assert(psSizes != NULL);
+
+   if(psSizes->ulFiles == 0)
+      return;
+
+   for(; oNAncestor != NULL; oNAncestor = oNAncestor->oNParent) {
+      oNAncestor->ulFiles -= psSizes->ulFiles;
+      for(ulBucket = 0; ulBucket < NODE_SIZE_BUCKETS; ulBucket++)
+         oNAncestor->pulBuckets[ulBucket] -=
+            psSizes->aulBuckets[ulBucket];
+      if(psSizes->ulMaxSize == oNAncestor->ulMaxSize ||
+         psSizes->ulMinSize == oNAncestor->ulMinSize)
+         Node_recomputeExtremes(oNAncestor);
+   }
+}
+
+/*
+  Makes room in directory oNDir's Fenwick tree for one more child.
+  Returns SUCCESS or MEMORY_ERROR.
+*/
+static int Node_reserveFenwick(Node_T oNDir) {
+   size_t ulNeeded = DynArray_getLength(oNDir->oDChildren) + 2;
+   size_t *pulNew;
+
+   if(ulNeeded <= oNDir->ulFenwickCap)
+      return SUCCESS;
+   if(ulNeeded < 2 * oNDir->ulFenwickCap)
+      ulNeeded = 2 * oNDir->ulFenwickCap;
+   pulNew = realloc(oNDir->pulFenwick, ulNeeded * sizeof(size_t));
+   if(pulNew == NULL)
+      return MEMORY_ERROR;
+   oNDir->pulFenwick = pulNew;
+   oNDir->ulFenwickCap = ulNeeded;
+   return SUCCESS;
+}
+
+/*
+  Makes room in directory oNDir for one more child, in its children
+  array as well as its Fenwick tree, so that linking one cannot fail.
+  Returns SUCCESS or MEMORY_ERROR.
+*/
+static int Node_reserveChild(Node_T oNDir) {
+   size_t ulLength = DynArray_getLength(oNDir->oDChildren);
+
+   if(Node_reserveFenwick(oNDir) != SUCCESS)
+      return MEMORY_ERROR;
+   /* a DynArray never shrinks, so growing it by one and taking the
+      element back off leaves the room */
+   if(!DynArray_add(oNDir->oDChildren, oNDir))
+      return MEMORY_ERROR;
+   (void) DynArray_removeAt(oNDir->oDChildren, ulLength);
+   return SUCCESS;
+}
+
+/*
+  Rebuilds the entries of directory oNDir's Fenwick tree for children
+  ulFrom onwards, after a child was linked or unlinked at ulFrom and
+  shifted the ones after it. Each entry is its child's count plus the
+  entries it covers before it, so this takes O((n - ulFrom) log n)
+  time for n children, and appending a child O(log n).
+*/
+static void Node_rebuildFenwick(Node_T oNDir, size_t ulFrom) {
+   size_t ulLength = DynArray_getLength(oNDir->oDChildren);
+   size_t i;
+
+   for(i = ulFrom + 1; i <= ulLength; i++) {
+      Node_T oNChild = DynArray_get(oNDir->oDChildren, i - 1);
+      size_t ulStep;
+      oNDir->pulFenwick[i] = oNChild->ulNodes;
+      for(ulStep = 1; ulStep < (i & (0 - i)); ulStep *= 2)
+         oNDir->pulFenwick[i] += oNDir->pulFenwick[i - ulStep];
+   }
+}
+
+/*
+  Adds ulDelta to the subtree node count of oNNode and of each of its
+  ancestors, and to their Fenwick tree entries, and ulLengthDelta to
+  oNNode's length of the paths below it, and the corresponding amount
+  to its ancestors', in O(depth log fanout) time. Decrements are
+  passed as their (unsigned) negation, relying on size_t arithmetic
+  wrapping around. The lines of all of these subtrees change, so
+  their cached fragments are dropped, and their hashes outdated, on
+  the way up.
+*/
+static void Node_addNodes(Node_T oNNode, size_t ulDelta,
+                          size_t ulLengthDelta) {
+   Node_T oNParent;
+
+   for(;;) {
+      size_t ulPos;
+
+      oNNode->ulNodes += ulDelta;
+      oNNode->ulBelowLength += ulLengthDelta;
+      Node_setFragment(oNNode, NULL, 0);
+      oNNode->bHashIsValid = FALSE;
+      oNParent = oNNode->oNParent;
+      if(oNParent == NULL)
+         break;
+      /* seen from the parent, each path gains this node's name */
+      ulLengthDelta += ulDelta * (strlen(oNNode->pcName) + 1);
+      (void) Node_hasChildName(oNParent, Node_getName(oNNode), &ulPos);
+      for(ulPos++; ulPos <= DynArray_getLength(oNParent->oDChildren);
+          ulPos += ulPos & (0 - ulPos))
+         oNParent->pulFenwick[ulPos] += ulDelta;
+      oNNode = oNParent;
+   }
+}
+
+/* Outdates the hashes of oNNode and its ancestors, stopping at the
+   first that is already outdated, as all above it then are. */
+static void Node_outdateHashes(Node_T oNNode) {
+   for(; oNNode != NULL && oNNode->bHashIsValid;
+       oNNode = oNNode->oNParent)
+      oNNode->bHashIsValid = FALSE;
+}
+
+/* Returns the total length of the paths of the nodes in oNNode's
+   subtree, each taken from just after its parent's name. */
+static size_t Node_getLengthFromParent(Node_T oNNode) {
+   return oNNode->ulNodes * (strlen(oNNode->pcName) + 1) +
+          oNNode->ulBelowLength;
+}
+
+/*
+  Links the unlinked subtree rooted at oNNode under oNParent, which
+  must have room for it (see Node_reserveChild) and no child of the
+  same name, and adds its aggregates and node count to oNParent and
+  its ancestors.
+*/
+static void Node_link(Node_T oNNode, Node_T oNParent) {
+   size_t ulIndex;
+   struct NodeSizes sSizes;
+
+   (void) Node_hasChildName(oNParent, oNNode->pcName, &ulIndex);
+   (void) DynArray_addAt(oNParent->oDChildren, ulIndex, oNNode);
+   oNNode->oNParent = oNParent;
+   Node_getSizes(oNNode, &sSizes);
+   Node_addSizes(oNParent, &sSizes);
+   Node_rebuildFenwick(oNParent, ulIndex);
+   Node_addNodes(oNParent, oNNode->ulNodes,
+                 Node_getLengthFromParent(oNNode));
+}
+
+/*
+  Unlinks the subtree rooted at oNNode, which must not be a root, from
+  its parent, and removes its aggregates and node count from the
+  parent and its ancestors. The parent keeps the room oNNode used.
+*/
+static void Node_unlink(Node_T oNNode) {
+   Node_T oNParent = oNNode->oNParent;
+   size_t ulIndex;
+   struct NodeSizes sSizes;
+
+   if(Node_hasChildName(oNParent, oNNode->pcName, &ulIndex))
+      (void) DynArray_removeAt(oNParent->oDChildren, ulIndex);
+   Node_getSizes(oNNode, &sSizes);
+   Node_removeSizes(oNParent, &sSizes);
+   Node_rebuildFenwick(oNParent, ulIndex);
+   Node_addNodes(oNParent, 0 - oNNode->ulNodes,
+                 0 - Node_getLengthFromParent(oNNode));
+   oNNode->oNParent = NULL;
+}
 
 /*
   Links new child oNChild into oNParent's children array at index
@@ -46,134 +414,118 @@ static int Node_addChild(Node_T oNParent, Node_T oNChild,
 }
 
 /*
-  Compares the string representation of oNfirst with a string
-  pcSecond representing a node's path.
-  Returns <0, 0, or >0 if oNFirst is "less than", "equal to", or
-  "greater than" pcSecond, respectively.
+  Compares the name (final path component) of oNFirst with pcName.
+  Siblings share every other component, so this orders them the same
+  way as Node_compare.
 */
-static int Node_compareString(const Node_T oNFirst,
-                                 const char *pcSecond) {
+static int Node_compareName(const Node_T oNFirst, const char *pcName) {
    assert(oNFirst != NULL);
-   assert(pcSecond != NULL);
+   assert(pcName != NULL);
 
-   return Path_compareString(oNFirst->oPPath, pcSecond); 
+   return strcmp(Node_getName(oNFirst), pcName);
 }
 
-/* compares 2 nodes by their pathnames in lexicographic order */
+/* compares 2 nodes by their paths in path order, climbing from both
+   to the children of their closest common ancestor */
 int Node_compare(Node_T oNFirst, Node_T oNSecond) {
+   size_t ulFirstDepth;
+   size_t ulSecondDepth;
+   int iTie = 0;
+
    assert(oNFirst != NULL);
    assert(oNSecond != NULL);
 
-   return Path_comparePath(oNFirst->oPPath, oNSecond->oPPath);  
+   ulFirstDepth = Node_getDepth(oNFirst);
+   ulSecondDepth = Node_getDepth(oNSecond);
+
+   /* bring both to the same depth; an ancestor precedes its
+      descendants */
+   for(; ulFirstDepth > ulSecondDepth; ulFirstDepth--) {
+      oNFirst = oNFirst->oNParent;
+      iTie = 1;
+   }
+   for(; ulSecondDepth > ulFirstDepth; ulSecondDepth--) {
+      oNSecond = oNSecond->oNParent;
+      iTie = -1;
+   }
+   if(oNFirst == oNSecond)
+      return iTie;
+
+   while(oNFirst->oNParent != oNSecond->oNParent) {
+      oNFirst = oNFirst->oNParent;
+      oNSecond = oNSecond->oNParent;
+   }
+   return strcmp(oNFirst->pcName, oNSecond->pcName);
 }
 
 
 /*
-  Creates a new node with path oPPath and parent oNParent.  Returns an
+  Creates a new node named pcName with parent oNParent.  Returns an
   int SUCCESS status and sets *poNResult to be the new node if
   successful. Otherwise, sets *poNResult to NULL and returns status:
   * MEMORY_ERROR if memory could not be allocated to complete request
-  * CONFLICTING_PATH if oNParent's path is not an ancestor of oPPath
-  * NO_SUCH_PATH if oPPath is of depth 0
-                 or oNParent's path is not oPPath's direct parent
-                 or oNParent is NULL but oPPath is not of depth 1
-  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * NOT_A_DIRECTORY if oNParent is a file
+  * ALREADY_IN_TREE if oNParent already has a child named pcName
 */
-int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, void *pvContents, 
-             size_t ulLength, Node_T *poNResult) {
+int Node_new(const char *pcName, Node_T oNParent, boolean bIsFile,
+             void *pvContents, size_t ulLength, Node_T *poNResult) {
    struct node *psNew;
-   Path_T oPParentPath = NULL;
-   Path_T oPNewPath = NULL;
-   size_t ulParentDepth;
    size_t ulIndex;
+   struct NodeSizes sSizes;
    int iStatus;
 
-   assert(oPPath != NULL);
+   assert(pcName != NULL);
    assert(poNResult != NULL);
    assert(oNParent == NULL || CheckerFT_Node_isValid(oNParent)); 
 
-   /* allocate space for a new node */
-   psNew = malloc(sizeof(struct node));
-   if(psNew == NULL) {
-      *poNResult = NULL;
-      return MEMORY_ERROR;
-   }
-
-   /* set the new node's path */
-   iStatus = Path_dup(oPPath, &oPNewPath);
-   if(iStatus != SUCCESS) {
-      free(psNew);
-      *poNResult = NULL;
-      return iStatus;
-   }
-   psNew->oPPath = oPNewPath;
-
-   /* validate and set the new node's parent */
+   /* validate the new node's place under its parent */
    if(oNParent != NULL) {
-      size_t ulSharedDepth;
-
       /* parent can't be a file */
       if(oNParent->bIsFile) {
-         Path_free(psNew->oPPath);
-         free(psNew);
          *poNResult = NULL;
          return NOT_A_DIRECTORY;
       }
 
-      oPParentPath = oNParent->oPPath;
-      ulParentDepth = Path_getDepth(oPParentPath);
-      ulSharedDepth = Path_getSharedPrefixDepth(psNew->oPPath,
-                                                oPParentPath);
-      
-      /* parent must be an ancestor of child */
-      if(ulSharedDepth < ulParentDepth) {
-         Path_free(psNew->oPPath);
-         free(psNew);
+      /* parent must not already have child with this name */
+      if(Node_hasChildName(oNParent, pcName, &ulIndex)) {
          *poNResult = NULL;
-         return CONFLICTING_PATH;
+         return ALREADY_IN_TREE;
       }
 
-      /* parent must be exactly one level up from child */
-      if(Path_getDepth(psNew->oPPath) != ulParentDepth + 1) {
-         Path_free(psNew->oPPath);
-         free(psNew);
+      /* nor share its children with a snapshot */
+      if(Node_unshare(oNParent) != SUCCESS) {
          *poNResult = NULL;
-         return NO_SUCH_PATH;
+         return MEMORY_ERROR;
       }
+   }
 
-      /* parent must not already have child with this path */
-      if(Node_hasChild(oNParent, oPPath, &ulIndex)) {
-         if(psNew->oDChildren != NULL) {
-            DynArray_free(psNew->oDChildren);
-         }
-         Path_free(psNew->oPPath);
-         free(psNew);
-         *poNResult = NULL;
-         return ALREADY_IN_TREE;
-      } 
+   /* allocate space for a new node */
+   psNew = malloc(sizeof(struct node));
+   if(psNew == NULL) {
+      *poNResult = NULL;
+      return MEMORY_ERROR;
    }
 
-   else {
-      /* new node must be root */
-      /* can only create one "level" at a time */
-      if(Path_getDepth(psNew->oPPath) != 1) {
-         Path_free(psNew->oPPath);
-         free(psNew);
-         *poNResult = NULL;
-         return NO_SUCH_PATH;
-      }
+   /* set the new node's name */
+   psNew->pcName = malloc(strlen(pcName) + 1);
+   if(psNew->pcName == NULL) {
+      free(psNew);
+      *poNResult = NULL;
+      return MEMORY_ERROR;
    }
+   strcpy(psNew->pcName, pcName);
 
    /*initializing file/directory */
 
    /* file */
    psNew->bIsFile = bIsFile;
+   psNew->pulShares = NULL;
    
    if(bIsFile) {
       if(ulLength > 0) {
          psNew->pvContents = malloc(ulLength);
          if(psNew->pvContents== NULL) {
-            Path_free(psNew->oPPath);
+            free(psNew->pcName);
             free(psNew);
             *poNResult = NULL;
             return MEMORY_ERROR;
@@ -194,13 +546,41 @@ int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, void *pvContents,
       psNew->ulLength = 0;
    }
 
+   /* initializing the size aggregates */
+   psNew->ulFiles = 0;
+   psNew->ulMaxSize = 0;
+   psNew->ulMinSize = 0;
+   psNew->pulBuckets = NULL;
+   if(!bIsFile) {
+      psNew->pulBuckets = calloc(NODE_SIZE_BUCKETS, sizeof(size_t));
+      if(psNew->pulBuckets == NULL) {
+         free(psNew->pcName);
+         free(psNew);
+         *poNResult = NULL;
+         return MEMORY_ERROR;
+      }
+   }
+
+   /* initializing the order statistics */
+   psNew->ulNodes = 1;
+   psNew->ulBelowLength = 0;
+   psNew->pulFenwick = NULL;
+   psNew->ulFenwickCap = 0;
+   psNew->pcFragment = NULL;
+   psNew->ulFragmentLength = 0;
+   psNew->ulHash = 0;
+   psNew->bHashIsValid = FALSE;
+   psNew->oNShared = NULL;
+   psNew->psSnapshot = NULL;
+
    /* initializing children */
    psNew->oDChildren = DynArray_new(0);
    if(psNew->oDChildren == NULL) {
       if(psNew->bIsFile && psNew->pvContents != NULL) {
          free(psNew->pvContents);
       }
-      Path_free(psNew->oPPath);
+      free(psNew->pulBuckets);
+      free(psNew->pcName);
       free(psNew);
       *poNResult = NULL;
       return MEMORY_ERROR;
@@ -209,17 +589,24 @@ int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, void *pvContents,
    /* Link into parent's children list */
    psNew->oNParent = oNParent;
    if(oNParent != NULL) { 
-      iStatus = Node_addChild(oNParent, psNew, ulIndex);
+      iStatus = Node_reserveFenwick(oNParent);
+      if(iStatus == SUCCESS)
+         iStatus = Node_addChild(oNParent, psNew, ulIndex);
       if(iStatus != SUCCESS) {
          DynArray_free(psNew->oDChildren);
          if(psNew->bIsFile && psNew->pvContents != NULL) {
             free(psNew->pvContents); 
          }
-         Path_free(psNew->oPPath);
+         free(psNew->pulBuckets);
+         free(psNew->pcName);
          free(psNew);
          *poNResult = NULL;
          return iStatus;
       }
+      Node_getSizes(psNew, &sSizes);
+      Node_addSizes(oNParent, &sSizes);
+      Node_rebuildFenwick(oNParent, ulIndex);
+      Node_addNodes(oNParent, 1, strlen(psNew->pcName) + 1);
    }
    
    *poNResult = psNew;
@@ -231,38 +618,87 @@ int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, void *pvContents,
 }
 
 
-size_t Node_free(Node_T oNNode) {
-   size_t ulIndex;
-   size_t ulCount = 0;
+/*
+  Frees the contents of the file oNNode, unless other files still
+  share them, in which case it just gives up oNNode's share.
+*/
+static void Node_releaseContents(Node_T oNNode) {
+   boolean bIsLast = TRUE;
 
    assert(oNNode != NULL);
-   assert(CheckerFT_Node_isValid(oNNode)); 
 
-   /* remove from parent's list */
-   if(oNNode->oNParent != NULL) {
-      if(DynArray_bsearch(
-            oNNode->oNParent->oDChildren,
-            oNNode, &ulIndex,
-            (int (*)(const void *, const void *)) Node_compare)
-        )
-         (void) DynArray_removeAt(oNNode->oNParent->oDChildren,
-                                  ulIndex);
+   if(oNNode->pvContents == NULL)
+      return;
+   if(oNNode->pulShares != NULL) {
+      (void) pthread_mutex_lock(&oShareLock);
+      bIsLast = (boolean) (--*oNNode->pulShares == 0);
+      (void) pthread_mutex_unlock(&oShareLock);
+   }
+   if(bIsLast) {
+      free(oNNode->pvContents);
+      free(oNNode->pulShares);
    }
+   oNNode->pvContents = NULL;
+   oNNode->pulShares = NULL;
+}
+
+static size_t Node_freeSubtree(Node_T oNNode);
+
+/* Takes one more reference to psSnapshot for a shared directory. */
+static void Node_holdSnapshot(struct NodeSnapshot *psSnapshot) {
+   (void) pthread_mutex_lock(&oShareLock);
+   psSnapshot->ulRefs++;
+   (void) pthread_mutex_unlock(&oShareLock);
+}
 
-   /* recursively remove children (Directory only)*/
-   while(DynArray_getLength(oNNode->oDChildren) != 0) {
-      ulCount += Node_free(DynArray_get(oNNode->oDChildren, 0));
+/* Gives up a shared directory's reference to psSnapshot, freeing it
+   and its frozen subtree (if any yet) with the last one. */
+static void Node_releaseSnapshot(struct NodeSnapshot *psSnapshot) {
+   boolean bIsLast;
+
+   (void) pthread_mutex_lock(&oShareLock);
+   bIsLast = (boolean) (--psSnapshot->ulRefs == 0);
+   (void) pthread_mutex_unlock(&oShareLock);
+   if(bIsLast) {
+      if(psSnapshot->oNRoot != NULL)
+         (void) Node_freeSubtree(psSnapshot->oNRoot);
+      free(psSnapshot);
    }
-   DynArray_free(oNNode->oDChildren);
-   
+}
 
-   /*free file content */
-   if(oNNode->bIsFile && oNNode->pvContents != NULL) {
-      free(oNNode->pvContents);
+/*
+  Frees the subtree rooted at oNNode, which has already been unlinked
+  from its parent. Returns the number of nodes freed, counting a
+  shared directory as the nodes it stands for.
+*/
+static size_t Node_freeSubtree(Node_T oNNode) {
+   size_t ulIndex;
+   size_t ulCount = 0;
+
+   assert(oNNode != NULL);
+
+   /* recursively free children (Directory only)*/
+   if(oNNode->oNShared != NULL) {
+      ulCount = oNNode->ulNodes - 1;
+      Node_releaseSnapshot(oNNode->psSnapshot);
+   }
+   else {
+      for(ulIndex = 0;
+          ulIndex < DynArray_getLength(oNNode->oDChildren); ulIndex++)
+         ulCount += Node_freeSubtree(DynArray_get(oNNode->oDChildren,
+                                                  ulIndex));
+      DynArray_free(oNNode->oDChildren);
    }
 
-   /* remove path */
-   Path_free(oNNode->oPPath);
+   /*free file content, unless other files still share it */
+   if(oNNode->bIsFile)
+      Node_releaseContents(oNNode);
+   free(oNNode->pulBuckets);
+   free(oNNode->pulFenwick);
+   free(oNNode->pcFragment);
+
+   /* remove name */
+   free(oNNode->pcName);
 
    /* finally, free the struct node */
    free(oNNode);
@@ -270,17 +706,105 @@ size_t Node_free(Node_T oNNode) {
    return ulCount;
 }
 
+size_t Node_free(Node_T oNNode) {
+   assert(oNNode != NULL);
+   assert(CheckerFT_Node_isValid(oNNode)); 
+
+   /* remove from parent's list, and the subtree's files from the
+      ancestors' aggregates */
+   if(oNNode->oNParent != NULL)
+      Node_unlink(oNNode);
+
+   return Node_freeSubtree(oNNode);
+}
+
+
+int Node_freeTop(Node_T oNNode, DynArray_T oDOrphans) {
+   size_t ulLength;
+   size_t ulIndex;
+
+   assert(oNNode != NULL);
+   assert(oNNode->oNParent == NULL);
+   assert(oDOrphans != NULL);
+
+   if(oNNode->oNShared != NULL) {
+      (void) Node_freeSubtree(oNNode);
+      return SUCCESS;
+   }
+
+   /* the only step that can fail comes first */
+   ulLength = DynArray_getLength(oDOrphans);
+   for(ulIndex = 0; ulIndex < DynArray_getLength(oNNode->oDChildren);
+       ulIndex++)
+      if(!DynArray_add(oDOrphans,
+                       DynArray_get(oNNode->oDChildren, ulIndex))) {
+         while(DynArray_getLength(oDOrphans) > ulLength)
+            (void) DynArray_removeAt(oDOrphans,
+                                     DynArray_getLength(oDOrphans) - 1);
+         return MEMORY_ERROR;
+      }
+
+   /* cut the children loose, then free what is left */
+   while(DynArray_getLength(oNNode->oDChildren) > 0) {
+      Node_T oNChild = DynArray_removeAt(oNNode->oDChildren,
+                          DynArray_getLength(oNNode->oDChildren) - 1);
+      oNChild->oNParent = NULL;
+   }
+   (void) Node_freeSubtree(oNNode);
+   return SUCCESS;
+}
+
+const char *Node_getName(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return oNNode->pcName;
+}
+
+size_t Node_getDepth(Node_T oNNode) {
+   size_t ulDepth = 0;
 
-Path_T Node_getPath(Node_T oNNode) {
    assert(oNNode != NULL);
-   return oNNode->oPPath;
+
+   for(; oNNode != NULL; oNNode = oNNode->oNParent)
+      ulDepth++;
+   return ulDepth;
+}
+
+size_t Node_getPathLength(Node_T oNNode) {
+   size_t ulLength = 0;
+
+   assert(oNNode != NULL);
+
+   /* each name and the '/' before it, but none before the root's */
+   for(; oNNode != NULL; oNNode = oNNode->oNParent)
+      ulLength += strlen(oNNode->pcName) + 1;
+   return ulLength - 1;
 }
 
-/* files will have 0 children */
-boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
-                         size_t *pulChildID) {
+char *Node_writePath(Node_T oNNode, char *pcDest) {
+   char *pcEnd;
+
+   assert(oNNode != NULL);
+   assert(pcDest != NULL);
+
+   /* fill in the names from the last one back */
+   pcEnd = pcDest + Node_getPathLength(oNNode);
+   *pcEnd = '\0';
+   for(;;) {
+      size_t ulNameLength = strlen(oNNode->pcName);
+      pcEnd -= ulNameLength;
+      memcpy(pcEnd, oNNode->pcName, ulNameLength);
+      oNNode = oNNode->oNParent;
+      if(oNNode == NULL)
+         break;
+      *--pcEnd = '/';
+   }
+   return pcDest;
+}
+
+boolean Node_hasChildName(Node_T oNParent, const char *pcName,
+                          size_t *pulChildID) {
    assert(oNParent != NULL);
-   assert(oPPath != NULL);
+   assert(pcName != NULL);
    assert(pulChildID != NULL);
 
    if(oNParent->bIsFile) {
@@ -288,10 +812,9 @@ boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
       return FALSE;
    }
 
-   /* *pulChildID is the index into oNParent->oDChildren */
-   return DynArray_bsearch(oNParent->oDChildren,
-            (char*) Path_getPathname(oPPath), pulChildID,
-            (int (*)(const void*,const void*)) Node_compareString);
+   return DynArray_bsearch(Node_getHolder(oNParent)->oDChildren,
+            (char *) pcName, pulChildID,
+            (int (*)(const void*,const void*)) Node_compareName);
 }
 
 size_t Node_getNumChildren(Node_T oNParent) {
@@ -299,7 +822,7 @@ size_t Node_getNumChildren(Node_T oNParent) {
    if (oNParent->bIsFile) {
       return 0;
    }
-   return DynArray_getLength(oNParent->oDChildren);
+   return DynArray_getLength(Node_getHolder(oNParent)->oDChildren);
 }
 
 int  Node_getChild(Node_T oNParent, size_t ulChildID,
@@ -318,28 +841,602 @@ int  Node_getChild(Node_T oNParent, size_t ulChildID,
       *poNResult = NULL;
       return NO_SUCH_PATH;
    }
+   else if(Node_unshare(oNParent) != SUCCESS) {
+      *poNResult = NULL;
+      return MEMORY_ERROR;
+   }
    else {
       *poNResult = DynArray_get(oNParent->oDChildren, ulChildID);
       return SUCCESS;
    }
 }
 
+Node_T Node_peekChild(Node_T oNParent, size_t ulChildID) {
+   assert(oNParent != NULL);
+   assert(ulChildID < Node_getNumChildren(oNParent));
+
+   return DynArray_get(Node_getHolder(oNParent)->oDChildren, ulChildID);
+}
+
+boolean Node_isShared(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return (boolean) (oNNode->oNShared != NULL);
+}
+
 Node_T Node_getParent(Node_T oNNode) {
    assert(oNNode != NULL);
    return oNNode->oNParent;
 }
 
 
+int Node_move(Node_T oNNode, Node_T oNNewParent, char **ppcName) {
+   Node_T oNOldParent;
+   Node_T oNAncestor;
+   size_t ulNewIndex;
+   char *pcOldName;
+
+   assert(oNNode != NULL);
+   assert(oNNode->oNParent != NULL);
+   assert(oNNewParent != NULL);
+   assert(ppcName != NULL && *ppcName != NULL);
+   assert(CheckerFT_Node_isValid(oNNode->oNParent));
+
+   if(oNNewParent->bIsFile)
+      return NOT_A_DIRECTORY;
+   for(oNAncestor = oNNewParent; oNAncestor != NULL;
+       oNAncestor = oNAncestor->oNParent)
+      if(oNAncestor == oNNode)
+         return CONFLICTING_PATH;
+   if(Node_hasChildName(oNNewParent, *ppcName, &ulNewIndex))
+      return ALREADY_IN_TREE;
+
+   /* the only steps that can fail come first; a parent the node was
+      just taken from still has room for it */
+   oNOldParent = oNNode->oNParent;
+   if(oNNewParent != oNOldParent &&
+      (Node_unshare(oNNewParent) != SUCCESS ||
+       Node_reserveChild(oNNewParent) != SUCCESS))
+      return MEMORY_ERROR;
+
+   /* unlink, trade names with the caller, and relink */
+   Node_unlink(oNNode);
+   pcOldName = oNNode->pcName;
+   oNNode->pcName = *ppcName;
+   *ppcName = pcOldName;
+   Node_link(oNNode, oNNewParent);
+
+   assert(CheckerFT_Node_isValid(oNOldParent));
+   assert(CheckerFT_Node_isValid(oNNewParent));
+   return SUCCESS;
+}
+
+/* Adds the file aggregates of the subtree rooted at oNSub to the
+   aggregates *psTotal of other subtrees. */
+static void Node_accumulateSizes(struct NodeSizes *psTotal,
+                                 Node_T oNSub) {
+   struct NodeSizes sSizes;
+   size_t ulBucket;
+
+   Node_getSizes(oNSub, &sSizes);
+   if(sSizes.ulFiles == 0)
+      return;
+   if(psTotal->ulFiles == 0 || sSizes.ulMaxSize > psTotal->ulMaxSize)
+      psTotal->ulMaxSize = sSizes.ulMaxSize;
+   if(psTotal->ulFiles == 0 || sSizes.ulMinSize < psTotal->ulMinSize)
+      psTotal->ulMinSize = sSizes.ulMinSize;
+   psTotal->ulFiles += sSizes.ulFiles;
+   for(ulBucket = 0; ulBucket < NODE_SIZE_BUCKETS; ulBucket++)
+      psTotal->aulBuckets[ulBucket] += sSizes.aulBuckets[ulBucket];
+}
+
+int Node_adopt(Node_T oNDir, Node_T oNSrc) {
+   size_t ulDirLength;
+   size_t ulSrcLength;
+   size_t ulMoving = 0;
+   size_t ulMovedNodes = 0;
+   size_t ulMovedLength = 0;
+   size_t ulKept = 0;
+   size_t ulOut = 0;
+   size_t i = 0;
+   size_t j = 0;
+   DynArray_T oDMerged;
+   struct NodeSizes sMoved;
+
+   assert(oNDir != NULL);
+   assert(oNSrc != NULL);
+   assert(!oNDir->bIsFile && !oNSrc->bIsFile);
+   assert(oNDir != oNSrc);
+
+   if(Node_unshare(oNDir) != SUCCESS || Node_unshare(oNSrc) != SUCCESS)
+      return MEMORY_ERROR;
+
+   /* count the children to move in a first pass over both arrays */
+   ulDirLength = DynArray_getLength(oNDir->oDChildren);
+   ulSrcLength = DynArray_getLength(oNSrc->oDChildren);
+   while(j < ulSrcLength) {
+      int iCmp = i == ulDirLength ? 1 :
+         strcmp(((Node_T) DynArray_get(oNDir->oDChildren, i))->pcName,
+                ((Node_T) DynArray_get(oNSrc->oDChildren, j))->pcName);
+      if(iCmp <= 0)
+         i++;
+      if(iCmp >= 0) {
+         if(iCmp > 0)
+            ulMoving++;
+         j++;
+      }
+   }
+   if(ulMoving == 0)
+      return SUCCESS;
+
+   /* the only steps that can fail come first */
+   oDMerged = DynArray_new(ulDirLength + ulMoving);
+   if(oDMerged == NULL)
+      return MEMORY_ERROR;
+   if(oNDir->ulFenwickCap < ulDirLength + ulMoving + 1) {
+      size_t *pulNew = realloc(oNDir->pulFenwick,
+                              (ulDirLength + ulMoving + 1) *
+                              sizeof(size_t));
+      if(pulNew == NULL) {
+         DynArray_free(oDMerged);
+         return MEMORY_ERROR;
+      }
+      oNDir->pulFenwick = pulNew;
+      oNDir->ulFenwickCap = ulDirLength + ulMoving + 1;
+   }
+
+   /* merge the moving children into the new array in order, packing
+      the ones that stay at the front of oNSrc's */
+   memset(&sMoved, 0, sizeof(sMoved));
+   i = 0;
+   j = 0;
+   while(i < ulDirLength || j < ulSrcLength) {
+      Node_T oNOld = i < ulDirLength ?
+         DynArray_get(oNDir->oDChildren, i) : NULL;
+      Node_T oNNew = j < ulSrcLength ?
+         DynArray_get(oNSrc->oDChildren, j) : NULL;
+      int iCmp = oNOld == NULL ? 1 : oNNew == NULL ? -1 :
+         strcmp(oNOld->pcName, oNNew->pcName);
+      if(iCmp <= 0) {
+         (void) DynArray_set(oDMerged, ulOut++, oNOld);
+         i++;
+         if(iCmp == 0)
+            (void) DynArray_set(oNSrc->oDChildren, ulKept++,
+                                DynArray_get(oNSrc->oDChildren, j++));
+      }
+      else {
+         Node_accumulateSizes(&sMoved, oNNew);
+         ulMovedNodes += oNNew->ulNodes;
+         ulMovedLength += Node_getLengthFromParent(oNNew);
+         oNNew->oNParent = oNDir;
+         (void) DynArray_set(oDMerged, ulOut++, oNNew);
+         j++;
+      }
+   }
+   while(DynArray_getLength(oNSrc->oDChildren) > ulKept)
+      (void) DynArray_removeAt(oNSrc->oDChildren,
+                               DynArray_getLength(oNSrc->oDChildren) - 1);
+   DynArray_free(oNDir->oDChildren);
+   oNDir->oDChildren = oDMerged;
+
+   /* rebuild both Fenwick trees, then carry the moved aggregates and
+      node counts from one parent chain to the other */
+   Node_rebuildFenwick(oNDir, 0);
+   Node_rebuildFenwick(oNSrc, 0);
+   Node_removeSizes(oNSrc, &sMoved);
+   Node_addSizes(oNDir, &sMoved);
+   Node_addNodes(oNSrc, 0 - ulMovedNodes, 0 - ulMovedLength);
+   Node_addNodes(oNDir, ulMovedNodes, ulMovedLength);
+
+   assert(CheckerFT_Node_isValid(oNDir));
+   assert(CheckerFT_Node_isValid(oNSrc));
+   return SUCCESS;
+}
+
+void Node_swap(Node_T oNFirst, Node_T oNSecond) {
+   Node_T oNFirstParent;
+   Node_T oNSecondParent;
+
+   assert(oNFirst != NULL);
+   assert(oNSecond != NULL);
+   assert(strcmp(oNFirst->pcName, oNSecond->pcName) == 0);
+
+   oNFirstParent = oNFirst->oNParent;
+   oNSecondParent = oNSecond->oNParent;
+   assert(oNFirstParent != NULL && oNSecondParent != NULL);
+   assert(oNFirstParent != oNSecondParent);
+
+   /* each parent keeps the room of the node it gives up */
+   Node_unlink(oNFirst);
+   Node_unlink(oNSecond);
+   Node_link(oNFirst, oNSecondParent);
+   Node_link(oNSecond, oNFirstParent);
+
+   assert(CheckerFT_Node_isValid(oNFirstParent));
+   assert(CheckerFT_Node_isValid(oNSecondParent));
+}
+
+void Node_detach(Node_T oNNode) {
+   Node_T oNParent;
+
+   assert(oNNode != NULL);
+   assert(oNNode->oNParent != NULL);
+
+   oNParent = oNNode->oNParent;
+   Node_unlink(oNNode);
+
+   assert(CheckerFT_Node_isValid(oNParent));
+   (void) oNParent;
+}
+
+void Node_detachChildren(Node_T oNDir, Node_T *aoNChildren,
+                         size_t ulChildren) {
+   size_t ulLength, ulFirst, ulKept, i;
+   size_t ulGone = 0;
+   size_t ulGoneNodes = 0;
+   size_t ulGoneLength = 0;
+   struct NodeSizes sGone;
+
+   assert(oNDir != NULL);
+   assert(!oNDir->bIsFile);
+   assert(aoNChildren != NULL || ulChildren == 0);
+
+   if(ulChildren == 0)
+      return;
+
+   /* the children before the first to go stay where they are */
+   ulLength = DynArray_getLength(oNDir->oDChildren);
+   (void) Node_hasChildName(oNDir, aoNChildren[0]->pcName, &ulFirst);
+   memset(&sGone, 0, sizeof(sGone));
+   for(i = ulKept = ulFirst; i < ulLength; i++) {
+      Node_T oNChild = DynArray_get(oNDir->oDChildren, i);
+      if(ulGone < ulChildren && oNChild == aoNChildren[ulGone]) {
+         Node_accumulateSizes(&sGone, oNChild);
+         ulGoneNodes += oNChild->ulNodes;
+         ulGoneLength += Node_getLengthFromParent(oNChild);
+         oNChild->oNParent = NULL;
+         ulGone++;
+      }
+      else
+         (void) DynArray_set(oNDir->oDChildren, ulKept++, oNChild);
+   }
+   assert(ulGone == ulChildren);
+   while(DynArray_getLength(oNDir->oDChildren) > ulKept)
+      (void) DynArray_removeAt(oNDir->oDChildren,
+                               DynArray_getLength(oNDir->oDChildren) - 1);
+
+   Node_rebuildFenwick(oNDir, ulFirst);
+   Node_removeSizes(oNDir, &sGone);
+   Node_addNodes(oNDir, 0 - ulGoneNodes, 0 - ulGoneLength);
+
+   assert(CheckerFT_Node_isValid(oNDir));
+}
+
+int Node_attach(Node_T oNNode, Node_T oNParent, char **ppcName) {
+   size_t ulIndex;
+   char *pcOldName;
+
+   assert(oNNode != NULL);
+   assert(oNNode->oNParent == NULL);
+   assert(oNParent != NULL);
+   assert(ppcName == NULL || *ppcName != NULL);
+
+   if(oNParent->bIsFile)
+      return NOT_A_DIRECTORY;
+   if(Node_hasChildName(oNParent, ppcName != NULL ? *ppcName :
+                        oNNode->pcName, &ulIndex))
+      return ALREADY_IN_TREE;
+   if(Node_unshare(oNParent) != SUCCESS ||
+      Node_reserveChild(oNParent) != SUCCESS)
+      return MEMORY_ERROR;
+
+   if(ppcName != NULL) {
+      pcOldName = oNNode->pcName;
+      oNNode->pcName = *ppcName;
+      *ppcName = pcOldName;
+   }
+   Node_link(oNNode, oNParent);
+
+   assert(CheckerFT_Node_isValid(oNParent));
+   return SUCCESS;
+}
+
+/*
+  Makes an unlinked copy named pcName of node oNSrc alone, sharing a
+  file's contents with it. A directory copy shares its children with
+  the snapshot directory that oNSrc does if oNSrc is shared, or else
+  with oNSrc itself, which lies in psSnapshot, unless psSnapshot is
+  NULL, in which case the copy gets room for copies of them and the
+  same Fenwick tree, to be filled in. Returns SUCCESS and sets
+  *poNResult to the copy, or sets it to NULL and returns MEMORY_ERROR.
+*/
+static int Node_copyNode(Node_T oNSrc, const char *pcName,
+                         struct NodeSnapshot *psSnapshot,
+                         Node_T *poNResult) {
+   struct node *psNew;
+   size_t ulChildren = Node_getNumChildren(oNSrc);
+   boolean bShares;
+
+   *poNResult = NULL;
+   if(oNSrc->oNShared != NULL)
+      psSnapshot = oNSrc->psSnapshot;
+   bShares = (boolean) (!oNSrc->bIsFile && psSnapshot != NULL);
+   psNew = malloc(sizeof(struct node));
+   if(psNew == NULL)
+      return MEMORY_ERROR;
+
+   /* aggregates, counts, contents and hashes are the original's */
+   *psNew = *oNSrc;
+   psNew->oNParent = NULL;
+   psNew->oDChildren = NULL;
+   psNew->pvContents = NULL;
+   psNew->pulShares = NULL;
+   psNew->pulBuckets = NULL;
+   psNew->pulFenwick = NULL;
+   psNew->ulFenwickCap = 0;
+   psNew->pcFragment = NULL;
+   psNew->ulFragmentLength = 0;
+   psNew->oNShared = NULL;
+   psNew->psSnapshot = NULL;
+   psNew->pcName = malloc(strlen(pcName) + 1);
+   if(!bShares)
+      psNew->oDChildren = DynArray_new(oNSrc->bIsFile ? 0 : ulChildren);
+   if(!oNSrc->bIsFile) {
+      psNew->pulBuckets = malloc(NODE_SIZE_BUCKETS * sizeof(size_t));
+      if(!bShares && ulChildren > 0) {
+         psNew->pulFenwick = malloc((ulChildren + 1) * sizeof(size_t));
+         psNew->ulFenwickCap = ulChildren + 1;
+      }
+   }
+   else if(oNSrc->pvContents != NULL && oNSrc->pulShares == NULL) {
+      oNSrc->pulShares = malloc(sizeof(size_t));
+      if(oNSrc->pulShares != NULL)
+         *oNSrc->pulShares = 1;
+   }
+   if(psNew->pcName == NULL || (!bShares && psNew->oDChildren == NULL) ||
+      (!oNSrc->bIsFile && psNew->pulBuckets == NULL) ||
+      (psNew->ulFenwickCap > 0 && psNew->pulFenwick == NULL) ||
+      (oNSrc->pvContents != NULL && oNSrc->pulShares == NULL)) {
+      free(psNew->pcName);
+      if(psNew->oDChildren != NULL)
+         DynArray_free(psNew->oDChildren);
+      free(psNew->pulBuckets);
+      free(psNew->pulFenwick);
+      free(psNew);
+      return MEMORY_ERROR;
+   }
+   strcpy(psNew->pcName, pcName);
+   if(!oNSrc->bIsFile) {
+      memcpy(psNew->pulBuckets, oNSrc->pulBuckets,
+             NODE_SIZE_BUCKETS * sizeof(size_t));
+      if(psNew->ulFenwickCap > 0)
+         memcpy(psNew->pulFenwick, oNSrc->pulFenwick,
+                (ulChildren + 1) * sizeof(size_t));
+   }
+   else if(oNSrc->pvContents != NULL) {
+      psNew->pvContents = oNSrc->pvContents;
+      psNew->pulShares = oNSrc->pulShares;
+      (void) pthread_mutex_lock(&oShareLock);
+      (*psNew->pulShares)++;
+      (void) pthread_mutex_unlock(&oShareLock);
+   }
+   if(bShares) {
+      psNew->oNShared = Node_getHolder(oNSrc);
+      psNew->psSnapshot = psSnapshot;
+      Node_holdSnapshot(psSnapshot);
+   }
+
+   *poNResult = psNew;
+   return SUCCESS;
+}
+
+/*
+  Makes an unlinked copy named pcName of the subtree rooted at oNSrc,
+  with its own nodes but sharing each file's contents, and each shared
+  directory's snapshot, with the original. Returns SUCCESS and sets
+  *poNResult to the copy's root, or sets it to NULL and returns
+  MEMORY_ERROR.
+*/
+static int Node_copySubtree(Node_T oNSrc, const char *pcName,
+                            Node_T *poNResult) {
+   Node_T oNNew;
+   size_t ulIndex;
+
+   if(Node_copyNode(oNSrc, pcName, NULL, &oNNew) != SUCCESS) {
+      *poNResult = NULL;
+      return MEMORY_ERROR;
+   }
+
+   /* the children are copied in order into the slots made for them,
+      so they stay sorted */
+   for(ulIndex = 0; oNNew->oNShared == NULL &&
+       ulIndex < DynArray_getLength(oNNew->oDChildren); ulIndex++) {
+      Node_T oNChild = DynArray_get(oNSrc->oDChildren, ulIndex);
+      Node_T oNCopy;
+      if(Node_copySubtree(oNChild, oNChild->pcName, &oNCopy)
+         != SUCCESS) {
+         /* drop the slots not yet filled before freeing the rest */
+         while(DynArray_getLength(oNNew->oDChildren) > ulIndex)
+            (void) DynArray_removeAt(oNNew->oDChildren, ulIndex);
+         (void) Node_freeSubtree(oNNew);
+         *poNResult = NULL;
+         return MEMORY_ERROR;
+      }
+      oNCopy->oNParent = oNNew;
+      (void) DynArray_set(oNNew->oDChildren, ulIndex, oNCopy);
+   }
+
+   *poNResult = oNNew;
+   return SUCCESS;
+}
+
+int Node_unshare(Node_T oNDir) {
+   Node_T oNHolder;
+   struct NodeSnapshot *psSnapshot;
+   DynArray_T oDChildren;
+   size_t *pulFenwick = NULL;
+   size_t ulChildren;
+   size_t ulIndex;
+
+   assert(oNDir != NULL);
+
+   if(oNDir->oNShared == NULL)
+      return SUCCESS;
+
+   /* the children are copied in order, each file sharing its contents
+      and each directory the snapshot */
+   oNHolder = oNDir->oNShared;
+   psSnapshot = oNDir->psSnapshot;
+   ulChildren = DynArray_getLength(oNHolder->oDChildren);
+   oDChildren = DynArray_new(ulChildren);
+   if(ulChildren > 0)
+      pulFenwick = malloc((ulChildren + 1) * sizeof(size_t));
+   if(oDChildren == NULL || (ulChildren > 0 && pulFenwick == NULL)) {
+      if(oDChildren != NULL)
+         DynArray_free(oDChildren);
+      free(pulFenwick);
+      return MEMORY_ERROR;
+   }
+   for(ulIndex = 0; ulIndex < ulChildren; ulIndex++) {
+      Node_T oNChild = DynArray_get(oNHolder->oDChildren, ulIndex);
+      Node_T oNCopy;
+      if(Node_copyNode(oNChild, oNChild->pcName, psSnapshot, &oNCopy)
+         != SUCCESS) {
+         while(ulIndex > 0)
+            (void) Node_freeSubtree(DynArray_get(oDChildren, --ulIndex));
+         DynArray_free(oDChildren);
+         free(pulFenwick);
+         return MEMORY_ERROR;
+      }
+      oNCopy->oNParent = oNDir;
+      (void) DynArray_set(oDChildren, ulIndex, oNCopy);
+   }
+
+   /* the counts below are the snapshot's, and so is the Fenwick tree */
+   if(ulChildren > 0)
+      memcpy(pulFenwick, oNHolder->pulFenwick,
+             (ulChildren + 1) * sizeof(size_t));
+   oNDir->oDChildren = oDChildren;
+   oNDir->pulFenwick = pulFenwick;
+   oNDir->ulFenwickCap = ulChildren > 0 ? ulChildren + 1 : 0;
+   oNDir->oNShared = NULL;
+   oNDir->psSnapshot = NULL;
+   Node_releaseSnapshot(psSnapshot);
+
+   assert(CheckerFT_Node_isValid(oNDir));
+   return SUCCESS;
+}
+
+int Node_clone(Node_T oNSrc, Node_T oNNewParent, const char *pcName,
+               Node_T *poNResult) {
+   size_t ulIndex;
+   int iStatus;
+
+   assert(oNSrc != NULL);
+   assert(oNNewParent != NULL);
+   assert(pcName != NULL);
+   assert(poNResult != NULL);
+
+   *poNResult = NULL;
+   if(oNNewParent->bIsFile)
+      return NOT_A_DIRECTORY;
+   if(Node_hasChildName(oNNewParent, pcName, &ulIndex))
+      return ALREADY_IN_TREE;
+
+   iStatus = Node_unshare(oNNewParent);
+   if(iStatus == SUCCESS)
+      iStatus = Node_reserveChild(oNNewParent);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Node_copySubtree(oNSrc, pcName, poNResult);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   Node_link(*poNResult, oNNewParent);
+
+   assert(CheckerFT_Node_isValid(oNNewParent));
+   assert(CheckerFT_Node_isValid(*poNResult));
+   return SUCCESS;
+}
+
+int Node_share(Node_T oNSrc, Node_T oNNewParent, const char *pcName,
+               Node_T *poNResult) {
+   struct NodeSnapshot *psSnapshot;
+   Node_T oNStandIn;
+   Node_T oNAncestor;
+   size_t ulIndex;
+   int iStatus;
+
+   assert(oNSrc != NULL);
+   assert(oNNewParent != NULL);
+   assert(pcName != NULL);
+   assert(poNResult != NULL);
+
+   /* a file, a directory already shared, or one that cannot be
+      frozen in place costs no more to clone */
+   for(oNAncestor = oNNewParent; oNAncestor != NULL &&
+       oNAncestor != oNSrc; oNAncestor = oNAncestor->oNParent)
+      ;
+   if(oNSrc->bIsFile || oNSrc->oNShared != NULL ||
+      oNSrc->oNParent == NULL || oNAncestor == oNSrc)
+      return Node_clone(oNSrc, oNNewParent, pcName, poNResult);
+
+   *poNResult = NULL;
+   if(oNNewParent->bIsFile)
+      return NOT_A_DIRECTORY;
+   if(Node_hasChildName(oNNewParent, pcName, &ulIndex))
+      return ALREADY_IN_TREE;
+
+   /* the steps that can fail come first: the snapshot does not take
+      oNSrc until both shared directories exist */
+   iStatus = Node_unshare(oNNewParent);
+   if(iStatus == SUCCESS)
+      iStatus = Node_reserveChild(oNNewParent);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   psSnapshot = malloc(sizeof(struct NodeSnapshot));
+   if(psSnapshot == NULL)
+      return MEMORY_ERROR;
+   psSnapshot->oNRoot = NULL;
+   psSnapshot->ulRefs = 1;
+   if(Node_copyNode(oNSrc, oNSrc->pcName, psSnapshot, &oNStandIn)
+      != SUCCESS) {
+      free(psSnapshot);
+      return MEMORY_ERROR;
+   }
+   if(Node_copyNode(oNSrc, pcName, psSnapshot, poNResult) != SUCCESS) {
+      (void) Node_freeSubtree(oNStandIn);
+      Node_releaseSnapshot(psSnapshot);
+      return MEMORY_ERROR;
+   }
+   Node_releaseSnapshot(psSnapshot);
+
+   /* the stand-in takes oNSrc's place, with the same counts and lines,
+      so its parent's Fenwick tree and the fragments above hold */
+   (void) Node_hasChildName(oNSrc->oNParent, oNSrc->pcName, &ulIndex);
+   (void) DynArray_set(oNSrc->oNParent->oDChildren, ulIndex, oNStandIn);
+   oNStandIn->oNParent = oNSrc->oNParent;
+   oNStandIn->pcFragment = oNSrc->pcFragment;
+   oNStandIn->ulFragmentLength = oNSrc->ulFragmentLength;
+   oNSrc->pcFragment = NULL;
+   oNSrc->ulFragmentLength = 0;
+   oNSrc->oNParent = NULL;
+   psSnapshot->oNRoot = oNSrc;
+   Node_link(*poNResult, oNNewParent);
+
+   assert(CheckerFT_Node_isValid(oNStandIn->oNParent));
+   assert(CheckerFT_Node_isValid(oNNewParent));
+   return SUCCESS;
+}
+
 char *Node_toString(Node_T oNNode) {
    char *copyPath;
 
    assert(oNNode != NULL);
 
-   copyPath = malloc(Path_getStrLength(Node_getPath(oNNode))+1);
+   copyPath = malloc(Node_getPathLength(oNNode)+1);
    if(copyPath == NULL)
       return NULL;
    else
-      return strcpy(copyPath, Path_getPathname(Node_getPath(oNNode)));
+      return Node_writePath(oNNode, copyPath);
 }
 
 /* for file */
@@ -368,6 +1465,77 @@ size_t Node_getFileLength(Node_T oNNode) {
    }
 }
 
+int Node_takeFileContents(Node_T oNNode, void *pvContents,
+                          size_t ulLength, void **ppvOld) {
+   void *pvOldContents;
+   struct NodeSizes sOldSizes, sNewSizes;
+
+   assert(oNNode != NULL);
+   assert(ppvOld != NULL);
+   assert(CheckerFT_Node_isValid(oNNode));
+
+   *ppvOld = NULL;
+   if(!oNNode->bIsFile)
+      return NOT_A_FILE;
+
+   /* store old contents to return later; contents still shared with
+      other files stay theirs, and the caller gets a copy */
+   pvOldContents = oNNode->pvContents;
+   if(oNNode->pulShares != NULL) {
+      /* the copy is made first, in case the others go meanwhile */
+      if(oNNode->ulLength > 0) {
+         pvOldContents = malloc(oNNode->ulLength);
+         if(pvOldContents == NULL)
+            return MEMORY_ERROR;
+         memcpy(pvOldContents, oNNode->pvContents, oNNode->ulLength);
+      }
+      else
+         pvOldContents = NULL;
+      (void) pthread_mutex_lock(&oShareLock);
+      if(--*oNNode->pulShares == 0) {
+         /* no other file shares them after all: the caller gets the
+            original */
+         free(oNNode->pulShares);
+         free(pvOldContents);
+         pvOldContents = oNNode->pvContents;
+      }
+      (void) pthread_mutex_unlock(&oShareLock);
+   }
+   oNNode->pulShares = NULL;
+
+   /* the ancestors' aggregates see the old size go and the new come */
+   Node_getSizes(oNNode, &sOldSizes);
+   oNNode->pvContents = pvContents;
+   oNNode->ulLength = ulLength;
+   Node_removeSizes(oNNode->oNParent, &sOldSizes);
+   Node_getSizes(oNNode, &sNewSizes);
+   Node_addSizes(oNNode->oNParent, &sNewSizes);
+   Node_outdateHashes(oNNode);
+   assert(CheckerFT_Node_isValid(oNNode));
+
+   *ppvOld = pvOldContents;
+   return SUCCESS;
+}
+
+void Node_restoreFileContents(Node_T oNNode, void *pvContents,
+                              size_t ulLength) {
+   struct NodeSizes sOldSizes, sNewSizes;
+
+   assert(oNNode != NULL);
+   assert(oNNode->bIsFile);
+   assert(CheckerFT_Node_isValid(oNNode));
+
+   Node_getSizes(oNNode, &sOldSizes);
+   Node_releaseContents(oNNode);
+   oNNode->pvContents = pvContents;
+   oNNode->ulLength = ulLength;
+   Node_removeSizes(oNNode->oNParent, &sOldSizes);
+   Node_getSizes(oNNode, &sNewSizes);
+   Node_addSizes(oNNode->oNParent, &sNewSizes);
+   Node_outdateHashes(oNNode);
+   assert(CheckerFT_Node_isValid(oNNode));
+}
+
 void *Node_replaceFileContents(Node_T oNNode, void *pvNewContents, 
                               size_t ulNewLength) {
    void *pvOldContents;
@@ -380,30 +1548,156 @@ void *Node_replaceFileContents(Node_T oNNode, void *pvNewContents,
       return NULL;
    }
 
-   /* store old contents to return later */
-   pvOldContents = oNNode->pvContents;
-
    if(ulNewLength == 0) {
       /* don't need to allocate */
-      oNNode->pvContents = NULL;
-      oNNode->ulLength = 0;
-      
-      /*if (pvOldContents !=NULL) {
-         free(pvOldContents);
-      } */
-      assert(CheckerFT_Node_isValid(oNNode));
-      return pvOldContents;
+      pvNew = NULL;
+   }
+   else {
+      /* replace with new contents */
+      pvNew = malloc(ulNewLength);
+      if(pvNew == NULL) {
+         return NULL;
+      }
+      memcpy(pvNew, pvNewContents, ulNewLength);
    }
 
-   /* replace with new contents */
-   pvNew = malloc(ulNewLength);
-   if(pvNew == NULL) {
+   if(Node_takeFileContents(oNNode, pvNew, ulNewLength,
+                            &pvOldContents) != SUCCESS) {
+      free(pvNew);
       return NULL;
    }
-   memcpy(pvNew, pvNewContents, ulNewLength);
-   oNNode->pvContents = pvNew;
-   oNNode->ulLength = ulNewLength;
-   assert(CheckerFT_Node_isValid(oNNode));
-
    return pvOldContents;
 }
+
+size_t Node_getIndexSlot(Node_T oNNode, size_t ulSlot) {
+   assert(oNNode != NULL);
+   assert(ulSlot < NODE_INDEX_SLOTS);
+   return oNNode->aulIndexSlots[ulSlot];
+}
+
+void Node_setIndexSlot(Node_T oNNode, size_t ulSlot, size_t ulValue) {
+   assert(oNNode != NULL);
+   assert(ulSlot < NODE_INDEX_SLOTS);
+   oNNode->aulIndexSlots[ulSlot] = ulValue;
+}
+
+size_t Node_getNumNodes(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return oNNode->ulNodes;
+}
+
+size_t Node_getBelowLength(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return oNNode->ulBelowLength;
+}
+
+const char *Node_getFragment(Node_T oNNode, size_t *pulLength) {
+   assert(oNNode != NULL);
+   assert(pulLength != NULL);
+   *pulLength = oNNode->ulFragmentLength;
+   return oNNode->pcFragment;
+}
+
+void Node_setFragment(Node_T oNNode, char *pcFragment,
+                      size_t ulLength) {
+   assert(oNNode != NULL);
+   assert(pcFragment == NULL || !oNNode->bIsFile);
+   if(oNNode->pcFragment == pcFragment)
+      return;
+   free(oNNode->pcFragment);
+   oNNode->pcFragment = pcFragment;
+   oNNode->ulFragmentLength = pcFragment != NULL ? ulLength : 0;
+}
+
+/* Returns ulHash extended by the FNV-1a hash of the ulLength bytes at
+   pvBytes. */
+static size_t Node_hashBytes(size_t ulHash, const void *pvBytes,
+                             size_t ulLength) {
+   const unsigned char *pucBytes = pvBytes;
+   size_t i;
+
+   for(i = 0; i < ulLength; i++)
+      ulHash = (ulHash ^ pucBytes[i]) * ulHashPrime;
+   return ulHash;
+}
+
+size_t Node_getHash(Node_T oNNode) {
+   size_t ulHash;
+   size_t ulIndex;
+
+   assert(oNNode != NULL);
+
+   if(oNNode->bHashIsValid)
+      return oNNode->ulHash;
+
+   /* a tag keeps an empty file apart from an empty directory, and each
+      name's '\0' keeps it apart from the hash after it */
+   if(oNNode->bIsFile) {
+      ulHash = Node_hashBytes(ulHashBasis, "f", 1);
+      ulHash = Node_hashBytes(ulHash, oNNode->pvContents,
+                              oNNode->ulLength);
+   }
+   else {
+      DynArray_T oDChildren = Node_getHolder(oNNode)->oDChildren;
+      ulHash = Node_hashBytes(ulHashBasis, "d", 1);
+      for(ulIndex = 0;
+          ulIndex < DynArray_getLength(oDChildren); ulIndex++) {
+         Node_T oNChild = DynArray_get(oDChildren, ulIndex);
+         size_t ulChildHash = Node_getHash(oNChild);
+         ulHash = Node_hashBytes(ulHash, oNChild->pcName,
+                                 strlen(oNChild->pcName) + 1);
+         ulHash = Node_hashBytes(ulHash, &ulChildHash,
+                                 sizeof(ulChildHash));
+      }
+   }
+   oNNode->ulHash = ulHash;
+   oNNode->bHashIsValid = TRUE;
+   return ulHash;
+}
+
+boolean Node_hasHash(Node_T oNNode) {
+   assert(oNNode != NULL);
+   return oNNode->bHashIsValid;
+}
+
+size_t Node_getNodesBefore(Node_T oNParent, size_t ulChildID) {
+   size_t *pulFenwick;
+   size_t ulSum = 0;
+
+   assert(oNParent != NULL);
+   assert(ulChildID <= Node_getNumChildren(oNParent));
+
+   pulFenwick = Node_getHolder(oNParent)->pulFenwick;
+   for(; ulChildID > 0; ulChildID -= ulChildID & (0 - ulChildID))
+      ulSum += pulFenwick[ulChildID];
+   return ulSum;
+}
+
+size_t Node_findChildByNodes(Node_T oNParent, size_t ulK,
+                             size_t *pulBefore) {
+   size_t *pulFenwick;
+   size_t ulLength;
+   size_t ulStep = 1;
+   size_t ulPos = 0;
+   size_t ulLeft = ulK;
+
+   assert(oNParent != NULL);
+   assert(pulBefore != NULL);
+   assert(ulK + 1 < oNParent->ulNodes);
+
+   pulFenwick = Node_getHolder(oNParent)->pulFenwick;
+   /* descend the Fenwick tree, skipping whole blocks of children that
+      all fall before the sought node */
+   ulLength = Node_getNumChildren(oNParent);
+   while(2 * ulStep <= ulLength)
+      ulStep *= 2;
+   for(; ulStep > 0; ulStep /= 2)
+      if(ulPos + ulStep <= ulLength &&
+         pulFenwick[ulPos + ulStep] <= ulLeft) {
+         ulPos += ulStep;
+         ulLeft -= pulFenwick[ulPos];
+      }
+
+   *pulBefore = ulK - ulLeft;
+   return ulPos;
+}
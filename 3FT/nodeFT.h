@@ -8,29 +8,35 @@
 
 #include <stddef.h>
 #include "a4def.h"
-#include "path.h"
+#include "dynarray.h"
 
 
 /* A Node_T is a node in a File Tree(directory or file) */
 typedef struct node *Node_T;
 
+/* Number of file size buckets kept per directory */
+enum { NODE_SIZE_BUCKETS = 17 };
+
+/* Number of per-node slots that inverted indexes may use for their
+   own bookkeeping (see nameIndex.h) */
+enum { NODE_INDEX_SLOTS = 3 };
+
 /*
-  Creates a new node in the File Tree, with path oPPath,parent oNParent. 
-  and the node type;
+  Creates a new node named pcName, the final component of its path,
+  as a child of oNParent, or as a root if oNParent is NULL, and of
+  the given type:
   * for directory; bIsFile = False, pvContents = NULL, ulLength = 0
   * for files; bIsFile = True, pvContents and ulLength depend on the file node
-  Returns an int SUCCESS status and sets *poNResult
-  to be the new node if successful. Otherwise, sets *poNResult to NULL
-  and returns status:
+  Nodes store only their names, so a node's path is that of its
+  parent followed by its name. Returns an int SUCCESS status and sets
+  *poNResult to be the new node if successful. Otherwise, sets
+  *poNResult to NULL and returns status:
   * MEMORY_ERROR if memory could not be allocated to complete request
-  * CONFLICTING_PATH if oNParent's path is not an ancestor of oPPath
-  * NO_SUCH_PATH if oPPath is of depth 0
-                 or oNParent's path is not oPPath's direct parent
-                 or oNParent is NULL but oPPath is not of depth 1
-  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * NOT_A_DIRECTORY if oNParent is a file
+  * ALREADY_IN_TREE if oNParent already has a child named pcName
 */
-int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, void *pvContents, 
-             size_t ulLength, Node_T *poNResult);
+int Node_new(const char *pcName, Node_T oNParent, boolean bIsFile,
+             void *pvContents, size_t ulLength, Node_T *poNResult);
 
 /*
   Destroys and frees all memory allocated for the subtree rooted at
@@ -40,21 +46,48 @@ int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, void *pvContents,
 */
 size_t Node_free(Node_T oNNode);
 
-/* Returns the path object representing oNNode's absolute path. */
-Path_T Node_getPath(Node_T oNNode);
+/*
+  Frees oNNode, which must be a root, but not its subtree: each of its
+  children becomes a root in turn and is appended to oDOrphans, so
+  that a large subtree can be freed a few nodes at a time; a shared
+  directory is freed whole, along with its snapshot if no other
+  directory shares it. Files' share counts and snapshots' holds are
+  updated under a lock, so this may run on another thread than the
+  one using the rest of the nodes. Returns SUCCESS, or leaves
+  everything unchanged and returns MEMORY_ERROR if oDOrphans could not
+  grow.
+*/
+int Node_freeTop(Node_T oNNode, DynArray_T oDOrphans);
+
+/* Returns oNNode's name, the final component of its path. */
+const char *Node_getName(Node_T oNNode);
+
+/* Returns the number of components in oNNode's path, 1 for a root. */
+size_t Node_getDepth(Node_T oNNode);
+
+/* Returns the length of oNNode's absolute path, found by walking up
+   to the root. */
+size_t Node_getPathLength(Node_T oNNode);
+
+/*
+  Writes oNNode's absolute path, with its terminating '\0', into
+  pcDest, which must have room for Node_getPathLength(oNNode) + 1
+  characters. Returns pcDest.
+*/
+char *Node_writePath(Node_T oNNode, char *pcDest);
 
 /*
   (just for directory nodes)
-  Returns TRUE if oNParent has a child with path oPPath. Returns
-  FALSE if it does not.
+  Returns TRUE if oNParent has a child named pcName. Returns FALSE if
+  it does not.
 
   If oNParent has such a child, stores in *pulChildID the child's
   identifier (as used in Node_getChild). If oNParent does not have
   such a child, stores in *pulChildID the identifier that such a
   child _would_ have if inserted.
 */
-boolean Node_hasChild(Node_T oNParent, Path_T oPPath,
-                         size_t *pulChildID);
+boolean Node_hasChildName(Node_T oNParent, const char *pcName,
+                          size_t *pulChildID);
 
 /* 
 (just for directory nodes)
@@ -65,13 +98,40 @@ size_t Node_getNumChildren(Node_T oNParent);
 /*
   (just for directory nodes)
   Returns an int SUCCESS status and sets *poNResult to be the child
-  node of oNParent with identifier ulChildID, if one exists.
-  Otherwise, sets *poNResult to NULL and returns status:
+  node of oNParent with identifier ulChildID, if one exists, first
+  unsharing oNParent (see Node_unshare). Otherwise, sets *poNResult
+  to NULL and returns status:
   * NO_SUCH_PATH if ulChildID is not a valid child for oNParent
+  * MEMORY_ERROR if memory could not be allocated to unshare oNParent
 */
 int Node_getChild(Node_T oNParent, size_t ulChildID,
                   Node_T *poNResult);
 
+/*
+  (just for directory nodes)
+  Returns the child of oNParent with identifier ulChildID, which must
+  be valid, without unsharing oNParent. If oNParent is shared, the
+  child is the snapshot's: its name, kind, contents, aggregates and
+  children are right, but its parent and path are not, and it must
+  not be changed.
+*/
+Node_T Node_peekChild(Node_T oNParent, size_t ulChildID);
+
+/*
+  Returns TRUE if oNNode is a directory still sharing its children
+  with a snapshot (see Node_share), and FALSE otherwise.
+*/
+boolean Node_isShared(Node_T oNNode);
+
+/*
+  Gives the shared directory oNDir children of its own: a node for
+  each of the snapshot's, a file sharing its contents and a directory
+  sharing its own children in turn. Does nothing if oNDir is not
+  shared. Returns SUCCESS, or leaves oNDir shared and returns
+  MEMORY_ERROR.
+*/
+int Node_unshare(Node_T oNDir);
+
 /*
   Returns a the parent node of oNNode.
   Returns NULL if oNNode is the root and thus has no parent.
@@ -79,12 +139,111 @@ int Node_getChild(Node_T oNParent, size_t ulChildID,
 Node_T Node_getParent(Node_T oNNode);
 
 /*
-  Compares oNFirst and oNSecond lexicographically based on their paths.
-  Returns <0, 0, or >0 if onFirst is "less than", "equal to", or
-  "greater than" oNSecond, respectively.
+  Compares oNFirst and oNSecond by their paths in path order: name by
+  name from the root, with a node preceding its descendants. Returns
+  <0, 0, or >0 if onFirst is "less than", "equal to", or "greater
+  than" oNSecond, respectively.
 */
 int Node_compare(Node_T oNFirst, Node_T oNSecond);
 
+/*
+  Moves the subtree rooted at oNNode, which must not be a root, to be
+  a child of oNNewParent named *ppcName, a string allocated with
+  malloc that the node takes over; its old name is handed back in
+  *ppcName. The size aggregates and order statistics of both parent
+  chains are updated, in O(depth log fanout) time plus the shifting
+  of the two children arrays, independent of the subtree's size.
+  Moving a node back to where it came from cannot fail. Returns
+  SUCCESS, or leaves everything unchanged and returns status:
+  * NOT_A_DIRECTORY if oNNewParent is a file
+  * CONFLICTING_PATH if oNNewParent is oNNode or one of its descendants
+  * ALREADY_IN_TREE if oNNewParent already has a child named *ppcName
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_move(Node_T oNNode, Node_T oNNewParent, char **ppcName);
+
+/*
+  Unlinks the subtree rooted at oNNode, which must not be a root, from
+  its parent, making oNNode a root of its own, and removes its
+  aggregates and node count from its former ancestors, in O(depth log
+  fanout) time plus the shifting of the parent's children array.
+*/
+void Node_detach(Node_T oNNode);
+
+/*
+  Detaches the ulChildren children of directory oNDir at aoNChildren,
+  which must be in the order of oNDir's children, as Node_detach does
+  each, but in one pass that compacts oNDir's children array from the
+  first of them on, and carries their aggregates and node counts up
+  the parent chain once. oNDir keeps the room they used, so attaching
+  them back cannot fail. Cannot fail.
+*/
+void Node_detachChildren(Node_T oNDir, Node_T *aoNChildren,
+                         size_t ulChildren);
+
+/*
+  Links the subtree rooted at oNNode, which must be a root, as a child
+  of oNParent, which must not lie in that subtree. If ppcName is not
+  NULL, the node is renamed *ppcName, a string allocated with malloc
+  that the node takes over, and its old name is handed back in
+  *ppcName. Takes the time Node_detach does. Attaching a node back to
+  the parent it was detached from, as that parent was left, cannot
+  fail. Returns SUCCESS, or leaves everything unchanged and returns
+  status:
+  * NOT_A_DIRECTORY if oNParent is a file
+  * ALREADY_IN_TREE if oNParent already has a child named *ppcName
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_attach(Node_T oNNode, Node_T oNParent, char **ppcName);
+
+/*
+  Moves every child of directory oNSrc that has no namesake among the
+  children of directory oNDir to oNDir, subtree and all, merging the
+  two sorted children arrays in one pass: O(m + n) time for m and n
+  children, plus O(depth log fanout) to carry the moved aggregates
+  and node counts between the two parent chains. Children whose names
+  clash stay in oNSrc. oNDir may not lie within oNSrc.
+  Returns SUCCESS, or leaves everything unchanged and returns
+  MEMORY_ERROR if memory could not be allocated to complete request.
+*/
+int Node_adopt(Node_T oNDir, Node_T oNSrc);
+
+/*
+  Exchanges oNFirst and oNSecond, which have the same name but
+  different parents, with their subtrees, so that each takes the
+  other's place. Neither may be a root or lie within the other. Cannot
+  fail.
+*/
+void Node_swap(Node_T oNFirst, Node_T oNSecond);
+
+/*
+  Copies the subtree rooted at oNSrc to be a new child of oNNewParent
+  named pcName. The copy gets nodes of its own, but each of its files
+  shares its contents with the original until one of them has its
+  contents replaced, so no contents are copied. Returns SUCCESS and
+  sets *poNResult to the copy. Otherwise, leaves everything unchanged,
+  sets *poNResult to NULL and returns status:
+  * NOT_A_DIRECTORY if oNNewParent is a file
+  * ALREADY_IN_TREE if oNNewParent already has a child named pcName
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_clone(Node_T oNSrc, Node_T oNNewParent, const char *pcName,
+               Node_T *poNResult);
+
+/*
+  Copies the subtree rooted at oNSrc like Node_clone, but in time
+  independent of its size when oNSrc is a directory with a parent:
+  the subtree becomes a snapshot that is no longer changed, and both
+  oNSrc's place and the copy get shared directories reading their
+  children from it, which are unshared a level at a time as they or
+  their descendants are changed. oNSrc itself leaves the tree; a
+  directory of the same name and subtree stands in its place. Clones
+  instead if oNSrc is a file, a shared directory, the root, or an
+  ancestor of oNNewParent. Returns as Node_clone does.
+*/
+int Node_share(Node_T oNSrc, Node_T oNNewParent, const char *pcName,
+               Node_T *poNResult);
+
 /*
   Returns a string representation for oNNode, or NULL if
   there is an allocation error.
@@ -111,8 +270,136 @@ size_t Node_getFileLength(Node_T oNNode);
   Replaces current contents of the file node oNNode with pvNewContents
   of size ulNewLength. Returns a pointer to the old contents if successful.
   otherwise returns NULL if direcotry or if there's an allocation error.
+  If the old contents are still shared with copies (see Node_clone),
+  they stay with those, and the pointer returned is to a copy.
 */
 void *Node_replaceFileContents(Node_T oNNode, void *pvNewContents,
                              size_t ulNewLength);
 
+/*
+  Like Node_replaceFileContents, but makes file oNNode take over
+  pvContents, allocated with malloc (or NULL if ulLength is 0), rather
+  than a copy, and sets *ppvOld to the old contents. The copy of
+  shared contents is the only allocation, so a file whose contents
+  are not shared cannot fail. Returns SUCCESS, or leaves oNNode
+  unchanged, sets *ppvOld to NULL and returns status:
+  * NOT_A_FILE if oNNode is a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Node_takeFileContents(Node_T oNNode, void *pvContents,
+                          size_t ulLength, void **ppvOld);
+
+/*
+  Makes the file oNNode take over pvContents, allocated with malloc
+  (or NULL if ulLength is 0), and frees its current contents, or just
+  gives up its share of them if other files still share them. Unlike
+  Node_takeFileContents it never copies, so it cannot fail, which
+  suits putting back contents that an undo log kept.
+*/
+void Node_restoreFileContents(Node_T oNNode, void *pvContents,
+                              size_t ulLength);
+
+/*
+  Returns the size bucket of a file of ulSize bytes: 0 for empty
+  files, and otherwise one more than the number of whole hexadecimal
+  digits needed for ulSize, so bucket b holds sizes in [16^(b-1), 16^b).
+*/
+size_t Node_getSizeBucket(size_t ulSize);
+
+/*
+  Size aggregates over the files in the subtree rooted at oNNode,
+  maintained incrementally as files are added, removed or replaced.
+  A file counts as a subtree holding just itself. The largest and
+  smallest sizes are 0 if the subtree holds no files.
+*/
+
+/* Returns the number of files in oNNode's subtree. */
+size_t Node_getNumFiles(Node_T oNNode);
+
+/* Returns the size of the largest file in oNNode's subtree. */
+size_t Node_getMaxFileSize(Node_T oNNode);
+
+/* Returns the size of the smallest file in oNNode's subtree. */
+size_t Node_getMinFileSize(Node_T oNNode);
+
+/* Returns the number of files in oNNode's subtree whose size falls in
+   bucket ulBucket, which must be less than NODE_SIZE_BUCKETS. */
+size_t Node_getBucketCount(Node_T oNNode, size_t ulBucket);
+
+/*
+  Returns FALSE if the aggregates prove that no file in oNNode's
+  subtree has a size in [ulMin, ulMax], and TRUE otherwise.
+*/
+boolean Node_mayHaveSizeIn(Node_T oNNode, size_t ulMin, size_t ulMax);
+
+/* Returns the value oNNode holds in index slot ulSlot, which must be
+   less than NODE_INDEX_SLOTS. */
+size_t Node_getIndexSlot(Node_T oNNode, size_t ulSlot);
+
+/* Stores ulValue in oNNode's index slot ulSlot. */
+void Node_setIndexSlot(Node_T oNNode, size_t ulSlot, size_t ulValue);
+
+/*
+  Order statistics, maintained on every link and unlink: each node
+  counts the nodes in its subtree, and each directory keeps a Fenwick
+  tree over its children's counts, so that the number of nodes below
+  the children before a given one is found in O(log fanout) time.
+*/
+
+/* Returns the number of nodes in oNNode's subtree, itself included. */
+size_t Node_getNumNodes(Node_T oNNode);
+
+/*
+  Returns the total length of the paths of the nodes strictly below
+  oNNode, each taken from just after oNNode's name (so starting with
+  '/'). Like the node count it is kept up to date on every link and
+  unlink, and does not depend on oNNode's own name or position.
+*/
+size_t Node_getBelowLength(Node_T oNNode);
+
+/*
+  Returns the fragment cached on directory oNNode by Node_setFragment,
+  or NULL if there is none, and sets *pulLength to its length.
+*/
+const char *Node_getFragment(Node_T oNNode, size_t *pulLength);
+
+/*
+  Caches on directory oNNode the ulLength bytes at pcFragment, taking
+  ownership of them, in place of (and freeing) any fragment cached
+  before; a NULL pcFragment just drops it. The node keeps its fragment
+  until then, or until it or a descendant gains or loses a child,
+  which drops it, so a fragment made of the subtree's lines stays
+  true to them for as long as the subtree's path does.
+*/
+void Node_setFragment(Node_T oNNode, char *pcFragment,
+                      size_t ulLength);
+
+/*
+  Returns the hash of oNNode's subtree: of a file's contents, or of a
+  directory's children's names and hashes, in order. Neither oNNode's
+  name nor its position enters it, so subtrees with the same contents
+  under any names have the same hash. Hashes are kept on the nodes and
+  outdated along the parent chain by every change, so this takes O(1)
+  time for an unchanged subtree, and otherwise rehashes only the
+  outdated directories' children lists and files' contents.
+*/
+size_t Node_getHash(Node_T oNNode);
+
+/* Returns whether oNNode's hash is up to date, which its children's
+   then are too. */
+boolean Node_hasHash(Node_T oNNode);
+
+/* Returns the total number of nodes in the subtrees of oNParent's
+   children with identifiers less than ulChildID. */
+size_t Node_getNodesBefore(Node_T oNParent, size_t ulChildID);
+
+/*
+  Numbering the nodes below oNParent from 0 in pre-order, returns the
+  identifier of the child of oNParent whose subtree holds node ulK,
+  which must be less than Node_getNumNodes(oNParent) - 1, and sets
+  *pulBefore to Node_getNodesBefore of that child.
+*/
+size_t Node_findChildByNodes(Node_T oNParent, size_t ulK,
+                             size_t *pulBefore);
+
 #endif /* NODEFT_INCLUDED */
@@ -0,0 +1,375 @@
+/*--------------------------------------------------------------------*/
+/* tar.c                                                              */
+/* Author: Helenia                                                    */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tar.h"
+
+/* Offsets and widths of the ustar header fields we read or write */
+enum { TAR_NAME_OFF = 0, TAR_NAME_LEN = 100,
+       TAR_MODE_OFF = 100, TAR_UID_OFF = 108, TAR_GID_OFF = 116,
+       TAR_SIZE_OFF = 124, TAR_SIZE_LEN = 12,
+       TAR_MTIME_OFF = 136, TAR_CHKSUM_OFF = 148, TAR_CHKSUM_LEN = 8,
+       TAR_TYPE_OFF = 156, TAR_MAGIC_OFF = 257, TAR_VERSION_OFF = 263,
+       TAR_PREFIX_OFF = 345, TAR_PREFIX_LEN = 155 };
+
+/* Largest size an 11-digit octal size field can hold */
+#define TAR_MAX_OCTAL_SIZE ((size_t) 077777777777UL)
+
+/* Name given to the pseudo-member carrying pax records */
+static const char acPaxName[] = "././@PaxHeader";
+
+/*
+  Parses the ulLength-byte numeric field at pcField, which is either
+  space/NUL-terminated octal or GNU base-256 (high bit of first byte
+  set). Stores the value in *pulValue. Returns SUCCESS or IO_ERROR.
+*/
+static int Tar_parseNumber(const char *pcField, size_t ulLength,
+                           size_t *pulValue) {
+   size_t ulValue = 0;
+   size_t i = 0;
+
+   assert(pcField != NULL);
+   assert(pulValue != NULL);
+
+   if((unsigned char) pcField[0] & 0x80) {
+      ulValue = (unsigned char) pcField[0] & 0x7f;
+      for(i = 1; i < ulLength; i++)
+         ulValue = (ulValue << 8) | (unsigned char) pcField[i];
+      *pulValue = ulValue;
+      return SUCCESS;
+   }
+
+   while(i < ulLength && pcField[i] == ' ')
+      i++;
+   for(; i < ulLength && pcField[i] >= '0' && pcField[i] <= '7'; i++)
+      ulValue = ulValue * 8 + (size_t) (pcField[i] - '0');
+   if(i < ulLength && pcField[i] != ' ' && pcField[i] != '\0')
+      return IO_ERROR;
+
+   *pulValue = ulValue;
+   return SUCCESS;
+}
+
+/* Returns the checksum of header block pcBlock, counting the checksum
+   field itself as spaces. */
+static size_t Tar_checksum(const char *pcBlock) {
+   size_t ulSum = 0;
+   size_t i;
+
+   assert(pcBlock != NULL);
+
+   for(i = 0; i < TAR_BLOCK_SIZE; i++) {
+      if(i >= TAR_CHKSUM_OFF && i < TAR_CHKSUM_OFF + TAR_CHKSUM_LEN)
+         ulSum += ' ';
+      else
+         ulSum += (unsigned char) pcBlock[i];
+   }
+   return ulSum;
+}
+
+/* Copies the at most ulMax-byte, possibly unterminated, field pcField
+   onto the end of pcDest. */
+static void Tar_appendField(char *pcDest, const char *pcField,
+                            size_t ulMax) {
+   size_t ulLen = 0;
+   size_t ulDestLen;
+
+   while(ulLen < ulMax && pcField[ulLen] != '\0')
+      ulLen++;
+   ulDestLen = strlen(pcDest);
+   memcpy(pcDest + ulDestLen, pcField, ulLen);
+   pcDest[ulDestLen + ulLen] = '\0';
+}
+
+int Tar_parseHeader(const char *pcBlock, struct TarHeader *psHeader) {
+   size_t ulStored;
+   int iStatus;
+
+   assert(pcBlock != NULL);
+   assert(psHeader != NULL);
+
+   iStatus = Tar_parseNumber(pcBlock + TAR_CHKSUM_OFF, TAR_CHKSUM_LEN,
+                             &ulStored);
+   if(iStatus != SUCCESS || ulStored != Tar_checksum(pcBlock))
+      return IO_ERROR;
+
+   iStatus = Tar_parseNumber(pcBlock + TAR_SIZE_OFF, TAR_SIZE_LEN,
+                             &psHeader->ulSize);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   switch(pcBlock[TAR_TYPE_OFF]) {
+      case '\0': case '0': case '7':
+         psHeader->iType = TAR_FILE;
+         break;
+      case '5':
+         psHeader->iType = TAR_DIR;
+         break;
+      case 'x':
+         psHeader->iType = TAR_PAX;
+         break;
+      case 'g':
+         psHeader->iType = TAR_GLOBAL_PAX;
+         break;
+      case 'L':
+         psHeader->iType = TAR_LONGNAME;
+         break;
+      default:
+         psHeader->iType = TAR_OTHER;
+         break;
+   }
+
+   /* links, devices and fifos carry no data even if size is set */
+   if(psHeader->iType == TAR_DIR || psHeader->iType == TAR_OTHER)
+      psHeader->ulSize = 0;
+
+   psHeader->acName[0] = '\0';
+   if(!strncmp(pcBlock + TAR_MAGIC_OFF, "ustar", 5) &&
+      pcBlock[TAR_PREFIX_OFF] != '\0') {
+      Tar_appendField(psHeader->acName, pcBlock + TAR_PREFIX_OFF,
+                      TAR_PREFIX_LEN);
+      strcat(psHeader->acName, "/");
+   }
+   Tar_appendField(psHeader->acName, pcBlock + TAR_NAME_OFF,
+                   TAR_NAME_LEN);
+
+   return SUCCESS;
+}
+
+boolean Tar_isZeroBlock(const char *pcBlock) {
+   size_t i;
+
+   assert(pcBlock != NULL);
+
+   for(i = 0; i < TAR_BLOCK_SIZE; i++)
+      if(pcBlock[i] != '\0')
+         return FALSE;
+   return TRUE;
+}
+
+int Tar_parsePax(const char *pcRecords, size_t ulLength,
+                 char **ppcPath, size_t *pulSize, boolean *pbHasSize) {
+   size_t ulPos = 0;
+
+   assert(pcRecords != NULL);
+   assert(ppcPath != NULL);
+   assert(pulSize != NULL);
+   assert(pbHasSize != NULL);
+
+   /* each record is "<len> <key>=<value>\n", len counting it all */
+   while(ulPos < ulLength && pcRecords[ulPos] != '\0') {
+      size_t ulRecLen = 0;
+      size_t ulKey;
+      const char *pcValue;
+      size_t ulValueLen;
+
+      ulKey = ulPos;
+      while(ulKey < ulLength && pcRecords[ulKey] >= '0' &&
+            pcRecords[ulKey] <= '9')
+         ulRecLen = ulRecLen * 10 + (size_t) (pcRecords[ulKey++] - '0');
+      if(ulKey >= ulLength || pcRecords[ulKey] != ' ' ||
+         ulRecLen <= ulKey - ulPos + 1 || ulRecLen > ulLength - ulPos ||
+         pcRecords[ulPos + ulRecLen - 1] != '\n')
+         return IO_ERROR;
+      ulKey++;
+
+      pcValue = memchr(pcRecords + ulKey, '=',
+                       ulPos + ulRecLen - 1 - ulKey);
+      if(pcValue == NULL)
+         return IO_ERROR;
+      pcValue++;
+      ulValueLen = (size_t) (pcRecords + ulPos + ulRecLen - 1 - pcValue);
+
+      if(pcValue - (pcRecords + ulKey) == 5 &&
+         !strncmp(pcRecords + ulKey, "path=", 5)) {
+         char *pcPath = malloc(ulValueLen + 1);
+         if(pcPath == NULL)
+            return MEMORY_ERROR;
+         memcpy(pcPath, pcValue, ulValueLen);
+         pcPath[ulValueLen] = '\0';
+         free(*ppcPath);
+         *ppcPath = pcPath;
+      }
+      else if(pcValue - (pcRecords + ulKey) == 5 &&
+              !strncmp(pcRecords + ulKey, "size=", 5)) {
+         size_t ulSize = 0;
+         size_t i;
+         for(i = 0; i < ulValueLen; i++) {
+            if(pcValue[i] < '0' || pcValue[i] > '9')
+               return IO_ERROR;
+            ulSize = ulSize * 10 + (size_t) (pcValue[i] - '0');
+         }
+         *pulSize = ulSize;
+         *pbHasSize = TRUE;
+      }
+
+      ulPos += ulRecLen;
+   }
+   return SUCCESS;
+}
+
+/* Returns the length of the pax record "<len> <pcKey>=<value>\n" for
+   a value of ulValueLen bytes. */
+static size_t Tar_getRecordLength(const char *pcKey, size_t ulValueLen) {
+   size_t ulBase = 1 + strlen(pcKey) + 1 + ulValueLen + 1;
+   size_t ulDigits = 1;
+   size_t ulPow = 10;
+
+   /* the length prefix counts its own digits */
+   while(ulBase + ulDigits >= ulPow) {
+      ulDigits++;
+      ulPow *= 10;
+   }
+   return ulBase + ulDigits;
+}
+
+/*
+  Looks for a split of the ulLength-byte name pcName into a ustar
+  prefix and name. Returns the index of the '/' to split at, or 0 if
+  the name must go in a pax record instead.
+*/
+static size_t Tar_findSplit(const char *pcName, size_t ulLength) {
+   size_t i;
+
+   for(i = ulLength > TAR_NAME_LEN + 1 ? ulLength - TAR_NAME_LEN - 1
+                                       : 1;
+       i < ulLength && i <= TAR_PREFIX_LEN; i++)
+      if(pcName[i] == '/' && i + 1 < ulLength)
+         return i;
+   return 0;
+}
+
+/* Returns the length of all pax records needed for a member with
+   ulNameLen-byte name (0 if the name fits ustar) and size ulSize. */
+static size_t Tar_getPaxLength(size_t ulNameLen, boolean bNeedsPath,
+                               size_t ulSize) {
+   size_t ulLength = 0;
+   char acDigits[32];
+
+   if(bNeedsPath)
+      ulLength += Tar_getRecordLength("path", ulNameLen);
+   if(ulSize > TAR_MAX_OCTAL_SIZE) {
+      sprintf(acDigits, "%lu", (unsigned long) ulSize);
+      ulLength += Tar_getRecordLength("size", strlen(acDigits));
+   }
+   return ulLength;
+}
+
+size_t Tar_getHeaderLength(const char *pcName, boolean bIsDir,
+                           size_t ulSize) {
+   size_t ulNameLen;
+   size_t ulPax;
+
+   assert(pcName != NULL);
+
+   ulNameLen = strlen(pcName) + (bIsDir ? 1 : 0);
+   ulPax = Tar_getPaxLength(ulNameLen,
+                            ulNameLen > TAR_NAME_LEN &&
+                               Tar_findSplit(pcName, ulNameLen) == 0,
+                            ulSize);
+   if(ulPax == 0)
+      return TAR_BLOCK_SIZE;
+   return 2 * TAR_BLOCK_SIZE + ulPax + Tar_getPadding(ulPax);
+}
+
+/*
+  Fills the single ustar header block pcBlock for a member of type
+  cType and size ulSize. The member's name is the ulNameLen bytes of
+  pcName followed by a '/' if bSlash; it is split into prefix and name
+  fields, or truncated to its tail if it only fits in a pax record.
+*/
+static void Tar_formatBlock(char *pcBlock, const char *pcName,
+                            size_t ulNameLen, boolean bSlash,
+                            char cType, size_t ulSize) {
+   size_t ulFullLen = ulNameLen + (bSlash ? 1 : 0);
+   size_t ulSplit;
+   char *pcField = pcBlock + TAR_NAME_OFF;
+
+   memset(pcBlock, 0, TAR_BLOCK_SIZE);
+
+   if(ulFullLen <= TAR_NAME_LEN)
+      memcpy(pcField, pcName, ulNameLen);
+   else if((ulSplit = Tar_findSplit(pcName, ulFullLen)) != 0) {
+      memcpy(pcBlock + TAR_PREFIX_OFF, pcName, ulSplit);
+      memcpy(pcField, pcName + ulSplit + 1, ulNameLen - ulSplit - 1);
+   }
+   else {
+      /* the real name is in a pax record; keep its tail for readers
+         that ignore pax */
+      memcpy(pcField, pcName + ulFullLen - TAR_NAME_LEN,
+             TAR_NAME_LEN - (bSlash ? 1 : 0));
+   }
+   if(bSlash)
+      pcField[strlen(pcField)] = '/';
+
+   sprintf(pcBlock + TAR_MODE_OFF, "%07o", cType == '5' ? 0755 : 0644);
+   sprintf(pcBlock + TAR_UID_OFF, "%07o", 0);
+   sprintf(pcBlock + TAR_GID_OFF, "%07o", 0);
+   if(ulSize > TAR_MAX_OCTAL_SIZE)
+      ulSize = 0;
+   sprintf(pcBlock + TAR_SIZE_OFF, "%011lo", (unsigned long) ulSize);
+   sprintf(pcBlock + TAR_MTIME_OFF, "%011o", 0);
+   pcBlock[TAR_TYPE_OFF] = cType;
+   memcpy(pcBlock + TAR_MAGIC_OFF, "ustar", 6);
+   memcpy(pcBlock + TAR_VERSION_OFF, "00", 2);
+   sprintf(pcBlock + TAR_CHKSUM_OFF, "%06lo",
+           (unsigned long) Tar_checksum(pcBlock));
+   pcBlock[TAR_CHKSUM_OFF + 7] = ' ';
+}
+
+void Tar_formatHeader(char *pcOut, const char *pcName, boolean bIsDir,
+                      size_t ulSize) {
+   size_t ulLen;
+   size_t ulFullLen;
+   size_t ulPax;
+   boolean bNeedsPath;
+
+   assert(pcOut != NULL);
+   assert(pcName != NULL);
+
+   ulLen = strlen(pcName);
+   ulFullLen = ulLen + (bIsDir ? 1 : 0);
+   bNeedsPath = (boolean) (ulFullLen > TAR_NAME_LEN &&
+                           Tar_findSplit(pcName, ulFullLen) == 0);
+   ulPax = Tar_getPaxLength(ulFullLen, bNeedsPath, ulSize);
+
+   if(ulPax != 0) {
+      char *pcRec = pcOut + TAR_BLOCK_SIZE;
+
+      Tar_formatBlock(pcOut, acPaxName, strlen(acPaxName), FALSE, 'x',
+                      ulPax);
+      if(bNeedsPath) {
+         pcRec += sprintf(pcRec, "%lu path=",
+                          (unsigned long)
+                             Tar_getRecordLength("path", ulFullLen));
+         memcpy(pcRec, pcName, ulLen);
+         pcRec += ulLen;
+         if(bIsDir)
+            *pcRec++ = '/';
+         *pcRec++ = '\n';
+      }
+      if(ulSize > TAR_MAX_OCTAL_SIZE) {
+         char acDigits[32];
+         sprintf(acDigits, "%lu", (unsigned long) ulSize);
+         pcRec += sprintf(pcRec, "%lu size=%s\n",
+                          (unsigned long)
+                             Tar_getRecordLength("size",
+                                                 strlen(acDigits)),
+                          acDigits);
+      }
+      memset(pcRec, 0, Tar_getPadding(ulPax));
+      pcOut += TAR_BLOCK_SIZE + ulPax + Tar_getPadding(ulPax);
+   }
+
+   Tar_formatBlock(pcOut, pcName, ulLen, bIsDir, bIsDir ? '5' : '0',
+                   ulSize);
+}
+
+size_t Tar_getPadding(size_t ulSize) {
+   return (TAR_BLOCK_SIZE - ulSize % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+}
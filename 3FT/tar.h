@@ -0,0 +1,78 @@
+/*--------------------------------------------------------------------*/
+/* tar.h                                                              */
+/* Author: Helenia                                                    */
+/*--------------------------------------------------------------------*/
+
+#ifndef TAR_INCLUDED
+#define TAR_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  Encoding and decoding of POSIX ustar/pax archive headers. The
+  module only deals with header blocks; reading and writing member
+  data is left to the caller.
+*/
+
+/* Size of every block in an archive, and the longest member name a
+   plain ustar header (prefix + '/' + name) can carry */
+enum { TAR_BLOCK_SIZE = 512, TAR_NAME_MAX = 256 };
+
+/* Member types, as reported by Tar_parseHeader */
+enum { TAR_FILE, TAR_DIR, TAR_PAX, TAR_GLOBAL_PAX, TAR_LONGNAME,
+       TAR_OTHER };
+
+/* The fields of a member header that a File Tree cares about */
+struct TarHeader {
+   /* one of the member types above */
+   int iType;
+   /* number of data bytes following the header */
+   size_t ulSize;
+   /* '\0'-terminated name, with any ustar prefix joined on */
+   char acName[TAR_NAME_MAX + 1];
+};
+
+/*
+  Decodes the header block pcBlock (TAR_BLOCK_SIZE bytes) into
+  *psHeader. Returns SUCCESS, or IO_ERROR if the block's checksum
+  does not match or a numeric field is malformed.
+*/
+int Tar_parseHeader(const char *pcBlock, struct TarHeader *psHeader);
+
+/* Returns TRUE if pcBlock is all zero bytes (end-of-archive marker). */
+boolean Tar_isZeroBlock(const char *pcBlock);
+
+/*
+  Scans the ulLength bytes of pax extended header records at
+  pcRecords. If a "path" record is present, stores a newly allocated
+  copy of its value in *ppcPath (owned by the caller); if a "size"
+  record is present, stores its value in *pulSize and sets *pbHasSize
+  to TRUE. Other records are ignored. Returns SUCCESS, IO_ERROR if
+  the records are malformed, or MEMORY_ERROR.
+*/
+int Tar_parsePax(const char *pcRecords, size_t ulLength,
+                 char **ppcPath, size_t *pulSize, boolean *pbHasSize);
+
+/*
+  Returns the number of bytes (a multiple of TAR_BLOCK_SIZE) that
+  Tar_formatHeader will produce for a member named pcName, which is a
+  directory if bIsDir and otherwise a file of ulSize bytes. This is a
+  single block unless the name or size needs a pax extended header.
+*/
+size_t Tar_getHeaderLength(const char *pcName, boolean bIsDir,
+                           size_t ulSize);
+
+/*
+  Writes the header block(s) for the member described by pcName,
+  bIsDir and ulSize into pcOut, which must have room for
+  Tar_getHeaderLength(pcName, bIsDir, ulSize) bytes.
+*/
+void Tar_formatHeader(char *pcOut, const char *pcName, boolean bIsDir,
+                      size_t ulSize);
+
+/* Returns the number of zero bytes padding ulSize data bytes out to
+   a whole number of blocks. */
+size_t Tar_getPadding(size_t ulSize);
+
+#endif
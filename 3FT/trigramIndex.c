@@ -0,0 +1,420 @@
+/*--------------------------------------------------------------------*/
+/* trigramIndex.c                                                     */
+/* Author: Helenia                                                    */
+/*--------------------------------------------------------------------*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trigramIndex.h"
+
+/* Initial number of posting list slots in the hash table, and the
+   fewest dead node numbers worth rebuilding the posting lists for */
+enum { TRIGRAM_INITIAL_SLOTS = 1024, TRIGRAM_MIN_DEAD = 1024 };
+
+/* Most bytes one variable-length delta can take */
+enum { TRIGRAM_MAX_DELTA_BYTES = (sizeof(size_t) * 8 + 6) / 7 };
+
+/* The posting list of one trigram */
+struct TrigramPosting {
+   /* the trigram, packed into the low 24 bits */
+   unsigned long ulKey;
+   /* the deltas between successive node numbers, 7 bits per byte
+      with the high bit set on all but the last byte of a delta, in
+      ulBytes used of ulCap allocated; NULL for an unused slot */
+   unsigned char *pucData;
+   size_t ulBytes;
+   size_t ulCap;
+   /* the number of node numbers in the list, and the last one */
+   size_t ulCount;
+   size_t ulLastId;
+};
+
+/* An open-addressed hash table of posting lists, and the nodes by
+   number (NULL once removed) */
+struct TrigramIndex {
+   struct TrigramPosting *psTable;
+   size_t ulTableSize;
+   size_t ulUsed;
+   Node_T *poNById;
+   size_t ulNextId;
+   size_t ulIdCap;
+   size_t ulLive;
+   /* the node index slot holding each node's number */
+   size_t ulSlot;
+};
+
+/* Returns the trigram at pcText packed into an unsigned long. */
+static unsigned long TrigramIndex_key(const char *pcText) {
+   return ((unsigned long) (unsigned char) pcText[0] << 16) |
+          ((unsigned long) (unsigned char) pcText[1] << 8) |
+          (unsigned long) (unsigned char) pcText[2];
+}
+
+/* Returns the table position where the search for ulKey starts in a
+   table of ulTableSize (a power of 2) slots. */
+static size_t TrigramIndex_hash(unsigned long ulKey, size_t ulTableSize) {
+   return (size_t) ((ulKey * 2654435761UL) >> 7) & (ulTableSize - 1);
+}
+
+/* Returns the slot of psIndex holding ulKey's posting list, or the
+   unused slot where it belongs if there is none. */
+static struct TrigramPosting *TrigramIndex_probe(
+   struct TrigramIndex *psIndex, unsigned long ulKey) {
+   size_t ulPos = TrigramIndex_hash(ulKey, psIndex->ulTableSize);
+
+   while(psIndex->psTable[ulPos].pucData != NULL &&
+         psIndex->psTable[ulPos].ulKey != ulKey)
+      ulPos = (ulPos + 1) & (psIndex->ulTableSize - 1);
+   return &psIndex->psTable[ulPos];
+}
+
+/* Doubles the size of psIndex's hash table. Returns SUCCESS or
+   MEMORY_ERROR. */
+static int TrigramIndex_grow(struct TrigramIndex *psIndex) {
+   struct TrigramPosting *psOld = psIndex->psTable;
+   size_t ulOldSize = psIndex->ulTableSize;
+   size_t i;
+
+   psIndex->psTable = calloc(2 * ulOldSize,
+                             sizeof(struct TrigramPosting));
+   if(psIndex->psTable == NULL) {
+      psIndex->psTable = psOld;
+      return MEMORY_ERROR;
+   }
+   psIndex->ulTableSize = 2 * ulOldSize;
+   for(i = 0; i < ulOldSize; i++)
+      if(psOld[i].pucData != NULL)
+         *TrigramIndex_probe(psIndex, psOld[i].ulKey) = psOld[i];
+   free(psOld);
+   return SUCCESS;
+}
+
+/* Appends node number ulId, which is no less than any number already
+   there, to the posting list psPosting. Returns SUCCESS or
+   MEMORY_ERROR. */
+static int TrigramIndex_append(struct TrigramPosting *psPosting,
+                               size_t ulId) {
+   size_t ulDelta;
+
+   /* a name holding the same trigram twice is only listed once */
+   if(psPosting->ulCount > 0 && psPosting->ulLastId == ulId)
+      return SUCCESS;
+
+   if(psPosting->ulBytes + TRIGRAM_MAX_DELTA_BYTES > psPosting->ulCap) {
+      unsigned char *pucNew = realloc(psPosting->pucData,
+                                      2 * psPosting->ulCap);
+      if(pucNew == NULL)
+         return MEMORY_ERROR;
+      psPosting->pucData = pucNew;
+      psPosting->ulCap *= 2;
+   }
+
+   ulDelta = psPosting->ulCount == 0 ? ulId : ulId - psPosting->ulLastId;
+   while(ulDelta >= 0x80) {
+      psPosting->pucData[psPosting->ulBytes++] =
+         (unsigned char) (0x80 | (ulDelta & 0x7f));
+      ulDelta >>= 7;
+   }
+   psPosting->pucData[psPosting->ulBytes++] = (unsigned char) ulDelta;
+   psPosting->ulCount++;
+   psPosting->ulLastId = ulId;
+   return SUCCESS;
+}
+
+/* Decodes the delta at *pulPos in pucData, advancing *pulPos past it,
+   and returns it. */
+static size_t TrigramIndex_decode(const unsigned char *pucData,
+                                  size_t *pulPos) {
+   size_t ulDelta = 0;
+   unsigned int uShift = 0;
+
+   while(pucData[*pulPos] & 0x80) {
+      ulDelta |= (size_t) (pucData[(*pulPos)++] & 0x7f) << uShift;
+      uShift += 7;
+   }
+   ulDelta |= (size_t) pucData[(*pulPos)++] << uShift;
+   return ulDelta;
+}
+
+/* Files node number ulId under every trigram of pcName in psIndex.
+   Returns SUCCESS or MEMORY_ERROR. */
+static int TrigramIndex_file(struct TrigramIndex *psIndex,
+                             const char *pcName, size_t ulId) {
+   size_t ulLength = strlen(pcName);
+   size_t i;
+
+   for(i = 0; i + 3 <= ulLength; i++) {
+      unsigned long ulKey = TrigramIndex_key(pcName + i);
+      struct TrigramPosting *psPosting =
+         TrigramIndex_probe(psIndex, ulKey);
+
+      if(psPosting->pucData == NULL) {
+         /* keep the table at most half full */
+         if(2 * (psIndex->ulUsed + 1) > psIndex->ulTableSize) {
+            if(TrigramIndex_grow(psIndex) != SUCCESS)
+               return MEMORY_ERROR;
+            psPosting = TrigramIndex_probe(psIndex, ulKey);
+         }
+         psPosting->pucData = malloc(2 * TRIGRAM_MAX_DELTA_BYTES);
+         if(psPosting->pucData == NULL)
+            return MEMORY_ERROR;
+         psPosting->ulKey = ulKey;
+         psPosting->ulBytes = 0;
+         psPosting->ulCap = 2 * TRIGRAM_MAX_DELTA_BYTES;
+         psPosting->ulCount = 0;
+         psIndex->ulUsed++;
+      }
+      if(TrigramIndex_append(psPosting, ulId) != SUCCESS)
+         return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+/* Makes room in psIndex for node number psIndex->ulNextId. Returns
+   SUCCESS or MEMORY_ERROR. */
+static int TrigramIndex_reserveId(struct TrigramIndex *psIndex) {
+   Node_T *poNNew;
+
+   if(psIndex->ulNextId < psIndex->ulIdCap)
+      return SUCCESS;
+   poNNew = realloc(psIndex->poNById,
+                    2 * psIndex->ulIdCap * sizeof(Node_T));
+   if(poNNew == NULL)
+      return MEMORY_ERROR;
+   psIndex->poNById = poNNew;
+   psIndex->ulIdCap *= 2;
+   return SUCCESS;
+}
+
+/* Sets up the fields of psIndex for an empty index. Returns SUCCESS,
+   or MEMORY_ERROR leaving nothing allocated. */
+static int TrigramIndex_initFields(struct TrigramIndex *psIndex,
+                                   size_t ulSlot) {
+   psIndex->psTable = calloc(TRIGRAM_INITIAL_SLOTS,
+                             sizeof(struct TrigramPosting));
+   psIndex->poNById = malloc(TRIGRAM_INITIAL_SLOTS * sizeof(Node_T));
+   if(psIndex->psTable == NULL || psIndex->poNById == NULL) {
+      free(psIndex->psTable);
+      free(psIndex->poNById);
+      return MEMORY_ERROR;
+   }
+   psIndex->ulTableSize = TRIGRAM_INITIAL_SLOTS;
+   psIndex->ulUsed = 0;
+   psIndex->ulNextId = 0;
+   psIndex->ulIdCap = TRIGRAM_INITIAL_SLOTS;
+   psIndex->ulLive = 0;
+   psIndex->ulSlot = ulSlot;
+   return SUCCESS;
+}
+
+/* Frees everything the fields of psIndex refer to. */
+static void TrigramIndex_freeFields(struct TrigramIndex *psIndex) {
+   size_t i;
+
+   for(i = 0; i < psIndex->ulTableSize; i++)
+      free(psIndex->psTable[i].pucData);
+   free(psIndex->psTable);
+   free(psIndex->poNById);
+}
+
+/*
+  Renumbers the live nodes of psIndex consecutively, in their current
+  order, and rebuilds the posting lists without the dead numbers. If
+  there is not enough memory, leaves psIndex as it was.
+*/
+static void TrigramIndex_compact(struct TrigramIndex *psIndex) {
+   struct TrigramIndex sNew;
+   size_t ulId;
+
+   if(TrigramIndex_initFields(&sNew, psIndex->ulSlot) != SUCCESS)
+      return;
+
+   for(ulId = 0; ulId < psIndex->ulNextId; ulId++) {
+      Node_T oNNode = psIndex->poNById[ulId];
+      if(oNNode == NULL)
+         continue;
+      if(TrigramIndex_reserveId(&sNew) != SUCCESS ||
+         TrigramIndex_file(&sNew, Node_getName(oNNode), sNew.ulNextId)
+            != SUCCESS) {
+         TrigramIndex_freeFields(&sNew);
+         return;
+      }
+      sNew.poNById[sNew.ulNextId++] = oNNode;
+   }
+
+   sNew.ulLive = sNew.ulNextId;
+   for(ulId = 0; ulId < sNew.ulNextId; ulId++)
+      Node_setIndexSlot(sNew.poNById[ulId], sNew.ulSlot, ulId);
+   TrigramIndex_freeFields(psIndex);
+   *psIndex = sNew;
+}
+
+TrigramIndex_T TrigramIndex_new(size_t ulSlot) {
+   TrigramIndex_T oTIIndex;
+
+   assert(ulSlot < NODE_INDEX_SLOTS);
+
+   oTIIndex = malloc(sizeof(struct TrigramIndex));
+   if(oTIIndex == NULL)
+      return NULL;
+   if(TrigramIndex_initFields(oTIIndex, ulSlot) != SUCCESS) {
+      free(oTIIndex);
+      return NULL;
+   }
+   return oTIIndex;
+}
+
+void TrigramIndex_free(TrigramIndex_T oTIIndex) {
+   if(oTIIndex == NULL)
+      return;
+   TrigramIndex_freeFields(oTIIndex);
+   free(oTIIndex);
+}
+
+int TrigramIndex_add(TrigramIndex_T oTIIndex, Node_T oNNode) {
+   size_t ulId;
+
+   assert(oTIIndex != NULL);
+   assert(oNNode != NULL);
+
+   if(TrigramIndex_reserveId(oTIIndex) != SUCCESS)
+      return MEMORY_ERROR;
+
+   /* the number is used up even on failure: any postings already
+      written for it then refer to a dead node */
+   ulId = oTIIndex->ulNextId++;
+   oTIIndex->poNById[ulId] = NULL;
+   if(TrigramIndex_file(oTIIndex, Node_getName(oNNode), ulId)
+      != SUCCESS)
+      return MEMORY_ERROR;
+
+   oTIIndex->poNById[ulId] = oNNode;
+   Node_setIndexSlot(oNNode, oTIIndex->ulSlot, ulId);
+   oTIIndex->ulLive++;
+   return SUCCESS;
+}
+
+void TrigramIndex_remove(TrigramIndex_T oTIIndex, Node_T oNNode) {
+   size_t ulId;
+   size_t ulDead;
+
+   assert(oTIIndex != NULL);
+   assert(oNNode != NULL);
+
+   ulId = Node_getIndexSlot(oNNode, oTIIndex->ulSlot);
+   assert(ulId < oTIIndex->ulNextId &&
+          oTIIndex->poNById[ulId] == oNNode);
+   oTIIndex->poNById[ulId] = NULL;
+   oTIIndex->ulLive--;
+
+   ulDead = oTIIndex->ulNextId - oTIIndex->ulLive;
+   if(ulDead > oTIIndex->ulLive && ulDead >= TRIGRAM_MIN_DEAD)
+      TrigramIndex_compact(oTIIndex);
+}
+
+/* qsort comparison of the posting lists pointed to by pvFirst and
+   pvSecond: shortest first, and identical lists adjacent. */
+static int TrigramIndex_comparePostings(const void *pvFirst,
+                                        const void *pvSecond) {
+   const struct TrigramPosting *psFirst =
+      *(const struct TrigramPosting * const *) pvFirst;
+   const struct TrigramPosting *psSecond =
+      *(const struct TrigramPosting * const *) pvSecond;
+
+   if(psFirst->ulCount != psSecond->ulCount)
+      return psFirst->ulCount < psSecond->ulCount ? -1 : 1;
+   if(psFirst != psSecond)
+      return psFirst < psSecond ? -1 : 1;
+   return 0;
+}
+
+int TrigramIndex_search(TrigramIndex_T oTIIndex, const char *pcText,
+                        Node_T **ppoNNodes, size_t *pulCount) {
+   struct TrigramPosting **ppsPostings;
+   size_t ulPostings;
+   size_t *pulIds;
+   size_t ulIds;
+   size_t ulPos = 0;
+   size_t ulId = 0;
+   size_t i, j;
+
+   assert(oTIIndex != NULL);
+   assert(pcText != NULL && strlen(pcText) >= 3);
+   assert(ppoNNodes != NULL);
+   assert(pulCount != NULL);
+
+   *ppoNNodes = NULL;
+   *pulCount = 0;
+
+   /* look up the posting list of every trigram of pcText */
+   ulPostings = strlen(pcText) - 2;
+   ppsPostings = malloc(ulPostings * sizeof(struct TrigramPosting *));
+   if(ppsPostings == NULL)
+      return MEMORY_ERROR;
+   for(i = 0; i < ulPostings; i++) {
+      ppsPostings[i] = TrigramIndex_probe(oTIIndex,
+                                          TrigramIndex_key(pcText + i));
+      if(ppsPostings[i]->pucData == NULL) {
+         free(ppsPostings);
+         return SUCCESS;
+      }
+   }
+   qsort(ppsPostings, ulPostings, sizeof(struct TrigramPosting *),
+         TrigramIndex_comparePostings);
+
+   /* start from the shortest list... */
+   ulIds = ppsPostings[0]->ulCount;
+   pulIds = malloc(ulIds * sizeof(size_t));
+   if(pulIds == NULL) {
+      free(ppsPostings);
+      return MEMORY_ERROR;
+   }
+   for(i = 0; i < ulIds; i++) {
+      ulId += TrigramIndex_decode(ppsPostings[0]->pucData, &ulPos);
+      pulIds[i] = ulId;
+   }
+
+   /* ...and intersect it with each of the others in turn */
+   for(i = 1; i < ulPostings && ulIds > 0; i++) {
+      const struct TrigramPosting *psPosting = ppsPostings[i];
+      size_t ulKept = 0;
+      size_t ulRead = 0;
+
+      if(psPosting == ppsPostings[i - 1])
+         continue;
+      ulPos = 0;
+      ulId = 0;
+      for(j = 0; j < ulIds; j++) {
+         while(ulRead < psPosting->ulCount &&
+               (ulRead == 0 || ulId < pulIds[j])) {
+            ulId += TrigramIndex_decode(psPosting->pucData, &ulPos);
+            ulRead++;
+         }
+         if(ulRead > 0 && ulId == pulIds[j])
+            pulIds[ulKept++] = pulIds[j];
+         else if(ulRead == psPosting->ulCount && ulId < pulIds[j])
+            break;
+      }
+      ulIds = ulKept;
+   }
+   free(ppsPostings);
+
+   /* map the surviving numbers to the nodes still alive */
+   if(ulIds > 0) {
+      *ppoNNodes = malloc(ulIds * sizeof(Node_T));
+      if(*ppoNNodes == NULL) {
+         free(pulIds);
+         return MEMORY_ERROR;
+      }
+      for(i = 0; i < ulIds; i++)
+         if(oTIIndex->poNById[pulIds[i]] != NULL)
+            (*ppoNNodes)[(*pulCount)++] = oTIIndex->poNById[pulIds[i]];
+      if(*pulCount == 0) {
+         free(*ppoNNodes);
+         *ppoNNodes = NULL;
+      }
+   }
+   free(pulIds);
+   return SUCCESS;
+}
@@ -0,0 +1,54 @@
+/*--------------------------------------------------------------------*/
+/* trigramIndex.h                                                     */
+/* Author: Helenia                                                    */
+/*--------------------------------------------------------------------*/
+
+#ifndef TRIGRAMINDEX_INCLUDED
+#define TRIGRAMINDEX_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "nodeFT.h"
+
+/*
+  A TrigramIndex_T maps every three-character substring (trigram) of
+  the names of its nodes to a posting list of the nodes whose names
+  contain it. Nodes are numbered in the order they are added, and the
+  posting lists hold those numbers in increasing order, compressed as
+  variable-length deltas. Removed nodes are only forgotten by number;
+  the posting lists are rebuilt once dead entries outnumber live ones.
+*/
+typedef struct TrigramIndex *TrigramIndex_T;
+
+/*
+  Returns a new empty index that keeps each node's number in node
+  index slot ulSlot (less than NODE_INDEX_SLOTS, and not used by any
+  other live index), or NULL if there is not enough memory.
+*/
+TrigramIndex_T TrigramIndex_new(size_t ulSlot);
+
+/* Frees oTIIndex. The indexed nodes themselves are not affected. */
+void TrigramIndex_free(TrigramIndex_T oTIIndex);
+
+/*
+  Adds oNNode, filed under the trigrams of its name, to oTIIndex.
+  Returns SUCCESS, or MEMORY_ERROR (leaving oNNode out of oTIIndex)
+  if there is not enough memory.
+*/
+int TrigramIndex_add(TrigramIndex_T oTIIndex, Node_T oNNode);
+
+/* Removes oNNode, which must have been added, from oTIIndex. */
+void TrigramIndex_remove(TrigramIndex_T oTIIndex, Node_T oNNode);
+
+/*
+  Finds the nodes of oTIIndex whose names contain every trigram of
+  pcText, which must be at least three characters long: a superset of
+  the nodes whose names contain pcText. Sets *ppoNNodes to a newly
+  allocated array of them, in the order they were added, and
+  *pulCount to their number; the array is owned by the caller, and is
+  NULL if there are none. Returns SUCCESS or MEMORY_ERROR.
+*/
+int TrigramIndex_search(TrigramIndex_T oTIIndex, const char *pcText,
+                        Node_T **ppoNNodes, size_t *pulCount);
+
+#endif